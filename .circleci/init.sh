@@ -2,11 +2,9 @@
 if [[ $(uname -s) == Linux ]]; then
     yum install -y \
         make \
-        patchelf \
         binutils \
         curl-devel \
         openssl-devel \
-        file \
         which \
         rsync \
         bsdtar \
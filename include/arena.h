@@ -0,0 +1,28 @@
+/**
+ * Arena allocator
+ * @file arena.h
+ */
+#ifndef SPM_ARENA_H
+#define SPM_ARENA_H
+
+#define SPM_ARENA_BLOCK_SIZE 0x10000
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+    size_t block_size;
+    size_t bytes;           // total bytes handed out
+} Arena;
+
+Arena *arena_init(size_t block_size);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *s);
+void arena_free(Arena *arena);
+
+#endif //SPM_ARENA_H
@@ -5,5 +5,6 @@
 #define SPM_CHECKSUM_H
 
 char *sha256sum(const char *filename);
+void sha256_digest_str(const unsigned char *digest, char *result);
 
 #endif //SPM_CHECKSUM_H
@@ -0,0 +1,18 @@
+/**
+ * @file compress.h
+ */
+#ifndef SPM_COMPRESS_H
+#define SPM_COMPRESS_H
+
+#define SPM_COMPRESS_NONE 0
+#define SPM_COMPRESS_GZIP 1
+#define SPM_COMPRESS_ZSTD 2
+
+int compress_format(const char *name);
+int compress_supported(int format);
+const char *compress_extension(int format);
+int compress_detect(const char *filename);
+FILE *compress_fopen(const char *filename);
+int compress_file(const char *src, const char *dest, int format);
+
+#endif //SPM_COMPRESS_H
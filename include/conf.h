@@ -41,6 +41,11 @@ typedef struct {
     char *user_config_file;
     char *tar_program;
     int verbose;
+    int jobs;           // number of worker threads (0=all processors)
+    long manifest_ttl;  // seconds a cached remote manifest is used without revalidation
+    int solve;          // select package versions with the dependency solver (see resolve_solve)
+    int download_jobs;      // number of concurrent package downloads (0=default)
+    int download_host_jobs; // number of concurrent package downloads from one host (0=default)
     int prompt_user;
     int privileged;
     ConfigItem **config;
@@ -0,0 +1,50 @@
+/**
+ * Concurrent downloads
+ * @file download.h
+ */
+#ifndef SPM_DOWNLOAD_H
+#define SPM_DOWNLOAD_H
+
+#define SPM_DOWNLOAD_JOBS 8             // default number of concurrent transfers
+#define SPM_DOWNLOAD_HOST_JOBS 4        // default number of concurrent transfers from one host
+#define SPM_DOWNLOAD_PART_EXT ".part"   // suffix of a file being downloaded
+#define SPM_DOWNLOAD_VALIDATOR_EXT ".validator"     // suffix of the file holding the ETag of a partial file
+#define SPM_DOWNLOAD_RETRIES 5          // number of times a transfer is retried after a transient error
+#define SPM_DOWNLOAD_BACKOFF_MAX 60     // longest delay between two attempts (seconds)
+#define SPM_DOWNLOAD_ERROR_SIZE 256
+
+/**
+ * A file queued with `download_add`
+ */
+typedef struct {
+    char *url;
+    char *dest;
+    char *host;             // scheme and authority of `url` (transfers are capped per host)
+    char *sha256;           // expected SHA-256 of the file (NULL=not verified)
+    char checksum[SHA256_DIGEST_STRING_LENGTH];     // SHA-256 of the data received
+    long http_status;       // response code of the last response (0=none, or not HTTP)
+    int status;             // 0=complete, -1=failed, 1=not finished
+    char error[SPM_DOWNLOAD_ERROR_SIZE];
+    uint64_t bytes;         // bytes received, including those kept from a previous attempt
+    uint64_t size;          // expected size (0=unknown)
+    uint64_t resumed;       // bytes kept from a previous attempt
+    size_t attempts;        // number of transfers started
+} Download;
+
+typedef struct DownloadManager DownloadManager;
+
+DownloadManager *download_init(size_t jobs, size_t host_jobs);
+Download *download_add(DownloadManager *dm, const char *url, const char *dest, const char *sha256);
+Download *download_find(const DownloadManager *dm, const char *dest);
+int download_run(DownloadManager *dm);
+size_t download_count(const DownloadManager *dm);
+Download *download_item(const DownloadManager *dm, size_t index);
+void download_free(DownloadManager *dm);
+
+uint64_t download_part_resume(const char *partfile, int verified, char **validator, EVP_MD_CTX *context);
+int download_part_save(const char *partfile, const char *validator);
+void download_part_remove(const char *partfile);
+int download_retryable(int result, long http_status);
+unsigned int download_backoff(size_t attempt);
+
+#endif //SPM_DOWNLOAD_H
@@ -0,0 +1,61 @@
+/**
+ * ELF image access
+ * @file elffile.h
+ */
+#ifndef SPM_ELFFILE_H
+#define SPM_ELFFILE_H
+
+// Program header types
+#define ELF_PT_LOAD 1
+#define ELF_PT_DYNAMIC 2
+#define ELF_PT_PHDR 6
+
+// Dynamic section tags
+#define ELF_DT_NULL 0
+#define ELF_DT_NEEDED 1
+#define ELF_DT_STRTAB 5
+#define ELF_DT_STRSZ 10
+#define ELF_DT_SONAME 14
+#define ELF_DT_RPATH 15
+#define ELF_DT_RUNPATH 29
+
+/**
+ * Program header (segment) of an ELF image
+ */
+typedef struct {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t filesz;
+    uint64_t memsz;
+    uint64_t align;
+} ElfSegment;
+
+/**
+ * ELF image mapped into memory
+ */
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    int is64;               // ELFCLASS64 (otherwise ELFCLASS32)
+    int big_endian;         // ELFDATA2MSB (otherwise ELFDATA2LSB)
+    uint64_t phoff;         // file offset of the program header table
+    size_t phentsize;
+    size_t phnum;
+    uint64_t dynamic;       // file offset of the dynamic array (0=not dynamically linked)
+    size_t num_dynamic;     // entries in the dynamic array, not counting DT_NULL
+    uint64_t strtab;        // file offset of the dynamic string table
+    uint64_t strsz;         // size of the dynamic string table
+} ElfFile;
+
+ElfFile *elffile_open(const char *filename);
+uint64_t elffile_get(const ElfFile *elf, uint64_t offset, size_t size);
+int elffile_segment(const ElfFile *elf, size_t index, ElfSegment *segment);
+int elffile_vaddr_offset(const ElfFile *elf, uint64_t vaddr, uint64_t *offset);
+int elffile_dynamic(const ElfFile *elf, size_t index, uint64_t *tag, uint64_t *value);
+const char *elffile_string(const ElfFile *elf, uint64_t offset);
+int elffile_set_rpath(const char *filename, const char *rpath);
+void elffile_close(ElfFile *elf);
+
+#endif //SPM_ELFFILE_H
@@ -19,6 +19,7 @@
 #define SPM_ERR_PARSE               _SPM_ERR(9)     // general parsing error
 #define SPM_ERR_NOT_IMPLEMENTED     _SPM_ERR(10)    // not implemented (does exist on this platform)
 #define SPM_ERR_FETCH               _SPM_ERR(11)    // failed to download data (non-package)
+#define SPM_ERR_PKG_CONFLICT        _SPM_ERR(12)    // package requirements cannot be satisfied together
 
 extern int spmerrno;
 extern const char *SPM_ERR_STRING[];
@@ -0,0 +1,25 @@
+/**
+ * String keyed hash map
+ * @file hashmap.h
+ */
+#ifndef SPM_HASHMAP_H
+#define SPM_HASHMAP_H
+
+typedef struct {
+    const char *key;
+    void *value;
+} HashMapEntry;
+
+typedef struct {
+    HashMapEntry *entry;
+    size_t num_alloc;       // always a power of two
+    size_t num_inuse;
+} HashMap;
+
+HashMap *hashmap_init(size_t hint);
+void *hashmap_get(const HashMap *map, const char *key);
+int hashmap_put(HashMap *map, const char *key, void *value);
+size_t hashmap_count(const HashMap *map);
+void hashmap_free(HashMap *map);
+
+#endif //SPM_HASHMAP_H
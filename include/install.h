@@ -14,5 +14,7 @@ int spm_install(SPM_Hierarchy *fs, const char *tmpdir, const char *_package);
 int spm_install_package_record(SPM_Hierarchy *fs, char *tmpdir, char *package_name);
 int spm_check_installed(SPM_Hierarchy *fs, char *package_name);
 int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages);
+int spm_do_install_lock(SPM_Hierarchy *fs, const char *filename);
+int spm_do_lock(ManifestList *mf, StrList *packages, const char *filename);
 
 #endif //SPM_INSTALL_H
@@ -11,48 +11,166 @@
 #define SPM_MANIFEST_NODATA "*"
 #define SPM_MANIFEST_HEADER "# SPM PACKAGE MANIFEST"
 #define SPM_MANIFEST_FILENAME "manifest.dat"
+#define SPM_MANIFEST_INDEX_FILENAME "manifest.idx"
+#define SPM_MANIFEST_GENERATION_FILENAME "manifest.gen"
+#define SPM_MANIFEST_DELTA_PREFIX "manifest.delta."
+#define SPM_MANIFEST_DELTA_HEADER "# SPM MANIFEST DELTA"
+#define SPM_MANIFEST_DELTA_MAX 32       // deltas kept by a repository (and applied by a client)
+#define SPM_MANIFEST_LOCK_HEADER "# SPM LOCK FILE"
+#define SPM_MANIFEST_INDEX_MAGIC "SPMINDEX"
+#define SPM_MANIFEST_INDEX_VERSION 4
+#define SPM_MANIFEST_INDEX_BYTE_ORDER 0x01020304
 
+// manifest_from_ex flags
+#define SPM_MANIFEST_FROM_FULL 1 << 0    // Ignore the existing index and re-read every archive
+
+/**
+ * Package record. String members are owned by the `Manifest` the record belongs to and must not be modified.
+ */
 typedef struct {
     char **requirements;
     size_t requirements_records;
     size_t size;
-    char archive[SPM_PACKAGE_MEMBER_SIZE];
-    char name[SPM_PACKAGE_MEMBER_SIZE];
-    char version[SPM_PACKAGE_MEMBER_SIZE];
-    char revision[SPM_PACKAGE_MEMBER_SIZE];
-    char checksum_sha256[SHA256_DIGEST_STRING_LENGTH];
-    char origin[SPM_PACKAGE_MEMBER_ORIGIN_SIZE];
+    time_t mtime;
+    char *archive;
+    char *name;
+    char *version;
+    char *version_key;      // version_key() of `version`
+    char *revision;
+    char *checksum_sha256;
+    char *origin;
 } ManifestPackage;
 
+/**
+ * Binary manifest index header. All offsets are relative to the start of the file.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t generation;            // manifest generation (0=not tracked)
+    uint64_t records;
+    uint64_t requirements;
+    uint64_t buckets;
+    uint64_t strings;
+    uint64_t offset_records;
+    uint64_t offset_requirements;
+    uint64_t offset_buckets;
+    uint64_t offset_strings;
+} ManifestIndexHeader;
+
+/**
+ * Fixed-width package record. String members are offsets into the string table.
+ */
+typedef struct {
+    uint64_t size;
+    int64_t mtime;                  // modification time of the archive when it was indexed
+    uint32_t archive;
+    uint32_t name;
+    uint32_t version;
+    uint32_t version_key;
+    uint32_t revision;
+    uint32_t checksum_sha256;
+    uint32_t requirements;          // first slot in the requirements table
+    uint32_t requirements_records;
+    uint32_t next;                  // next record in the same hash bucket (1-based, 0=end of chain)
+} ManifestIndexRecord;
+
+typedef struct {
+    void *data;
+    size_t data_size;
+    const ManifestIndexHeader *header;
+    const ManifestIndexRecord *records;
+    const uint32_t *requirements;
+    const uint32_t *buckets;
+    const char *strings;
+} ManifestIndex;
+
+/**
+ * Span of `Manifest.by_name` holding every version of one package
+ */
+typedef struct {
+    size_t first;
+    size_t count;
+} ManifestRange;
+
 typedef struct {
     size_t records;
     ManifestPackage **packages;
-    char origin[SPM_PACKAGE_MEMBER_ORIGIN_SIZE];
+    char *origin;
+    ManifestIndex *index;
+    Arena *arena;           // storage for packages and strings
+    HashMap *strings;       // interned strings
+    HashMap *names;         // package name -> ManifestRange (built on first lookup)
+    ManifestPackage **by_name;      // packages grouped by name, each group sorted by version
+    size_t generation;      // generation published in `manifest.gen` (0=not tracked)
 } Manifest;
 
 typedef struct {
     size_t num_inuse;
     size_t num_alloc;
     Manifest **data;
+    HashMap *names;                 // package name -> ManifestRange (built on first search)
+    ManifestRange *ranges;          // storage for the values of `names`
+    ManifestPackage **by_name;      // packages of every manifest grouped by name, then by manifest, then by version
+    size_t *by_name_rank;           // position in `data` of the manifest each record in by_name came from
+    HashMap *specs;                 // specification -> compiled `VersionSpec` (see manifestlist_search)
 } ManifestList;
 
+struct VersionSpec;
+
 int fetch(const char *url, const char *dest);
+int fetch_sha256(const char *url, const char *dest, const char *sha256);
 int manifest_package_cmp(const ManifestPackage *a, const ManifestPackage *b);
 void manifest_package_separator_swap(char **name);
 void manifest_package_separator_restore(char **name);
+Manifest *manifest_init(void);
+char *manifest_intern(Manifest *info, const char *s);
+ManifestPackage *manifest_package_init(Manifest *info);
+int manifest_package_set_version(Manifest *info, ManifestPackage *package, const char *version);
+int manifest_package_set_requirements(Manifest *info, ManifestPackage *package, char **requirements, size_t count);
+char *manifest_package_str(const ManifestPackage *package);
+ManifestPackage *manifest_package_parse(Manifest *info, char *record);
 Manifest *manifest_from(const char *package_dir);
+Manifest *manifest_from_ex(const char *package_dir, int flags);
 Manifest *manifest_read(char *file_or_url);
 int manifest_write(Manifest *info, const char *dest);
 void manifest_free(Manifest *info);
 void manifest_package_free(ManifestPackage *info);
 ManifestPackage *manifest_search(const Manifest *info, const char *package);
+const ManifestRange *manifest_name_range(const Manifest *info, const char *name);
 ManifestPackage *find_by_strspec(const Manifest *manifest, const char *_strspec);
 ManifestPackage *manifest_package_copy(const ManifestPackage *manifest);
 
+char *manifest_cache_path(const char *url);
+int manifest_cache_fetch(const char *url, char **path);
+int manifest_cache_lookup(const char *url, char **path, size_t *generation);
+int manifest_cache_store(const char *url, const Manifest *info);
+
+int manifest_generation_read(const char *filename, size_t *generation);
+int manifest_generation_write(const char *filename, size_t generation);
+int manifest_delta_write(const Manifest *previous, const Manifest *current, size_t generation, FILE *fp);
+int manifest_delta_apply(Manifest *info, FILE *fp, size_t generation);
+int manifest_delta_publish(const char *pkgdir, const Manifest *previous, Manifest *current);
+
+int manifest_lock_write(const char *filename, ManifestPackage **packages);
+Manifest *manifest_lock_read(const char *filename);
+
+int manifest_index_fwrite(const Manifest *info, FILE *fp);
+int manifest_index_write(const Manifest *info, const char *dest);
+ManifestIndex *manifest_index_open(const char *filename);
+void manifest_index_close(ManifestIndex *index);
+Manifest *manifest_index_read(const char *filename);
+const char *manifest_index_str(const ManifestIndex *index, uint32_t offset);
+size_t manifest_index_first(const ManifestIndex *index, const char *name);
+size_t manifest_index_next(const ManifestIndex *index, size_t slot, const char *name);
+
 ManifestList *manifestlist_init();
 Manifest *manifestlist_item(const ManifestList *pManifestList, size_t index);
 void manifestlist_set(ManifestList *pManifestList, size_t index, Manifest *manifest);
 ManifestPackage *manifestlist_search(ManifestList *pManifestList, const char *_package);
+ManifestPackage *manifestlist_search_spec(ManifestList *pManifestList, const struct VersionSpec *spec);
+const ManifestRange *manifestlist_name_range(ManifestList *pManifestList, const char *name);
 size_t manifestlist_count(const ManifestList *pManifestList);
 void manifestlist_append(ManifestList *pManifestList, char* path);
 void manifestlist_free(ManifestList *pManifestList);
@@ -0,0 +1,23 @@
+/**
+ * Multi-pattern search
+ * @file matcher.h
+ */
+#ifndef SPM_MATCHER_H
+#define SPM_MATCHER_H
+
+/**
+ * Aho-Corasick automaton recognising a set of patterns
+ */
+typedef struct {
+    size_t num_patterns;
+    size_t num_states;
+    uint32_t *next;         // transitions: next[state * 256 + byte] (see matcher.c)
+    uint32_t *match_start;  // patterns recognised in `state`: match_list[match_start[state] .. match_start[state + 1]]
+    uint32_t *match_list;   // pattern numbers
+} Matcher;
+
+Matcher *matcher_init(char **patterns);
+size_t matcher_feed(const Matcher *matcher, uint32_t *state, const char *data, size_t size, unsigned char *found);
+void matcher_free(Matcher *matcher);
+
+#endif //SPM_MATCHER_H
@@ -4,18 +4,28 @@
 #ifndef SPM_MIME_H
 #define SPM_MIME_H
 
-typedef struct {
-    char *origin;
-    char *type;
-    char *charset;
-} Mime;
+#define SPM_MIME_TEXT_SIZE (1024 * 1024)    // number of bytes examined to tell text from binary data
+#define SPM_MIME_MAGIC_SIZE 4096            // number of bytes read to classify a file (see mime_classify)
+
+// File classes
+#define SPM_MIME_EMPTY 0            // empty file
+#define SPM_MIME_SPECIAL 1          // not a regular file (directory, device, FIFO, etc)
+#define SPM_MIME_DATA 2             // binary data of no particular format
+#define SPM_MIME_TEXT 3
+#define SPM_MIME_SCRIPT 4           // text starting with an interpreter line ("#!")
+#define SPM_MIME_ARCHIVE 5          // ar(1) archive (static library)
+#define SPM_MIME_ELF_OBJECT 6       // ELF relocatable object, core dump, etc
+#define SPM_MIME_ELF_EXEC 7         // ELF executable
+#define SPM_MIME_ELF_SHARED 8       // ELF shared library or position independent executable
+#define SPM_MIME_MACHO_OBJECT 9     // Mach-O object file, debug symbols, etc
+#define SPM_MIME_MACHO_EXEC 10      // Mach-O executable, dynamic library, bundle, or universal binary
 
-Process *file_command(const char *_filename);
-Mime *file_mimetype(const char *filename);
-void mime_free(Mime *m);
 int build(int bargc, char **bargv);
+int mime_classify_data(const char *data, size_t size);
+int mime_classify(const char *filename);
 int file_is_binary(const char *filename);
 int file_is_text(const char *filename);
 int file_is_binexec(const char *filename);
+int mime_data_is_text(const char *data, size_t size);
 
 #endif //SPM_MIME_H
@@ -12,8 +12,10 @@ typedef struct {
     char *path;
 } RelocationEntry;
 
-int relocate(const char *filename, const char *_oldstr, const char *_newstr);
+int relocate(const char *filename, const char *oldstr, const char *newstr);
+ssize_t relocate_prefixes(const char *filename, char **prefix, const char *newstr);
 void relocate_root(const char *destroot, const char *baseroot);
+void relocate_root_ex(const char *destroot, const char *baseroot, FSTree *provided);
 ssize_t replace_text(char *data, const char *_spattern, const char *_sreplacement);
 int file_replace_text(char *filename, const char *spattern, const char *sreplacement);
 RelocationEntry **prefixes_read(const char *filename);
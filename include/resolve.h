@@ -4,10 +4,48 @@
 #ifndef SPM_RESOLVE_H
 #define SPM_RESOLVE_H
 
-#define SPM_REQUIREMENT_MAX 1024
+/**
+ * Reason dependency resolution stopped
+ */
+typedef struct {
+    int code;                       // spmerrno value (0=no error)
+    char *spec;                     // specification that could not be satisfied
+    char *required_by;              // archive that requires `spec` (NULL=requested directly)
+} ResolveError;
+
+/**
+ * Package in a dependency graph
+ */
+typedef struct {
+    ManifestPackage *package;       // copy owned by the `Resolver`
+    size_t *edges;                  // nodes required by this package
+    size_t num_edges;
+    int state;                      // topological sort state
+} ResolveNode;
+
+/**
+ * Dependency graph of one or more requested packages
+ */
+typedef struct {
+    ManifestList *manifests;
+    Arena *arena;                   // storage for nodes, edges and strings
+    HashMap *visited;               // archive -> node (1-based slot in `nodes`)
+    HashMap *lookups;               // specification -> node (1-based slot in `nodes`)
+    HashMap *pinned;                // package name -> `ManifestPackage` selected by `resolve_solve` (NULL=greedy)
+    ResolveNode *nodes;
+    size_t num_nodes;
+    size_t num_alloc;
+    size_t *requested;              // nodes requested by the caller, in order
+    size_t num_requested;
+    size_t num_requested_alloc;
+    ResolveError error;
+} Resolver;
 
-void resolve_free();
-int resolve_has_dependency(const char *archive);
+Resolver *resolve_init(ManifestList *manifests);
+int resolve_add(Resolver *resolver, const char *spec);
+ManifestPackage **resolve_order(Resolver *resolver);
+void resolve_free(Resolver *resolver);
+int resolve_solve(Resolver *resolver, StrList *specs);
 ManifestPackage **resolve_dependencies(ManifestList *manifests, const char *spec);
 
 #endif //SPM_RESOLVE_H
@@ -18,7 +18,20 @@
 #define SPM_SHLIB_EXTENSION ".so"
 #endif
 
+/**
+ * Dynamic linking information of an executable or shared library
+ */
+typedef struct {
+    char *soname;       // DT_SONAME (NULL=none)
+    char *rpath;        // DT_RPATH (NULL=none)
+    char *runpath;      // DT_RUNPATH (NULL=none)
+    StrList *needed;    // DT_NEEDED
+} ShlibInfo;
+
 char *objdump(const char *_filename, char *_args);
+ShlibInfo *shlib_info(const char *filename);
+void shlib_info_forget(const char *filename);
+void shlib_info_free(ShlibInfo *info);
 char *shlib_rpath(const char *filename);
 StrList *shlib_deps(const char *_filename);
 
@@ -41,6 +41,7 @@
 #include <time.h>
 #include <sys/stat.h>
 #include <openssl/sha.h>
+#include <openssl/evp.h>
 
 #if !OS_WINDOWS
 #include <fts.h>
@@ -55,7 +56,11 @@ extern spm_vars SPM_GLOBAL;
 #include "error_handler.h"
 #include "package.h"
 #include "str.h"
+#include "arena.h"
+#include "hashmap.h"
+#include "matcher.h"
 #include "strlist.h"
+#include "elffile.h"
 #include "shlib.h"
 #include "config.h"
 #include "internal_cmd.h"
@@ -65,6 +70,7 @@ extern spm_vars SPM_GLOBAL;
 #include "fs.h"
 #include "version_spec.h"
 #include "checksum.h"
+#include "compress.h"
 #include "resolve.h"
 #include "shell.h"
 #include "relocation.h"
@@ -73,8 +79,10 @@ extern spm_vars SPM_GLOBAL;
 #include "mime.h"
 #include "mirrors.h"
 #include "user_input.h"
+#include "download.h"
 #include "install.h"
 #include "purge.h"
+#include "threadpool.h"
 
 #define SYSERROR stderr, "%s:%s:%d: %s\n", basename(__FILE__), __FUNCTION__, __LINE__, strerror(errno)
 
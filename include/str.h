@@ -35,5 +35,6 @@ char **strdup_array(char **array);
 int strcmp_array(const char **a, const char **b);
 int isdigit_s(char *s);
 char *tolower_s(char *s);
+uint64_t strhash(const char *s);
 
 #endif //SPM_STR_H
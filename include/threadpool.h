@@ -0,0 +1,19 @@
+/**
+ * Thread pool
+ * @file threadpool.h
+ */
+#ifndef SPM_THREADPOOL_H
+#define SPM_THREADPOOL_H
+
+/**
+ * Work item callback
+ * @param index item number (0 to count - 1)
+ * @param worker worker number (0 to jobs - 1)
+ * @param arg user data
+ */
+typedef void (*ThreadPoolFunc)(size_t index, size_t worker, void *arg);
+
+size_t threadpool_jobs(size_t count);
+int threadpool_run(size_t jobs, size_t count, ThreadPoolFunc func, void *arg);
+
+#endif //SPM_THREADPOOL_H
@@ -14,6 +14,10 @@
 
 #include <curl/curl.h>
 
+#define URL_STALL_TIMEOUT 30L  /* abort a transfer after this many seconds without data */
+#define URL_POLL_TIMEOUT 1000   /* longest wait for transfer activity (milliseconds) */
+#define URL_BUFFER_SIZE CURL_MAX_WRITE_SIZE    /* initial size of the read buffer */
+
 enum fcurl_type_e {
   CFTYPE_NONE = 0,
   CFTYPE_FILE = 1,
@@ -30,15 +34,26 @@ struct fcurl_data
 
   char *buffer;               /* buffer to store cached data*/
   size_t buffer_len;          /* currently allocated buffers length */
+  size_t buffer_start;        /* start of unread data in buffer */
   size_t buffer_pos;          /* end of data in buffer*/
+  char *direct;               /* caller memory receiving data before the buffer (NULL=none) */
+  size_t direct_len;          /* size of direct */
+  size_t direct_pos;          /* end of data in direct */
   int still_running;          /* Is background url fetch still in progress */
   long http_status;           /* HTTP server response code */
+  CURLcode result;            /* result of the finished transfer */
+  struct curl_slist *headers; /* extra request headers */
+  char *etag;                 /* ETag response header */
+  char *last_modified;        /* Last-Modified response header */
 };
 
 typedef struct fcurl_data URL_FILE;
 
 /* exported functions */
 URL_FILE *url_fopen(const char *url, const char *operation);
+URL_FILE *url_fopen_conditional(const char *url, const char *etag, const char *last_modified);
+URL_FILE *url_fopen_range(const char *url, curl_off_t offset, const char *validator);
+long url_status(URL_FILE *file);
 int url_fclose(URL_FILE *file);
 int url_feof(URL_FILE *file);
 size_t url_fread(void *ptr, size_t size, size_t nmemb, URL_FILE *file);
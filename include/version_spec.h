@@ -17,6 +17,26 @@
 #define VERSION_LT 1 << 4
 #define VERSION_COMPAT 1 << 5
 
+// version_key() markers (keys never contain a NUL byte)
+#define VERSION_KEY_END 0x01            // end of key
+#define VERSION_KEY_LOCAL 0x02          // local version follows
+#define VERSION_KEY_SUFFIX 0x03         // alphanumeric suffix of a segment follows
+#define VERSION_KEY_SEGMENT 0x04        // next segment follows
+#define VERSION_KEY_NUMBER 0x80         // plus the number of digits that follow
+#define VERSION_KEY_DIGITS_MAX 0x7f
+
+/**
+ * Compiled package specification (see `version_spec_compile`)
+ */
+typedef struct VersionSpec {
+    char *spec;             // specification it was compiled from
+    char *name;             // package name
+    unsigned int op;        // VERSION_* flags
+    char *lower;            // version_key() of the version operand
+    char *upper;            // version_key() of the first release excluded by `~=`, otherwise NULL
+    char data[];            // storage for the strings above
+} VersionSpec;
+
 struct Version {
     char *local;
     uint64_t asInt;
@@ -28,8 +48,17 @@ int version_read(struct Version **version, char *s);
 void version_info(struct Version *version);
 
 uint64_t version_from(const char *str);
+size_t version_key_encode(const char *str, char *dest, size_t size);
+char *version_key(const char *str);
 unsigned int version_spec_from(const char *op);
+VersionSpec *version_spec_init(const char *name, const char *op, const char *version_str);
+VersionSpec *version_spec_compile(const char *strspec);
+void version_spec_free(VersionSpec *spec);
+int version_spec_test(const VersionSpec *spec, const char *key);
+size_t version_spec_eval(const VersionSpec *spec, ManifestPackage **candidates, size_t count, unsigned char *match);
+ssize_t version_spec_best(const VersionSpec *spec, ManifestPackage **candidates, size_t count);
 ManifestPackage **find_by_spec(const Manifest *manifest, const char *name, const char *op, const char *version_str);
+void strspec_parse(const char *strspec, char *name, char *op, char *version);
 int pep440_match(const char *version);
 struct PEP440 *pep440_version(const char *version);
 
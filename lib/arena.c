@@ -0,0 +1,103 @@
+/**
+ * Arena allocator
+ *
+ * Memory is carved out of large blocks and released all at once with `arena_free`. Allocations never move, so
+ * pointers into an arena remain valid until the arena is freed.
+ *
+ * @file arena.c
+ */
+#include "spm.h"
+
+#define ARENA_ALIGN(X) (((X) + 7) & ~((size_t) 7))
+
+/**
+ * Initialize an empty `Arena`
+ * @param block_size minimum size of each block (0=`SPM_ARENA_BLOCK_SIZE`)
+ * @return success=`Arena`, failure=NULL
+ */
+Arena *arena_init(size_t block_size) {
+    Arena *arena = calloc(1, sizeof(Arena));
+    if (arena == NULL) {
+        perror("failed to allocate arena");
+        return NULL;
+    }
+    arena->block_size = block_size ? block_size : SPM_ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+/**
+ * Allocate zeroed memory from an `Arena`
+ * @param arena `Arena`
+ * @param size number of bytes
+ * @return success=pointer aligned to 8 bytes, failure=NULL
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    ArenaBlock *block = NULL;
+    void *result = NULL;
+
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    size = ARENA_ALIGN(size ? size : 1);
+    block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = arena->block_size > size ? arena->block_size : size;
+        block = calloc(1, sizeof(ArenaBlock) + block_size);
+        if (block == NULL) {
+            perror("failed to allocate arena block");
+            return NULL;
+        }
+        block->size = block_size;
+        if (arena->head != NULL && block_size == size) {
+            // Oversized allocations get a dedicated block behind the current one so its free space is not wasted
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    result = &block->data[block->used];
+    block->used += size;
+    arena->bytes += size;
+    return result;
+}
+
+/**
+ * Duplicate a string into an `Arena`
+ * @param arena `Arena`
+ * @param s string to copy
+ * @return success=copy of `s`, failure=NULL
+ */
+char *arena_strdup(Arena *arena, const char *s) {
+    size_t len;
+    char *result = NULL;
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    len = strlen(s);
+    if ((result = arena_alloc(arena, len + 1)) != NULL) {
+        memcpy(result, s, len + 1);
+    }
+    return result;
+}
+
+/**
+ * Release all memory held by an `Arena`
+ * @param arena `Arena`
+ */
+void arena_free(Arena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    for (ArenaBlock *block = arena->head; block != NULL;) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
@@ -33,10 +33,17 @@ char *sha256sum(const char *filename) {
     fclose(fp);
 
     SHA256_Final(digest, &context);
-    char *rtmp = result;
+    sha256_digest_str(digest, result);
+    return result;
+}
+
+/**
+ * Convert a SHA-256 digest to a hexadecimal string
+ * @param digest `SHA256_DIGEST_LENGTH` bytes
+ * @param result destination of at least `SHA256_DIGEST_STRING_LENGTH` bytes
+ */
+void sha256_digest_str(const unsigned char *digest, char *result) {
     for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        snprintf(&rtmp[i * 2], 3, "%02x", digest[i]);
+        snprintf(&result[i * 2], 3, "%02x", digest[i]);
     }
-
-    return result;
 }
@@ -0,0 +1,434 @@
+/**
+ * Compressed file streams
+ *
+ * Compressed files are decompressed on the fly behind a regular `FILE` handle, so readers such as the manifest parser
+ * consume them without a temporary copy. gzip support requires zlib (`HAVE_ZLIB`) and zstd support requires libzstd
+ * (`HAVE_ZSTD`).
+ *
+ * @file compress.c
+ */
+// fopencookie() requires _GNU_SOURCE, which conflicts with the basename() declared by fs.h, so spm.h is not used here
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "config.h"
+#include "compress.h"
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESS_BUFFER_SIZE 0x10000
+
+/**
+ * A decompressing reader wrapped by `compress_stream`
+ */
+struct CompressStream {
+    void *handle;
+    ssize_t (*read)(void *handle, char *buf, size_t size);
+    int (*close)(void *handle);
+};
+
+/**
+ * Convert a format name to a `SPM_COMPRESS_*` value
+ * @param name "gz", "gzip", "zst", "zstd" or "none"
+ * @return format, or -1 when the name is not recognized
+ */
+int compress_format(const char *name) {
+    if (name == NULL) {
+        return -1;
+    }
+    if (strcmp(name, "none") == 0) {
+        return SPM_COMPRESS_NONE;
+    }
+    if (strcmp(name, "gz") == 0 || strcmp(name, "gzip") == 0) {
+        return SPM_COMPRESS_GZIP;
+    }
+    if (strcmp(name, "zst") == 0 || strcmp(name, "zstd") == 0) {
+        return SPM_COMPRESS_ZSTD;
+    }
+    return -1;
+}
+
+/**
+ * Determine whether this build can read and write a format
+ * @param format `SPM_COMPRESS_*`
+ * @return 1=yes, 0=no
+ */
+int compress_supported(int format) {
+    switch (format) {
+        case SPM_COMPRESS_NONE:
+            return 1;
+#if HAVE_ZLIB
+        case SPM_COMPRESS_GZIP:
+            return 1;
+#endif
+#if HAVE_ZSTD
+        case SPM_COMPRESS_ZSTD:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Get the file name extension of a format
+ * @param format `SPM_COMPRESS_*`
+ * @return extension including the leading dot ("" for `SPM_COMPRESS_NONE`)
+ */
+const char *compress_extension(int format) {
+    switch (format) {
+        case SPM_COMPRESS_GZIP:
+            return ".gz";
+        case SPM_COMPRESS_ZSTD:
+            return ".zst";
+        default:
+            return "";
+    }
+}
+
+/**
+ * Identify the compression format of a file from its leading bytes
+ * @param filename path to file
+ * @return `SPM_COMPRESS_*`, or -1 on error
+ */
+int compress_detect(const char *filename) {
+    unsigned char magic[4] = {0};
+    FILE *fp = fopen(filename, "rb");
+    size_t bytes = 0;
+
+    if (fp == NULL) {
+        return -1;
+    }
+    bytes = fread(magic, sizeof(char), sizeof(magic), fp);
+    fclose(fp);
+
+    if (bytes >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return SPM_COMPRESS_GZIP;
+    }
+    if (bytes >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return SPM_COMPRESS_ZSTD;
+    }
+    return SPM_COMPRESS_NONE;
+}
+
+static ssize_t compress_stream_read(void *cookie, char *buf, size_t size) {
+    struct CompressStream *stream = cookie;
+    return stream->read(stream->handle, buf, size);
+}
+
+static int compress_stream_close(void *cookie) {
+    struct CompressStream *stream = cookie;
+    int result = stream->close(stream->handle);
+    free(stream);
+    return result;
+}
+
+#if defined(__APPLE__) && defined(__MACH__)
+static int compress_stream_read_darwin(void *cookie, char *buf, int size) {
+    return (int) compress_stream_read(cookie, buf, (size_t) size);
+}
+#endif
+
+/**
+ * Expose a decompressing reader as a read-only `FILE`
+ * @param handle reader state
+ * @param reader read callback
+ * @param closer close callback (called with `handle` on failure too)
+ * @return `FILE` handle, or NULL on error
+ */
+static FILE *compress_stream(void *handle, ssize_t (*reader)(void *, char *, size_t), int (*closer)(void *)) {
+    struct CompressStream *stream = calloc(1, sizeof(*stream));
+    FILE *fp = NULL;
+
+    if (stream == NULL) {
+        closer(handle);
+        return NULL;
+    }
+    stream->handle = handle;
+    stream->read = reader;
+    stream->close = closer;
+
+#if defined(__APPLE__) && defined(__MACH__)
+    fp = funopen(stream, compress_stream_read_darwin, NULL, NULL, compress_stream_close);
+#else
+    cookie_io_functions_t io = {.read = compress_stream_read, .close = compress_stream_close};
+    fp = fopencookie(stream, "r", io);
+#endif
+    if (fp == NULL) {
+        compress_stream_close(stream);
+    }
+    return fp;
+}
+
+#if HAVE_ZLIB
+static ssize_t compress_gzip_read(void *handle, char *buf, size_t size) {
+    int errnum = Z_OK;
+    int result = gzread((gzFile) handle, buf, size > INT_MAX ? INT_MAX : (unsigned) size);
+    if (result == 0) {
+        // Z_BUF_ERROR means the input ended in the middle of the stream
+        gzerror((gzFile) handle, &errnum);
+    }
+    if (result < 0 || errnum != Z_OK) {
+        errno = EIO;
+        return -1;
+    }
+    return result;
+}
+
+static int compress_gzip_close(void *handle) {
+    return gzclose_r((gzFile) handle) == Z_OK ? 0 : EOF;
+}
+#endif
+
+#if HAVE_ZSTD
+struct CompressZstd {
+    FILE *fp;
+    ZSTD_DStream *dstream;
+    ZSTD_inBuffer input;
+    char buffer[COMPRESS_BUFFER_SIZE];
+    size_t frame;           // last result of ZSTD_decompressStream (0=frame complete)
+};
+
+static ssize_t compress_zstd_read(void *handle, char *buf, size_t size) {
+    struct CompressZstd *z = handle;
+    ZSTD_outBuffer output = {buf, size, 0};
+
+    while (output.pos == 0) {
+        if (z->input.pos == z->input.size) {
+            size_t bytes = fread(z->buffer, sizeof(char), sizeof(z->buffer), z->fp);
+            if (bytes == 0) {
+                if (z->frame != 0) {
+                    // truncated frame
+                    errno = EIO;
+                    return -1;
+                }
+                break;
+            }
+            z->input.src = z->buffer;
+            z->input.size = bytes;
+            z->input.pos = 0;
+        }
+        z->frame = ZSTD_decompressStream(z->dstream, &output, &z->input);
+        if (ZSTD_isError(z->frame)) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    return (ssize_t) output.pos;
+}
+
+static int compress_zstd_close(void *handle) {
+    struct CompressZstd *z = handle;
+    int result = fclose(z->fp);
+    ZSTD_freeDStream(z->dstream);
+    free(z);
+    return result;
+}
+#endif
+
+/**
+ * Open a file for reading, decompressing it if necessary
+ *
+ * ~~~{.c}
+ * FILE *fp = compress_fopen("manifest.dat.gz");
+ * char *line = NULL;
+ * size_t line_alloc = 0;
+ * while (getline(&line, &line_alloc, fp) >= 0) {
+ *     // ...
+ * }
+ * free(line);
+ * fclose(fp);
+ * ~~~
+ *
+ * @param filename path to a plain, gzip or zstd compressed file
+ * @return `FILE` handle, or NULL on error (the format is not supported, etc)
+ */
+FILE *compress_fopen(const char *filename) {
+    int format = compress_detect(filename);
+
+    if (format < 0) {
+        return NULL;
+    }
+    if (!compress_supported(format)) {
+        fprintf(stderr, "%s: unsupported compression format\n", filename);
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    switch (format) {
+#if HAVE_ZLIB
+        case SPM_COMPRESS_GZIP: {
+            gzFile gz = gzopen(filename, "rb");
+            if (gz == NULL) {
+                return NULL;
+            }
+            gzbuffer(gz, COMPRESS_BUFFER_SIZE);
+            return compress_stream(gz, compress_gzip_read, compress_gzip_close);
+        }
+#endif
+#if HAVE_ZSTD
+        case SPM_COMPRESS_ZSTD: {
+            struct CompressZstd *z = calloc(1, sizeof(*z));
+            if (z == NULL) {
+                return NULL;
+            }
+            z->fp = fopen(filename, "rb");
+            z->dstream = ZSTD_createDStream();
+            if (z->fp == NULL || z->dstream == NULL) {
+                if (z->fp != NULL) {
+                    fclose(z->fp);
+                }
+                ZSTD_freeDStream(z->dstream);
+                free(z);
+                return NULL;
+            }
+            ZSTD_initDStream(z->dstream);
+            return compress_stream(z, compress_zstd_read, compress_zstd_close);
+        }
+#endif
+        default:
+            return fopen(filename, "r");
+    }
+}
+
+#if HAVE_ZLIB
+static int compress_file_gzip(FILE *in, int fd) {
+    char buffer[COMPRESS_BUFFER_SIZE];
+    size_t bytes = 0;
+    gzFile gz = gzdopen(fd, "wb9");
+
+    if (gz == NULL) {
+        close(fd);
+        return -1;
+    }
+    while ((bytes = fread(buffer, sizeof(char), sizeof(buffer), in)) > 0) {
+        if (gzwrite(gz, buffer, (unsigned) bytes) != (int) bytes) {
+            gzclose_w(gz);
+            return -1;
+        }
+    }
+    return gzclose_w(gz) == Z_OK && !ferror(in) ? 0 : -1;
+}
+#endif
+
+#if HAVE_ZSTD
+static int compress_file_zstd(FILE *in, int fd) {
+    char buffer[COMPRESS_BUFFER_SIZE];
+    char compressed[COMPRESS_BUFFER_SIZE];
+    size_t bytes = 0;
+    size_t remaining = 0;
+    int result = 0;
+    FILE *out = fdopen(fd, "wb");
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+
+    if (out == NULL || cctx == NULL) {
+        if (out != NULL) {
+            fclose(out);
+        } else {
+            close(fd);
+        }
+        ZSTD_freeCCtx(cctx);
+        return -1;
+    }
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 19);
+
+    do {
+        bytes = fread(buffer, sizeof(char), sizeof(buffer), in);
+        ZSTD_EndDirective mode = bytes < sizeof(buffer) ? ZSTD_e_end : ZSTD_e_continue;
+        ZSTD_inBuffer input = {buffer, bytes, 0};
+        do {
+            ZSTD_outBuffer output = {compressed, sizeof(compressed), 0};
+            remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining) || fwrite(compressed, sizeof(char), output.pos, out) != output.pos) {
+                result = -1;
+                break;
+            }
+        } while (result == 0 && (mode == ZSTD_e_end ? remaining != 0 : input.pos != input.size));
+    } while (result == 0 && bytes == sizeof(buffer));
+
+    ZSTD_freeCCtx(cctx);
+    if (fclose(out) != 0 || ferror(in)) {
+        result = -1;
+    }
+    return result;
+}
+#endif
+
+/**
+ * Write a compressed copy of a file
+ *
+ * The destination is replaced atomically, so readers never observe a partial file.
+ *
+ * @param src path to plain file
+ * @param dest path to compressed file
+ * @param format `SPM_COMPRESS_GZIP` or `SPM_COMPRESS_ZSTD`
+ * @return 0=success, -1=error
+ */
+int compress_file(const char *src, const char *dest, int format) {
+    char tmpfile[PATH_MAX];
+    FILE *in = NULL;
+    int fd = -1;
+    int result = -1;
+
+    if (format == SPM_COMPRESS_NONE || !compress_supported(format)) {
+        fprintf(stderr, "%s: unsupported compression format\n", dest);
+        return -1;
+    }
+
+    if ((in = fopen(src, "rb")) == NULL) {
+        perror(src);
+        return -1;
+    }
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", dest) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(dest);
+        fclose(in);
+        return -1;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        fclose(in);
+        return -1;
+    }
+
+    switch (format) {
+#if HAVE_ZLIB
+        case SPM_COMPRESS_GZIP:
+            result = compress_file_gzip(in, fd);
+            break;
+#endif
+#if HAVE_ZSTD
+        case SPM_COMPRESS_ZSTD:
+            result = compress_file_zstd(in, fd);
+            break;
+#endif
+        default:
+            close(fd);
+            break;
+    }
+    fclose(in);
+
+    if (result == 0 && rename(tmpfile, dest) < 0) {
+        perror(dest);
+        result = -1;
+    }
+    if (result != 0) {
+        unlink(tmpfile);
+    }
+    return result;
+}
@@ -162,18 +162,14 @@ char *get_package_manifest(void) {
 void check_runtime_environment(void) {
     int bad_rt = 0;
     char *required[] = {
-            "file",
-#if OS_LINUX
-            "patchelf",
-#elif OS_DARWIN
+#if OS_DARWIN
             "install_name_tool",
+            "objdump",
 #elif OS_WINDOWS
             // TODO: Does windows provide some kind of equivalent?
 #endif
-            "objdump",
             "rsync",
             "bash",
-            "reloc",
             NULL,
     };
 
@@ -255,6 +251,11 @@ void init_config_global(void) {
     SPM_GLOBAL.package_manifest = NULL;
     SPM_GLOBAL.config = NULL;
     SPM_GLOBAL.verbose = 0;
+    SPM_GLOBAL.jobs = 1;
+    SPM_GLOBAL.manifest_ttl = 0;
+    SPM_GLOBAL.solve = 0;
+    SPM_GLOBAL.download_jobs = SPM_DOWNLOAD_JOBS;
+    SPM_GLOBAL.download_host_jobs = SPM_DOWNLOAD_HOST_JOBS;
     SPM_GLOBAL.repo_target = NULL;
     SPM_GLOBAL.mirror_list = NULL;
     SPM_GLOBAL.prompt_user = 1;
@@ -301,6 +302,34 @@ void init_config_global(void) {
         SPM_GLOBAL.repo_target = normpath(item->value);
     }
 
+    // Initialize worker thread count
+    item = config_get(SPM_GLOBAL.config, "jobs");
+    if (item) {
+        SPM_GLOBAL.jobs = (int) strtol(item->value, NULL, 10);
+    }
+
+    // Initialize remote manifest cache lifetime
+    item = config_get(SPM_GLOBAL.config, "manifest_ttl");
+    if (item) {
+        SPM_GLOBAL.manifest_ttl = strtol(item->value, NULL, 10);
+    }
+
+    // Initialize dependency solver mode
+    item = config_get(SPM_GLOBAL.config, "solve");
+    if (item) {
+        SPM_GLOBAL.solve = (int) strtol(item->value, NULL, 10);
+    }
+
+    // Initialize package download concurrency
+    item = config_get(SPM_GLOBAL.config, "download_jobs");
+    if (item) {
+        SPM_GLOBAL.download_jobs = (int) strtol(item->value, NULL, 10);
+    }
+    item = config_get(SPM_GLOBAL.config, "download_host_jobs");
+    if (item) {
+        SPM_GLOBAL.download_host_jobs = (int) strtol(item->value, NULL, 10);
+    }
+
     // Initialize mirror list filename
     SPM_GLOBAL.mirror_config = join((char *[]) {SPM_GLOBAL.user_config_basedir, SPM_MIRROR_FILENAME, NULL}, DIRSEPS);
     item = config_get(SPM_GLOBAL.config, "mirror_config");
@@ -0,0 +1,808 @@
+/**
+ * Concurrent downloads
+ *
+ * Every file is transferred through one curl multi handle. Idle connections are kept alive and reused by the next
+ * transfer to the same host, and HTTP/2 servers multiplex several transfers over a single connection. Easy handles are
+ * recycled as well, so DNS and TLS session caches survive from one file to the next.
+ *
+ * Data is hashed as it is written, so a file can be verified against its expected checksum without reading it again.
+ *
+ * A file is written to `<dest>.part` and its ETag (or Last-Modified date) to `<dest>.part.validator`. After a
+ * transient error the transfer is retried with exponential backoff, asking the server for the missing bytes only. The
+ * validator is sent along (If-Range), so a file that changed in the meantime is sent again in full by the same
+ * response. Partial files survive a failed run and are resumed by the next one.
+ *
+ * ~~~{.c}
+ * DownloadManager *dm = download_init(SPM_DOWNLOAD_JOBS, SPM_DOWNLOAD_HOST_JOBS);
+ * download_add(dm, "https://example.com/a.tar.gz", "/tmp/a.tar.gz", NULL);
+ * download_add(dm, "https://example.com/b.tar.gz", "/tmp/b.tar.gz", "4f1c...");
+ * if (download_run(dm) != 0) {
+ *     // check download_item(dm, i)->status
+ * }
+ * download_free(dm);
+ * ~~~
+ *
+ * @file download.c
+ */
+#include <curl/curl.h>
+#include <strings.h>
+#include "spm.h"
+#include "url.h"
+
+#if SPM_DOWNLOAD_ERROR_SIZE < CURL_ERROR_SIZE
+#error "SPM_DOWNLOAD_ERROR_SIZE is too small for CURLOPT_ERRORBUFFER"
+#endif
+
+#define DOWNLOAD_WAIT_MS 1000           // longest time to wait for network activity
+#define DOWNLOAD_PROGRESS_MS 250        // shortest time between progress updates
+
+struct DownloadHost {
+    char *name;
+    size_t active;
+};
+
+struct DownloadEntry {
+    Download item;
+    struct DownloadHost *host;
+    CURL *curl;
+    FILE *fp;
+    char *partfile;
+    char *validator;                // ETag or Last-Modified date of the data in `partfile`
+    char *response_validator;       // ETag or Last-Modified date sent with the current response
+    struct curl_slist *headers;
+    EVP_MD_CTX *context;
+    size_t index;
+    long retry_at;                  // earliest time the next attempt may start (ms)
+    int response_checked;
+    int started;
+};
+
+struct DownloadManager {
+    CURLM *multi;
+    size_t jobs;                    // maximum number of transfers
+    size_t host_jobs;               // maximum number of transfers from one host
+    struct DownloadEntry **entry;
+    size_t count;
+    size_t next;                    // entries before this one have been started
+    size_t active;
+    size_t waiting;                 // entries waiting to be retried
+    size_t done;
+    HashMap *hosts;                 // host name -> struct DownloadHost
+    HashMap *dests;                 // destination -> struct DownloadEntry
+    CURL **idle;                    // easy handles waiting to be reused
+    size_t idle_count;
+    int show_progress;
+    long progress_time;             // time of the last progress update (ms)
+    int progress_shown;
+};
+
+/**
+ * Get the scheme and authority of a URL
+ * @param url
+ * @return `malloc()`ed string
+ */
+static char *download_host(const char *url) {
+    const char *authority = strstr(url, "://");
+    if (authority == NULL) {
+        return strdup("");
+    }
+    authority += 3;
+    return strndup(url, (authority - url) + strcspn(authority, "/?#"));
+}
+
+/**
+ * @return milliseconds of a monotonic clock
+ */
+static long download_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+/**
+ * Get the path of the file holding the validator of a partial file
+ * @param partfile path to the partial file
+ * @param dest destination of at least PATH_MAX bytes
+ */
+static void download_validator_path(const char *partfile, char *dest) {
+    snprintf(dest, PATH_MAX, "%s%s", partfile, SPM_DOWNLOAD_VALIDATOR_EXT);
+}
+
+/**
+ * Prepare to resume a partial download
+ *
+ * A partial file is kept when the validator of its data was saved, or when the completed file is verified against a
+ * checksum anyway. Its contents are hashed into `context` so the final checksum covers the whole file. Any other
+ * partial file is removed.
+ *
+ * @param partfile path to the partial file
+ * @param verified non-zero if the completed file will be verified against a checksum
+ * @param validator receives the saved validator, or NULL if there is none (free with `free()`)
+ * @param context initialized SHA-256 context
+ * @return offset to resume from (0=start over)
+ */
+uint64_t download_part_resume(const char *partfile, int verified, char **validator, EVP_MD_CTX *context) {
+    char path[PATH_MAX];
+    char buf[BUFSIZ];
+    uint64_t offset = 0;
+    size_t bytes = 0;
+    struct stat st;
+    FILE *fp = NULL;
+
+    *validator = NULL;
+    if (stat(partfile, &st) < 0 || st.st_size == 0) {
+        download_part_remove(partfile);
+        return 0;
+    }
+
+    download_validator_path(partfile, path);
+    if ((fp = fopen(path, "r")) != NULL) {
+        if (fgets(buf, sizeof(buf), fp) != NULL && !isempty(strip(buf))) {
+            *validator = strdup(buf);
+        }
+        fclose(fp);
+    }
+    if (*validator == NULL && !verified) {
+        download_part_remove(partfile);
+        return 0;
+    }
+
+    if ((fp = fopen(partfile, "rb")) == NULL) {
+        free(*validator);
+        *validator = NULL;
+        download_part_remove(partfile);
+        return 0;
+    }
+    while ((bytes = fread(buf, 1, sizeof(buf), fp)) != 0) {
+        EVP_DigestUpdate(context, buf, bytes);
+        offset += bytes;
+    }
+    fclose(fp);
+    return offset;
+}
+
+/**
+ * Record the validator of the data in a partial file
+ * @param partfile path to the partial file
+ * @param validator ETag or Last-Modified date (NULL=forget the validator)
+ * @return 0=success, -1=error
+ */
+int download_part_save(const char *partfile, const char *validator) {
+    char path[PATH_MAX];
+    FILE *fp = NULL;
+
+    download_validator_path(partfile, path);
+    if (validator == NULL || isempty((char *) validator)) {
+        unlink(path);
+        return 0;
+    }
+    if ((fp = fopen(path, "w")) == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "%s\n", validator);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+/**
+ * Remove a partial file and its validator
+ * @param partfile path to the partial file
+ */
+void download_part_remove(const char *partfile) {
+    char path[PATH_MAX];
+    download_validator_path(partfile, path);
+    unlink(partfile);
+    unlink(path);
+}
+
+/**
+ * Determine whether a failed transfer is worth another attempt
+ * @param result `CURLcode` of the transfer
+ * @param http_status HTTP response code (0=none)
+ * @return yes=1, no=0
+ */
+int download_retryable(int result, long http_status) {
+    switch (result) {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            return 1;
+        case CURLE_HTTP_RETURNED_ERROR:
+            return http_status == 408 || http_status == 429 || http_status >= 500;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Get the delay before an attempt
+ * @param attempt number of attempts made so far (1=first retry)
+ * @return seconds
+ */
+unsigned int download_backoff(size_t attempt) {
+    unsigned int delay = 1;
+    for (size_t i = 1; i < attempt && delay < SPM_DOWNLOAD_BACKOFF_MAX; i++) {
+        delay *= 2;
+    }
+    return delay < SPM_DOWNLOAD_BACKOFF_MAX ? delay : SPM_DOWNLOAD_BACKOFF_MAX;
+}
+
+static size_t download_write(char *buffer, size_t size, size_t nitems, void *userp) {
+    struct DownloadEntry *entry = userp;
+
+    if (!entry->response_checked) {
+        long http_status = 0;
+        curl_easy_getinfo(entry->curl, CURLINFO_RESPONSE_CODE, &http_status);
+        entry->response_checked = 1;
+        // The server ignored the range (or the file changed) and sends all of it
+        if (entry->item.resumed && http_status == 200) {
+            if (ftruncate(fileno(entry->fp), 0) < 0 || fseeko(entry->fp, 0, SEEK_SET) < 0) {
+                return 0;
+            }
+            EVP_DigestInit_ex(entry->context, EVP_sha256(), NULL);
+            entry->item.resumed = 0;
+        }
+    }
+
+    size_t written = fwrite(buffer, size, nitems, entry->fp);
+    EVP_DigestUpdate(entry->context, buffer, written * size);
+    return written * size;
+}
+
+static size_t download_header(char *buffer, size_t size, size_t nitems, void *userp) {
+    struct DownloadEntry *entry = userp;
+    size_t length = size * nitems;
+    size_t start = 0;
+    size_t end = length;
+
+    if (length > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        // A new response begins (i.e. after a redirect)
+        free(entry->response_validator);
+        entry->response_validator = NULL;
+        return length;
+    }
+    if (length > 5 && strncasecmp(buffer, "ETag:", 5) == 0) {
+        start = 5;
+    } else if (length > 14 && strncasecmp(buffer, "Last-Modified:", 14) == 0 && entry->response_validator == NULL) {
+        start = 14;
+    } else {
+        return length;
+    }
+
+    while (start < end && isspace((unsigned char) buffer[start])) {
+        start++;
+    }
+    while (end > start && isspace((unsigned char) buffer[end - 1])) {
+        end--;
+    }
+    // A weak ETag cannot be used with If-Range
+    if (end - start > 2 && strncmp(&buffer[start], "W/", 2) == 0) {
+        return length;
+    }
+    free(entry->response_validator);
+    entry->response_validator = strndup(&buffer[start], end - start);
+    return length;
+}
+
+static int download_xferinfo(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    struct DownloadEntry *entry = clientp;
+    (void) ultotal;
+    (void) ulnow;
+    entry->item.size = dltotal ? entry->item.resumed + (uint64_t) dltotal : 0;
+    entry->item.bytes = entry->item.resumed + (uint64_t) dlnow;
+    return 0;
+}
+
+/**
+ * Print the combined progress of all transfers
+ * @param dm `DownloadManager`
+ * @param final non-zero to print regardless of the time since the last update and end the line
+ */
+static void download_progress(DownloadManager *dm, int final) {
+    uint64_t bytes = 0;
+    uint64_t size = 0;
+    long now = download_clock();
+
+    if (!dm->show_progress || (!final && now - dm->progress_time < DOWNLOAD_PROGRESS_MS)) {
+        return;
+    }
+    dm->progress_time = now;
+
+    for (size_t i = 0; i < dm->count; i++) {
+        bytes += dm->entry[i]->item.bytes;
+        size += dm->entry[i]->item.size ? dm->entry[i]->item.size : dm->entry[i]->item.bytes;
+    }
+    char *str_bytes = human_readable_size(bytes);
+    char *str_size = human_readable_size(size);
+    printf("\rDownloading: %zu of %zu file(s), %s of %s    ", dm->done, dm->count, str_bytes, str_size);
+    fflush(stdout);
+    free(str_bytes);
+    free(str_size);
+    dm->progress_shown = 1;
+
+    if (final) {
+        printf("\n");
+    }
+}
+
+/**
+ * Begin a transfer, resuming a partial file when possible
+ * @param dm `DownloadManager`
+ * @param entry entry to start
+ */
+static void download_start(DownloadManager *dm, struct DownloadEntry *entry) {
+    Download *item = &entry->item;
+    char header[BUFSIZ];
+    char range[64];
+
+    entry->started = 1;
+    entry->response_checked = 0;
+    item->attempts++;
+    item->error[0] = '\0';
+    curl_slist_free_all(entry->headers);
+    entry->headers = NULL;
+    free(entry->validator);
+    free(entry->response_validator);
+    entry->validator = NULL;
+    entry->response_validator = NULL;
+
+    EVP_DigestInit_ex(entry->context, EVP_sha256(), NULL);
+    item->resumed = download_part_resume(entry->partfile, item->sha256 != NULL, &entry->validator, entry->context);
+    item->bytes = item->resumed;
+
+    entry->curl = dm->idle_count ? dm->idle[--dm->idle_count] : curl_easy_init();
+    if (entry->curl == NULL) {
+        snprintf(item->error, sizeof(item->error), "unable to start transfer");
+        goto failed;
+    }
+    if ((entry->fp = fopen(entry->partfile, item->resumed ? "ab" : "wb")) == NULL) {
+        snprintf(item->error, sizeof(item->error), "%s: %s", entry->partfile, strerror(errno));
+        goto failed;
+    }
+
+    curl_easy_reset(entry->curl);
+    curl_easy_setopt(entry->curl, CURLOPT_URL, item->url);
+    curl_easy_setopt(entry->curl, CURLOPT_PRIVATE, entry);
+    curl_easy_setopt(entry->curl, CURLOPT_WRITEFUNCTION, download_write);
+    curl_easy_setopt(entry->curl, CURLOPT_WRITEDATA, entry);
+    curl_easy_setopt(entry->curl, CURLOPT_HEADERFUNCTION, download_header);
+    curl_easy_setopt(entry->curl, CURLOPT_HEADERDATA, entry);
+    curl_easy_setopt(entry->curl, CURLOPT_XFERINFOFUNCTION, download_xferinfo);
+    curl_easy_setopt(entry->curl, CURLOPT_XFERINFODATA, entry);
+    curl_easy_setopt(entry->curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(entry->curl, CURLOPT_ERRORBUFFER, item->error);
+    curl_easy_setopt(entry->curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(entry->curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(entry->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(entry->curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(entry->curl, CURLOPT_LOW_SPEED_TIME, URL_STALL_TIMEOUT);
+    curl_easy_setopt(entry->curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+    // Wait for a connection that can be multiplexed rather than opening another one
+    curl_easy_setopt(entry->curl, CURLOPT_PIPEWAIT, 1L);
+    if (item->resumed) {
+        // CURLOPT_RESUME_FROM_LARGE would make libcurl abort a "200 OK" response, which is how a server answers a
+        // stale If-Range. Requesting a range lets download_write() restart the file from the same response instead
+        snprintf(range, sizeof(range), "%llu-", (unsigned long long) item->resumed);
+        curl_easy_setopt(entry->curl, CURLOPT_RANGE, range);
+        if (entry->validator != NULL) {
+            snprintf(header, sizeof(header), "If-Range: %s", entry->validator);
+            entry->headers = curl_slist_append(entry->headers, header);
+            curl_easy_setopt(entry->curl, CURLOPT_HTTPHEADER, entry->headers);
+        }
+    }
+
+    if (curl_multi_add_handle(dm->multi, entry->curl) != CURLM_OK) {
+        snprintf(item->error, sizeof(item->error), "unable to start transfer");
+        goto failed;
+    }
+    entry->host->active++;
+    dm->active++;
+    return;
+
+failed:
+    if (entry->fp != NULL) {
+        fclose(entry->fp);
+        entry->fp = NULL;
+    }
+    if (entry->curl != NULL) {
+        dm->idle[dm->idle_count++] = entry->curl;
+        entry->curl = NULL;
+    }
+    item->status = -1;
+    dm->done++;
+}
+
+/**
+ * Get the validator of the data written to the partial file
+ * @param entry
+ * @return validator, or NULL if there is none
+ */
+static const char *download_validator(struct DownloadEntry *entry) {
+    // Once data arrived the partial file holds the current response, with or without a validator
+    return entry->response_checked ? entry->response_validator : entry->validator;
+}
+
+/**
+ * Queue another attempt of a transfer
+ * @param dm `DownloadManager`
+ * @param entry entry to retry
+ * @param delay seconds to wait before the attempt
+ */
+static void download_retry(DownloadManager *dm, struct DownloadEntry *entry, unsigned int delay) {
+    if (delay) {
+        fprintf(stderr, "Retrying in %us: %s: %s\n", delay, entry->item.url, entry->item.error);
+    }
+    entry->started = 0;
+    entry->retry_at = download_clock() + delay * 1000L;
+    if (entry->index < dm->next) {
+        dm->next = entry->index;
+    }
+    dm->waiting++;
+}
+
+/**
+ * Complete a transfer and move the file into place
+ * @param dm `DownloadManager`
+ * @param entry finished entry
+ * @param result result of the transfer
+ */
+static void download_finish(DownloadManager *dm, struct DownloadEntry *entry, CURLcode result) {
+    Download *item = &entry->item;
+    int status = result == CURLE_OK ? 0 : -1;
+    int keep = 0;
+
+    curl_easy_getinfo(entry->curl, CURLINFO_RESPONSE_CODE, &item->http_status);
+    curl_multi_remove_handle(dm->multi, entry->curl);
+    dm->idle[dm->idle_count++] = entry->curl;
+    entry->curl = NULL;
+    entry->host->active--;
+    dm->active--;
+
+    if (fclose(entry->fp) != 0 && status == 0) {
+        snprintf(item->error, sizeof(item->error), "%s: %s", entry->partfile, strerror(errno));
+        status = -1;
+    }
+    entry->fp = NULL;
+    if (status == 0) {
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        EVP_DigestFinal_ex(entry->context, digest, NULL);
+        sha256_digest_str(digest, item->checksum);
+        if (item->sha256 != NULL && strcmp(item->checksum, item->sha256) != 0) {
+            snprintf(item->error, sizeof(item->error), "checksum mismatch (expected %s, got %s)", item->sha256, item->checksum);
+            download_part_remove(entry->partfile);
+            // The data kept from a previous attempt may belong to another version of the file
+            if (item->resumed && item->attempts <= SPM_DOWNLOAD_RETRIES) {
+                download_retry(dm, entry, 0);
+                return;
+            }
+            status = -1;
+        }
+    }
+    if (status == 0 && rename(entry->partfile, item->dest) < 0) {
+        snprintf(item->error, sizeof(item->error), "%s: %s", item->dest, strerror(errno));
+        status = -1;
+    }
+
+    if (status < 0) {
+        if (isempty(item->error)) {
+            snprintf(item->error, sizeof(item->error), "%s", curl_easy_strerror(result));
+        }
+        if (item->http_status == 416 || result == CURLE_BAD_DOWNLOAD_RESUME || result == CURLE_RANGE_ERROR) {
+            // The partial file does not fit the file on the server
+            download_part_remove(entry->partfile);
+            if (item->attempts <= SPM_DOWNLOAD_RETRIES) {
+                download_retry(dm, entry, 0);
+                return;
+            }
+        } else if (download_retryable(result, item->http_status)) {
+            keep = 1;
+            download_part_save(entry->partfile, download_validator(entry));
+            if (item->attempts <= SPM_DOWNLOAD_RETRIES) {
+                download_retry(dm, entry, download_backoff(item->attempts));
+                return;
+            }
+        }
+        if (!keep) {
+            download_part_remove(entry->partfile);
+        }
+    } else {
+        download_part_save(entry->partfile, NULL);
+        item->error[0] = '\0';
+    }
+
+    item->status = status;
+    dm->done++;
+}
+
+/**
+ * Start queued transfers while there is capacity
+ * @param dm `DownloadManager`
+ * @return milliseconds until the next retry may start, or -1 if no transfer is waiting to be retried
+ */
+static long download_schedule(DownloadManager *dm) {
+    long now = download_clock();
+    long wait = -1;
+
+    for (size_t i = dm->next; i < dm->count && dm->active < dm->jobs; i++) {
+        struct DownloadEntry *entry = dm->entry[i];
+        if (entry->started || entry->host->active >= dm->host_jobs) {
+            continue;
+        }
+        if (entry->retry_at > now) {
+            if (wait < 0 || entry->retry_at - now < wait) {
+                wait = entry->retry_at - now;
+            }
+            continue;
+        }
+        if (entry->item.attempts) {
+            dm->waiting--;
+        }
+        download_start(dm, entry);
+    }
+    while (dm->next < dm->count && dm->entry[dm->next]->started) {
+        dm->next++;
+    }
+    return wait;
+}
+
+/**
+ * Create a download manager
+ * @param jobs maximum number of concurrent transfers (0=default)
+ * @param host_jobs maximum number of concurrent transfers from one host (0=default)
+ * @return `DownloadManager`, or NULL on error
+ */
+DownloadManager *download_init(size_t jobs, size_t host_jobs) {
+    DownloadManager *dm = calloc(1, sizeof(*dm));
+    if (dm == NULL) {
+        perror("Unable to allocate download manager");
+        fprintf(SYSERROR);
+        return NULL;
+    }
+
+    dm->jobs = jobs ? jobs : SPM_DOWNLOAD_JOBS;
+    dm->host_jobs = host_jobs ? host_jobs : SPM_DOWNLOAD_HOST_JOBS;
+    dm->multi = curl_multi_init();
+    dm->hosts = hashmap_init(0);
+    dm->dests = hashmap_init(0);
+    dm->idle = calloc(dm->jobs, sizeof(*dm->idle));
+    dm->show_progress = isatty(STDOUT_FILENO);
+    if (dm->multi == NULL || dm->hosts == NULL || dm->dests == NULL || dm->idle == NULL) {
+        download_free(dm);
+        return NULL;
+    }
+
+    curl_multi_setopt(dm->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(dm->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) dm->host_jobs);
+    curl_multi_setopt(dm->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) dm->jobs);
+    return dm;
+}
+
+/**
+ * Queue a file for download
+ *
+ * Nothing is transferred until `download_run` is called. Queueing the same destination twice returns the existing
+ * item.
+ *
+ * @param dm `DownloadManager`
+ * @param url address of the file
+ * @param dest path to write the file to
+ * @param sha256 expected SHA-256 of the file (NULL=not verified). A file that does not match is discarded.
+ * @return `Download` owned by `dm`, or NULL on error
+ */
+Download *download_add(DownloadManager *dm, const char *url, const char *dest, const char *sha256) {
+    struct DownloadEntry *entry = NULL;
+    struct DownloadHost *host = NULL;
+
+    if ((entry = hashmap_get(dm->dests, dest)) != NULL) {
+        return &entry->item;
+    }
+
+    struct DownloadEntry **tmp = realloc(dm->entry, (dm->count + 1) * sizeof(*tmp));
+    if (tmp == NULL || (entry = calloc(1, sizeof(*entry))) == NULL) {
+        perror("Unable to allocate download");
+        fprintf(SYSERROR);
+        if (tmp != NULL) {
+            dm->entry = tmp;
+        }
+        return NULL;
+    }
+    dm->entry = tmp;
+
+    entry->item.url = strdup(url);
+    entry->item.dest = strdup(dest);
+    entry->item.host = download_host(url);
+    entry->item.sha256 = sha256 ? strdup(sha256) : NULL;
+    entry->item.status = 1;
+    entry->partfile = join_ex("", dest, SPM_DOWNLOAD_PART_EXT, NULL);
+    entry->context = EVP_MD_CTX_new();
+    if (entry->item.url == NULL || entry->item.dest == NULL || entry->item.host == NULL || entry->partfile == NULL
+        || (sha256 && entry->item.sha256 == NULL) || entry->context == NULL) {
+        goto failed;
+    }
+
+    if ((host = hashmap_get(dm->hosts, entry->item.host)) == NULL) {
+        if ((host = calloc(1, sizeof(*host))) == NULL || (host->name = strdup(entry->item.host)) == NULL
+            || hashmap_put(dm->hosts, host->name, host) < 0) {
+            if (host != NULL) {
+                free(host->name);
+                free(host);
+            }
+            goto failed;
+        }
+    }
+    if (hashmap_put(dm->dests, entry->item.dest, entry) < 0) {
+        goto failed;
+    }
+    entry->host = host;
+    entry->index = dm->count;
+    dm->entry[dm->count++] = entry;
+    return &entry->item;
+
+failed:
+    perror("Unable to allocate download");
+    fprintf(SYSERROR);
+    free(entry->item.url);
+    free(entry->item.dest);
+    free(entry->item.host);
+    free(entry->item.sha256);
+    free(entry->partfile);
+    EVP_MD_CTX_free(entry->context);
+    free(entry);
+    return NULL;
+}
+
+/**
+ * Find the download writing to a file
+ * @param dm `DownloadManager`
+ * @param dest path passed to `download_add`
+ * @return `Download`, or NULL if `dest` was not queued
+ */
+Download *download_find(const DownloadManager *dm, const char *dest) {
+    struct DownloadEntry *entry = hashmap_get(dm->dests, dest);
+    return entry ? &entry->item : NULL;
+}
+
+/**
+ * Transfer every queued file
+ *
+ * A file is written to `<dest>.part` and renamed to `dest` once it is complete. Transient errors are retried up to
+ * `SPM_DOWNLOAD_RETRIES` times. The outcome of each transfer is stored in its `Download`.
+ *
+ * @param dm `DownloadManager`
+ * @return number of failed transfers, or -1 if the transfers could not be driven
+ */
+int download_run(DownloadManager *dm) {
+    int failed = 0;
+    long wait = download_schedule(dm);
+
+    while (dm->active || dm->waiting) {
+        CURLMsg *msg = NULL;
+        int running = 0;
+        int queued = 0;
+
+        if (curl_multi_perform(dm->multi, &running) != CURLM_OK) {
+            failed = -1;
+            break;
+        }
+        while ((msg = curl_multi_info_read(dm->multi, &queued)) != NULL) {
+            struct DownloadEntry *entry = NULL;
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &entry);
+            download_finish(dm, entry, msg->data.result);
+        }
+        wait = download_schedule(dm);
+        download_progress(dm, 0);
+
+        if (dm->active || dm->waiting) {
+            int timeout = DOWNLOAD_WAIT_MS;
+            if (wait >= 0 && wait < timeout) {
+                timeout = (int) wait;
+            }
+            // unlike curl_multi_wait(), curl_multi_poll() also sleeps when no transfer is active (retry backoff)
+#if LIBCURL_VERSION_NUM >= 0x074200
+            if (curl_multi_poll(dm->multi, NULL, 0, timeout, NULL) != CURLM_OK) {
+#else
+            if (curl_multi_wait(dm->multi, NULL, 0, timeout, NULL) != CURLM_OK) {
+#endif
+                failed = -1;
+                break;
+            }
+        }
+    }
+    if (dm->progress_shown) {
+        download_progress(dm, 1);
+    }
+
+    if (failed < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < dm->count; i++) {
+        if (dm->entry[i]->item.status != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+ * @param dm `DownloadManager`
+ * @return number of queued files
+ */
+size_t download_count(const DownloadManager *dm) {
+    return dm->count;
+}
+
+/**
+ * @param dm `DownloadManager`
+ * @param index position in the queue
+ * @return `Download`, or NULL when `index` is out of range
+ */
+Download *download_item(const DownloadManager *dm, size_t index) {
+    if (index >= dm->count) {
+        return NULL;
+    }
+    return &dm->entry[index]->item;
+}
+
+/**
+ * Free a `DownloadManager`
+ *
+ * Unfinished transfers are aborted. Their partial files are kept so they can be resumed later.
+ *
+ * @param dm `DownloadManager`
+ */
+void download_free(DownloadManager *dm) {
+    if (dm == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < dm->count; i++) {
+        struct DownloadEntry *entry = dm->entry[i];
+        if (entry->curl != NULL) {
+            curl_multi_remove_handle(dm->multi, entry->curl);
+            curl_easy_cleanup(entry->curl);
+        }
+        if (entry->fp != NULL) {
+            fclose(entry->fp);
+            download_part_save(entry->partfile, download_validator(entry));
+        }
+        curl_slist_free_all(entry->headers);
+        free(entry->validator);
+        free(entry->response_validator);
+        free(entry->partfile);
+        EVP_MD_CTX_free(entry->context);
+        free(entry->item.url);
+        free(entry->item.dest);
+        free(entry->item.host);
+        free(entry->item.sha256);
+        free(entry);
+    }
+    for (size_t i = 0; i < dm->idle_count; i++) {
+        curl_easy_cleanup(dm->idle[i]);
+    }
+    if (dm->hosts != NULL) {
+        for (size_t i = 0; i < dm->hosts->num_alloc; i++) {
+            struct DownloadHost *host = dm->hosts->entry[i].value;
+            if (dm->hosts->entry[i].key != NULL) {
+                free(host->name);
+                free(host);
+            }
+        }
+        hashmap_free(dm->hosts);
+    }
+    hashmap_free(dm->dests);
+    if (dm->multi != NULL) {
+        curl_multi_cleanup(dm->multi);
+    }
+    free(dm->idle);
+    free(dm->entry);
+    free(dm);
+}
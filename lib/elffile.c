@@ -0,0 +1,687 @@
+/**
+ * ELF image access
+ *
+ * Files are mapped into memory and read in place. Both classes (32 and 64-bit) and both byte orders are supported, so
+ * images built for other architectures can be handled as well. Only the parts needed to reach the dynamic section
+ * are parsed: the file header, the program headers, and the dynamic array with its string table.
+ *
+ * `elffile_set_rpath` edits images in place, replacing `patchelf --force-rpath --set-rpath`.
+ *
+ * @file elffile.c
+ */
+#include "spm.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define ELF_EI_CLASS 4
+#define ELF_EI_DATA 5
+#define ELF_CLASS32 1
+#define ELF_CLASS64 2
+#define ELF_DATA2LSB 1
+#define ELF_DATA2MSB 2
+#define ELF_PN_XNUM 0xffff      // e_phnum overflowed. The count is kept in sh_info of the first section header
+#define ELF_PF_W 2
+#define ELF_PF_R 4
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_DYNAMIC 6
+
+#define ELF_EHDR_SIZE(elf) ((elf)->is64 ? 64 : 52)
+#define ELF_PHDR_SIZE(elf) ((elf)->is64 ? 56 : 32)
+#define ELF_DYN_SIZE(elf) ((elf)->is64 ? 16 : 8)
+#define ELF_WORD_SIZE(elf) ((elf)->is64 ? 8 : 4)    // size of addresses, offsets and dynamic entries
+#define ELF_FIELD(elf, off32, off64) ((elf)->is64 ? (off64) : (off32))
+
+/**
+ * Determine whether `size` bytes at `offset` are within the image
+ * @param elf `ElfFile`
+ * @param offset
+ * @param size
+ * @return 1=yes, 0=no
+ */
+static int elffile_contains(const ElfFile *elf, uint64_t offset, uint64_t size) {
+    return offset <= elf->size && size <= elf->size - offset;
+}
+
+/**
+ * Release `elf` after a parsing error
+ * @param elf `ElfFile`
+ * @param reason
+ * @return NULL
+ */
+static ElfFile *elffile_invalid(ElfFile *elf, const char *reason) {
+    spmerrno = SPM_ERR_PARSE;
+    spmerrno_cause(reason);
+    elffile_close(elf);
+    return NULL;
+}
+
+/**
+ * Map an ELF image into memory
+ * @param filename path to executable or library
+ * @param writable 0=read-only, 1=changes to `data` are written to the file
+ * @return success=`ElfFile`, failure=NULL (see `elffile_open`)
+ */
+static ElfFile *elffile_map(const char *filename, int writable) {
+    ElfFile *elf = NULL;
+    struct stat st;
+    unsigned char *data = NULL;
+    uint64_t strtab_addr = 0;
+    uint64_t strsz = 0;
+    int have_strtab = 0;
+    int fd = -1;
+
+    if (filename == NULL) {
+        spmerrno = EINVAL;
+        spmerrno_cause("filename was NULL");
+        return NULL;
+    }
+
+    if ((fd = open(filename, writable ? O_RDWR : O_RDONLY)) < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    // Too small to hold the smallest (32-bit) file header
+    if (!S_ISREG(st.st_mode) || st.st_size < 52) {
+        close(fd);
+        errno = ENOEXEC;
+        return NULL;
+    }
+    data = mmap(NULL, (size_t) st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (memcmp(data, "\x7f" "ELF", 4) != 0
+        || (data[ELF_EI_CLASS] != ELF_CLASS32 && data[ELF_EI_CLASS] != ELF_CLASS64)
+        || (data[ELF_EI_DATA] != ELF_DATA2LSB && data[ELF_EI_DATA] != ELF_DATA2MSB)) {
+        munmap(data, (size_t) st.st_size);
+        errno = ENOEXEC;
+        return NULL;
+    }
+
+    if ((elf = calloc(1, sizeof(*elf))) == NULL) {
+        munmap(data, (size_t) st.st_size);
+        return NULL;
+    }
+    elf->data = data;
+    elf->size = (size_t) st.st_size;
+    elf->is64 = data[ELF_EI_CLASS] == ELF_CLASS64;
+    elf->big_endian = data[ELF_EI_DATA] == ELF_DATA2MSB;
+
+    if (!elffile_contains(elf, 0, ELF_EHDR_SIZE(elf))) {
+        return elffile_invalid(elf, "truncated ELF header");
+    }
+    elf->phoff = elffile_get(elf, ELF_FIELD(elf, 28, 32), ELF_WORD_SIZE(elf));
+    elf->phentsize = elffile_get(elf, ELF_FIELD(elf, 42, 54), 2);
+    elf->phnum = elffile_get(elf, ELF_FIELD(elf, 44, 56), 2);
+    if (elf->phnum == ELF_PN_XNUM) {
+        uint64_t shoff = elffile_get(elf, ELF_FIELD(elf, 32, 40), ELF_WORD_SIZE(elf));
+        uint64_t sh_info = ELF_FIELD(elf, 28, 44);
+        if (!elffile_contains(elf, shoff, sh_info + 4)) {
+            return elffile_invalid(elf, "truncated ELF section header table");
+        }
+        elf->phnum = elffile_get(elf, shoff + sh_info, 4);
+    }
+    if (elf->phnum && (elf->phentsize < ELF_PHDR_SIZE(elf)
+        || !elffile_contains(elf, elf->phoff, (uint64_t) elf->phentsize * elf->phnum))) {
+        return elffile_invalid(elf, "truncated ELF program header table");
+    }
+
+    // Find the dynamic array. Static executables and relocatable objects have none
+    for (size_t i = 0; i < elf->phnum; i++) {
+        ElfSegment segment;
+        elffile_segment(elf, i, &segment);
+        if (segment.type != ELF_PT_DYNAMIC) {
+            continue;
+        }
+        if (segment.offset == 0 || !elffile_contains(elf, segment.offset, segment.filesz)) {
+            return elffile_invalid(elf, "ELF dynamic segment is outside of the file");
+        }
+        elf->dynamic = segment.offset;
+        elf->num_dynamic = segment.filesz / ELF_DYN_SIZE(elf);
+        break;
+    }
+
+    // Find its string table. DT_STRTAB holds a virtual address, so it must be mapped back to the file
+    for (size_t i = 0; i < elf->num_dynamic; i++) {
+        uint64_t tag, value;
+        elffile_dynamic(elf, i, &tag, &value);
+        if (tag == ELF_DT_NULL) {
+            elf->num_dynamic = i;
+            break;
+        } else if (tag == ELF_DT_STRTAB) {
+            strtab_addr = value;
+            have_strtab = 1;
+        } else if (tag == ELF_DT_STRSZ) {
+            strsz = value;
+        }
+    }
+    if (have_strtab) {
+        if (elffile_vaddr_offset(elf, strtab_addr, &elf->strtab) < 0) {
+            return elffile_invalid(elf, "ELF dynamic string table is outside of the file");
+        }
+        elf->strsz = elf->size - elf->strtab;
+        if (strsz && strsz < elf->strsz) {
+            elf->strsz = strsz;
+        }
+    }
+    return elf;
+}
+
+/**
+ * Map an ELF image into memory (read-only)
+ *
+ * ~~~{.c}
+ * ElfFile *elf = elffile_open("/bin/sh");
+ * for (size_t i = 0; elf != NULL && i < elf->num_dynamic; i++) {
+ *     uint64_t tag, value;
+ *     elffile_dynamic(elf, i, &tag, &value);
+ *     if (tag == ELF_DT_NEEDED) {
+ *         printf("%s\n", elffile_string(elf, value));
+ *     }
+ * }
+ * elffile_close(elf);
+ * ~~~
+ *
+ * @param filename path to executable or library
+ * @return success=`ElfFile`, failure=NULL (errno is ENOEXEC when `filename` is not an ELF image, spmerrno is
+ * SPM_ERR_PARSE when the image is damaged)
+ */
+ElfFile *elffile_open(const char *filename) {
+    return elffile_map(filename, 0);
+}
+
+/**
+ * Read an integer stored in the byte order of the image
+ * @param elf `ElfFile`
+ * @param offset file offset (the caller checks the bounds)
+ * @param size width of the integer in bytes (1, 2, 4 or 8)
+ * @return value
+ */
+uint64_t elffile_get(const ElfFile *elf, uint64_t offset, size_t size) {
+    const unsigned char *p = &elf->data[offset];
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = elf->big_endian ? size - 1 - i : i;
+        result |= (uint64_t) p[i] << (shift * 8);
+    }
+    return result;
+}
+
+/**
+ * Read a program header
+ * @param elf `ElfFile`
+ * @param index program header number
+ * @param segment destination
+ * @return 0=success, -1=no such program header
+ */
+int elffile_segment(const ElfFile *elf, size_t index, ElfSegment *segment) {
+    uint64_t base;
+
+    if (index >= elf->phnum) {
+        return -1;
+    }
+    base = elf->phoff + (uint64_t) index * elf->phentsize;
+    segment->type = (uint32_t) elffile_get(elf, base, 4);
+    if (elf->is64) {
+        segment->flags = (uint32_t) elffile_get(elf, base + 4, 4);
+        segment->offset = elffile_get(elf, base + 8, 8);
+        segment->vaddr = elffile_get(elf, base + 16, 8);
+        segment->filesz = elffile_get(elf, base + 32, 8);
+        segment->memsz = elffile_get(elf, base + 40, 8);
+        segment->align = elffile_get(elf, base + 48, 8);
+    } else {
+        segment->offset = elffile_get(elf, base + 4, 4);
+        segment->vaddr = elffile_get(elf, base + 8, 4);
+        segment->filesz = elffile_get(elf, base + 16, 4);
+        segment->memsz = elffile_get(elf, base + 20, 4);
+        segment->flags = (uint32_t) elffile_get(elf, base + 24, 4);
+        segment->align = elffile_get(elf, base + 28, 4);
+    }
+    return 0;
+}
+
+/**
+ * Translate a virtual address to a file offset using the loadable segments
+ * @param elf `ElfFile`
+ * @param vaddr virtual address
+ * @param offset destination
+ * @return 0=success, -1=`vaddr` is not backed by the file
+ */
+int elffile_vaddr_offset(const ElfFile *elf, uint64_t vaddr, uint64_t *offset) {
+    for (size_t i = 0; i < elf->phnum; i++) {
+        ElfSegment segment;
+        elffile_segment(elf, i, &segment);
+        if (segment.type != ELF_PT_LOAD || vaddr < segment.vaddr || vaddr - segment.vaddr >= segment.filesz) {
+            continue;
+        }
+        if (!elffile_contains(elf, segment.offset + (vaddr - segment.vaddr), 1)) {
+            return -1;
+        }
+        *offset = segment.offset + (vaddr - segment.vaddr);
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * Read an entry of the dynamic array
+ * @param elf `ElfFile`
+ * @param index entry number
+ * @param tag destination of `d_tag`
+ * @param value destination of `d_val` (or `d_ptr`)
+ * @return 0=success, -1=no such entry
+ */
+int elffile_dynamic(const ElfFile *elf, size_t index, uint64_t *tag, uint64_t *value) {
+    uint64_t base;
+
+    if (elf->dynamic == 0 || index >= elf->num_dynamic) {
+        return -1;
+    }
+    base = elf->dynamic + (uint64_t) index * ELF_DYN_SIZE(elf);
+    *tag = elffile_get(elf, base, ELF_WORD_SIZE(elf));
+    *value = elffile_get(elf, base + ELF_WORD_SIZE(elf), ELF_WORD_SIZE(elf));
+    return 0;
+}
+
+/**
+ * Get a string from the dynamic string table
+ * @param elf `ElfFile`
+ * @param offset offset into the string table (e.g. the value of a DT_NEEDED entry)
+ * @return pointer into the image, or NULL if the string is not terminated within the table
+ */
+const char *elffile_string(const ElfFile *elf, uint64_t offset) {
+    const char *result = NULL;
+
+    if (offset >= elf->strsz) {
+        return NULL;
+    }
+    result = (const char *) &elf->data[elf->strtab + offset];
+    if (memchr(result, '\0', elf->strsz - offset) == NULL) {
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Store an integer in the byte order of the image
+ * @param elf `ElfFile`
+ * @param dest destination (in the image, or in a buffer to be written to it)
+ * @param size width of the integer in bytes (1, 2, 4 or 8)
+ * @param value
+ */
+static void elffile_store(const ElfFile *elf, unsigned char *dest, size_t size, uint64_t value) {
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = elf->big_endian ? size - 1 - i : i;
+        dest[i] = (unsigned char) (value >> (shift * 8));
+    }
+}
+
+/**
+ * Store a program header (`p_paddr` is set to `p_vaddr`)
+ * @param elf `ElfFile`
+ * @param dest destination
+ * @param segment
+ */
+static void elffile_segment_store(const ElfFile *elf, unsigned char *dest, const ElfSegment *segment) {
+    elffile_store(elf, dest, 4, segment->type);
+    if (elf->is64) {
+        elffile_store(elf, dest + 4, 4, segment->flags);
+        elffile_store(elf, dest + 8, 8, segment->offset);
+        elffile_store(elf, dest + 16, 8, segment->vaddr);
+        elffile_store(elf, dest + 24, 8, segment->vaddr);
+        elffile_store(elf, dest + 32, 8, segment->filesz);
+        elffile_store(elf, dest + 40, 8, segment->memsz);
+        elffile_store(elf, dest + 48, 8, segment->align);
+    } else {
+        elffile_store(elf, dest + 4, 4, segment->offset);
+        elffile_store(elf, dest + 8, 4, segment->vaddr);
+        elffile_store(elf, dest + 12, 4, segment->vaddr);
+        elffile_store(elf, dest + 16, 4, segment->filesz);
+        elffile_store(elf, dest + 20, 4, segment->memsz);
+        elffile_store(elf, dest + 24, 4, segment->flags);
+        elffile_store(elf, dest + 28, 4, segment->align);
+    }
+}
+
+/**
+ * Store an entry of a dynamic array
+ * @param elf `ElfFile`
+ * @param dynamic start of the dynamic array
+ * @param index entry number
+ * @param tag
+ * @param value
+ */
+static void elffile_dynamic_store(const ElfFile *elf, unsigned char *dynamic, size_t index, uint64_t tag, uint64_t value) {
+    unsigned char *dest = &dynamic[index * ELF_DYN_SIZE(elf)];
+    elffile_store(elf, dest, ELF_WORD_SIZE(elf), tag);
+    elffile_store(elf, dest + ELF_WORD_SIZE(elf), ELF_WORD_SIZE(elf), value);
+}
+
+/**
+ * Point the section header describing data that moved to its new location
+ *
+ * Nothing needs the section headers at run time, but tools reading the file (readelf, strip, ...) rely on them.
+ *
+ * @param elf `ElfFile` (writable)
+ * @param type section type
+ * @param offset old file offset of the section
+ * @param new_offset
+ * @param new_addr
+ * @param new_size
+ */
+static void elffile_section_move(ElfFile *elf, uint32_t type, uint64_t offset, uint64_t new_offset, uint64_t new_addr,
+                                 uint64_t new_size) {
+    size_t word = ELF_WORD_SIZE(elf);
+    uint64_t shoff = elffile_get(elf, ELF_FIELD(elf, 32, 40), word);
+    size_t shentsize = elffile_get(elf, ELF_FIELD(elf, 46, 58), 2);
+    size_t shnum = elffile_get(elf, ELF_FIELD(elf, 48, 60), 2);
+
+    if (shoff == 0 || shentsize < ELF_FIELD(elf, 40u, 64u) || !elffile_contains(elf, shoff, (uint64_t) shentsize * shnum)) {
+        return;
+    }
+    for (size_t i = 0; i < shnum; i++) {
+        uint64_t base = shoff + (uint64_t) i * shentsize;
+        if (elffile_get(elf, base + 4, 4) != type || elffile_get(elf, base + ELF_FIELD(elf, 16, 24), word) != offset) {
+            continue;
+        }
+        elffile_store(elf, &elf->data[base + ELF_FIELD(elf, 12, 16)], word, new_addr);
+        elffile_store(elf, &elf->data[base + ELF_FIELD(elf, 16, 24)], word, new_offset);
+        elffile_store(elf, &elf->data[base + ELF_FIELD(elf, 20, 32)], word, new_size);
+    }
+}
+
+/**
+ * Give an ELF image a new DT_RPATH string stored in a new loadable segment at the end of the file
+ *
+ * The segment holds a copy of the dynamic string table with `rpath` appended, so every existing string keeps its
+ * offset. The program header table moves into the segment as well, because it needs one more entry. The dynamic
+ * array moves there too when a DT_RPATH entry must be added and it has no free slot.
+ *
+ * The segment is placed at the same distance from the first loadable segment in the file and in memory, so kernels
+ * that derive the address of the program headers from `e_phoff` (instead of PT_PHDR) find them too.
+ *
+ * @param elf `ElfFile` (writable)
+ * @param filename path to `elf`
+ * @param rpath new search path
+ * @param rpath_entry index of the DT_RPATH entry (-1=none)
+ * @param runpath_entry index of the DT_RUNPATH entry (-1=none)
+ * @return 0=success, -1=error
+ */
+static int elffile_rpath_append(ElfFile *elf, const char *filename, const char *rpath, ssize_t rpath_entry,
+                                ssize_t runpath_entry) {
+    size_t dyn_size = ELF_DYN_SIZE(elf);
+    size_t rpath_size = strlen(rpath) + 1;
+    ElfSegment dynamic_segment = {0};
+    ElfSegment first_load = {0};
+    ssize_t last_load = -1;
+    ssize_t strtab_entry = -1;
+    ssize_t strsz_entry = -1;
+    uint64_t align = 0;
+    uint64_t end = 0;
+    int add_entry = rpath_entry < 0 && runpath_entry < 0;
+    int move_dynamic = 0;
+    size_t num_edited = elf->num_dynamic + (add_entry ? 2 : 0);
+    uint64_t phdr_size = (uint64_t) (elf->phnum + 1) * elf->phentsize;
+    uint64_t dynamic_offset = phdr_size;
+    uint64_t strtab_offset = phdr_size;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t size;
+    unsigned char *buffer = NULL;
+    unsigned char *edited = NULL;
+    int fd = -1;
+
+    for (size_t i = 0; i < elf->phnum; i++) {
+        ElfSegment segment;
+        elffile_segment(elf, i, &segment);
+        if (segment.type == ELF_PT_DYNAMIC) {
+            dynamic_segment = segment;
+        }
+        if (segment.type != ELF_PT_LOAD) {
+            continue;
+        }
+        if (last_load < 0 || segment.vaddr < first_load.vaddr) {
+            first_load = segment;
+        }
+        if (segment.align > align) {
+            align = segment.align;
+        }
+        if (segment.vaddr + segment.memsz > end) {
+            end = segment.vaddr + segment.memsz;
+        }
+        last_load = (ssize_t) i;
+    }
+    for (size_t i = 0; i < elf->num_dynamic; i++) {
+        uint64_t tag, value;
+        elffile_dynamic(elf, i, &tag, &value);
+        if (tag == ELF_DT_STRTAB) {
+            strtab_entry = (ssize_t) i;
+        } else if (tag == ELF_DT_STRSZ) {
+            strsz_entry = (ssize_t) i;
+        }
+    }
+    if (last_load < 0 || strtab_entry < 0 || strsz_entry < 0 || first_load.vaddr < first_load.offset
+        || elf->phnum + 1 >= ELF_PN_XNUM) {
+        spmerrno = SPM_ERR_PARSE;
+        spmerrno_cause("ELF image cannot be extended");
+        return -1;
+    }
+    if (align < 2) {
+        align = (uint64_t) sysconf(_SC_PAGESIZE);
+    }
+
+    // Layout of the new segment: program headers, dynamic array (when moved), string table
+    if (add_entry && dynamic_segment.filesz / dyn_size < elf->num_dynamic + 2) {
+        move_dynamic = 1;
+        strtab_offset = dynamic_offset + num_edited * dyn_size;
+    }
+    size = strtab_offset + elf->strsz + rpath_size;
+    offset = end - (first_load.vaddr - first_load.offset);
+    if (offset < elf->size) {
+        offset = elf->size;
+    }
+    offset = (offset + align - 1) / align * align;
+    vaddr = offset + (first_load.vaddr - first_load.offset);
+
+    buffer = calloc(size, sizeof(*buffer));
+    edited = calloc(elf->num_dynamic + 2, dyn_size);
+    if (buffer == NULL || edited == NULL) {
+        free(buffer);
+        free(edited);
+        return -1;
+    }
+
+    // Program headers. The new PT_LOAD follows the others (they are sorted by address)
+    for (size_t i = 0, n = 0; i < elf->phnum; i++) {
+        unsigned char *dest = &buffer[n++ * elf->phentsize];
+        ElfSegment segment;
+
+        elffile_segment(elf, i, &segment);
+        memcpy(dest, &elf->data[elf->phoff + i * elf->phentsize], elf->phentsize);
+        if (segment.type == ELF_PT_PHDR) {
+            segment.offset = offset;
+            segment.vaddr = vaddr;
+            segment.filesz = segment.memsz = phdr_size;
+            elffile_segment_store(elf, dest, &segment);
+        } else if (segment.type == ELF_PT_DYNAMIC && move_dynamic) {
+            segment.offset = offset + dynamic_offset;
+            segment.vaddr = vaddr + dynamic_offset;
+            segment.filesz = segment.memsz = num_edited * dyn_size;
+            elffile_segment_store(elf, dest, &segment);
+        }
+
+        if ((ssize_t) i == last_load) {
+            ElfSegment load = {
+                .type = ELF_PT_LOAD,
+                .flags = move_dynamic ? ELF_PF_R | ELF_PF_W : ELF_PF_R,    // the dynamic linker writes to the dynamic array
+                .offset = offset,
+                .vaddr = vaddr,
+                .filesz = size,
+                .memsz = size,
+                .align = align,
+            };
+            elffile_segment_store(elf, &buffer[n++ * elf->phentsize], &load);
+        }
+    }
+
+    // Dynamic array
+    memcpy(edited, &elf->data[elf->dynamic], elf->num_dynamic * dyn_size);
+    elffile_dynamic_store(elf, edited, (size_t) strtab_entry, ELF_DT_STRTAB, vaddr + strtab_offset);
+    elffile_dynamic_store(elf, edited, (size_t) strsz_entry, ELF_DT_STRSZ, elf->strsz + rpath_size);
+    if (rpath_entry >= 0) {
+        elffile_dynamic_store(elf, edited, (size_t) rpath_entry, ELF_DT_RPATH, elf->strsz);
+    }
+    if (runpath_entry >= 0) {
+        elffile_dynamic_store(elf, edited, (size_t) runpath_entry, rpath_entry < 0 ? ELF_DT_RPATH : ELF_DT_RUNPATH, elf->strsz);
+    }
+    if (add_entry) {
+        elffile_dynamic_store(elf, edited, elf->num_dynamic, ELF_DT_RPATH, elf->strsz);
+    }
+    if (move_dynamic) {
+        memcpy(&buffer[dynamic_offset], edited, num_edited * dyn_size);
+    }
+
+    // String table
+    memcpy(&buffer[strtab_offset], &elf->data[elf->strtab], elf->strsz);
+    memcpy(&buffer[strtab_offset + elf->strsz], rpath, rpath_size);
+
+    // Write the segment (beyond the mapped image) before changing anything that refers to it
+    if ((fd = open(filename, O_WRONLY)) < 0) {
+        free(buffer);
+        free(edited);
+        return -1;
+    }
+    for (uint64_t written = 0; written < size;) {
+        ssize_t bytes = pwrite(fd, &buffer[written], size - written, (off_t) (offset + written));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            if (ftruncate(fd, (off_t) elf->size) < 0) {
+                perror(filename);
+            }
+            close(fd);
+            free(buffer);
+            free(edited);
+            return -1;
+        }
+        written += (uint64_t) bytes;
+    }
+    close(fd);
+
+    if (!move_dynamic) {
+        memcpy(&elf->data[elf->dynamic], edited, num_edited * dyn_size);
+    }
+    elffile_store(elf, &elf->data[ELF_FIELD(elf, 28, 32)], ELF_WORD_SIZE(elf), offset);
+    elffile_store(elf, &elf->data[ELF_FIELD(elf, 44, 56)], 2, elf->phnum + 1);
+    elffile_section_move(elf, ELF_SHT_STRTAB, elf->strtab, offset + strtab_offset, vaddr + strtab_offset,
+                         elf->strsz + rpath_size);
+    if (move_dynamic) {
+        elffile_section_move(elf, ELF_SHT_DYNAMIC, elf->dynamic, offset + dynamic_offset, vaddr + dynamic_offset,
+                             num_edited * dyn_size);
+    }
+
+    free(buffer);
+    free(edited);
+    return 0;
+}
+
+/**
+ * Set the RPATH of an ELF executable or library (like `patchelf --force-rpath --set-rpath`)
+ *
+ * When every existing DT_RPATH and DT_RUNPATH string is long enough, `rpath` is written over it. Otherwise the string
+ * table is relocated to a new segment (see `elffile_rpath_append`). A lone DT_RUNPATH becomes a DT_RPATH.
+ *
+ * @param filename path to executable or library
+ * @param rpath new search path
+ * @return 0=success, -1=error (errno is ENOEXEC when `filename` is not a dynamically linked ELF image)
+ */
+int elffile_set_rpath(const char *filename, const char *rpath) {
+    ElfFile *elf = NULL;
+    ssize_t rpath_entry = -1;
+    ssize_t runpath_entry = -1;
+    size_t rpath_len = 0;
+    int fits = 1;
+    int result = 0;
+
+    if (rpath == NULL) {
+        spmerrno = EINVAL;
+        spmerrno_cause("rpath was NULL");
+        return -1;
+    }
+    if ((elf = elffile_map(filename, 1)) == NULL) {
+        return -1;
+    }
+    if (elf->dynamic == 0 || elf->strsz == 0) {
+        elffile_close(elf);
+        errno = ENOEXEC;
+        return -1;
+    }
+
+    rpath_len = strlen(rpath);
+    for (size_t i = 0; i < elf->num_dynamic; i++) {
+        const char *str = NULL;
+        uint64_t tag, value;
+
+        elffile_dynamic(elf, i, &tag, &value);
+        if (tag == ELF_DT_RPATH) {
+            rpath_entry = (ssize_t) i;
+        } else if (tag == ELF_DT_RUNPATH) {
+            runpath_entry = (ssize_t) i;
+        } else {
+            continue;
+        }
+
+        if ((str = elffile_string(elf, value)) == NULL) {
+            spmerrno = SPM_ERR_PARSE;
+            spmerrno_cause("ELF dynamic entry refers to an invalid string");
+            elffile_close(elf);
+            return -1;
+        }
+        if (strlen(str) < rpath_len) {
+            fits = 0;
+        }
+    }
+
+    if (fits && (rpath_entry >= 0 || runpath_entry >= 0)) {
+        ssize_t entry[] = {rpath_entry, runpath_entry};
+        for (size_t i = 0; i < sizeof(entry) / sizeof(*entry); i++) {
+            uint64_t tag, value;
+            char *str = NULL;
+
+            if (entry[i] < 0) {
+                continue;
+            }
+            elffile_dynamic(elf, (size_t) entry[i], &tag, &value);
+            str = (char *) elffile_string(elf, value);
+            memset(str, '\0', strlen(str));
+            memcpy(str, rpath, rpath_len);
+        }
+        if (rpath_entry < 0) {
+            elffile_store(elf, &elf->data[elf->dynamic + runpath_entry * ELF_DYN_SIZE(elf)], ELF_WORD_SIZE(elf), ELF_DT_RPATH);
+        }
+    } else {
+        result = elffile_rpath_append(elf, filename, rpath, rpath_entry, runpath_entry);
+    }
+
+    elffile_close(elf);
+    return result;
+}
+
+/**
+ * Unmap an ELF image
+ * @param elf `ElfFile`
+ */
+void elffile_close(ElfFile *elf) {
+    if (elf != NULL) {
+        munmap(elf->data, elf->size);
+        free(elf);
+    }
+}
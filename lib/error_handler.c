@@ -16,6 +16,7 @@ const char *SPM_ERR_STRING[] = {
         "Parsing error",
         "Not implemented",
         "Failed to fetch data",
+        "Conflicting package requirements",
         NULL,
 };
 
@@ -48,141 +48,177 @@
  */
 
 #include <url.h>
+#include <ctype.h>
+#include <strings.h>
 #include "url.h"
 
 /* we use a global one for convenience */
 static CURLM *multi_handle;
 
+/* number of bytes waiting in the buffer */
+static size_t buffer_avail(URL_FILE *file) {
+    return file->buffer_pos - file->buffer_start;
+}
+
+/* number of bytes received since the reader last asked for data */
+static size_t buffer_filled(URL_FILE *file) {
+    return file->direct_pos + buffer_avail(file);
+}
+
 /* curl calls this routine to get more data */
 static size_t write_callback(char *buffer,
                              size_t size,
                              size_t nitems,
                              void *userp) {
     char *newbuff;
-    size_t rembuff;
+    size_t newlen;
+    size_t used = 0;
 
     URL_FILE *url = (URL_FILE *) userp;
     size *= nitems;
 
-    rembuff = url->buffer_len - url->buffer_pos; /* remaining space in buffer */
+    /* a reader is waiting: hand the data over without buffering it first */
+    if (url->direct != NULL && !buffer_avail(url) && url->direct_pos < url->direct_len) {
+        used = url->direct_len - url->direct_pos;
+        if (used > size)
+            used = size;
+        memcpy(&url->direct[url->direct_pos], buffer, used);
+        url->direct_pos += used;
+        if (used == size)
+            return size;
+        buffer += used;
+        size -= used;
+    }
+
+    if (size > url->buffer_len - url->buffer_pos) {
+        /* reclaim the space of data already read */
+        if (url->buffer_start) {
+            memmove(url->buffer, &url->buffer[url->buffer_start], buffer_avail(url));
+            url->buffer_pos -= url->buffer_start;
+            url->buffer_start = 0;
+        }
+    }
 
-    if (size > rembuff) {
+    if (size > url->buffer_len - url->buffer_pos) {
         /* not enough space in buffer */
-        newbuff = realloc(url->buffer, url->buffer_len + (size - rembuff));
+        newlen = url->buffer_len ? url->buffer_len : URL_BUFFER_SIZE;
+        while (size > newlen - url->buffer_pos)
+            newlen *= 2;
+        newbuff = realloc(url->buffer, newlen);
         if (newbuff == NULL) {
             fprintf(stderr, "callback buffer grow failed\n");
-            size = rembuff;
+            size = url->buffer_len - url->buffer_pos;
         } else {
             /* realloc succeeded increase buffer size*/
-            url->buffer_len += size - rembuff;
+            url->buffer_len = newlen;
             url->buffer = newbuff;
         }
     }
 
-    memcpy(&url->buffer[url->buffer_pos], buffer, size);
-    url->buffer_pos += size;
+    if (size) {
+        memcpy(&url->buffer[url->buffer_pos], buffer, size);
+        url->buffer_pos += size;
+    }
+
+    return used + size;
+}
+
+/* curl calls this routine once for each response header line */
+static size_t header_callback(char *buffer,
+                              size_t size,
+                              size_t nitems,
+                              void *userp) {
+    URL_FILE *url = (URL_FILE *) userp;
+    size_t length = size * nitems;
+    size_t start = 0;
+    size_t end = length;
+    char **dest = NULL;
+
+    if (length > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        /* a new response begins (i.e. after a redirect) */
+        free(url->etag);
+        free(url->last_modified);
+        url->etag = NULL;
+        url->last_modified = NULL;
+        return length;
+    }
+
+    if (length > 5 && strncasecmp(buffer, "ETag:", 5) == 0) {
+        dest = &url->etag;
+        start = 5;
+    } else if (length > 14 && strncasecmp(buffer, "Last-Modified:", 14) == 0) {
+        dest = &url->last_modified;
+        start = 14;
+    } else {
+        return length;
+    }
+
+    while (start < end && isspace((unsigned char) buffer[start]))
+        start++;
+    while (end > start && isspace((unsigned char) buffer[end - 1]))
+        end--;
+
+    free(*dest);
+    *dest = strndup(&buffer[start], end - start);
+    return length;
+}
+
+/* collect the response code and result of finished transfers */
+static void update_status(URL_FILE *file) {
+    long http_status = 0;
+    CURLMsg *m = NULL;
+
+    do {
+        int msg_queue = 0;
+        m = curl_multi_info_read(multi_handle, &msg_queue);
+        if (m != NULL) {
+            curl_easy_getinfo(m->easy_handle, CURLINFO_RESPONSE_CODE, &http_status);
+            if (m->msg == CURLMSG_DONE && m->easy_handle == file->handle.curl)
+                file->result = m->data.result;
+        }
+    } while (m);
 
-    return size;
+    file->http_status = http_status;
 }
 
 /* use to attempt to fill the read buffer up to requested number of bytes */
 static int fill_buffer(URL_FILE *file, size_t want) {
-    fd_set fdread;
-    fd_set fdwrite;
-    fd_set fdexcep;
-    struct timeval timeout;
-    int rc;
-    CURLMcode mc; /* curl_multi_fdset() return code */
+    CURLMcode mc;
 
     /* only attempt to fill buffer if transactions still running and buffer
      * doesn't exceed required size already
      */
-    if ((!file->still_running) || (file->buffer_pos > want))
+    if ((!file->still_running) || (buffer_filled(file) >= want))
         return 0;
 
     /* attempt to fill buffer */
     do {
-        int maxfd = -1;
-        long curl_timeo = -1;
-
-        FD_ZERO(&fdread);
-        FD_ZERO(&fdwrite);
-        FD_ZERO(&fdexcep);
-
-        /* set a suitable timeout to fail on */
-        timeout.tv_sec = 60; /* 1 minute */
-        timeout.tv_usec = 0;
-
-        curl_multi_timeout(multi_handle, &curl_timeo);
-        if (curl_timeo >= 0) {
-            timeout.tv_sec = curl_timeo / 1000;
-            if (timeout.tv_sec > 1)
-                timeout.tv_sec = 1;
-            else
-                timeout.tv_usec = (curl_timeo % 1000) * 1000;
-        }
-
-        /* get file descriptors from the transfers */
-        mc = curl_multi_fdset(multi_handle, &fdread, &fdwrite, &fdexcep, &maxfd);
-
-        if (mc != CURLM_OK) {
-            fprintf(stderr, "curl_multi_fdset() failed, code %d.\n", mc);
-            break;
-        }
-
-        /* On success the value of maxfd is guaranteed to be >= -1. We call
-           select(maxfd + 1, ...); specially in case of (maxfd == -1) there are
-           no fds ready yet so we call select(0, ...) --or Sleep() on Windows--
-           to sleep 100ms, which is the minimum suggested value in the
-           curl_multi_fdset() doc. */
-
-        if (maxfd == -1) {
-#ifdef _WIN32   // OS_WINDOWS not available at this level
-            Sleep(100);
-            rc = 0;
+        /* sleep until a socket is ready or curl has a timeout to handle. URL_POLL_TIMEOUT is only an upper bound */
+#if LIBCURL_VERSION_NUM >= 0x074200
+        mc = curl_multi_poll(multi_handle, NULL, 0, URL_POLL_TIMEOUT, NULL);
 #else
-            /* Portable sleep for platforms other than Windows. */
-            struct timeval wait = {0, 100 * 1000}; /* 100ms */
-            rc = select(0, NULL, NULL, NULL, &wait);
+        mc = curl_multi_wait(multi_handle, NULL, 0, URL_POLL_TIMEOUT, NULL);
 #endif
-        } else {
-            /* Note that on some platforms 'timeout' may be modified by select().
-               If you need access to the original value save a copy beforehand. */
-            rc = select(maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
+        if (mc != CURLM_OK) {
+            fprintf(stderr, "curl_multi_poll() failed, code %d.\n", mc);
+            break;
         }
 
-        switch (rc) {
-            case -1:
-                /* select error */
-                break;
-
-            case 0:
-            default:
-                /* timeout or readable/writable sockets */
-                curl_multi_perform(multi_handle, &file->still_running);
-                file->http_status = get_http_response(multi_handle);
-                break;
-        }
-    } while (file->still_running && (file->buffer_pos < want));
+        curl_multi_perform(multi_handle, &file->still_running);
+        update_status(file);
+    } while (file->still_running && (buffer_filled(file) < want));
     return 1;
 }
 
 /* use to remove want bytes from the front of a files buffer */
 static int use_buffer(URL_FILE *file, size_t want) {
-    /* sort out buffer */
-    if (file->buffer_pos <= want) {
-        /* ditch buffer - write will recreate */
-        free(file->buffer);
-        file->buffer = NULL;
+    if (buffer_avail(file) <= want) {
+        /* everything was read; keep the allocation for the next write */
+        file->buffer_start = 0;
         file->buffer_pos = 0;
-        file->buffer_len = 0;
     } else {
-        /* move rest down make it available for later */
-        memmove(file->buffer,
-                &file->buffer[want],
-                (file->buffer_pos - want));
-
-        file->buffer_pos -= want;
+        /* the rest is read from here next time */
+        file->buffer_start += want;
     }
     return 0;
 }
@@ -207,7 +243,8 @@ long get_http_response(CURLM *handle) {
     return http_status;
 }
 
-URL_FILE *url_fopen(const char *url, const char *operation) {
+static URL_FILE *url_fopen_ex(const char *url, const char *operation, struct curl_slist *headers,
+                              curl_off_t offset, int keep_failed) {
     /* this code could check for URLs or types in the 'url' and
        basically use the real fopen() for standard files */
 
@@ -215,24 +252,46 @@ URL_FILE *url_fopen(const char *url, const char *operation) {
     (void) operation;
 
     file = calloc(1, sizeof(URL_FILE));
-    if (!file)
+    if (!file) {
+        curl_slist_free_all(headers);
         return NULL;
+    }
 
     file->http_status = 0;
     file->handle.file = fopen(url, operation);
-    if (file->handle.file)
+    if (file->handle.file) {
         file->type = CFTYPE_FILE; /* marked as URL */
+        curl_slist_free_all(headers);
+        if (offset > 0 && fseeko(file->handle.file, (off_t) offset, SEEK_SET) != 0) {
+            fclose(file->handle.file);
+            free(file);
+            return NULL;
+        }
+    }
 
     else {
         file->type = CFTYPE_CURL; /* marked as URL */
         file->handle.curl = curl_easy_init();
+        file->headers = headers;
 
         curl_easy_setopt(file->handle.curl, CURLOPT_URL, url);
         curl_easy_setopt(file->handle.curl, CURLOPT_WRITEDATA, file);
         curl_easy_setopt(file->handle.curl, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(file->handle.curl, CURLOPT_HEADERDATA, file);
+        curl_easy_setopt(file->handle.curl, CURLOPT_HEADERFUNCTION, header_callback);
         curl_easy_setopt(file->handle.curl, CURLOPT_VERBOSE, 0L);
         curl_easy_setopt(file->handle.curl, CURLOPT_FOLLOWLOCATION, 1L);
         curl_easy_setopt(file->handle.curl, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(file->handle.curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(file->handle.curl, CURLOPT_LOW_SPEED_TIME, URL_STALL_TIMEOUT);
+        if (file->headers)
+            curl_easy_setopt(file->handle.curl, CURLOPT_HTTPHEADER, file->headers);
+        if (offset > 0) {
+            /* not CURLOPT_RESUME_FROM_LARGE: libcurl aborts when the server answers a resumed request with a 200 */
+            char range[64];
+            snprintf(range, sizeof(range), "%" CURL_FORMAT_CURL_OFF_T "-", offset);
+            curl_easy_setopt(file->handle.curl, CURLOPT_RANGE, range);
+        }
 
         if (!multi_handle)
             multi_handle = curl_multi_init();
@@ -241,8 +300,11 @@ URL_FILE *url_fopen(const char *url, const char *operation) {
 
         /* lets start the fetch */
         curl_multi_perform(multi_handle, &file->still_running);
+        if (!file->still_running)
+            update_status(file);
 
-        if ((file->buffer_pos == 0) && (!file->still_running)) {
+        /* a "304 Not Modified" response has no body but is not an error */
+        if (!keep_failed && (!buffer_avail(file)) && (!file->still_running) && url_status(file) != 304) {
             /* if still_running is 0 now, we should return NULL */
 
             /* make sure the easy handle is not in the multi handle anymore */
@@ -250,6 +312,9 @@ URL_FILE *url_fopen(const char *url, const char *operation) {
 
             /* cleanup */
             curl_easy_cleanup(file->handle.curl);
+            curl_slist_free_all(file->headers);
+            free(file->etag);
+            free(file->last_modified);
 
             free(file);
 
@@ -259,6 +324,79 @@ URL_FILE *url_fopen(const char *url, const char *operation) {
     return file;
 }
 
+URL_FILE *url_fopen(const char *url, const char *operation) {
+    return url_fopen_ex(url, operation, NULL, 0, 0);
+}
+
+/**
+ * Open a URL for reading from a byte offset
+ *
+ * When `validator` is given it is sent as an If-Range request header: a server holding a different version of the
+ * file sends all of it instead of the requested range, and the handle reads that response from its first byte. Check
+ * `url_status()` to tell the two apart (206=range, 200=whole file). Local files and non-HTTP URLs always start at
+ * `offset`.
+ *
+ * Unlike `url_fopen()`, a handle is returned when the transfer ends before any data arrives, so the caller can inspect
+ * `url_status()` and `file->result`.
+ *
+ * @param url address to read
+ * @param offset first byte to read
+ * @param validator ETag or Last-Modified date of the data already received (NULL=none)
+ * @return `URL_FILE` handle, or NULL on error
+ */
+URL_FILE *url_fopen_range(const char *url, curl_off_t offset, const char *validator) {
+    struct curl_slist *headers = NULL;
+    char header[BUFSIZ];
+
+    if (offset > 0 && validator != NULL && *validator != '\0') {
+        snprintf(header, sizeof(header), "If-Range: %s", validator);
+        headers = curl_slist_append(headers, header);
+    }
+    return url_fopen_ex(url, "r", headers, offset, 1);
+}
+
+/**
+ * Open a URL for reading unless it matches a copy the caller already has
+ *
+ * The validators are sent as If-None-Match and If-Modified-Since request headers. When the server answers
+ * "304 Not Modified" the handle returns no data and `url_status()` reports 304. The validators of the response are
+ * available in `file->etag` and `file->last_modified`.
+ *
+ * @param url address to read
+ * @param etag ETag of the cached copy (NULL=none)
+ * @param last_modified Last-Modified date of the cached copy (NULL=none)
+ * @return `URL_FILE` handle, or NULL on error
+ */
+URL_FILE *url_fopen_conditional(const char *url, const char *etag, const char *last_modified) {
+    struct curl_slist *headers = NULL;
+    char header[BUFSIZ];
+
+    if (etag != NULL && *etag != '\0') {
+        snprintf(header, sizeof(header), "If-None-Match: %s", etag);
+        headers = curl_slist_append(headers, header);
+    }
+    if (last_modified != NULL && *last_modified != '\0') {
+        snprintf(header, sizeof(header), "If-Modified-Since: %s", last_modified);
+        headers = curl_slist_append(headers, header);
+    }
+    return url_fopen_ex(url, "r", headers, 0, 0);
+}
+
+/**
+ * Get the HTTP response code of a `URL_FILE`
+ * @param file handle returned by `url_fopen()`
+ * @return response code (0=no response yet, or not a URL)
+ */
+long url_status(URL_FILE *file) {
+    long http_status = 0;
+
+    if (file == NULL || file->type != CFTYPE_CURL)
+        return 0;
+
+    curl_easy_getinfo(file->handle.curl, CURLINFO_RESPONSE_CODE, &http_status);
+    return http_status;
+}
+
 int url_fclose(URL_FILE *file) {
     int ret = 0;/* default is good return */
 
@@ -273,6 +411,7 @@ int url_fclose(URL_FILE *file) {
 
             /* cleanup */
             curl_easy_cleanup(file->handle.curl);
+            curl_slist_free_all(file->headers);
             break;
 
         default: /* unknown or supported type - oh dear */
@@ -282,6 +421,8 @@ int url_fclose(URL_FILE *file) {
     }
 
     free(file->buffer);/* free any allocated buffer space */
+    free(file->etag);
+    free(file->last_modified);
     free(file);
 
     return ret;
@@ -296,7 +437,7 @@ int url_feof(URL_FILE *file) {
             break;
 
         case CFTYPE_CURL:
-            if ((file->buffer_pos == 0) && (!file->still_running))
+            if ((!buffer_avail(file)) && (!file->still_running))
                 ret = 1;
             break;
 
@@ -310,6 +451,7 @@ int url_feof(URL_FILE *file) {
 
 size_t url_fread(void *ptr, size_t size, size_t nmemb, URL_FILE *file) {
     size_t want;
+    size_t got;
 
     switch (file->type) {
         case CFTYPE_FILE:
@@ -318,24 +460,29 @@ size_t url_fread(void *ptr, size_t size, size_t nmemb, URL_FILE *file) {
 
         case CFTYPE_CURL:
             want = nmemb * size;
+            got = buffer_avail(file);
+            if (got > want)
+                got = want;
+
+            /* xfer buffered data to caller */
+            if (got) {
+                memcpy(ptr, &file->buffer[file->buffer_start], got);
+                use_buffer(file, got);
+            }
 
-            fill_buffer(file, want);
-
-            /* check if there's data in the buffer - if not fill_buffer()
-             * either errored or EOF */
-            if (!file->buffer_pos)
-                return 0;
-
-            /* ensure only available data is considered */
-            if (file->buffer_pos < want)
-                want = file->buffer_pos;
-
-            /* xfer data to caller */
-            memcpy(ptr, file->buffer, want);
-
-            use_buffer(file, want);
+            if (got < want && file->still_running) {
+                /* the rest is written straight to the caller by write_callback() */
+                file->direct = (char *) ptr + got;
+                file->direct_len = want - got;
+                file->direct_pos = 0;
+                fill_buffer(file, file->direct_len);
+                got += file->direct_pos;
+                file->direct = NULL;
+                file->direct_len = 0;
+                file->direct_pos = 0;
+            }
 
-            want = want / size;     /* number of items */
+            want = got / size;     /* number of items */
             break;
 
         default: /* unknown or supported type - oh dear */
@@ -349,7 +496,7 @@ size_t url_fread(void *ptr, size_t size, size_t nmemb, URL_FILE *file) {
 
 char *url_fgets(char *ptr, size_t size, URL_FILE *file) {
     size_t want = size - 1;/* always need to leave room for zero termination */
-    size_t loop;
+    char *newline;
 
     switch (file->type) {
         case CFTYPE_FILE:
@@ -361,24 +508,21 @@ char *url_fgets(char *ptr, size_t size, URL_FILE *file) {
 
             /* check if there's data in the buffer - if not fill either errored or
              * EOF */
-            if (!file->buffer_pos)
+            if (!buffer_avail(file))
                 return NULL;
 
             /* ensure only available data is considered */
-            if (file->buffer_pos < want)
-                want = file->buffer_pos;
+            if (buffer_avail(file) < want)
+                want = buffer_avail(file);
 
             /*buffer contains data */
             /* look for newline or eof */
-            for (loop = 0; loop < want; loop++) {
-                if (file->buffer[loop] == '\n') {
-                    want = loop + 1;/* include newline */
-                    break;
-                }
-            }
+            newline = memchr(&file->buffer[file->buffer_start], '\n', want);
+            if (newline != NULL)
+                want = (size_t) (newline - &file->buffer[file->buffer_start]) + 1;/* include newline */
 
             /* xfer data to caller */
-            memcpy(ptr, file->buffer, want);
+            memcpy(ptr, &file->buffer[file->buffer_start], want);
             ptr[want] = 0;/* always null terminate */
 
             use_buffer(file, want);
@@ -410,6 +554,7 @@ void url_rewind(URL_FILE *file) {
             /* ditch buffer - write will recreate - resets stream pos*/
             free(file->buffer);
             file->buffer = NULL;
+            file->buffer_start = 0;
             file->buffer_pos = 0;
             file->buffer_len = 0;
 
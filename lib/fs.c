@@ -533,6 +533,10 @@ int mkdirs(const char *_path, mode_t mode) {
         strcat(tmp, sep);
         if (access(tmp, F_OK) != 0) {
             result = mkdir(tmp, mode);
+            if (result < 0 && errno == EEXIST) {
+                // Created by someone else in the meantime
+                result = 0;
+            }
         }
     }
     split_free(parts);
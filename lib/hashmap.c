@@ -0,0 +1,132 @@
+/**
+ * String keyed hash map
+ *
+ * Open addressing with linear probing. Keys are not copied; they must remain valid for the lifetime of the map.
+ *
+ * @file hashmap.c
+ */
+#include "spm.h"
+
+/**
+ * Find the slot holding `key`, or the empty slot where it belongs
+ * @param entry table
+ * @param num_alloc table size (power of two)
+ * @param key
+ * @return slot number
+ */
+static size_t hashmap_slot(const HashMapEntry *entry, size_t num_alloc, const char *key) {
+    size_t slot = strhash(key) & (num_alloc - 1);
+    while (entry[slot].key != NULL && strcmp(entry[slot].key, key) != 0) {
+        slot = (slot + 1) & (num_alloc - 1);
+    }
+    return slot;
+}
+
+/**
+ * Resize the table of a `HashMap`
+ * @param map `HashMap`
+ * @param num_alloc new table size (power of two)
+ * @return 0=success, -1=error
+ */
+static int hashmap_resize(HashMap *map, size_t num_alloc) {
+    HashMapEntry *entry = calloc(num_alloc, sizeof(HashMapEntry));
+    if (entry == NULL) {
+        perror("failed to allocate hash map");
+        return -1;
+    }
+
+    for (size_t i = 0; i < map->num_alloc; i++) {
+        if (map->entry[i].key != NULL) {
+            entry[hashmap_slot(entry, num_alloc, map->entry[i].key)] = map->entry[i];
+        }
+    }
+    free(map->entry);
+    map->entry = entry;
+    map->num_alloc = num_alloc;
+    return 0;
+}
+
+/**
+ * Initialize an empty `HashMap`
+ * @param hint expected number of keys
+ * @return success=`HashMap`, failure=NULL
+ */
+HashMap *hashmap_init(size_t hint) {
+    size_t num_alloc = 16;
+    HashMap *map = calloc(1, sizeof(HashMap));
+    if (map == NULL) {
+        perror("failed to allocate hash map");
+        return NULL;
+    }
+
+    while (num_alloc < hint * 2) {
+        num_alloc <<= 1;
+    }
+    if (hashmap_resize(map, num_alloc) < 0) {
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+/**
+ * Retrieve the value stored under `key`
+ * @param map `HashMap`
+ * @param key
+ * @return value, or NULL when `key` is not present
+ */
+void *hashmap_get(const HashMap *map, const char *key) {
+    if (map == NULL || key == NULL) {
+        return NULL;
+    }
+    return map->entry[hashmap_slot(map->entry, map->num_alloc, key)].value;
+}
+
+/**
+ * Store `value` under `key`, replacing any previous value
+ * @param map `HashMap`
+ * @param key
+ * @param value
+ * @return 0=success, -1=error
+ */
+int hashmap_put(HashMap *map, const char *key, void *value) {
+    size_t slot;
+
+    if (map == NULL || key == NULL) {
+        return -1;
+    }
+
+    // Keep the load factor under 50%
+    if ((map->num_inuse + 1) * 2 > map->num_alloc && hashmap_resize(map, map->num_alloc * 2) < 0) {
+        return -1;
+    }
+
+    slot = hashmap_slot(map->entry, map->num_alloc, key);
+    if (map->entry[slot].key == NULL) {
+        map->entry[slot].key = key;
+        map->num_inuse++;
+    }
+    map->entry[slot].value = value;
+    return 0;
+}
+
+/**
+ * Get the number of keys stored in a `HashMap`
+ * @param map `HashMap`
+ * @return
+ */
+size_t hashmap_count(const HashMap *map) {
+    return map->num_inuse;
+}
+
+/**
+ * Free a `HashMap` (keys and values are not freed)
+ * @param map `HashMap`
+ */
+void hashmap_free(HashMap *map) {
+    if (map == NULL) {
+        return;
+    }
+    free(map->entry);
+    free(map);
+}
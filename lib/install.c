@@ -35,6 +35,50 @@ int spm_hierarchy_make_root(SPM_Hierarchy *fs) {
     return 0;
 }
 
+/**
+ * Append bytes to a growing string
+ * @param output string (reallocated as needed)
+ * @param len length of `output`
+ * @param num_alloc bytes allocated for `output`
+ * @param data bytes to append
+ * @param size number of bytes in `data`
+ * @return success=0, failure=-1
+ */
+static int info_str_append(char **output, size_t *len, size_t *num_alloc, const char *data, size_t size) {
+    if (*len + size + 1 > *num_alloc) {
+        size_t want = *num_alloc ? *num_alloc : 64;
+        while (*len + size + 1 > want) {
+            want *= 2;
+        }
+        char *tmp = realloc(*output, want);
+        if (tmp == NULL) {
+            return -1;
+        }
+        *output = tmp;
+        *num_alloc = want;
+    }
+    memcpy(*output + *len, data, size);
+    *len += size;
+    (*output)[*len] = '\0';
+    return 0;
+}
+
+/**
+ * Append `count` spaces to a growing string
+ * @see info_str_append
+ */
+static int info_str_pad(char **output, size_t *len, size_t *num_alloc, size_t count) {
+    static const char spaces[] = "                                ";
+    while (count > 0) {
+        size_t n = count < sizeof(spaces) - 1 ? count : sizeof(spaces) - 1;
+        if (info_str_append(output, len, num_alloc, spaces, n) < 0) {
+            return -1;
+        }
+        count -= n;
+    }
+    return 0;
+}
+
 /**
  * Generates a formatted string containing package information
  *
@@ -53,26 +97,33 @@ int spm_hierarchy_make_root(SPM_Hierarchy *fs) {
  * @return `malloc()`ed string
  */
 char *spm_get_package_info_str(ManifestPackage *package, const char *fmt) {
-    // Allocate at least enough space for the character arrays in ManifestPackage (there are several)
-    char *output = calloc(1, sizeof(ManifestPackage));
-
-    // Stores raw record data
-    char tmp[SPM_PACKAGE_MEMBER_SIZE];
+    char *output = NULL;
+    size_t len = 0;
+    size_t num_alloc = 0;
 
     // Stores width string (i.e. '%-12n' is parsed as '12')
     char str_width[10];
 
+    // Stores numeric record data
+    char number[32];
+
     // Record the maximum number of bytes to read
     size_t len_fmt = strlen(fmt);
 
+    // Start with an empty string
+    if (info_str_append(&output, &len, &num_alloc, "", 0) < 0) {
+        fprintf(SYSERROR);
+        return NULL;
+    }
+
     // Begin reading format string
     for (size_t i = 0; i < len_fmt; i++) {
         size_t width = 0;  // Default string padding amount
         int when = -1;  // When string padding is applied (-1 = none, 0 = before, 1 = after)
-        char *hrs = NULL;  // Buffer for human_readable_size
+        const char *value = NULL;  // Record data
+        char *value_alloc = NULL;  // Record data generated on demand (freed after use)
 
         // Truncate temporary strings
-        tmp[0] = '\0';
         str_width[0] = '\0';
 
         // Begin parsing formatter
@@ -93,10 +144,11 @@ char *spm_get_package_info_str(ManifestPackage *package, const char *fmt) {
                 }
 
                 // Consume the numerical string and convert it to an integer
-                int j = 0;
+                size_t j = 0;
                 while (isdigit(fmt[i])) {
-                    memcpy(&str_width[j], &fmt[i], 1);
-                    j++;
+                    if (j < sizeof(str_width) - 1) {
+                        str_width[j++] = fmt[i];
+                    }
                     i++;
                 }
                 str_width[j] = 0;
@@ -106,68 +158,61 @@ char *spm_get_package_info_str(ManifestPackage *package, const char *fmt) {
             // Retrieve information based on requested format character'
             switch (fmt[i]) {
                 case 'n':
-                    strcpy(tmp, package->name);
+                    value = package->name;
                     break;
                 case 'v':
-                    strcpy(tmp, package->version);
+                    value = package->version;
                     break;
                 case 'V':
-                    strcpy(tmp, package->version);
-                    strcat(tmp, "-");
-                    strcat(tmp, package->revision);
+                    value = value_alloc = join_ex("-", package->version ? package->version : "",
+                                                  package->revision ? package->revision : "", NULL);
                     break;
                 case 'r':
-                    strcpy(tmp, package->revision);
+                    value = package->revision;
                     break;
                 case 'o':
-                    strcpy(tmp, package->origin);
+                    value = package->origin;
                     break;
                 case 'a':
-                    strcpy(tmp, package->archive);
+                    value = package->archive;
                     break;
                 case 'c':
-                    strcpy(tmp, package->checksum_sha256);
+                    value = package->checksum_sha256;
                     break;
                 case 's':
-                    sprintf(tmp, "%zu", package->size);
+                    snprintf(number, sizeof(number), "%zu", package->size);
+                    value = number;
                     break;
                 case 'S':
-                    hrs = human_readable_size(package->size);
-                    strcpy(tmp, hrs);
-                    free(hrs);
+                    value = value_alloc = human_readable_size(package->size);
                     break;
                 default:
                     // Formatter is not registered above. Oh well.
                     continue;
             }
-
-            // Pad the string up to the length of the length of `tmp`
-            int width_final = ((int)width - (int)strlen(tmp));
-
-            // When `tmp` is longer than the requested width, use the original width
-            if (width_final < 0) {
-                width_final = width;
+            if (value == NULL) {
+                value = "";
             }
 
-            // Write padding "before" appending `tmp` to the output string
-            if (when == 0) {
-                for (size_t m = 0; m < width_final; m++) {
-                    strcat(output, " ");
-                }
-            }
-
-            // Append data to output string
-            strcat(output, tmp);
-
-            // Write padding "after" appending `tmp` to the output string
-            if (when == 1) {
-                for (size_t m = 0; m < width_final; m++) {
-                    strcat(output, " ");
-                }
+            // Pad the string up to the requested width (when `value` is longer than the width, pad by the width itself)
+            size_t value_len = strlen(value);
+            size_t width_final = width >= value_len ? width - value_len : width;
+
+            // Write padding "before" appending `value` to the output string, the value itself, then padding "after"
+            if ((when == 0 && info_str_pad(&output, &len, &num_alloc, width_final) < 0)
+                || info_str_append(&output, &len, &num_alloc, value, value_len) < 0
+                || (when == 1 && info_str_pad(&output, &len, &num_alloc, width_final) < 0)) {
+                fprintf(SYSERROR);
+                free(value_alloc);
+                free(output);
+                return NULL;
             }
-        } else {
+            free(value_alloc);
+        } else if (info_str_append(&output, &len, &num_alloc, &fmt[i], 1) < 0) {
             // Data was not parsed as a formatter, so append it to the output string as-is
-            strncat(output, &fmt[i], 1);
+            fprintf(SYSERROR);
+            free(output);
+            return NULL;
         }
     }
 
@@ -371,45 +416,178 @@ char *spm_install_fetch(const char *pkgdir, const char *_package) {
 }
 
 /**
- * Perform a full package installation
- * @param mf
- * @param rootdir
- * @param packages
- * @return 0=success, -1=failed to create storage, -2=denied by user
+ * Resolve the requested packages
+ * @param mf `ManifestList` to search
+ * @param packages package specifications
+ * @param resolver destination for the `Resolver` owning the result (free with `resolve_free`)
+ * @return NULL terminated array of `ManifestPackage` in installation order (caller must free the array only), or
+ * NULL on error (`spmerrno` is set)
  */
-int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
-    size_t num_requirements = 0;
+static ManifestPackage **spm_resolve_packages(ManifestList *mf, StrList *packages, Resolver **resolver) {
     ManifestPackage **requirements = NULL;
-    char source[PATH_MAX];
-    char *tmpdir = NULL;
     size_t package_count;
+    int status;
 
     package_count = strlist_count(packages);
     if (package_count == 0) {
         spmerrno = SPM_ERR_PKG_NOT_FOUND;
         spmerrno_cause("EMPTY PACKAGE LIST");
-        return -1;
+        return NULL;
     }
 
     // Produce a dependency tree from requested package(s)
-    for (size_t i = 0; i < package_count; i++) {
-        char *item = strlist_item(packages, i);
-
-        // Does the package exist in the manifest?
-        if (manifestlist_search(mf, item) == NULL) {
-            spmerrno = SPM_ERR_PKG_NOT_FOUND;
-            spmerrno_cause(item);
-            return -1;
+    if ((*resolver = resolve_init(mf)) == NULL) {
+        return NULL;
+    }
+    status = SPM_GLOBAL.solve ? resolve_solve(*resolver, packages) : 0;
+    for (size_t i = 0; status == 0 && i < package_count; i++) {
+        status = resolve_add(*resolver, strlist_item(packages, i));
+    }
+    if (status < 0) {
+        if ((*resolver)->error.required_by != NULL) {
+            fprintf(stderr, "ERROR: unable to resolve '%s' (required by %s)\n", (*resolver)->error.spec, (*resolver)->error.required_by);
         }
+        spmerrno = (*resolver)->error.code ? (*resolver)->error.code : SPM_ERR_PKG_INVALID;
+        spmerrno_cause((*resolver)->error.spec);
+        resolve_free(*resolver);
+        *resolver = NULL;
+        return NULL;
+    }
+
+    if ((requirements = resolve_order(*resolver)) == NULL) {
+        resolve_free(*resolver);
+        *resolver = NULL;
+        return NULL;
+    }
+    return requirements;
+}
+
+/**
+ * Verify a package archive against the checksum of its record
+ * @param package_path path to the archive
+ * @param package `ManifestPackage`
+ * @return 0=success, -1=mismatch or error (`spmerrno` is set)
+ */
+static int spm_verify_package(const char *package_path, const ManifestPackage *package) {
+    char *checksum = sha256sum(package_path);
+
+    if (checksum == NULL || strcmp(checksum, package->checksum_sha256) != 0) {
+        fprintf(stderr, "Checksum mismatch: %s (expected %s, got %s)\n", package_path, package->checksum_sha256, checksum ? checksum : "nothing");
+        spmerrno = SPM_ERR_PKG_CHECKSUM;
+        spmerrno_cause(package->archive);
+        free(checksum);
+        return -1;
+    }
+    free(checksum);
+    return 0;
+}
+
+/**
+ * Package scheduled by `spm_install_packages`
+ */
+struct InstallJob {
+    SPM_Hierarchy *fs;
+    ManifestPackage *package;
+    char *package_path;     // archive in the local package directory
+    char *stagedir;         // private root the package is extracted into and relocated in
+    size_t level;           // 0=depends on nothing else being installed, otherwise 1 + level of its deepest dependency
+    int verify;
+    int status;
+};
+
+/**
+ * Packages of one dependency level
+ */
+struct InstallLevel {
+    struct InstallJob **jobs;
+    size_t count;
+    FSTree *provided;       // libraries installed by the previous levels
+};
 
-        requirements = resolve_dependencies(mf, item);
-        if (requirements != NULL) {
-            for (size_t c = num_requirements; requirements[c] != NULL; c++) {
-                num_requirements++;
+/**
+ * Install one package into its own staging directory (`ThreadPoolFunc`)
+ * @param index job index
+ * @param worker unused
+ * @param arg `struct InstallLevel`
+ */
+static void spm_install_job(size_t index, size_t worker, void *arg) {
+    struct InstallLevel *level = arg;
+    struct InstallJob *job = level->jobs[index];
+    (void) worker;
+
+    job->status = -1;
+    if (job->verify && spm_verify_package(job->package_path, job->package) < 0) {
+        return;
+    }
+    if ((job->stagedir = spm_mkdtemp(TMP_DIR, "spm_stage", NULL)) == NULL) {
+        perror("Could not create staging directory");
+        return;
+    }
+    if (spm_install(job->fs, job->stagedir, job->package_path) < 0) {
+        return;
+    }
+    relocate_root_ex(job->fs->rootdir, job->stagedir, level->provided);
+    if (spm_install_package_record(job->fs, job->stagedir, job->package->name) < 0) {
+        return;
+    }
+    job->status = 0;
+}
+
+/**
+ * Assign a dependency level to each job
+ *
+ * Jobs are in installation order, so every dependency that is part of the same transaction precedes the package
+ * requiring it. Packages sharing a level neither depend on each other nor share a name.
+ *
+ * @param jobs array of `struct InstallJob`
+ * @param count number of jobs
+ * @return highest level
+ */
+static size_t spm_install_levels(struct InstallJob *jobs, size_t count) {
+    HashMap *names = hashmap_init(count);
+    size_t highest = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        ManifestPackage *package = jobs[i].package;
+        jobs[i].level = 0;
+        struct InstallJob *previous = hashmap_get(names, package->name);
+        // A later record of the same package replaces the earlier one, as if installed one after the other
+        if (previous != NULL) {
+            jobs[i].level = previous->level + 1;
+        }
+        for (size_t r = 0; r < package->requirements_records; r++) {
+            VersionSpec *spec = version_spec_compile(package->requirements[r]);
+            struct InstallJob *dependency = NULL;
+            if (spec == NULL) {
+                continue;
+            }
+            if ((dependency = hashmap_get(names, spec->name)) != NULL && dependency->level + 1 > jobs[i].level) {
+                jobs[i].level = dependency->level + 1;
             }
+            version_spec_free(spec);
+        }
+        if (jobs[i].level > highest) {
+            highest = jobs[i].level;
         }
+        hashmap_put(names, package->name, &jobs[i]);
     }
+    hashmap_free(names);
+    return highest;
+}
 
+/**
+ * Fetch and install packages
+ * @param fs `SPM_Hierarchy` of the destination root
+ * @param requirements NULL terminated array of `ManifestPackage` in installation order
+ * @param verify non-zero to verify the checksum of each archive before it is installed
+ * @return 0=success, -1=error, -2=denied by user
+ */
+static int spm_install_packages(SPM_Hierarchy *fs, ManifestPackage **requirements, int verify) {
+    char source[PATH_MAX];
+    char *tmpdir = NULL;
+    size_t count_requirements = 0;
+
+    for (; requirements != NULL && requirements[count_requirements] != NULL; count_requirements++);
     tmpdir = spm_mkdtemp(TMP_DIR, "spm_destroot", NULL);
     if (tmpdir == NULL) {
         perror("Could not create temporary destination root");
@@ -441,6 +619,13 @@ int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
 
     int fetched = 0;
     char *package_dir = strdup(SPM_GLOBAL.package_dir);
+    DownloadManager *downloads = download_init(SPM_GLOBAL.download_jobs > 0 ? SPM_GLOBAL.download_jobs : 0,
+                                               SPM_GLOBAL.download_host_jobs > 0 ? SPM_GLOBAL.download_host_jobs : 0);
+    if (downloads == NULL) {
+        free(package_dir);
+        rmdirs(tmpdir);
+        return -1;
+    }
     for (size_t i = 0; requirements != NULL && requirements[i] != NULL; i++) {
         char *package_origin = calloc(PATH_MAX, sizeof(char));
         strncpy(package_origin, requirements[i]->origin, PATH_MAX);
@@ -456,17 +641,18 @@ int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
         char *package_localpath = join_ex(DIRSEPS, package_dir, requirements[i]->archive, NULL);
         free(package_origin);
 
-        // Download the archive if necessary
+        // Queue the archive for download if necessary
         if (strstr(package_path, "://") != NULL && exists(package_localpath) != 0) {
-            printf("Fetching: %s\n", package_path);
-            package_path = spm_install_fetch(package_dir, package_path);
-            if (package_path == NULL) {
+            if (SPM_GLOBAL.verbose) {
+                printf("Fetching: %s\n", package_path);
+            }
+            // Archives are verified while they are downloaded when the manifest provides a checksum
+            const char *checksum = isempty(requirements[i]->checksum_sha256) ? NULL : requirements[i]->checksum_sha256;
+            if (download_add(downloads, package_path, package_localpath, checksum) == NULL) {
                 free(package_path);
                 free(package_localpath);
-                // TODO: set spmerrno here
-                exit(1);
+                goto fatal;
             }
-            fetched = 1;
         }
         // Or copy the archive if necessary
         else {
@@ -476,19 +662,44 @@ int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
                 printf("Copying: %s\n", package_path);
                 if (rsync(NULL, package_path, package_dir) != 0) {
                     fprintf(stderr, "Unable to copy: %s to %s\n", package_path, package_dir);
-                    return -1;
+                    free(package_path);
+                    free(package_localpath);
+                    goto fatal;
                 }
                 fetched = 1;
             } else if (exists(package_localpath) != 0) {
                 // All attempts to retrieve the requested package have failed. Die.
                 fprintf(stderr, "Package manifest in '%s' claims '%s' exists, however it does not.\n", requirements[i]->origin, package_path);
-                return -1;
+                free(package_path);
+                free(package_localpath);
+                goto fatal;
             }
         }
         free(package_path);
         free(package_localpath);
     }
 
+    // Download the queued archives concurrently
+    if (download_count(downloads) != 0) {
+        printf("Fetching %zu package(s)...\n", download_count(downloads));
+        if (download_run(downloads) != 0) {
+            spmerrno = SPM_ERR_PKG_FETCH;
+            for (size_t i = 0; i < download_count(downloads); i++) {
+                Download *item = download_item(downloads, i);
+                if (item->status == 0) {
+                    continue;
+                }
+                fprintf(stderr, "Unable to fetch: %s: %s\n", item->url, item->error);
+                if (item->sha256 != NULL && !isempty(item->checksum) && strcmp(item->checksum, item->sha256) != 0) {
+                    spmerrno = SPM_ERR_PKG_CHECKSUM;
+                    spmerrno_cause(basename(item->dest));
+                }
+            }
+            goto fatal;
+        }
+        fetched = 1;
+    }
+
     // Update the package manifest
     if (fetched) {
         printf("Updating package manifest...\n");
@@ -503,35 +714,80 @@ int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
         }
     }
 
-    printf("Installing package(s):\n");
+    // Select the packages that are not installed yet
+    struct InstallJob *jobs = calloc(count_requirements + 1, sizeof(*jobs));
     size_t num_installed = 0;
-    for (size_t i = 0; requirements != NULL && requirements[i] != NULL; i++) {
-        char *package_path = join((char *[]) {package_dir, requirements[i]->archive, NULL}, DIRSEPS);
-
+    if (jobs == NULL) {
+        perror("Failed to allocate install jobs");
+        fprintf(SYSERROR);
+        goto fatal;
+    }
+    printf("Installing package(s):\n");
+    for (size_t i = 0; i < count_requirements; i++) {
         if (spm_check_installed(fs, requirements[i]->name)) {
             printf("  -> %s is already installed\n", requirements[i]->name);
-            free(package_path);
             continue;
         }
+        jobs[num_installed].fs = fs;
+        jobs[num_installed].package = requirements[i];
+        jobs[num_installed].package_path = join((char *[]) {package_dir, requirements[i]->archive, NULL}, DIRSEPS);
+        // An archive downloaded by this transaction has already been verified
+        Download *downloaded = download_find(downloads, jobs[num_installed].package_path);
+        jobs[num_installed].verify = verify && (downloaded == NULL || downloaded->sha256 == NULL);
+        num_installed++;
+    }
+    download_free(downloads);
+    free(package_dir);
 
-        spm_show_package(requirements[i]);
-        spm_install(fs, tmpdir, package_path);
+    // Packages of the same level are extracted, relocated and recorded concurrently, each in its own staging
+    // directory. Each level is merged into tmpdir before the next one starts so relocation can see the libraries
+    // provided by its dependencies.
+    struct InstallLevel level = {.jobs = calloc(num_installed + 1, sizeof(struct InstallJob *))};
+    size_t highest = spm_install_levels(jobs, num_installed);
+    int failed = 0;
+    for (size_t current = 0; num_installed != 0 && current <= highest && !failed; current++) {
+        level.count = 0;
+        for (size_t i = 0; i < num_installed; i++) {
+            if (jobs[i].level == current) {
+                spm_show_package(jobs[i].package);
+                level.jobs[level.count++] = &jobs[i];
+            }
+        }
 
-        // Relocate installation root
-        relocate_root(fs->rootdir, tmpdir);
-        spm_install_package_record(fs, tmpdir, requirements[i]->name);
-        num_installed++;
-        free(package_path);
+        threadpool_run(threadpool_jobs(level.count), level.count, spm_install_job, &level);
+
+        for (size_t i = 0; i < level.count && !failed; i++) {
+            failed = level.jobs[i]->status < 0;
+        }
+        for (size_t i = 0; i < level.count && !failed; i++) {
+            sprintf(source, "%s%c", level.jobs[i]->stagedir, DIRSEP);
+            spm_metadata_remove(source);
+            if (rsync(NULL, source, tmpdir) != 0) {
+                fprintf(stderr, "Unable to copy: %s to %s\n", source, tmpdir);
+                failed = 1;
+            }
+        }
+        if (!failed) {
+            fstree_free(level.provided);
+            level.provided = rpath_libraries_available(tmpdir);
+        }
     }
 
-    // free requirements array
-    for (size_t i = 0; i < num_requirements; i++) {
-        if (requirements[i] != NULL) {
-            manifest_package_free(requirements[i]);
-            requirements[i] = NULL;
+    for (size_t i = 0; i < num_installed; i++) {
+        if (jobs[i].stagedir != NULL) {
+            rmdirs(jobs[i].stagedir);
+            free(jobs[i].stagedir);
         }
+        free(jobs[i].package_path);
+    }
+    fstree_free(level.provided);
+    free(level.jobs);
+    free(jobs);
+    if (failed) {
+        rmdirs(tmpdir);
+        free(tmpdir);
+        return -1;
     }
-    free(package_dir);
 
     if (num_installed != 0) {
         // Append a trailing slash to tmpdir to direct rsync to copy files, not the directory, into destroot
@@ -557,5 +813,84 @@ int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
         printf("Removing temporary storage: '%s'\n", tmpdir);
     }
     rmdirs(tmpdir);
+    free(tmpdir);
     return 0;
+
+fatal:
+    download_free(downloads);
+    free(package_dir);
+    rmdirs(tmpdir);
+    free(tmpdir);
+    return -1;
+}
+
+/**
+ * Perform a full package installation
+ * @param mf
+ * @param rootdir
+ * @param packages
+ * @return 0=success, -1=failed to create storage, -2=denied by user
+ */
+int spm_do_install(SPM_Hierarchy *fs, ManifestList *mf, StrList *packages) {
+    Resolver *resolver = NULL;
+    ManifestPackage **requirements = NULL;
+    int status;
+
+    if ((requirements = spm_resolve_packages(mf, packages, &resolver)) == NULL) {
+        return -1;
+    }
+    status = spm_install_packages(fs, requirements, 0);
+    free(requirements);
+    resolve_free(resolver);
+    return status;
+}
+
+/**
+ * Install the packages recorded in a lock file
+ *
+ * No manifest is read and nothing is resolved. Every archive is verified against the checksum stored in the lock
+ * file before it is installed.
+ *
+ * @param fs `SPM_Hierarchy` of the destination root
+ * @param filename path to the lock file (see `manifest_lock_write`)
+ * @return 0=success, -1=error, -2=denied by user
+ */
+int spm_do_install_lock(SPM_Hierarchy *fs, const char *filename) {
+    Manifest *info = NULL;
+    int status;
+
+    if ((info = manifest_lock_read(filename)) == NULL) {
+        return -1;
+    }
+    status = spm_install_packages(fs, info->packages, 1);
+    manifest_free(info);
+    return status;
+}
+
+/**
+ * Resolve the requested packages and write the result to a lock file
+ * @param mf `ManifestList` to search
+ * @param packages package specifications
+ * @param filename path to the lock file
+ * @return 0=success, -1=error
+ */
+int spm_do_lock(ManifestList *mf, StrList *packages, const char *filename) {
+    Resolver *resolver = NULL;
+    ManifestPackage **requirements = NULL;
+    int status;
+
+    if ((requirements = spm_resolve_packages(mf, packages, &resolver)) == NULL) {
+        return -1;
+    }
+
+    printf("Locked package(s):\n");
+    for (size_t i = 0; requirements[i] != NULL; i++) {
+        spm_show_package(requirements[i]);
+    }
+    if ((status = manifest_lock_write(filename, requirements)) == 0) {
+        printf("Wrote lock file: %s\n", filename);
+    }
+    free(requirements);
+    resolve_free(resolver);
+    return status;
 }
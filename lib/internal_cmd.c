@@ -90,7 +90,10 @@ int mkprefix_interface(int argc, char **argv) {
  *
  */
 void mkmanifest_interface_usage(void) {
-    printf("usage: mkmanifest [-p target ...] [package_dir ...]\n");
+    printf("usage: mkmanifest [-f] [-j jobs] [-z format ...] [-p target ...] [package_dir ...]\n"
+           "  -f, --force    re-read every package (ignore the existing index)\n"
+           "  -j, --jobs     number of worker threads (0 = all processors)\n"
+           "  -z, --compress also publish a compressed manifest (gz, zst)\n");
 }
 
 /**
@@ -101,12 +104,16 @@ void mkmanifest_interface_usage(void) {
  */
 int mkmanifest_interface(int argc, char **argv) {
     Manifest *manifest = NULL;
+    Manifest *previous = NULL;
     int result = 0;
     char *pkgdir = NULL;
     char *path = NULL;
+    char *path_manifest = NULL;
     char *target = NULL;
     StrList *paths = NULL;
     StrList *targets = NULL;
+    int flags = 0;
+    int compress[SPM_COMPRESS_ZSTD + 1] = {0};
 
     if (argc < 2) {
         mkmanifest_interface_usage();
@@ -123,6 +130,33 @@ int mkmanifest_interface(int argc, char **argv) {
             strlist_append(targets, argv[i]);
             continue;
         }
+        if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--force") == 0) {
+            flags |= SPM_MANIFEST_FROM_FULL;
+            continue;
+        }
+        if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            i++;
+            if (argv[i] == NULL || isdigit_s(argv[i]) == 0) {
+                mkmanifest_interface_usage();
+                return -1;
+            }
+            SPM_GLOBAL.jobs = (int) strtol(argv[i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "-z") == 0 || strcmp(argv[i], "--compress") == 0) {
+            i++;
+            int format = compress_format(argv[i]);
+            if (format < 0) {
+                mkmanifest_interface_usage();
+                return -1;
+            }
+            if (!compress_supported(format)) {
+                fprintf(stderr, "%s compression is not supported by this build\n", argv[i]);
+                return -1;
+            }
+            compress[format] = 1;
+            continue;
+        }
 
         pth = expandpath(argv[i]);
         if (pth == NULL || exists(pth) != 0) {
@@ -159,25 +193,73 @@ int mkmanifest_interface(int argc, char **argv) {
 
             if (exists(pkgdir) != 0) {
                 fprintf(stderr, "WARNING: target directory does not exist: '%s'\n", pkgdir);
+                free(pkgdir);
+                pkgdir = NULL;
                 continue;
             }
 
-            manifest = manifest_from(pkgdir);
+            // The previous generation is needed to publish a delta
+            path_manifest = join((char *[]) {pkgdir, SPM_MANIFEST_FILENAME, NULL}, DIRSEPS);
+            previous = exists(path_manifest) == 0 ? manifest_read(pkgdir) : NULL;
+
+            manifest = manifest_from_ex(pkgdir, flags);
             if (manifest == NULL) {
                 fprintf(stderr, "No packages\n");
-                return -4;
+                result = -4;
+                goto cleanup;
             }
 
             result = manifest_write(manifest, pkgdir);
             if (result != 0) {
                 fprintf(stderr, "ERROR:  while writing manifest data: '%s'\n", pkgdir);
-                manifest_free(manifest);
-                return -5;
+                result = -5;
+                goto cleanup;
             }
+
+            // Clients prefer compressed manifests, so variants that were not requested must not be left behind
+            for (int format = SPM_COMPRESS_GZIP; format <= SPM_COMPRESS_ZSTD; format++) {
+                char *path_compressed = join_ex("", path_manifest, compress_extension(format), NULL);
+                if (compress[format]) {
+                    if (SPM_GLOBAL.verbose) {
+                        printf("Compressing manifest: %s\n", path_compressed);
+                    }
+                    result = compress_file(path_manifest, path_compressed, format);
+                } else if (exists(path_compressed) == 0) {
+                    if (SPM_GLOBAL.verbose) {
+                        printf("Removing outdated manifest: %s\n", path_compressed);
+                    }
+                    unlink(path_compressed);
+                }
+                free(path_compressed);
+                if (result != 0) {
+                    fprintf(stderr, "ERROR:  while compressing manifest data: '%s'\n", pkgdir);
+                    result = -5;
+                    goto cleanup;
+                }
+            }
+
+            result = manifest_delta_publish(pkgdir, previous, manifest);
+            if (result != 0) {
+                fprintf(stderr, "ERROR:  while publishing manifest delta: '%s'\n", pkgdir);
+                result = -5;
+                goto cleanup;
+            }
+
+            manifest_free(previous);
+            previous = NULL;
+            manifest_free(manifest);
+            manifest = NULL;
+            free(path_manifest);
+            path_manifest = NULL;
             free(pkgdir);
+            pkgdir = NULL;
         }
     }
 
+cleanup:
+    free(path_manifest);
+    free(pkgdir);
+
     if (targets != NULL)
         strlist_free(targets);
 
@@ -187,6 +269,9 @@ int mkmanifest_interface(int argc, char **argv) {
     if (manifest != NULL)
         manifest_free(manifest);
 
+    if (previous != NULL)
+        manifest_free(previous);
+
     return result;
 }
 
@@ -311,7 +396,6 @@ int mkruntime_interface(int argc, char **argv) {
     runtime_set(rt, "CPPFLAGS", "-I$SPM_INCLUDE");
     runtime_set(rt, "CXXFLAGS", "-I$SPM_INCLUDE");
 #if OS_DARWIN
-    // For now `reloc` can fix up the LC_ID_DYLIB on its own without install_name_tool
     runtime_set(rt, "LDFLAGS", "-Wl,-rpath,$SPM_LIB -L$SPM_LIB");
 #elif OS_LINUX
     runtime_set(rt, "LDFLAGS", "-Wl,-rpath=$SPM_LIB:$SPM_LIB64 -L$SPM_LIB -L$SPM_LIB64");
@@ -404,27 +488,37 @@ int mirror_clone_interface(int argc, char **argv) {
  *
  */
 void rpath_set_interface_usage(void) {
-    printf("usage: rpath_set {file} {rpath}\n");
+    printf("usage: rpath_set {file}... {rpath}\n");
 }
 
 /**
  * Set a RPATH from the CLI
  * @param argc
  * @param argv
- * @return return value of `rpath_set`
+ * @return 0=success, -1=one or more files could not be modified
  */
 int rpath_set_interface(int argc, char **argv) {
     if (argc < 3) {
         rpath_set_interface_usage();
         return -1;
     }
-    char *filename = argv[1];
-    char *rpath = argv[2];
-    int result = rpath_set(filename, rpath);
-    if (result < 0) {
+    size_t num_files = (size_t) argc - 2;
+    char **filename = calloc(num_files + 1, sizeof(char *));
+    char **rpath = calloc(num_files + 1, sizeof(char *));
+    if (filename == NULL || rpath == NULL) {
         fprintf(SYSERROR);
+        free(filename);
+        free(rpath);
+        return -1;
     }
-    return result;
+    for (size_t i = 0; i < num_files; i++) {
+        filename[i] = argv[i + 1];
+        rpath[i] = argv[argc - 1];
+    }
+    size_t failed = rpath_set_batch(filename, rpath);
+    free(filename);
+    free(rpath);
+    return failed ? -1 : 0;
 }
 
 /**
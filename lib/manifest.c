@@ -48,23 +48,285 @@ void manifest_package_separator_restore(char **name) {
     replace_text((*name), placeholder, separator);
 }
 
+/**
+ * Initialize an empty `Manifest`
+ * @return success=`Manifest`, failure=NULL
+ */
+Manifest *manifest_init(void) {
+    Manifest *info = calloc(1, sizeof(Manifest));
+    if (info == NULL) {
+        perror("Failed to allocate manifest");
+        fprintf(SYSERROR);
+        return NULL;
+    }
+
+    info->arena = arena_init(0);
+    info->strings = hashmap_init(0);
+    info->packages = calloc(1, sizeof(ManifestPackage *));
+    if (info->arena == NULL || info->strings == NULL || info->packages == NULL) {
+        fprintf(SYSERROR);
+        manifest_free(info);
+        return NULL;
+    }
+    info->origin = manifest_intern(info, "");
+    return info;
+}
+
+/**
+ * Store a string in a `Manifest`
+ *
+ * Identical strings share storage. The result lives until the `Manifest` is freed. Not thread-safe.
+ *
+ * @param info `Manifest`
+ * @param s string to store (NULL is stored as an empty string)
+ * @return success=stored string, failure=NULL
+ */
+char *manifest_intern(Manifest *info, const char *s) {
+    char *result = NULL;
+
+    if (s == NULL) {
+        s = "";
+    }
+
+    if ((result = hashmap_get(info->strings, s)) != NULL) {
+        return result;
+    }
+
+    if ((result = arena_strdup(info->arena, s)) == NULL || hashmap_put(info->strings, result, result) < 0) {
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Allocate an empty package record owned by a `Manifest`
+ *
+ * The record is not added to `Manifest.packages`.
+ *
+ * @param info `Manifest`
+ * @return success=`ManifestPackage`, failure=NULL
+ */
+ManifestPackage *manifest_package_init(Manifest *info) {
+    ManifestPackage *package = arena_alloc(info->arena, sizeof(ManifestPackage));
+    if (package == NULL) {
+        return NULL;
+    }
+
+    package->archive = manifest_intern(info, "");
+    package->name = package->archive;
+    package->version = package->archive;
+    package->revision = package->archive;
+    package->checksum_sha256 = package->archive;
+    package->origin = info->origin;
+    return package;
+}
+
+/**
+ * Store the version of a package record along with its version key
+ * @param info `Manifest` that owns `package`
+ * @param package `ManifestPackage`
+ * @param version version string
+ * @return 0=success, -1=error
+ */
+int manifest_package_set_version(Manifest *info, ManifestPackage *package, const char *version) {
+    char buf[NAME_MAX];
+    char *key = buf;
+    size_t size = version_key_encode(version, buf, sizeof(buf)) + 1;
+
+    if (size > sizeof(buf)) {
+        if ((key = malloc(size)) == NULL) {
+            return -1;
+        }
+        version_key_encode(version, key, size);
+    }
+    package->version = manifest_intern(info, version);
+    package->version_key = manifest_intern(info, key);
+    if (key != buf) {
+        free(key);
+    }
+    return package->version != NULL && package->version_key != NULL ? 0 : -1;
+}
+
+/**
+ * Store the requirement specs of a package record
+ * @param info `Manifest` that owns `package`
+ * @param package `ManifestPackage`
+ * @param requirements array of requirement specs
+ * @param count number of records in `requirements`
+ * @return 0=success, -1=error
+ */
+int manifest_package_set_requirements(Manifest *info, ManifestPackage *package, char **requirements, size_t count) {
+    package->requirements = NULL;
+    package->requirements_records = 0;
+    if (requirements == NULL || count == 0) {
+        return 0;
+    }
+
+    package->requirements = arena_alloc(info->arena, (count + 1) * sizeof(char *));
+    if (package->requirements == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((package->requirements[i] = manifest_intern(info, requirements[i])) == NULL) {
+            return -1;
+        }
+        package->requirements_records++;
+    }
+    return 0;
+}
+
+/**
+ * Populate a package record using the matching record of a previous index
+ *
+ * A record matches when the archive name, size and modification time are unchanged.
+ *
+ * @param index previous `ManifestIndex` (may be NULL)
+ * @param info `Manifest` that owns `package`
+ * @param package `ManifestPackage` with its archive, name, size and mtime already set
+ * @return 0=reused, -1=no match
+ */
+static int manifest_from_reuse(const ManifestIndex *index, Manifest *info, ManifestPackage *package) {
+    const ManifestIndexRecord *record = NULL;
+    size_t slot;
+
+    if (index == NULL) {
+        return -1;
+    }
+
+    for (slot = manifest_index_first(index, package->name); slot != 0; slot = manifest_index_next(index, slot, package->name)) {
+        record = &index->records[slot - 1];
+        if (record->size == package->size
+            && record->mtime == (int64_t) package->mtime
+            && strcmp(manifest_index_str(index, record->archive), package->archive) == 0) {
+            break;
+        }
+    }
+
+    if (slot == 0) {
+        return -1;
+    }
+
+    package->checksum_sha256 = manifest_intern(info, manifest_index_str(index, record->checksum_sha256));
+    if (package->checksum_sha256 == NULL) {
+        return -1;
+    }
+    if (record->requirements_records == 0) {
+        return 0;
+    }
+
+    char **requirements = calloc(record->requirements_records + 1, sizeof(char *));
+    if (requirements == NULL) {
+        return -1;
+    }
+    for (size_t r = 0; r < record->requirements_records; r++) {
+        requirements[r] = (char *) manifest_index_str(index, index->requirements[record->requirements + r]);
+    }
+    int result = manifest_package_set_requirements(info, package, requirements, record->requirements_records);
+    free(requirements);
+    return result;
+}
+
 /**
  * Generate a `Manifest` of package data
  * @param package_dir a directory containing SPM packages
  * @return `Manifest`
  */
 Manifest *manifest_from(const char *package_dir) {
+    return manifest_from_ex(package_dir, 0);
+}
+
+/**
+ * Shared state of `manifest_from_ex` workers
+ */
+struct ManifestFromJob {
+    Manifest *info;
+    size_t *pending;        // package slots that need to be read from their archives
+    char **tmpdirs;         // one scratch directory per worker
+    char ***requirements;   // requirement specs read for each pending item
+    int *status;            // result of each pending item
+};
+
+/**
+ * Read the requirement specs of one package archive
+ * @param index offset in `ManifestFromJob.pending`
+ * @param worker worker number
+ * @param arg `struct ManifestFromJob`
+ */
+static void manifest_from_worker(size_t index, size_t worker, void *arg) {
+    struct ManifestFromJob *job = arg;
+    ManifestPackage *package = job->info->packages[job->pending[index]];
+
+    // Read package requirement specs
+    char *archive = join((char *[]) {job->info->origin, package->archive, NULL}, DIRSEPS);
+    if (tar_extract_file(archive, SPM_META_DEPENDS, job->tmpdirs[worker]) != 0) {
+        // TODO: at this point is the package is invalid? .SPM_DEPENDS should be there...
+        fprintf(stderr, "extraction failure: %s\n", archive);
+        job->status[index] = -1;
+        free(archive);
+        return;
+    }
+    char *depfile = join((char *[]) {job->tmpdirs[worker], SPM_META_DEPENDS, NULL}, DIRSEPS);
+    // Stored in the manifest by the calling thread
+    job->requirements[index] = file_readlines(depfile, 0, 0, NULL);
+    for (size_t rec = 0; job->requirements[index] != NULL && job->requirements[index][rec] != NULL; rec++) {
+        strip(job->requirements[index][rec]);
+    }
+
+    unlink(depfile);
+    free(depfile);
+    free(archive);
+}
+
+/**
+ * Generate a `Manifest` of package data
+ *
+ * Archives that have not changed since `manifest.idx` was written are taken from the index as-is. Only new or
+ * modified archives are opened, using up to `SPM_GLOBAL.jobs` threads. Use `SPM_MANIFEST_FROM_FULL` to re-read
+ * every archive.
+ *
+ * @param package_dir a directory containing SPM packages
+ * @param flags `SPM_MANIFEST_FROM_FULL`
+ * @return `Manifest`
+ */
+Manifest *manifest_from_ex(const char *package_dir, int flags) {
     char *package_filter[] = {SPM_PACKAGE_EXTENSION, NULL}; // We only want packages
     FSTree *fsdata = NULL;
+    ManifestIndex *previous = NULL;
+    struct ManifestFromJob job;
+    size_t num_pending = 0;
+    size_t jobs = 0;
+    size_t reused = 0;
+    int failed = 0;
     fsdata = fstree(package_dir, package_filter, SPM_FSTREE_FLT_ENDSWITH);
 
-    Manifest *info = (Manifest *)calloc(1, sizeof(Manifest));
+    Manifest *info = manifest_init();
+    if (info == NULL) {
+        fstree_free(fsdata);
+        return NULL;
+    }
+    free(info->packages);
     info->records = fsdata->num_records;
     info->packages = (ManifestPackage **) calloc(info->records + 1, sizeof(ManifestPackage *));
     if (info->packages == NULL) {
         perror("Failed to allocate package array");
         fprintf(SYSERROR);
-        free(info);
+        manifest_free(info);
+        fstree_free(fsdata);
+        return NULL;
+    }
+
+    memset(&job, '\0', sizeof(job));
+    job.info = info;
+    job.pending = calloc(info->records + 1, sizeof(*job.pending));
+    job.requirements = calloc(info->records + 1, sizeof(*job.requirements));
+    job.status = calloc(info->records + 1, sizeof(*job.status));
+    if (job.pending == NULL || job.requirements == NULL || job.status == NULL) {
+        perror("Failed to allocate work queue");
+        fprintf(SYSERROR);
+        free(job.pending);
+        free(job.requirements);
+        free(job.status);
+        manifest_free(info);
         fstree_free(fsdata);
         return NULL;
     }
@@ -72,16 +334,14 @@ Manifest *manifest_from(const char *package_dir) {
     if (SPM_GLOBAL.verbose) {
         printf("Initializing package manifest:\n");
     }
-    strncpy(info->origin, package_dir, SPM_PACKAGE_MEMBER_ORIGIN_SIZE);
-
+    info->origin = manifest_intern(info, package_dir);
 
-    char *tmpdir = spm_mkdtemp(TMP_DIR, "spm_manifest_from", NULL);
-    if (!tmpdir) {
-        perror("failed to create temporary directory");
-        fprintf(SYSERROR);
-        free(info);
-        fstree_free(fsdata);
-        return NULL;
+    if (!(flags & SPM_MANIFEST_FROM_FULL)) {
+        char *path_index = join((char *[]) {info->origin, SPM_MANIFEST_INDEX_FILENAME, NULL}, DIRSEPS);
+        if (exists(path_index) == 0) {
+            previous = manifest_index_open(path_index);
+        }
+        free(path_index);
     }
 
     for (size_t i = 0; i < fsdata->num_records; i++) {
@@ -96,13 +356,16 @@ Manifest *manifest_from(const char *package_dir) {
         }
 
         // Initialize package record
-        info->packages[i] = (ManifestPackage *) calloc(1, sizeof(ManifestPackage));
+        info->packages[i] = manifest_package_init(info);
         if (info->packages[i] == NULL) {
             perror("Failed to allocate package record");
             fprintf(SYSERROR);
             fstree_free(fsdata);
-            free(info);
-            rmdirs(tmpdir);
+            manifest_free(info);
+            manifest_index_close(previous);
+            free(job.pending);
+            free(job.requirements);
+            free(job.status);
             return NULL;
         }
 
@@ -119,41 +382,83 @@ Manifest *manifest_from(const char *package_dir) {
         manifest_package_separator_restore(&fsdata->record[i]->name);
 
         // Populate `ManifestPackage` record
-        info->packages[i]->size = (size_t) get_file_size(fsdata->record[i]->name);
-        strncpy(info->packages[i]->origin, info->origin, SPM_PACKAGE_MEMBER_ORIGIN_SIZE);
-        strncpy(info->packages[i]->archive, basename(fsdata->record[i]->name), SPM_PACKAGE_MEMBER_SIZE);
-        strncpy(info->packages[i]->name, basename(parts[0]), SPM_PACKAGE_MEMBER_SIZE);
-        strncpy(info->packages[i]->version, parts[1], SPM_PACKAGE_MEMBER_SIZE);
-        strncpy(info->packages[i]->revision, parts[2], SPM_PACKAGE_MEMBER_SIZE);
-        strdelsuffix(info->packages[i]->revision, SPM_PACKAGE_EXTENSION);
-
-        // Read package requirement specs
-        char *archive = join((char *[]) {info->origin, info->packages[i]->archive, NULL}, DIRSEPS);
-        if (tar_extract_file(archive, SPM_META_DEPENDS, tmpdir) != 0) {
-            // TODO: at this point is the package is invalid? .SPM_DEPENDS should be there...
-            fprintf(stderr, "extraction failure: %s\n", archive);
-            rmdirs(tmpdir);
-            exit(1);
-        }
-        char *depfile = join((char *[]) {tmpdir, SPM_META_DEPENDS, NULL}, DIRSEPS);
-        info->packages[i]->requirements = file_readlines(depfile, 0, 0, NULL);
-
-        // Record count of requirement specs
-        if (info->packages[i]->requirements != NULL) {
-            for (size_t rec = 0; info->packages[i]->requirements[rec] != NULL; rec++) {
-                strip(info->packages[i]->requirements[rec]);
-                info->packages[i]->requirements_records++;
-            }
-        }
-
-        unlink(depfile);
-        free(depfile);
-        free(archive);
+        info->packages[i]->size = (size_t) fsdata->record[i]->st->st_size;
+        info->packages[i]->mtime = fsdata->record[i]->st->st_mtime;
+        strdelsuffix(parts[2], SPM_PACKAGE_EXTENSION);
+        info->packages[i]->archive = manifest_intern(info, basename(fsdata->record[i]->name));
+        info->packages[i]->name = manifest_intern(info, basename(parts[0]));
+        manifest_package_set_version(info, info->packages[i], parts[1]);
+        info->packages[i]->revision = manifest_intern(info, parts[2]);
         split_free(parts);
+
+        // Unchanged archives do not need to be opened again
+        if (manifest_from_reuse(previous, info, info->packages[i]) == 0) {
+            reused++;
+            continue;
+        }
+        job.pending[num_pending++] = i;
     }
 
+    if (SPM_GLOBAL.verbose && previous != NULL) {
+        printf("Reused %zu of %zu package records\n", reused, info->records);
+    }
+    manifest_index_close(previous);
     fstree_free(fsdata);
-    rmdirs(tmpdir);
+
+    // Read the remaining archives. Each worker extracts into its own directory.
+    jobs = num_pending ? threadpool_jobs(num_pending) : 0;
+    job.tmpdirs = calloc(jobs + 1, sizeof(char *));
+    for (size_t i = 0; job.tmpdirs != NULL && i < jobs; i++) {
+        job.tmpdirs[i] = spm_mkdtemp(TMP_DIR, "spm_manifest_from", NULL);
+        if (job.tmpdirs[i] == NULL) {
+            perror("failed to create temporary directory");
+            fprintf(SYSERROR);
+            failed = 1;
+            break;
+        }
+    }
+
+    if (job.tmpdirs == NULL || failed) {
+        for (size_t i = 0; job.tmpdirs != NULL && job.tmpdirs[i] != NULL; i++) {
+            rmdirs(job.tmpdirs[i]);
+            free(job.tmpdirs[i]);
+        }
+        free(job.tmpdirs);
+        free(job.pending);
+        free(job.requirements);
+        free(job.status);
+        manifest_free(info);
+        return NULL;
+    }
+
+    threadpool_run(jobs, num_pending, manifest_from_worker, &job);
+
+    for (size_t i = 0; i < num_pending; i++) {
+        char **requirements = job.requirements[i];
+        size_t count = 0;
+        if (job.status[i] != 0) {
+            failed = 1;
+        }
+        for (count = 0; requirements != NULL && requirements[count] != NULL; count++);
+        if (manifest_package_set_requirements(info, info->packages[job.pending[i]], requirements, count) < 0) {
+            failed = 1;
+        }
+        if (requirements != NULL) {
+            split_free(requirements);
+        }
+    }
+    for (size_t i = 0; i < jobs; i++) {
+        rmdirs(job.tmpdirs[i]);
+        free(job.tmpdirs[i]);
+    }
+    free(job.tmpdirs);
+    free(job.pending);
+    free(job.requirements);
+    free(job.status);
+
+    if (failed) {
+        exit(1);
+    }
     return info;
 }
 
@@ -162,42 +467,118 @@ Manifest *manifest_from(const char *package_dir) {
  * @param info `Manifest`
  */
 void manifest_free(Manifest *info) {
-    for (size_t i = 0; i < info->records; i++) {
-        if (info->packages[i] != NULL) {
-            manifest_package_free(info->packages[i]);
-        }
+    if (info == NULL) {
+        return;
     }
+    // Package records and strings live in the arena
+    free(info->packages);
+    manifest_index_close(info->index);
+    hashmap_free(info->strings);
+    hashmap_free(info->names);
+    arena_free(info->arena);
     free(info);
 }
 
 /**
- * Free a `ManifestPackage` structure
+ * Free a `ManifestPackage` returned by `manifest_package_copy`
+ *
+ * Records stored in a `Manifest` are released by `manifest_free`.
+ *
  * @param info `ManifestPackage`
  */
 void manifest_package_free(ManifestPackage *info) {
-    if (info == NULL) {
-        return;
+    free(info);
+}
+
+/**
+ * Shared state of `manifest_write` workers
+ */
+struct ManifestWriteJob {
+    Manifest *info;
+    const char *path;       // directory containing the archives
+    size_t *pending;        // package slots without a checksum
+    char (*checksums)[SHA256_DIGEST_STRING_LENGTH];     // result of each pending item
+};
+
+/**
+ * Compute the checksum of one package archive
+ * @param index offset in `ManifestWriteJob.pending`
+ * @param worker worker number (unused)
+ * @param arg `struct ManifestWriteJob`
+ */
+static void manifest_write_worker(size_t index, size_t worker, void *arg) {
+    struct ManifestWriteJob *job = arg;
+    ManifestPackage *package = job->info->packages[job->pending[index]];
+    (void) worker;
+
+    char *archive = join((char *[]) {(char *) job->path, package->archive, NULL}, DIRSEPS);
+    char *checksum_sha256 = sha256sum(archive);
+    if (checksum_sha256 != NULL) {
+        strncpy(job->checksums[index], checksum_sha256, SHA256_DIGEST_STRING_LENGTH - 1);
+        free(checksum_sha256);
     }
+    free(archive);
+}
 
-    for (size_t i = 0; i < info->requirements_records; i++) {
-        if (info->requirements[i] != NULL) {
-            free(info->requirements[i]);
+/**
+ * Format a package as a `manifest.dat` record
+ * @param package `ManifestPackage`
+ * @return record without a trailing newline (caller must free), or NULL on error
+ */
+char *manifest_package_str(const ManifestPackage *package) {
+    char *reqs = join(package->requirements, ",");
+    char *checksum_sha256 = package->checksum_sha256;
+    char *result = NULL;
+    int length = 0;
+
+    // Measure, then format
+    for (int pass = 0; pass < 2; pass++) {
+        length = snprintf(result, result ? (size_t) length + 1 : 0,
+                          "%s|" // archive
+                          "%zu|" // size
+                          "%s|"  // name
+                          "%s|"  // version
+                          "%s|"  // revision
+                          "%zu|"  // requirements_records
+                          "%s|"   // requirements
+                          "%s"   // checksum_sha256
+                          , package->archive,
+                          package->size,
+                          package->name,
+                          package->version,
+                          package->revision,
+                          package->requirements_records,
+                          reqs ? reqs : SPM_MANIFEST_NODATA,
+                          !isempty(checksum_sha256) ? checksum_sha256 : SPM_MANIFEST_NODATA);
+        if (length < 0 || (result == NULL && (result = calloc((size_t) length + 1, sizeof(char))) == NULL)) {
+            length = -1;
+            break;
         }
     }
-    free(info->requirements);
-    free(info);
+    free(reqs);
+    if (length < 0) {
+        perror("Failed to format manifest record");
+        fprintf(SYSERROR);
+        free(result);
+        return NULL;
+    }
+    return result;
 }
 
 /**
  * Write a `Manifest` to the configuration directory
+ *
+ * Archives without a checksum are hashed using up to `SPM_GLOBAL.jobs` threads before the manifest is written.
+ *
  * @param info
  * @param pkgdir
  * @return
  */
 int manifest_write(Manifest *info, const char *pkgdir) {
-    char *reqs = NULL;
     char path[PATH_MAX];
     char path_manifest[PATH_MAX];
+    struct ManifestWriteJob job;
+    size_t num_pending = 0;
 
     memset(path, '\0', sizeof(path));
     memset(path_manifest, '\0', sizeof(path));
@@ -209,8 +590,35 @@ int manifest_write(Manifest *info, const char *pkgdir) {
     if (!endswith(path_manifest, SPM_MANIFEST_FILENAME)) {
         strcat(path_manifest, DIRSEPS);
         strcat(path_manifest, SPM_MANIFEST_FILENAME);
+    } else {
+        // Archives live next to the manifest
+        strdelsuffix(path, SPM_MANIFEST_FILENAME);
     }
 
+    // Hash archives that have not been hashed already (see manifest_from_ex)
+    job.info = info;
+    job.path = path;
+    job.pending = calloc(info->records + 1, sizeof(*job.pending));
+    job.checksums = calloc(info->records + 1, sizeof(*job.checksums));
+    if (job.pending == NULL || job.checksums == NULL) {
+        perror("Failed to allocate work queue");
+        fprintf(SYSERROR);
+        free(job.pending);
+        free(job.checksums);
+        return -1;
+    }
+    for (size_t i = 0; i < info->records; i++) {
+        if (isempty(info->packages[i]->checksum_sha256)) {
+            job.pending[num_pending++] = i;
+        }
+    }
+    threadpool_run(threadpool_jobs(num_pending), num_pending, manifest_write_worker, &job);
+    for (size_t i = 0; i < num_pending; i++) {
+        info->packages[job.pending[i]]->checksum_sha256 = manifest_intern(info, job.checksums[i]);
+    }
+    free(job.pending);
+    free(job.checksums);
+
     FILE *fp = fopen(path_manifest, "w+");
     if (fp == NULL) {
         perror(path_manifest);
@@ -219,6 +627,7 @@ int manifest_write(Manifest *info, const char *pkgdir) {
     }
 #ifdef _DEBUG
     if (SPM_GLOBAL.verbose) {
+        char *reqs = NULL;
         for (size_t i = 0; i < info->records; i++) {
             printf("%-20s: %s\n"
                    "%-20s: %zu\n"
@@ -245,276 +654,747 @@ int manifest_write(Manifest *info, const char *pkgdir) {
         printf("Generating manifest file: %s\n", path_manifest);
     }
     fprintf(fp, "%s\n", SPM_MANIFEST_HEADER);
-    char data[BUFSIZ];
     for (size_t i = 0; i < info->records; i++) {
         // write CSV-like manifest
-        memset(data, '\0', BUFSIZ);
-        char *dptr = data;
         float percent = (((float)i + 1) / info->records) * 100;
         if (SPM_GLOBAL.verbose) {
             printf("[%3.0f%%] %s\n", percent, info->packages[i]->archive);
         }
-        reqs = join(info->packages[i]->requirements, ",");
-        char *archive = join((char *[]) {path, info->packages[i]->archive, NULL}, DIRSEPS);
-        char *checksum_sha256 = sha256sum(archive);
-
-        sprintf(dptr, "%s|" // archive
-                      "%zu|" // size
-                      "%s|"  // name
-                      "%s|"  // version
-                      "%s|"  // revision
-                      "%zu|"  // requirements_records
-                      "%s|"   // requirements
-                      "%s"   // checksum_md5
-                      , info->packages[i]->archive,
-                      info->packages[i]->size,
-                      info->packages[i]->name,
-                      info->packages[i]->version,
-                      info->packages[i]->revision,
-                      info->packages[i]->requirements_records,
-                      reqs ? reqs : SPM_MANIFEST_NODATA,
-                      checksum_sha256 ? checksum_sha256 : SPM_MANIFEST_NODATA);
-                fprintf(fp, "%s\n", dptr);
-        free(reqs);
-        free(archive);
-        if (checksum_sha256 != NULL)
-            free(checksum_sha256);
+        char *record = manifest_package_str(info->packages[i]);
+        if (record == NULL) {
+            fclose(fp);
+            return -1;
+        }
+        fprintf(fp, "%s\n", record);
+        free(record);
     }
     fclose(fp);
+
+    // Write the binary index next to the manifest
+    char path_index[PATH_MAX];
+    char *manifest_dir = dirname(path_manifest);
+    snprintf(path_index, sizeof(path_index), "%s%c%s", manifest_dir ? manifest_dir : ".", DIRSEP, SPM_MANIFEST_INDEX_FILENAME);
+    free(manifest_dir);
+    if (SPM_GLOBAL.verbose) {
+        printf("Generating manifest index: %s\n", path_index);
+    }
+    if (manifest_index_write(info, path_index) < 0) {
+        return -1;
+    }
     return 0;
 }
 
 /**
- *
- * @param url
- * @param dest
- * @return
+ * Download a file
+ * @param url address of the file
+ * @param dest path to write the file to
+ * @return 0=success, >=400=HTTP error, other=error (see `fetch_sha256`)
  */
 int fetch(const char *url, const char *dest) {
+    return fetch_sha256(url, dest, NULL);
+}
+
+/**
+ * Make one attempt to download a file (see `fetch_sha256`)
+ * @param url address of the file
+ * @param dest path to write the file to
+ * @param sha256 expected SHA-256 of the file (NULL=not verified)
+ * @param context SHA-256 context (reinitialized by each attempt)
+ * @param retry set to non-zero when another attempt could succeed
+ * @return same as `fetch_sha256`
+ */
+static int fetch_attempt(const char *url, const char *dest, const char *sha256, EVP_MD_CTX *context, int *retry) {
     URL_FILE *handle = NULL;
     FILE *outf = NULL;
     size_t chunk_size = 0xffff;
     size_t nread = 0;
+    int status = 0;
+    long http_status = 0;
+    char *validator = NULL;
+    char partfile[PATH_MAX];
+    char checksum[SHA256_DIGEST_STRING_LENGTH];
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    uint64_t offset = 0;
+
+    *retry = 0;
+    snprintf(partfile, sizeof(partfile), "%s%s", dest, SPM_DOWNLOAD_PART_EXT);
+    EVP_DigestInit_ex(context, EVP_sha256(), NULL);
+    offset = download_part_resume(partfile, sha256 != NULL, &validator, context);
+
+    handle = url_fopen_range(url, (curl_off_t) offset, validator);
+    free(validator);
+    if(!handle) {
+        fprintf(stderr, "couldn't url_fopen() %s\n", url);
+        return 2;
+    }
+
     char *buffer = calloc(chunk_size + 1, sizeof(char));
     if (!buffer) {
         perror("fetch buffer too big");
+        url_fclose(handle);
         return -1;
     }
 
-    handle = url_fopen(url, "r");
-    if(!handle) {
-        fprintf(stderr, "couldn't url_fopen() %s\n", url);
-        return 2;
+    // The response headers have arrived along with the first chunk
+    nread = url_fread(buffer, 1, chunk_size, handle);
+    http_status = url_status(handle);
+    if (offset && http_status == 200) {
+        // The server ignored the range (or the file changed) and sends all of it
+        EVP_DigestInit_ex(context, EVP_sha256(), NULL);
+        offset = 0;
     }
-
-    outf = fopen(dest, "wb+");
+    outf = fopen(partfile, offset ? "ab" : "wb");
     if(!outf) {
-        perror("couldn't open fread output file\n");
+        perror(partfile);
+        free(buffer);
+        url_fclose(handle);
         return 1;
     }
 
-    do {
+    while (nread) {
+        if (fwrite(buffer, 1, nread, outf) != nread) {
+            perror(partfile);
+            status = 1;
+            break;
+        }
+        EVP_DigestUpdate(context, buffer, nread);
         nread = url_fread(buffer, 1, chunk_size, handle);
-        if (handle->http_status >= 400) {
-            free(buffer);
-            fclose(outf);
-            if (exists(dest) == 0) {
-                unlink(dest);
-            }
+    }
+    free(buffer);
 
-            long http_status = handle->http_status;
-            url_fclose(handle);
-            return http_status;
-        }
-        fwrite(buffer, 1, nread, outf);
-    } while (nread);
+    if (fclose(outf) != 0 && status == 0) {
+        perror(partfile);
+        status = 1;
+    }
 
-    free(buffer);
-    fclose(outf);
+    // Did the transfer end early?
+    if (status == 0 && handle->type == CFTYPE_CURL && handle->result != CURLE_OK) {
+        http_status = url_status(handle);
+        status = http_status >= 400 ? (int) http_status : 2;
+        if (http_status == 416 || handle->result == CURLE_BAD_DOWNLOAD_RESUME || handle->result == CURLE_RANGE_ERROR) {
+            // The partial file does not fit the file on the server
+            download_part_remove(partfile);
+            *retry = 1;
+        } else if (download_retryable(handle->result, http_status)) {
+            const char *etag = handle->etag != NULL && strncmp(handle->etag, "W/", 2) != 0 ? handle->etag : NULL;
+            download_part_save(partfile, etag ? etag : handle->last_modified);
+            fprintf(stderr, "%s: %s\n", url, curl_easy_strerror(handle->result));
+            *retry = 1;
+        } else {
+            download_part_remove(partfile);
+        }
+        url_fclose(handle);
+        return status;
+    }
     url_fclose(handle);
-    return 0;
+
+    if (status == 0 && sha256 != NULL) {
+        EVP_DigestFinal_ex(context, digest, NULL);
+        sha256_digest_str(digest, checksum);
+        if (strcmp(checksum, sha256) != 0) {
+            fprintf(stderr, "Checksum mismatch: %s (expected %s, got %s)\n", url, sha256, checksum);
+            spmerrno = SPM_ERR_PKG_CHECKSUM;
+            spmerrno_cause(url);
+            // The data kept from a previous attempt may belong to another version of the file
+            *retry = offset != 0;
+            status = -1;
+        }
+    }
+    if (status == 0 && rename(partfile, dest) < 0) {
+        perror(dest);
+        status = 1;
+    }
+    if (status != 0) {
+        download_part_remove(partfile);
+    } else {
+        download_part_save(partfile, NULL);
+    }
+    return status;
 }
 
-int manifest_validate(void) {
-    size_t line_count;
-    int problems;
-    char data[BUFSIZ];
-    FILE *fp;
+/**
+ * Download a file and verify it as it is written
+ *
+ * The data is hashed while it is written to `<dest>.part`, which is renamed to `dest` only when the transfer completes
+ * and the checksum matches. A transfer interrupted by a transient error is retried with exponential backoff, resuming
+ * where it stopped (see `download_part_resume`). A partial file left behind by an earlier run is resumed as well.
+ *
+ * @param url address of the file
+ * @param dest path to write the file to
+ * @param sha256 expected SHA-256 of the file (NULL=not verified)
+ * @return 0=success, >=400=HTTP error, -1=checksum mismatch (`spmerrno` is set) or out of memory, 1=write error,
+ * 2=transfer error
+ */
+int fetch_sha256(const char *url, const char *dest, const char *sha256) {
+    EVP_MD_CTX *context = EVP_MD_CTX_new();
+    int status = 0;
+    int retry = 0;
+
+    if (context == NULL) {
+        perror("Unable to allocate digest context");
+        return -1;
+    }
+
+    for (size_t attempt = 0; ; attempt++) {
+        status = fetch_attempt(url, dest, sha256, context, &retry);
+        if (status == 0 || !retry || attempt >= SPM_DOWNLOAD_RETRIES) {
+            break;
+        }
+        if (status == -1) {
+            // Start over right away without the stale data
+            spmerrno = 0;
+            continue;
+        }
+        unsigned int delay = download_backoff(attempt + 1);
+        fprintf(stderr, "Retrying in %us: %s\n", delay, url);
+        sleep(delay);
+    }
+    EVP_MD_CTX_free(context);
+    return status;
+}
+
+/**
+ * Create a package from a `manifest.dat` record
+ *
+ * The package is allocated from `info` but is not added to it.
+ *
+ * @param info `Manifest` that will own the package
+ * @param record a single record without its trailing newline (modified)
+ * @return `ManifestPackage`, or NULL when the record is malformed or memory is exhausted
+ */
+ManifestPackage *manifest_package_parse(Manifest *info, char *record) {
+    const char separator[] = {SPM_MANIFEST_SEPARATOR, '\0'};
+    char *fields[SPM_MANIFEST_SEPARATOR_MAX + 1];
+    char *cursor = record;
+
+    if (num_chars(record, SPM_MANIFEST_SEPARATOR) != SPM_MANIFEST_SEPARATOR_MAX) {
+        return NULL;
+    }
+    for (size_t f = 0; f <= SPM_MANIFEST_SEPARATOR_MAX; f++) {
+        fields[f] = strsep(&cursor, separator);
+    }
+
+    ManifestPackage *package = manifest_package_init(info);
+    if (package == NULL) {
+        perror("Failed to allocate package record");
+        fprintf(SYSERROR);
+        return NULL;
+    }
+
+    package->archive = manifest_intern(info, fields[0]);
+    package->size = strtoul(fields[1], NULL, 10);
+    package->name = manifest_intern(info, fields[2]);
+    if (manifest_package_set_version(info, package, fields[3]) < 0) {
+        return NULL;
+    }
+    package->revision = manifest_intern(info, fields[4]);
+
+    // fields[5] (requirements_records) is derived from the requirements themselves
+    if (strncmp(fields[6], SPM_MANIFEST_NODATA, strlen(SPM_MANIFEST_NODATA)) != 0) {
+        char **requirements = split(fields[6], ",");
+        size_t count = 0;
+        for (count = 0; requirements != NULL && requirements[count] != NULL; count++);
+        manifest_package_set_requirements(info, package, requirements, count);
+        split_free(requirements);
+    }
+    if (strncmp(fields[7], SPM_MANIFEST_NODATA, strlen(SPM_MANIFEST_NODATA)) != 0) {
+        package->checksum_sha256 = manifest_intern(info, fields[7]);
+    }
+    return package;
+}
 
-    if (exists(SPM_GLOBAL.package_manifest) != 0) {
+/**
+ * Grow the package array of a `Manifest` geometrically
+ * @param info `Manifest`
+ * @param num_alloc pointer to the current capacity
+ * @return 0=success, -1=error
+ */
+static int manifest_grow(Manifest *info, size_t *num_alloc) {
+    size_t count = *num_alloc ? *num_alloc * 2 : 64;
+    ManifestPackage **tmp = realloc(info->packages, (count + 1) * sizeof(ManifestPackage *));
+    if (tmp == NULL) {
+        perror("Failed to allocate package array");
+        fprintf(SYSERROR);
         return -1;
     }
+    memset(&tmp[*num_alloc], '\0', (count + 1 - *num_alloc) * sizeof(ManifestPackage *));
+    info->packages = tmp;
+    *num_alloc = count;
+    return 0;
+}
 
-    if ((fp = fopen(SPM_GLOBAL.package_manifest, "r")) == NULL) {
-        perror(SPM_GLOBAL.package_manifest);
-        return -2;
+/**
+ * Parse a package manifest
+ *
+ * The stream is validated, counted and parsed in a single pass. Lines may be of any length. All formatting problems
+ * are reported before giving up.
+ *
+ * @param fp stream positioned at the start of the manifest
+ * @return success=`Manifest` (the caller assigns its origins), failure=NULL
+ */
+static Manifest *manifest_parse(FILE *fp) {
+    char *line = NULL;
+    size_t line_alloc = 0;
+    size_t line_count = 0;
+    size_t num_alloc = 0;
+    int problems = 0;
+
+    Manifest *info = manifest_init();
+    if (info == NULL || manifest_grow(info, &num_alloc) < 0) {
+        manifest_free(info);
+        return NULL;
     }
 
-    line_count = 0;
-    problems = 0;
-    while (fgets(data, BUFSIZ, fp) != NULL) {
+    while (getline(&line, &line_alloc, fp) >= 0) {
+        char *record = NULL;
         int separators;
-        if (line_count == 0) {
-            if (strncmp(data, SPM_MANIFEST_HEADER, strlen(SPM_MANIFEST_HEADER)) != 0) {
-                fprintf(stderr, "Invalid manifest header: %s (expecting '%s')\n", strip(data), SPM_MANIFEST_HEADER);
+
+        if (line_count++ == 0) {
+            if (strncmp(line, SPM_MANIFEST_HEADER, strlen(SPM_MANIFEST_HEADER)) != 0) {
+                fprintf(stderr, "Invalid manifest header: %s (expecting '%s')\n", strip(line), SPM_MANIFEST_HEADER);
                 problems++;
-                line_count++;
             }
+            continue;
         }
-        else if ((separators = num_chars(data, SPM_MANIFEST_SEPARATOR)) != SPM_MANIFEST_SEPARATOR_MAX) {
-            fprintf(stderr, "Invalid manifest record on line %zu: %s (expecting %d separators, found %d)\n", line_count, strip(data), SPM_MANIFEST_SEPARATOR_MAX, separators);
+
+        record = strip(line);
+        if ((separators = num_chars(record, SPM_MANIFEST_SEPARATOR)) != SPM_MANIFEST_SEPARATOR_MAX) {
+            fprintf(stderr, "Invalid manifest record on line %zu: %s (expecting %d separators, found %d)\n", line_count - 1, record, SPM_MANIFEST_SEPARATOR_MAX, separators);
             problems++;
         }
-        line_count++;
+        if (problems) {
+            // keep validating, but there is no point in parsing
+            continue;
+        }
+
+        if (info->records >= num_alloc && manifest_grow(info, &num_alloc) < 0) {
+            free(line);
+            manifest_free(info);
+            return NULL;
+        }
+
+        ManifestPackage *package = manifest_package_parse(info, record);
+        if (package == NULL) {
+            free(line);
+            manifest_free(info);
+            return NULL;
+        }
+        info->packages[info->records++] = package;
+    }
+    free(line);
+
+    if (line_count == 0) {
+        spmerrno = SPM_ERR_MANIFEST_INVALID;
+        manifest_free(info);
+        return NULL;
+    }
+
+    if (problems) {
+        manifest_free(info);
+        return NULL;
     }
-    return problems;
+    return info;
 }
 
 /**
- * Read the package manifest stored in the configuration directory
- * @return `Manifest` structure
+ * Record where the packages of a `Manifest` came from
+ * @param info `Manifest`
+ * @param file_or_url directory or URL containing the manifest
+ * @param remote_manifest path or URL of `manifest.dat`
  */
-Manifest *manifest_read(char *file_or_url) {
-    FILE *fp = NULL;
-    char *filename = SPM_MANIFEST_FILENAME;
-    char *tmpdir = NULL;
-    char path[PATH_MAX];
-    char *pathptr = path;
-    memset(path, '\0', PATH_MAX);
+static void manifest_set_origin(Manifest *info, const char *file_or_url, const char *remote_manifest) {
+    info->origin = manifest_intern(info, remote_manifest);
+    char *origin = manifest_intern(info, file_or_url);
+    for (size_t i = 0; i < info->records; i++) {
+        info->packages[i]->origin = origin;
+    }
+}
 
-    // When file_or_url is NULL we want to use the global manifest
-    if (file_or_url == NULL) {
-        // TODO: move this out
-        strcpy(path, SPM_GLOBAL.package_dir);
+/**
+ * Read a manifest through its binary index
+ *
+ * Local indexes are only used when they are at least as new as `manifest.dat`. Remote indexes are read from the
+ * manifest cache.
+ *
+ * @param file_or_url directory or URL containing the manifest
+ * @return success=`Manifest`, failure=NULL (the caller should fall back to the text manifest)
+ */
+static Manifest *manifest_read_index(const char *file_or_url) {
+    Manifest *info = NULL;
+    char *path_index = NULL;
+    char *remote_manifest = join_ex(DIRSEPS, file_or_url, SPM_MANIFEST_FILENAME, NULL);
+    char *remote_index = join_ex(DIRSEPS, file_or_url, SPM_MANIFEST_INDEX_FILENAME, NULL);
+
+    if (remote_manifest == NULL || remote_index == NULL) {
+        goto done;
+    }
+
+    if (exists(file_or_url) == 0) {
+        struct stat st_manifest;
+        struct stat st_index;
+        if (stat(remote_index, &st_index) < 0 || stat(remote_manifest, &st_manifest) < 0) {
+            goto done;
+        }
+        if (st_index.st_mtime < st_manifest.st_mtime) {
+            // stale
+            goto done;
+        }
+        info = manifest_index_read(remote_index);
     }
     else {
-        tmpdir = spm_mkdtemp(TMP_DIR, "spm_manifest_read_XXXXXX", NULL);
-        if (exists(tmpdir) != 0) {
-            fprintf(stderr, "Failed to create temporary storage directory\n");
-            fprintf(SYSERROR);
-            return NULL;
+        if (manifest_cache_fetch(remote_index, &path_index) != 0) {
+            goto done;
         }
+        // The mapping remains valid when the cache entry is replaced
+        info = manifest_index_read(path_index);
+    }
 
-        pathptr = join((char *[]) {tmpdir, filename, NULL}, DIRSEPS);
+    if (info == NULL) {
+        goto done;
     }
 
-    char *remote_manifest = join_ex(DIRSEPS, file_or_url, filename, NULL);
+    manifest_set_origin(info, file_or_url, remote_manifest);
 
-    if (exists(pathptr) != 0) {
-        // TODO: Move this out
-        int fetch_status = fetch(remote_manifest, pathptr);
-        if (fetch_status >= 400) {
-            fprintf(stderr, "HTTP %d: %s: %s\n", fetch_status, http_response_str(fetch_status), remote_manifest);
-            free(remote_manifest);
-            return NULL;
+done:
+    free(path_index);
+    free(remote_manifest);
+    free(remote_index);
+    return info;
+}
+
+/**
+ * Compression formats tried when downloading a manifest, in order of preference
+ */
+static const int manifest_read_formats[] = {SPM_COMPRESS_ZSTD, SPM_COMPRESS_GZIP, SPM_COMPRESS_NONE};
+
+/**
+ * Download the smallest available variant of a remote manifest
+ * @param remote_manifest URL of `manifest.dat`
+ * @param path where to store the path of the local copy (caller must free)
+ * @return 0=success, >=400=HTTP error, other=error (same as `manifest_cache_fetch()`)
+ */
+static int manifest_read_fetch(const char *remote_manifest, char **path) {
+    int status = -1;
+
+    for (size_t i = 0; i < sizeof(manifest_read_formats) / sizeof(*manifest_read_formats); i++) {
+        int format = manifest_read_formats[i];
+        if (!compress_supported(format)) {
+            continue;
         }
-        else if (fetch_status == 1 || fetch_status < 0) {
-            free(remote_manifest);
-            return NULL;
+
+        char *url = join_ex("", (char *) remote_manifest, compress_extension(format), NULL);
+        if (url == NULL) {
+            return -1;
+        }
+        status = manifest_cache_fetch(url, path);
+        free(url);
+
+        // Compressed variants are optional
+        if (status < 400 || format == SPM_COMPRESS_NONE) {
+            break;
         }
     }
+    return status;
+}
 
-    int valid = 0;
-    size_t total_records = 0;
-    char data[BUFSIZ];
-    char *dptr = data;
-    memset(dptr, '\0', BUFSIZ);
+/**
+ * Read a remote manifest at the generation published in `manifest.gen`
+ *
+ * Sources are tried from the cheapest to the most expensive:
+ *
+ * 1. the cached index, when it is at the published generation or at most `SPM_MANIFEST_DELTA_MAX` generations
+ *    behind it (the missing deltas are applied)
+ * 2. the repository's `manifest.idx`, when it was written for the published generation
+ * 3. the whole manifest
+ *
+ * Deltas are downloaded through the manifest cache. Unless it came from the cached index as-is, the result is stored in
+ * the cache as an index, so the next read maps it and later generations are applied to it.
+ *
+ * @param file_or_url URL containing the manifest
+ * @param remote_manifest URL of `manifest.dat`
+ * @return `Manifest`, or NULL when the repository does not publish a generation number
+ */
+static Manifest *manifest_read_delta(const char *file_or_url, const char *remote_manifest) {
+    char *url_generation = join_ex(DIRSEPS, (char *) file_or_url, SPM_MANIFEST_GENERATION_FILENAME, NULL);
+    char *url_index = join_ex(DIRSEPS, (char *) file_or_url, SPM_MANIFEST_INDEX_FILENAME, NULL);
+    char *key = join_ex("", (char *) remote_manifest, "#index", NULL);
+    char *path = NULL;
+    size_t generation = 0;
+    size_t base = 0;
+    Manifest *info = NULL;
+    FILE *fp = NULL;
 
-    fp = fopen(pathptr, "r+");
-    if (!fp) {
-        perror(filename);
-        fprintf(SYSERROR);
-        return NULL;
+    if (url_generation == NULL || url_index == NULL || key == NULL
+        || manifest_cache_fetch(url_generation, &path) != 0 || manifest_generation_read(path, &generation) < 0) {
+        goto done;
     }
+    free(path);
+    path = NULL;
+
+    if (manifest_cache_lookup(key, &path, &base) == 0 && base <= generation
+        && generation - base <= SPM_MANIFEST_DELTA_MAX && (info = manifest_index_read(path)) != NULL) {
+        for (size_t g = base + 1; info != NULL && g <= generation; g++) {
+            char url_delta[PATH_MAX];
+            char *path_delta = NULL;
+            FILE *delta = NULL;
+            snprintf(url_delta, sizeof(url_delta), "%s%c%s%zu", file_or_url, DIRSEP, SPM_MANIFEST_DELTA_PREFIX, g);
+
+            if (manifest_cache_fetch(url_delta, &path_delta) != 0 || (delta = fopen(path_delta, "r")) == NULL
+                || manifest_delta_apply(info, delta, g) < 0) {
+                if (SPM_GLOBAL.verbose) {
+                    printf("Unable to apply %s (downloading the whole manifest)\n", url_delta);
+                }
+                manifest_free(info);
+                info = NULL;
+            }
+            if (delta != NULL) {
+                fclose(delta);
+            }
+            free(path_delta);
+        }
 
-    while (fgets(dptr, BUFSIZ, fp) != NULL) {
-        total_records++;
+        if (info != NULL) {
+            if (generation != base) {
+                if (SPM_GLOBAL.verbose) {
+                    printf("Applied %zu manifest delta(s): %s\n", generation - base, remote_manifest);
+                }
+                manifest_cache_store(key, info);
+            }
+            goto done;
+        }
+    }
+    free(path);
+    path = NULL;
+
+    if (manifest_cache_fetch(url_index, &path) == 0 && (info = manifest_index_read(path)) != NULL) {
+        if (info->generation == generation) {
+            // Later generations are applied to this copy
+            manifest_cache_store(key, info);
+            goto done;
+        }
+        // written for another generation
+        manifest_free(info);
+        info = NULL;
     }
+    free(path);
+    path = NULL;
 
-    if (total_records == 0) {
-        spmerrno = SPM_ERR_MANIFEST_INVALID;
-        return NULL;
+    if (manifest_read_fetch(remote_manifest, &path) != 0 || (fp = compress_fopen(path)) == NULL) {
+        goto done;
+    }
+    info = manifest_parse(fp);
+    if (info != NULL && ferror(fp)) {
+        manifest_free(info);
+        info = NULL;
+    }
+    fclose(fp);
+    if (info != NULL) {
+        info->generation = generation;
+        manifest_cache_store(key, info);
     }
 
-    // There's a header, but don't count it in the total
-    total_records--;
+done:
+    free(url_generation);
+    free(url_index);
+    free(key);
+    free(path);
+    return info;
+}
 
-    // Going to reprocess the file again, so rewind
-    rewind(fp);
+/**
+ * Read the package manifest stored in the configuration directory
+ *
+ * When a current `manifest.idx` is available it is mapped instead of parsing `manifest.dat`. Remote repositories
+ * that publish `manifest.gen` are read from the manifest cache and kept up to date with deltas (see
+ * `manifest_read_delta`). Remote manifests are downloaded in compressed form when the server provides
+ * `manifest.dat.zst` or `manifest.dat.gz`, and decompressed while they are parsed.
+ *
+ * @param file_or_url directory or URL containing the manifest (NULL=`SPM_GLOBAL.package_dir`)
+ * @return `Manifest` structure
+ */
+Manifest *manifest_read(char *file_or_url) {
+    FILE *fp = NULL;
+    Manifest *info = NULL;
+    char *path_manifest = NULL;
+    char *remote_manifest = NULL;
 
-    Manifest *info = (Manifest *)calloc(1, sizeof(Manifest));
-    info->packages = (ManifestPackage **)calloc(total_records + 1, sizeof(ManifestPackage *));
+    // When file_or_url is NULL we want to use the global manifest
+    if (file_or_url == NULL) {
+        file_or_url = SPM_GLOBAL.package_dir;
+    }
 
-    // Record manifest's origin
-    memset(info->origin, '\0', SPM_PACKAGE_MEMBER_ORIGIN_SIZE);
-    if (remote_manifest != NULL) {
-        strcpy(info->origin, remote_manifest);
+    remote_manifest = join_ex(DIRSEPS, file_or_url, SPM_MANIFEST_FILENAME, NULL);
+    if (exists(file_or_url) != 0 && (info = manifest_read_delta(file_or_url, remote_manifest)) != NULL) {
+        manifest_set_origin(info, file_or_url, remote_manifest);
+        free(remote_manifest);
+        return info;
     }
-    else {
-        strcpy(info->origin, path);
+
+    if ((info = manifest_read_index(file_or_url)) != NULL) {
+        free(remote_manifest);
+        return info;
     }
-    free(remote_manifest);
 
-    // Check validity of the manifest's formatting and field length
-    if ((valid = manifest_validate()) != 0) {
-        return NULL;
+    if (exists(remote_manifest) == 0) {
+        // Local manifests are read in place
+        path_manifest = strdup(remote_manifest);
+    }
+    else if (exists(file_or_url) == 0) {
+        // A local repository published without a plain manifest
+        for (size_t i = 0; i < sizeof(manifest_read_formats) / sizeof(*manifest_read_formats); i++) {
+            path_manifest = join_ex("", remote_manifest, compress_extension(manifest_read_formats[i]), NULL);
+            if (path_manifest == NULL || exists(path_manifest) == 0) {
+                break;
+            }
+            free(path_manifest);
+            path_manifest = NULL;
+        }
+        if (path_manifest == NULL) {
+            perror(remote_manifest);
+            goto cleanup;
+        }
+    }
+    else {
+        int fetch_status = manifest_read_fetch(remote_manifest, &path_manifest);
+        if (fetch_status >= 400) {
+            fprintf(stderr, "HTTP %d: %s: %s\n", fetch_status, http_response_str(fetch_status), remote_manifest);
+            goto cleanup;
+        }
+        else if (fetch_status != 0) {
+            fprintf(stderr, "Unable to download %s\n", remote_manifest);
+            goto cleanup;
+        }
     }
 
-    // Begin parsing the manifest
-    const char separator[] = {SPM_MANIFEST_SEPARATOR, '\0'};
-    size_t i = 0;
+    if ((fp = compress_fopen(path_manifest)) == NULL) {
+        perror(SPM_MANIFEST_FILENAME);
+        fprintf(SYSERROR);
+        goto cleanup;
+    }
 
-    // Consume header
-    if (fgets(dptr, BUFSIZ, fp) == NULL) {
-        // file is probably empty
-        return NULL;
+    info = manifest_parse(fp);
+    if (info != NULL && ferror(fp)) {
+        fprintf(stderr, "%s: read error\n", path_manifest);
+        manifest_free(info);
+        info = NULL;
+    }
+    fclose(fp);
+    if (info == NULL) {
+        goto cleanup;
     }
 
-    info->records = total_records;
-    while (fgets(dptr, BUFSIZ, fp) != NULL) {
-        dptr = strip(dptr);
-        char **parts = split(dptr, separator);
-        char *_origin = NULL;
+    manifest_set_origin(info, file_or_url, remote_manifest);
 
-        if (file_or_url != NULL) {
-            _origin = strdup(file_or_url);
-        }
-        else {
-            _origin = dirname(path);
-        }
+cleanup:
+    free(path_manifest);
+    free(remote_manifest);
+    return info;
+}
 
-        info->packages[i] = (ManifestPackage *)calloc(1, sizeof(ManifestPackage));
+/**
+ * Name index sort record
+ */
+struct ManifestNameSort {
+    ManifestPackage *package;
+    size_t index;
+    size_t rank;            // position of the package's `Manifest` in a `ManifestList`
+};
 
-        strncpy(info->packages[i]->origin, _origin, SPM_PACKAGE_MEMBER_ORIGIN_SIZE);
-        free(_origin);
+/**
+ * Order packages by name, then manifest, then version, then position in the manifest
+ */
+static int manifest_name_compare(const void *a, const void *b) {
+    const struct ManifestNameSort *aa = a;
+    const struct ManifestNameSort *bb = b;
+    int result = strcmp(aa->package->name, bb->package->name);
+    if (result != 0) {
+        return result;
+    }
+    if (aa->rank != bb->rank) {
+        return aa->rank < bb->rank ? -1 : 1;
+    }
+    if ((result = strcmp(aa->package->version_key, bb->package->version_key)) != 0) {
+        return result;
+    }
+    return aa->index < bb->index ? -1 : aa->index > bb->index;
+}
 
-        strncpy(info->packages[i]->archive, parts[0], SPM_PACKAGE_MEMBER_SIZE);
-        info->packages[i]->size = strtoul(parts[1], NULL, 10);
-        strncpy(info->packages[i]->name, parts[2], SPM_PACKAGE_MEMBER_SIZE);
-        strncpy(info->packages[i]->version, parts[3], SPM_PACKAGE_MEMBER_SIZE);
-        strncpy(info->packages[i]->revision, parts[4], SPM_PACKAGE_MEMBER_SIZE);
-        info->packages[i]->requirements_records = strtoul(parts[5], NULL, 10);
+/**
+ * Group the records of a `Manifest` by package name, each group sorted by version
+ * @param info `Manifest`
+ * @return 0=success, -1=error
+ */
+static int manifest_name_index(Manifest *info) {
+    struct ManifestNameSort *sorted = NULL;
+    ManifestRange *range = NULL;
+    size_t count = 0;
+
+    sorted = calloc(info->records + 1, sizeof(*sorted));
+    info->names = hashmap_init(info->records);
+    info->by_name = arena_alloc(info->arena, (info->records + 1) * sizeof(*info->by_name));
+    if (sorted == NULL || info->names == NULL || info->by_name == NULL) {
+        perror("Failed to allocate package name index");
+        fprintf(SYSERROR);
+        goto failed;
+    }
 
-        info->packages[i]->requirements = NULL;
-        if (strncmp(parts[6], SPM_MANIFEST_NODATA, strlen(SPM_MANIFEST_NODATA)) != 0) {
-            info->packages[i]->requirements = split(parts[6], ",");
+    for (size_t i = 0; i < info->records; i++) {
+        if (info->packages[i] == NULL) {
+            continue;
         }
-        if (strncmp(parts[7], SPM_MANIFEST_NODATA, strlen(SPM_MANIFEST_NODATA)) != 0) {
-            memset(info->packages[i]->checksum_sha256, '\0', SHA256_DIGEST_STRING_LENGTH);
-            strcpy(info->packages[i]->checksum_sha256, parts[7]);
-
+        // Records built by hand may not have a version key yet
+        if (info->packages[i]->version_key == NULL
+            && manifest_package_set_version(info, info->packages[i], info->packages[i]->version) < 0) {
+            goto failed;
         }
+        sorted[count].package = info->packages[i];
+        sorted[count].index = i;
+        count++;
+    }
+    qsort(sorted, count, sizeof(*sorted), manifest_name_compare);
 
-        split_free(parts);
-        i++;
+    for (size_t i = 0; i < count; i++) {
+        info->by_name[i] = sorted[i].package;
+        if (range != NULL && strcmp(info->by_name[range->first]->name, sorted[i].package->name) == 0) {
+            range->count++;
+            continue;
+        }
+        range = arena_alloc(info->arena, sizeof(*range));
+        if (range == NULL || hashmap_put(info->names, sorted[i].package->name, range) < 0) {
+            goto failed;
+        }
+        range->first = i;
+        range->count = 1;
     }
 
-    if (tmpdir != NULL) {
-        rmdirs(tmpdir);
-        free(tmpdir);
+    free(sorted);
+    return 0;
+
+failed:
+    free(sorted);
+    hashmap_free(info->names);
+    info->names = NULL;
+    return -1;
+}
+
+/**
+ * Get every version of a package stored in a `Manifest`
+ *
+ * The records are found at `info->by_name[range->first .. range->first + range->count - 1]` in ascending version
+ * order, with matching versions kept in manifest order. The index is built on first use.
+ *
+ * @param info `Manifest`
+ * @param name package name
+ * @return success=`ManifestRange`, not found=NULL
+ */
+const ManifestRange *manifest_name_range(const Manifest *info, const char *name) {
+    if (info == NULL || name == NULL) {
+        return NULL;
     }
-    fclose(fp);
-    return info;
+    if (info->names == NULL && manifest_name_index((Manifest *) info) < 0) {
+        return NULL;
+    }
+    return hashmap_get(info->names, name);
 }
 
 /**
@@ -546,17 +1426,122 @@ ManifestPackage *manifest_package_copy(const ManifestPackage *manifest) {
         return NULL;
     }
 
+    // The copy shares its strings with the original, so it must not outlive the `Manifest` it came from
     ManifestPackage *result = calloc(1, sizeof(ManifestPackage));
+    if (result == NULL) {
+        return NULL;
+    }
     memcpy(result, manifest, sizeof(ManifestPackage));
+    return result;
+}
+
+/**
+ * Discard the merged name index of a `ManifestList`
+ * @param pManifestList `ManifestList`
+ */
+static void manifestlist_name_index_free(ManifestList *pManifestList) {
+    hashmap_free(pManifestList->names);
+    free(pManifestList->ranges);
+    free(pManifestList->by_name);
+    free(pManifestList->by_name_rank);
+    pManifestList->names = NULL;
+    pManifestList->ranges = NULL;
+    pManifestList->by_name = NULL;
+    pManifestList->by_name_rank = NULL;
+}
+
+/**
+ * Group the records of every `Manifest` in a `ManifestList` by package name
+ *
+ * Within a group, records are ordered by the position of their `Manifest` in the list, then by version.
+ *
+ * @param pManifestList `ManifestList`
+ * @return 0=success, -1=error
+ */
+static int manifestlist_name_index(ManifestList *pManifestList) {
+    struct ManifestNameSort *sorted = NULL;
+    ManifestRange *range = NULL;
+    size_t total = 0;
+    size_t count = 0;
+    size_t groups = 0;
+
+    for (size_t m = 0; m < manifestlist_count(pManifestList); m++) {
+        total += pManifestList->data[m]->records;
+    }
+
+    sorted = calloc(total + 1, sizeof(*sorted));
+    pManifestList->names = hashmap_init(total);
+    pManifestList->ranges = calloc(total + 1, sizeof(*pManifestList->ranges));
+    pManifestList->by_name = calloc(total + 1, sizeof(*pManifestList->by_name));
+    pManifestList->by_name_rank = calloc(total + 1, sizeof(*pManifestList->by_name_rank));
+    if (sorted == NULL || pManifestList->names == NULL || pManifestList->ranges == NULL
+        || pManifestList->by_name == NULL || pManifestList->by_name_rank == NULL) {
+        perror("Failed to allocate package name index");
+        fprintf(SYSERROR);
+        goto failed;
+    }
 
-    if (manifest->requirements_records > 0 && manifest->requirements != NULL) {
-        result->requirements = (char **)calloc(manifest->requirements_records, sizeof(char *));
-        for (size_t i = 0; i < manifest->requirements_records; i++) {
-            result->requirements[i] = strdup(manifest->requirements[i]);
+    for (size_t m = 0; m < manifestlist_count(pManifestList); m++) {
+        Manifest *info = pManifestList->data[m];
+        for (size_t i = 0; i < info->records; i++) {
+            if (info->packages[i] == NULL) {
+                continue;
+            }
+            if (info->packages[i]->version_key == NULL
+                && manifest_package_set_version(info, info->packages[i], info->packages[i]->version) < 0) {
+                goto failed;
+            }
+            sorted[count].package = info->packages[i];
+            sorted[count].index = i;
+            sorted[count].rank = m;
+            count++;
         }
     }
+    qsort(sorted, count, sizeof(*sorted), manifest_name_compare);
 
-    return result;
+    for (size_t i = 0; i < count; i++) {
+        pManifestList->by_name[i] = sorted[i].package;
+        pManifestList->by_name_rank[i] = sorted[i].rank;
+        if (range != NULL && strcmp(pManifestList->by_name[range->first]->name, sorted[i].package->name) == 0) {
+            range->count++;
+            continue;
+        }
+        range = &pManifestList->ranges[groups++];
+        if (hashmap_put(pManifestList->names, sorted[i].package->name, range) < 0) {
+            goto failed;
+        }
+        range->first = i;
+        range->count = 1;
+    }
+
+    free(sorted);
+    return 0;
+
+failed:
+    free(sorted);
+    manifestlist_name_index_free(pManifestList);
+    return -1;
+}
+
+/**
+ * Get every version of a package stored in a `ManifestList`
+ *
+ * The records are found at `by_name[range->first .. range->first + range->count - 1]`, ordered by the position of
+ * their `Manifest` in the list and then by ascending version. `by_name_rank` holds the `Manifest` position of each
+ * record at the same offsets. The index is built on first use and discarded when the list changes.
+ *
+ * @param pManifestList `ManifestList`
+ * @param name package name
+ * @return success=`ManifestRange`, not found=NULL
+ */
+const ManifestRange *manifestlist_name_range(ManifestList *pManifestList, const char *name) {
+    if (pManifestList == NULL || name == NULL) {
+        return NULL;
+    }
+    if (pManifestList->names == NULL && manifestlist_name_index(pManifestList) < 0) {
+        return NULL;
+    }
+    return hashmap_get(pManifestList->names, name);
 }
 
 /**
@@ -569,6 +1554,11 @@ void manifestlist_free(ManifestList *pManifestList) {
             manifest_free(pManifestList->data[i]);
         }
     }
+    manifestlist_name_index_free(pManifestList);
+    for (size_t i = 0; pManifestList->specs != NULL && i < pManifestList->specs->num_alloc; i++) {
+        version_spec_free(pManifestList->specs->entry[i].value);
+    }
+    hashmap_free(pManifestList->specs);
     free(pManifestList->data);
     free(pManifestList);
 }
@@ -585,8 +1575,7 @@ void manifestlist_append(ManifestList *pManifestList, char *path) {
         fprintf(SYSERROR);
         exit(1);
     } else if (spmerrno == SPM_ERR_MANIFEST_EMPTY || spmerrno == SPM_ERR_MANIFEST_INVALID) {
-        manifest = calloc(1, sizeof(Manifest));
-        manifest->packages = calloc(1, sizeof(ManifestPackage *));
+        manifest = manifest_init();
     }
 
     Manifest **tmp = realloc(pManifestList->data, (pManifestList->num_alloc + 1) * sizeof(Manifest *));
@@ -595,30 +1584,73 @@ void manifestlist_append(ManifestList *pManifestList, char *path) {
         perror("failed to append to array");
         exit(1);
     }
+    manifestlist_name_index_free(pManifestList);
     pManifestList->data = tmp;
     pManifestList->data[pManifestList->num_inuse] = manifest;
     pManifestList->num_inuse++;
     pManifestList->num_alloc++;
 }
 
-ManifestPackage *manifestlist_search(ManifestList *pManifestList, const char *_package) {
-    ManifestPackage *found[255] = {0,};
-    ManifestPackage *result = NULL;
-    ssize_t offset = -1;
+/**
+ * Find the best package matching a compiled specification across every `Manifest` in a `ManifestList`
+ *
+ * Manifests appended later take priority: the result is the highest matching version from the last `Manifest`
+ * that has a match.
+ *
+ * @param pManifestList `ManifestList`
+ * @param spec `VersionSpec`
+ * @return found=copy of `ManifestPackage` (caller must free), not found=NULL
+ */
+ManifestPackage *manifestlist_search_spec(ManifestList *pManifestList, const VersionSpec *spec) {
+    const ManifestRange *range = manifestlist_name_range(pManifestList, spec->name);
+    if (range == NULL) {
+        return NULL;
+    }
+
+    ManifestPackage **candidates = &pManifestList->by_name[range->first];
+    const size_t *ranks = &pManifestList->by_name_rank[range->first];
 
-    for (size_t i = 0; i < manifestlist_count(pManifestList); i++) {
-        Manifest *item = manifestlist_item(pManifestList, i);
-        result = manifest_search(item, _package);
-        if (result != NULL) {
-            offset++;
-            found[offset] = result;
+    // Walk the group one manifest at a time, starting with the last
+    for (size_t end = range->count; end > 0;) {
+        size_t start = end - 1;
+        while (start > 0 && ranks[start - 1] == ranks[end - 1]) {
+            start--;
         }
+        ssize_t best = version_spec_best(spec, &candidates[start], end - start);
+        if (best >= 0) {
+            return manifest_package_copy(candidates[start + best]);
+        }
+        end = start;
     }
+    return NULL;
+}
+
+/**
+ * Find the best package matching a specification across every `Manifest` in a `ManifestList`
+ *
+ * Specifications are compiled once and kept with the list, so repeated requirements are not parsed again.
+ * See `manifestlist_search_spec`.
+ *
+ * @param pManifestList `ManifestList`
+ * @param _package package specification (`zlib`, `zlib>=1.2`, or an archive name)
+ * @return found=copy of `ManifestPackage` (caller must free), not found=NULL
+ */
+ManifestPackage *manifestlist_search(ManifestList *pManifestList, const char *_package) {
+    VersionSpec *spec = NULL;
 
-    if (offset < 0) {
+    if (pManifestList->specs == NULL && (pManifestList->specs = hashmap_init(0)) == NULL) {
         return NULL;
     }
-    return found[offset];
+    if ((spec = hashmap_get(pManifestList->specs, _package)) == NULL) {
+        if ((spec = version_spec_compile(_package)) == NULL) {
+            return NULL;
+        }
+        if (hashmap_put(pManifestList->specs, spec->spec, spec) < 0) {
+            version_spec_free(spec);
+            return NULL;
+        }
+    }
+    return manifestlist_search_spec(pManifestList, spec);
 }
 
 /**
@@ -644,6 +1676,7 @@ void manifestlist_set(ManifestList *pManifestList, size_t index, Manifest *value
     if ((item = manifestlist_item(pManifestList, index)) == NULL) {
         return;
     }
+    manifestlist_name_index_free(pManifestList);
     memcpy(pManifestList->data[index], value, sizeof(Manifest));
 }
 
@@ -0,0 +1,435 @@
+/**
+ * Remote manifest cache
+ *
+ * Files downloaded from a manifest URL are kept in `~/.spm/cache/manifests`. Each entry is named after the SHA256
+ * digest of its URL and is accompanied by a `.meta` file holding the validators returned by the server. Later
+ * requests for the same URL are made conditional, so an unchanged manifest costs one "304 Not Modified" round trip.
+ * Entries validated less than `SPM_GLOBAL.manifest_ttl` seconds ago are used without contacting the server.
+ *
+ * Manifests kept up to date with deltas are stored as binary indexes with `manifest_cache_store()` under a key of
+ * their own, along with the generation they represent.
+ *
+ * @file manifest_cache.c
+ */
+#include "spm.h"
+#include "url.h"
+#include <openssl/sha.h>
+
+#define SPM_MANIFEST_CACHE_META ".meta"
+
+/**
+ * Validators stored alongside a cache entry
+ */
+struct ManifestCacheMeta {
+    long status;            // HTTP status of the cached response (0=success)
+    char *etag;
+    char *last_modified;
+    size_t generation;      // manifest generation (0=not tracked)
+};
+
+/**
+ * Get the directory holding cached manifests
+ * @return path (caller must free), or NULL on error
+ */
+static char *manifest_cache_dir(void) {
+    char *result = NULL;
+    const char *base = SPM_GLOBAL.user_config_basedir;
+
+    if (base == NULL) {
+        // The configuration directory is not writable
+        base = TMP_DIR;
+    }
+    if (base == NULL) {
+        return NULL;
+    }
+
+    result = join_ex(DIRSEPS, base, "cache", "manifests", NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    if (access(result, F_OK) != 0 && mkdirs(result, 0755) != 0) {
+        perror(result);
+        fprintf(SYSERROR);
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Get the path of the cache entry for a URL
+ * @param url address of a remote file
+ * @return path (caller must free), or NULL on error
+ */
+char *manifest_cache_path(const char *url) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    char name[SHA256_DIGEST_STRING_LENGTH];
+    char *dir = NULL;
+    char *result = NULL;
+
+    if (url == NULL || (dir = manifest_cache_dir()) == NULL) {
+        return NULL;
+    }
+
+    SHA256((const unsigned char *) url, strlen(url), digest);
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        snprintf(&name[i * 2], 3, "%02x", digest[i]);
+    }
+
+    result = join((char *[]) {dir, name, NULL}, DIRSEPS);
+    free(dir);
+    return result;
+}
+
+/**
+ * Read the validators of a cache entry
+ * @param filename path to `.meta` file
+ * @param meta destination
+ * @return 0=success, -1=missing or unreadable
+ */
+static int manifest_cache_meta_read(const char *filename, struct ManifestCacheMeta *meta) {
+    FILE *fp = NULL;
+    char *line = NULL;
+    size_t line_alloc = 0;
+    ssize_t line_len = 0;
+
+    memset(meta, '\0', sizeof(*meta));
+    if ((fp = fopen(filename, "r")) == NULL) {
+        return -1;
+    }
+
+    while ((line_len = getline(&line, &line_alloc, fp)) >= 0) {
+        char *value = strchr(line, '=');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        strip(value);
+
+        if (strcmp(line, "status") == 0) {
+            meta->status = strtol(value, NULL, 10);
+        } else if (strcmp(line, "etag") == 0 && *value != '\0') {
+            meta->etag = strdup(value);
+        } else if (strcmp(line, "last_modified") == 0 && *value != '\0') {
+            meta->last_modified = strdup(value);
+        } else if (strcmp(line, "generation") == 0) {
+            meta->generation = strtoul(value, NULL, 10);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * Write the validators of a cache entry
+ *
+ * The file is replaced atomically. Its modification time records when the entry was last validated.
+ *
+ * @param filename path to `.meta` file
+ * @param url address of the cached file
+ * @param meta validators
+ * @return 0=success, -1=error
+ */
+static int manifest_cache_meta_write(const char *filename, const char *url, const struct ManifestCacheMeta *meta) {
+    char tmpfile[PATH_MAX];
+    FILE *fp = NULL;
+    int fd = -1;
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", filename) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(filename);
+        return -1;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        return -1;
+    }
+
+    fprintf(fp, "url=%s\n", url);
+    fprintf(fp, "status=%ld\n", meta->status);
+    fprintf(fp, "etag=%s\n", meta->etag ? meta->etag : "");
+    fprintf(fp, "last_modified=%s\n", meta->last_modified ? meta->last_modified : "");
+    fprintf(fp, "generation=%zu\n", meta->generation);
+    if (fclose(fp) != 0 || rename(tmpfile, filename) < 0) {
+        perror(filename);
+        unlink(tmpfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Download a URL into the cache
+ * @param url address of a remote file
+ * @param path cache entry
+ * @param meta validators of the current entry (updated on success)
+ * @return 0=downloaded, 304=not modified, >=400=HTTP error, other=error
+ */
+static int manifest_cache_download(const char *url, const char *path, struct ManifestCacheMeta *meta) {
+    char tmpfile[PATH_MAX];
+    char buffer[0xffff];
+    URL_FILE *handle = NULL;
+    FILE *outf = NULL;
+    size_t nread = 0;
+    long status = 0;
+    int write_error = 0;
+    int fd = -1;
+
+    handle = url_fopen_conditional(url, meta->etag, meta->last_modified);
+    if (handle == NULL) {
+        return 2;
+    }
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", path) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(path);
+        url_fclose(handle);
+        return 1;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (outf = fdopen(fd, "wb")) == NULL) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        url_fclose(handle);
+        return 1;
+    }
+
+    do {
+        nread = url_fread(buffer, 1, sizeof(buffer), handle);
+        if (handle->http_status >= 400) {
+            break;
+        }
+        if (fwrite(buffer, 1, nread, outf) != nread) {
+            write_error = 1;
+            break;
+        }
+    } while (nread);
+
+    status = url_status(handle);
+    if (handle->http_status >= 400) {
+        status = handle->http_status;
+    } else if (status != 304 && handle->result != CURLE_OK) {
+        // i.e. the connection was refused
+        status = 2;
+    }
+    if (fclose(outf) != 0) {
+        write_error = 1;
+    }
+
+    if (write_error && status != 304 && status < 400) {
+        // i.e. the disk is full. Never store a truncated manifest
+        perror(tmpfile);
+        unlink(tmpfile);
+        status = 1;
+    } else if (status == 304 || status == 2) {
+        unlink(tmpfile);
+    } else if (status >= 400) {
+        unlink(tmpfile);
+        free(meta->etag);
+        free(meta->last_modified);
+        meta->etag = NULL;
+        meta->last_modified = NULL;
+        meta->status = status;
+    } else if (rename(tmpfile, path) < 0) {
+        perror(path);
+        unlink(tmpfile);
+        status = 1;
+    } else {
+        free(meta->etag);
+        free(meta->last_modified);
+        meta->etag = handle->etag;
+        meta->last_modified = handle->last_modified;
+        handle->etag = NULL;
+        handle->last_modified = NULL;
+        meta->status = 0;
+        meta->generation = 0;
+        status = 0;
+    }
+
+    url_fclose(handle);
+    return (int) status;
+}
+
+/**
+ * Get a current local copy of a remote manifest file
+ *
+ * ~~~{.c}
+ * char *path = NULL;
+ * int status = manifest_cache_fetch("https://example.com/Linux/x86_64/manifest.dat", &path);
+ * if (status == 0) {
+ *     // read path
+ *     free(path);
+ * }
+ * ~~~
+ *
+ * Errors reported by the server (i.e. 404 Not Found) are cached too, so a missing `manifest.idx` is not requested
+ * again until the entry expires. When the server cannot be reached a previously downloaded copy is used instead.
+ *
+ * @param url address of a remote file
+ * @param path where to store the path of the local copy (caller must free)
+ * @return 0=success, >=400=HTTP error, other=error (same as `fetch()`)
+ */
+int manifest_cache_fetch(const char *url, char **path) {
+    struct ManifestCacheMeta meta;
+    struct stat st;
+    char *entry = NULL;
+    char *meta_file = NULL;
+    int have_entry = 0;
+    int status = 0;
+
+    *path = NULL;
+    memset(&meta, '\0', sizeof(meta));
+    if ((entry = manifest_cache_path(url)) == NULL) {
+        return -1;
+    }
+    meta_file = join_ex("", entry, SPM_MANIFEST_CACHE_META, NULL);
+    if (meta_file == NULL) {
+        free(entry);
+        return -1;
+    }
+
+    if (manifest_cache_meta_read(meta_file, &meta) == 0) {
+        have_entry = meta.status != 0 || exists(entry) == 0;
+        if (meta.status == 0 && !have_entry) {
+            // The validators describe a file that is gone
+            free(meta.etag);
+            free(meta.last_modified);
+            memset(&meta, '\0', sizeof(meta));
+        }
+    }
+
+    if (have_entry && SPM_GLOBAL.manifest_ttl > 0 && stat(meta_file, &st) == 0
+        && time(NULL) - st.st_mtime < SPM_GLOBAL.manifest_ttl) {
+        if (SPM_GLOBAL.verbose) {
+            printf("Using cached copy of %s\n", url);
+        }
+        status = (int) meta.status;
+        goto done;
+    }
+
+    status = manifest_cache_download(url, entry, &meta);
+    if (status == 0 || status == 304 || status >= 400) {
+        if (status == 304) {
+            if (SPM_GLOBAL.verbose) {
+                printf("Not modified: %s\n", url);
+            }
+            status = (int) meta.status;
+        }
+        manifest_cache_meta_write(meta_file, url, &meta);
+    } else if (have_entry) {
+        fprintf(stderr, "Warning: unable to reach %s (using cached copy)\n", url);
+        status = (int) meta.status;
+    }
+
+done:
+    if (status == 0) {
+        *path = entry;
+        entry = NULL;
+    }
+    free(meta.etag);
+    free(meta.last_modified);
+    free(meta_file);
+    free(entry);
+    return status;
+}
+
+/**
+ * Get the cached copy of a URL without contacting the server
+ * @param url cache key
+ * @param path where to store the path of the cached copy (caller must free)
+ * @param generation where to store the generation of the cached copy (NULL=ignore)
+ * @return 0=success, -1=not cached
+ */
+int manifest_cache_lookup(const char *url, char **path, size_t *generation) {
+    struct ManifestCacheMeta meta;
+    char *entry = NULL;
+    char *meta_file = NULL;
+    int result = -1;
+
+    *path = NULL;
+    if ((entry = manifest_cache_path(url)) == NULL) {
+        return -1;
+    }
+    meta_file = join_ex("", entry, SPM_MANIFEST_CACHE_META, NULL);
+    if (meta_file != NULL && manifest_cache_meta_read(meta_file, &meta) == 0) {
+        if (meta.status == 0 && exists(entry) == 0) {
+            if (generation != NULL) {
+                *generation = meta.generation;
+            }
+            *path = entry;
+            entry = NULL;
+            result = 0;
+        }
+        free(meta.etag);
+        free(meta.last_modified);
+    }
+    free(meta_file);
+    free(entry);
+    return result;
+}
+
+/**
+ * Store a `Manifest` in the cache as a binary index
+ *
+ * The entry is replaced atomically, so a `Manifest` mapped from the previous entry remains valid.
+ *
+ * @param url cache key
+ * @param info `Manifest` (its `generation` is recorded)
+ * @return 0=success, -1=error
+ */
+int manifest_cache_store(const char *url, const Manifest *info) {
+    struct ManifestCacheMeta meta;
+    char tmpfile[PATH_MAX];
+    char *entry = NULL;
+    char *meta_file = NULL;
+    FILE *fp = NULL;
+    int fd = -1;
+    int result = -1;
+
+    memset(&meta, '\0', sizeof(meta));
+    meta.generation = info->generation;
+    if ((entry = manifest_cache_path(url)) == NULL || (meta_file = join_ex("", entry, SPM_MANIFEST_CACHE_META, NULL)) == NULL) {
+        free(entry);
+        return -1;
+    }
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", entry) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(entry);
+        goto done;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        goto done;
+    }
+
+    if (manifest_index_fwrite(info, fp) < 0) {
+        perror(tmpfile);
+        fclose(fp);
+        unlink(tmpfile);
+        goto done;
+    }
+    if (fclose(fp) != 0 || rename(tmpfile, entry) < 0) {
+        perror(entry);
+        unlink(tmpfile);
+        goto done;
+    }
+    result = manifest_cache_meta_write(meta_file, url, &meta);
+
+done:
+    free(meta_file);
+    free(entry);
+    return result;
+}
@@ -0,0 +1,417 @@
+/**
+ * Manifest generations and deltas
+ *
+ * Each time `mkmanifest` changes a repository's manifest it increments the generation number stored in
+ * `manifest.gen` and writes `manifest.delta.<generation>`, which lists the records that were removed from, and added
+ * to, the previous generation:
+ *
+ * ~~~
+ * # SPM MANIFEST DELTA <generation> <records>
+ * -<archive>
+ * +<position>|<manifest record>
+ * ~~~
+ *
+ * Clients holding generation N of a manifest apply deltas N+1 through the current generation instead of downloading
+ * the whole manifest again. Changed records are listed as a removal followed by an addition. Additions are sorted by
+ * position, so applying a delta reproduces the published manifest record for record. `manifest.idx` carries the
+ * generation it was written for, so clients only map it when it matches `manifest.gen`.
+ *
+ * @file manifest_delta.c
+ */
+#include "spm.h"
+
+/**
+ * A record added by a delta
+ */
+struct ManifestDeltaAddition {
+    size_t position;
+    ManifestPackage *package;
+};
+
+/**
+ * Read a generation number
+ * @param filename path to `manifest.gen`
+ * @param generation destination
+ * @return 0=success, -1=missing or invalid
+ */
+int manifest_generation_read(const char *filename, size_t *generation) {
+    char buf[64] = {0};
+    char *end = NULL;
+    FILE *fp = fopen(filename, "r");
+
+    if (fp == NULL) {
+        return -1;
+    }
+    if (fgets(buf, sizeof(buf), fp) == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    strip(buf);
+    *generation = strtoul(buf, &end, 10);
+    if (isempty(buf) || *end != '\0') {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write a generation number
+ *
+ * The file is replaced atomically.
+ *
+ * @param filename path to `manifest.gen`
+ * @param generation generation number
+ * @return 0=success, -1=error
+ */
+int manifest_generation_write(const char *filename, size_t generation) {
+    char tmpfile[PATH_MAX];
+    FILE *fp = NULL;
+    int fd = -1;
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", filename) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(filename);
+        return -1;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        return -1;
+    }
+    fprintf(fp, "%zu\n", generation);
+    if (fclose(fp) != 0 || rename(tmpfile, filename) < 0) {
+        perror(filename);
+        unlink(tmpfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write the delta between two generations of a manifest
+ *
+ * A delta can only be expressed when the records present in both manifests appear in the same relative order.
+ *
+ * @param previous `Manifest` of the previous generation
+ * @param current `Manifest` of the new generation
+ * @param generation the new generation number
+ * @param fp output stream
+ * @return 0=written, 1=the manifests are identical, 2=the delta cannot be expressed, -1=error
+ */
+int manifest_delta_write(const Manifest *previous, const Manifest *current, size_t generation, FILE *fp) {
+    HashMap *archives = hashmap_init(previous->records);
+    char **records = calloc(current->records + 1, sizeof(*records));
+    char *kept = calloc(previous->records + 1, sizeof(*kept));
+    size_t changes = 0;
+    size_t last = 0;
+    int result = 0;
+
+    if (archives == NULL || records == NULL || kept == NULL) {
+        perror("Failed to allocate manifest delta");
+        fprintf(SYSERROR);
+        result = -1;
+        goto done;
+    }
+
+    for (size_t i = 0; i < previous->records; i++) {
+        if (hashmap_put(archives, previous->packages[i]->archive, (void *) (uintptr_t) (i + 1)) < 0) {
+            result = -1;
+            goto done;
+        }
+    }
+
+    // Find changed and added records, and make sure unchanged records kept their order
+    for (size_t i = 0; i < current->records; i++) {
+        size_t slot = (uintptr_t) hashmap_get(archives, current->packages[i]->archive);
+        if ((records[i] = manifest_package_str(current->packages[i])) == NULL) {
+            result = -1;
+            goto done;
+        }
+        if (slot == 0) {
+            changes++;
+            continue;
+        }
+
+        char *record = manifest_package_str(previous->packages[slot - 1]);
+        if (record == NULL) {
+            result = -1;
+            goto done;
+        }
+        if (strcmp(record, records[i]) == 0) {
+            if (slot <= last) {
+                free(record);
+                result = 2;
+                goto done;
+            }
+            last = slot;
+            kept[slot - 1] = 1;
+            free(records[i]);
+            records[i] = NULL;
+        } else {
+            changes++;
+        }
+        free(record);
+    }
+
+    for (size_t i = 0; i < previous->records; i++) {
+        if (!kept[i]) {
+            changes++;
+        }
+    }
+    if (changes == 0) {
+        result = 1;
+        goto done;
+    }
+
+    fprintf(fp, "%s %zu %zu\n", SPM_MANIFEST_DELTA_HEADER, generation, current->records);
+    for (size_t i = 0; i < previous->records; i++) {
+        if (!kept[i]) {
+            fprintf(fp, "-%s\n", previous->packages[i]->archive);
+        }
+    }
+    for (size_t i = 0; i < current->records; i++) {
+        if (records[i] != NULL) {
+            fprintf(fp, "+%zu%c%s\n", i, SPM_MANIFEST_SEPARATOR, records[i]);
+        }
+    }
+
+done:
+    for (size_t i = 0; records != NULL && i < current->records; i++) {
+        free(records[i]);
+    }
+    free(records);
+    free(kept);
+    hashmap_free(archives);
+    return result;
+}
+
+/**
+ * Apply a delta to a manifest
+ *
+ * Applying the same delta twice has no further effect. On failure `info` is left unchanged.
+ *
+ * @param info `Manifest` of the previous generation
+ * @param fp delta stream
+ * @param generation expected generation of the delta
+ * @return 0=success, -1=error (the delta is invalid or does not match `info`)
+ */
+int manifest_delta_apply(Manifest *info, FILE *fp, size_t generation) {
+    struct ManifestDeltaAddition *additions = NULL;
+    ManifestPackage **packages = NULL;
+    HashMap *removed = NULL;
+    char *line = NULL;
+    size_t line_alloc = 0;
+    size_t line_count = 0;
+    size_t num_additions = 0;
+    size_t num_alloc = 0;
+    size_t records = 0;
+    size_t kept = 0;
+    int result = -1;
+
+    if ((removed = hashmap_init(0)) == NULL) {
+        return -1;
+    }
+
+    while (getline(&line, &line_alloc, fp) >= 0) {
+        char *record = strip(line);
+        char *cursor = NULL;
+
+        if (line_count++ == 0) {
+            size_t delta_generation = 0;
+            if (sscanf(record, SPM_MANIFEST_DELTA_HEADER " %zu %zu", &delta_generation, &records) != 2
+                || delta_generation != generation) {
+                fprintf(stderr, "Invalid manifest delta header: %s (expecting generation %zu)\n", record, generation);
+                goto done;
+            }
+            continue;
+        }
+
+        if (*record == '-') {
+            if (hashmap_put(removed, manifest_intern(info, record + 1), removed) < 0) {
+                goto done;
+            }
+        } else if (*record == '+') {
+            if (num_additions >= num_alloc) {
+                num_alloc = num_alloc ? num_alloc * 2 : 64;
+                struct ManifestDeltaAddition *tmp = realloc(additions, num_alloc * sizeof(*additions));
+                if (tmp == NULL) {
+                    perror("Failed to allocate manifest delta");
+                    fprintf(SYSERROR);
+                    goto done;
+                }
+                additions = tmp;
+            }
+            additions[num_additions].position = strtoul(record + 1, &cursor, 10);
+            if (cursor == record + 1 || *cursor != SPM_MANIFEST_SEPARATOR
+                || (num_additions && additions[num_additions].position <= additions[num_additions - 1].position)
+                || (additions[num_additions].package = manifest_package_parse(info, cursor + 1)) == NULL) {
+                fprintf(stderr, "Invalid manifest delta record on line %zu\n", line_count);
+                goto done;
+            }
+            // Replacing an existing record
+            if (hashmap_put(removed, additions[num_additions].package->archive, removed) < 0) {
+                goto done;
+            }
+            num_additions++;
+        } else if (!isempty(record)) {
+            fprintf(stderr, "Invalid manifest delta record on line %zu\n", line_count);
+            goto done;
+        }
+    }
+    if (line_count == 0) {
+        fprintf(stderr, "Empty manifest delta\n");
+        goto done;
+    }
+
+    for (size_t i = 0; i < info->records; i++) {
+        if (hashmap_get(removed, info->packages[i]->archive) == NULL) {
+            kept++;
+        }
+    }
+    if (kept + num_additions != records || (num_additions && additions[num_additions - 1].position >= records)) {
+        fprintf(stderr, "Manifest delta %zu does not match the manifest\n", generation);
+        goto done;
+    }
+
+    packages = calloc(records + 1, sizeof(*packages));
+    if (packages == NULL) {
+        perror("Failed to allocate package array");
+        fprintf(SYSERROR);
+        goto done;
+    }
+
+    // Interleave the surviving records with the additions
+    for (size_t i = 0, a = 0, p = 0; p < records; p++) {
+        if (a < num_additions && additions[a].position == p) {
+            packages[p] = additions[a++].package;
+            continue;
+        }
+        while (hashmap_get(removed, info->packages[i]->archive) != NULL) {
+            i++;
+        }
+        packages[p] = info->packages[i++];
+    }
+
+    free(info->packages);
+    info->packages = packages;
+    info->records = records;
+    info->generation = generation;
+    packages = NULL;
+
+    // The name index describes the previous records
+    hashmap_free(info->names);
+    info->names = NULL;
+    result = 0;
+
+done:
+    free(line);
+    free(packages);
+    free(additions);
+    hashmap_free(removed);
+    return result;
+}
+
+/**
+ * Rewrite a repository's `manifest.idx` for the generation it represents
+ * @param pkgdir directory containing `manifest.idx`
+ * @param current `Manifest` that was written
+ * @param generation generation of `current`
+ * @return 0=success, -1=error
+ */
+static int manifest_generation_stamp(const char *pkgdir, Manifest *current, size_t generation) {
+    char path_index[PATH_MAX];
+    if (snprintf(path_index, sizeof(path_index), "%s%c%s", pkgdir, DIRSEP, SPM_MANIFEST_INDEX_FILENAME) >= (int) sizeof(path_index)) {
+        errno = ENAMETOOLONG;
+        perror(pkgdir);
+        return -1;
+    }
+    current->generation = generation;
+    return manifest_index_write(current, path_index);
+}
+
+/**
+ * Record a new generation of a repository's manifest
+ *
+ * Called after `manifest.dat` has been rewritten. When the manifest changed, the generation number is incremented and
+ * the delta from the previous generation is written next to it. Deltas older than `SPM_MANIFEST_DELTA_MAX`
+ * generations are removed. Either way `manifest.idx` is rewritten last, with the generation of `current`.
+ *
+ * @param pkgdir directory containing `manifest.dat`
+ * @param previous `Manifest` of the previous generation (NULL=none)
+ * @param current `Manifest` that was written (its `generation` is updated)
+ * @return 0=success, -1=error
+ */
+int manifest_delta_publish(const char *pkgdir, const Manifest *previous, Manifest *current) {
+    char path_generation[PATH_MAX];
+    char path_delta[PATH_MAX];
+    char tmpfile[PATH_MAX];
+    size_t generation = 0;
+    int have_generation = 0;
+    int status = 2;
+    FILE *fp = NULL;
+    int fd = -1;
+
+    snprintf(path_generation, sizeof(path_generation), "%s%c%s", pkgdir, DIRSEP, SPM_MANIFEST_GENERATION_FILENAME);
+    have_generation = manifest_generation_read(path_generation, &generation) == 0;
+    snprintf(path_delta, sizeof(path_delta), "%s%c%s%zu", pkgdir, DIRSEP, SPM_MANIFEST_DELTA_PREFIX, generation + 1);
+
+    if (have_generation && previous != NULL) {
+        if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", path_delta) >= (int) sizeof(tmpfile)) {
+            errno = ENAMETOOLONG;
+            perror(path_delta);
+            return -1;
+        }
+        if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+            perror(tmpfile);
+            if (fd >= 0) {
+                close(fd);
+                unlink(tmpfile);
+            }
+            return -1;
+        }
+        status = manifest_delta_write(previous, current, generation + 1, fp);
+        if (fclose(fp) != 0) {
+            status = -1;
+        }
+        if (status == 0 && rename(tmpfile, path_delta) < 0) {
+            perror(path_delta);
+            status = -1;
+        }
+        if (status != 0) {
+            unlink(tmpfile);
+        }
+        if (status < 0) {
+            return -1;
+        }
+        if (status == 1) {
+            // nothing changed
+            return manifest_generation_stamp(pkgdir, current, generation);
+        }
+    }
+
+    // Without a delta (status 2) clients fall back to downloading the whole manifest
+    generation++;
+    if (SPM_GLOBAL.verbose) {
+        printf("Manifest generation: %zu%s\n", generation, status == 0 ? "" : " (no delta)");
+    }
+    if (status != 0) {
+        unlink(path_delta);
+    }
+    if (manifest_generation_write(path_generation, generation) < 0) {
+        return -1;
+    }
+
+    // Prune deltas clients are no longer expected to use
+    for (size_t g = generation > SPM_MANIFEST_DELTA_MAX ? generation - SPM_MANIFEST_DELTA_MAX : 0; g > 0; g--) {
+        snprintf(path_delta, sizeof(path_delta), "%s%c%s%zu", pkgdir, DIRSEP, SPM_MANIFEST_DELTA_PREFIX, g);
+        if (unlink(path_delta) < 0) {
+            break;
+        }
+    }
+    return manifest_generation_stamp(pkgdir, current, generation);
+}
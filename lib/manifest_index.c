@@ -0,0 +1,533 @@
+/**
+ * Binary manifest index
+ *
+ * The index mirrors `manifest.dat` using fixed-width records, an interned string table and a hash table keyed by
+ * package name. It is mapped into memory as-is so reading it requires no parsing.
+ *
+ * ~~~
+ * [ManifestIndexHeader]
+ * [ManifestIndexRecord ...]   header.records
+ * [uint32_t ...]              header.requirements (string offsets)
+ * [uint32_t ...]              header.buckets (1-based record slot, 0=empty)
+ * [char ...]                  header.strings (NUL terminated strings)
+ * ~~~
+ *
+ * @file manifest_index.c
+ */
+#include "spm.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define INDEX_ALIGNMENT 8   // sections start on this boundary so the uint64_t members of records are read in place
+#define INDEX_ALIGN(X) (((X) + (INDEX_ALIGNMENT - 1)) & ~((uint64_t) (INDEX_ALIGNMENT - 1)))
+
+/**
+ * String table under construction
+ */
+struct IndexStrings {
+    char *data;
+    size_t size;
+    size_t num_alloc;
+    uint32_t *slots;        // interned offsets (open addressing, 0=empty)
+    size_t num_slots;
+    int error;              // set when a string could not be stored (the table is incomplete)
+};
+
+/**
+ * Store `s` in the string table unless an identical string is already present
+ * @param st `struct IndexStrings`
+ * @param s string to store
+ * @return offset of string in table (on error `st->error` is set, and 0 is returned)
+ */
+static uint32_t index_strings_intern(struct IndexStrings *st, const char *s) {
+    size_t len;
+    size_t slot;
+
+    if (s == NULL || *s == '\0') {
+        return 0;
+    }
+
+    slot = strhash(s) & (st->num_slots - 1);
+    while (st->slots[slot] != 0) {
+        if (strcmp(&st->data[st->slots[slot]], s) == 0) {
+            return st->slots[slot];
+        }
+        slot = (slot + 1) & (st->num_slots - 1);
+    }
+
+    len = strlen(s) + 1;
+    if (st->size + len > UINT32_MAX) {
+        st->error = 1;
+        return 0;
+    }
+    if (st->size + len > st->num_alloc) {
+        size_t num_alloc = st->num_alloc * 2 + len;
+        char *tmp = realloc(st->data, num_alloc);
+        if (tmp == NULL) {
+            st->error = 1;
+            return 0;
+        }
+        st->data = tmp;
+        st->num_alloc = num_alloc;
+    }
+    memcpy(&st->data[st->size], s, len);
+    st->slots[slot] = (uint32_t) st->size;
+    st->size += len;
+    return st->slots[slot];
+}
+
+/**
+ * Round `n` up to the nearest power of two
+ * @param n
+ * @return
+ */
+static size_t index_pow2(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+/**
+ * Write zero bytes until the file position is aligned
+ * @param fp
+ * @return 0=success, -1=error
+ */
+static int index_pad(FILE *fp) {
+    const char zero[INDEX_ALIGNMENT] = {0};
+    long pos = ftell(fp);
+    if (pos < 0) {
+        return -1;
+    }
+    size_t pad = INDEX_ALIGN((uint64_t) pos) - (uint64_t) pos;
+    if (pad && fwrite(zero, 1, pad, fp) != pad) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write a binary index of a `Manifest` to a stream
+ * @param info `Manifest`
+ * @param fp stream positioned at the start of an empty file
+ * @return 0=success, -1=error
+ */
+int manifest_index_fwrite(const Manifest *info, FILE *fp) {
+    ManifestIndexHeader header;
+    ManifestIndexRecord *records = NULL;
+    uint32_t *requirements = NULL;
+    uint32_t *buckets = NULL;
+    struct IndexStrings st;
+    size_t num_requirements = 0;
+    size_t num_strings = 0;
+    int result = -1;
+
+    if (info == NULL || fp == NULL) {
+        return -1;
+    }
+
+    memset(&header, '\0', sizeof(header));
+    memset(&st, '\0', sizeof(st));
+
+    for (size_t i = 0; i < info->records; i++) {
+        num_requirements += info->packages[i]->requirements_records;
+        num_strings += info->packages[i]->requirements_records + 5;
+    }
+
+    st.num_slots = index_pow2(num_strings * 2 + 1);
+    st.slots = calloc(st.num_slots, sizeof(*st.slots));
+    st.num_alloc = BUFSIZ;
+    st.data = calloc(st.num_alloc, sizeof(char));
+    // offset zero is reserved for the empty string
+    st.size = 1;
+
+    header.records = info->records;
+    header.requirements = num_requirements;
+    header.buckets = index_pow2(info->records * 2 + 1);
+
+    records = calloc(info->records + 1, sizeof(*records));
+    requirements = calloc(num_requirements + 1, sizeof(*requirements));
+    buckets = calloc(header.buckets, sizeof(*buckets));
+    if (!st.slots || !st.data || !records || !requirements || !buckets) {
+        perror("manifest index");
+        fprintf(SYSERROR);
+        goto cleanup;
+    }
+
+    for (size_t i = 0, req = 0; i < info->records; i++) {
+        ManifestPackage *package = info->packages[i];
+        records[i].size = package->size;
+        records[i].mtime = (int64_t) package->mtime;
+        records[i].archive = index_strings_intern(&st, package->archive);
+        records[i].name = index_strings_intern(&st, package->name);
+        records[i].version = index_strings_intern(&st, package->version);
+        if (package->version_key != NULL) {
+            records[i].version_key = index_strings_intern(&st, package->version_key);
+        } else {
+            char *key = version_key(package->version);
+            records[i].version_key = index_strings_intern(&st, key);
+            free(key);
+        }
+        records[i].revision = index_strings_intern(&st, package->revision);
+        records[i].checksum_sha256 = index_strings_intern(&st, package->checksum_sha256);
+        records[i].requirements = (uint32_t) req;
+        records[i].requirements_records = (uint32_t) package->requirements_records;
+        for (size_t r = 0; r < package->requirements_records; r++) {
+            requirements[req++] = index_strings_intern(&st, package->requirements[r]);
+        }
+    }
+
+    if (st.error) {
+        fprintf(stderr, "manifest index: unable to store package strings\n");
+        fprintf(SYSERROR);
+        goto cleanup;
+    }
+
+    // Chain records in reverse so each bucket lists its records in manifest order
+    for (size_t i = info->records; i > 0; i--) {
+        uint64_t bucket = strhash(info->packages[i - 1]->name) & (header.buckets - 1);
+        records[i - 1].next = buckets[bucket];
+        buckets[bucket] = (uint32_t) i;
+    }
+
+    memcpy(header.magic, SPM_MANIFEST_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SPM_MANIFEST_INDEX_VERSION;
+    header.byte_order = SPM_MANIFEST_INDEX_BYTE_ORDER;
+    header.generation = info->generation;
+    header.strings = st.size;
+    header.offset_records = INDEX_ALIGN(sizeof(header));
+    header.offset_requirements = INDEX_ALIGN(header.offset_records + header.records * sizeof(*records));
+    header.offset_buckets = INDEX_ALIGN(header.offset_requirements + header.requirements * sizeof(*requirements));
+    header.offset_strings = INDEX_ALIGN(header.offset_buckets + header.buckets * sizeof(*buckets));
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1
+        || index_pad(fp) < 0
+        || fwrite(records, sizeof(*records), header.records, fp) != header.records
+        || index_pad(fp) < 0
+        || fwrite(requirements, sizeof(*requirements), header.requirements, fp) != header.requirements
+        || index_pad(fp) < 0
+        || fwrite(buckets, sizeof(*buckets), header.buckets, fp) != header.buckets
+        || index_pad(fp) < 0
+        || fwrite(st.data, sizeof(char), st.size, fp) != st.size) {
+        goto cleanup;
+    }
+    result = 0;
+
+cleanup:
+    free(records);
+    free(requirements);
+    free(buckets);
+    free(st.slots);
+    free(st.data);
+    return result;
+}
+
+/**
+ * Write a binary index of a `Manifest`
+ *
+ * The index is written to a temporary file and renamed into place so readers never map a partial file.
+ *
+ * @param info `Manifest`
+ * @param dest path to index file
+ * @return 0=success, -1=error
+ */
+int manifest_index_write(const Manifest *info, const char *dest) {
+    char tempfile[PATH_MAX];
+    FILE *fp = NULL;
+
+    if (info == NULL || dest == NULL) {
+        return -1;
+    }
+
+    snprintf(tempfile, sizeof(tempfile), "%s.tmp", dest);
+    if ((fp = fopen(tempfile, "w+b")) == NULL) {
+        perror(tempfile);
+        fprintf(SYSERROR);
+        return -1;
+    }
+
+    if (manifest_index_fwrite(info, fp) < 0) {
+        perror(tempfile);
+        fprintf(SYSERROR);
+        fclose(fp);
+        unlink(tempfile);
+        return -1;
+    }
+    if (fclose(fp) != 0) {
+        perror(tempfile);
+        fprintf(SYSERROR);
+        unlink(tempfile);
+        return -1;
+    }
+
+    if (rename(tempfile, dest) < 0) {
+        perror(dest);
+        fprintf(SYSERROR);
+        unlink(tempfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Verify a section of `count` elements of `size` bytes is aligned and fits within the mapped file
+ * @param index
+ * @param offset
+ * @param count
+ * @param size
+ * @return 1=valid, 0=invalid
+ */
+static int index_section_valid(const ManifestIndex *index, uint64_t offset, uint64_t count, size_t size) {
+    if (offset % INDEX_ALIGNMENT || offset > index->data_size) {
+        return 0;
+    }
+    if (count > (index->data_size - offset) / size) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Map a binary manifest index into memory
+ *
+ * Indexes written by an incompatible producer (version or byte order) are rejected, as are indexes with references
+ * pointing outside of the file.
+ *
+ * @param filename path to index file
+ * @return success=`ManifestIndex`, failure=NULL
+ */
+ManifestIndex *manifest_index_open(const char *filename) {
+    ManifestIndex *index = NULL;
+    struct stat st;
+    int fd;
+
+    if (filename == NULL || (fd = open(filename, O_RDONLY)) < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ManifestIndexHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    index = calloc(1, sizeof(ManifestIndex));
+    if (index == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    index->data_size = (size_t) st.st_size;
+    index->data = mmap(NULL, index->data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (index->data == MAP_FAILED) {
+        perror(filename);
+        free(index);
+        return NULL;
+    }
+
+    index->header = index->data;
+    if (memcmp(index->header->magic, SPM_MANIFEST_INDEX_MAGIC, sizeof(index->header->magic)) != 0
+        || index->header->version != SPM_MANIFEST_INDEX_VERSION
+        || index->header->byte_order != SPM_MANIFEST_INDEX_BYTE_ORDER
+        || index->header->buckets == 0
+        || (index->header->buckets & (index->header->buckets - 1)) != 0
+        || index->header->strings == 0
+        || !index_section_valid(index, index->header->offset_records, index->header->records, sizeof(ManifestIndexRecord))
+        || !index_section_valid(index, index->header->offset_requirements, index->header->requirements, sizeof(uint32_t))
+        || !index_section_valid(index, index->header->offset_buckets, index->header->buckets, sizeof(uint32_t))
+        || !index_section_valid(index, index->header->offset_strings, index->header->strings, sizeof(char))) {
+        goto invalid;
+    }
+
+    index->records = (const ManifestIndexRecord *) ((const char *) index->data + index->header->offset_records);
+    index->requirements = (const uint32_t *) ((const char *) index->data + index->header->offset_requirements);
+    index->buckets = (const uint32_t *) ((const char *) index->data + index->header->offset_buckets);
+    index->strings = (const char *) index->data + index->header->offset_strings;
+
+    // The string table must be terminated, and every reference must land inside of it
+    if (index->strings[index->header->strings - 1] != '\0') {
+        goto invalid;
+    }
+
+    for (size_t i = 0; i < index->header->records; i++) {
+        const ManifestIndexRecord *record = &index->records[i];
+        if (record->archive >= index->header->strings
+            || record->name >= index->header->strings
+            || record->version >= index->header->strings
+            || record->version_key >= index->header->strings
+            || record->revision >= index->header->strings
+            || record->checksum_sha256 >= index->header->strings
+            || record->next > index->header->records
+            || (uint64_t) record->requirements + record->requirements_records > index->header->requirements) {
+            goto invalid;
+        }
+    }
+
+    for (size_t i = 0; i < index->header->requirements; i++) {
+        if (index->requirements[i] >= index->header->strings) {
+            goto invalid;
+        }
+    }
+
+    for (size_t i = 0; i < index->header->buckets; i++) {
+        if (index->buckets[i] > index->header->records) {
+            goto invalid;
+        }
+    }
+
+    return index;
+
+invalid:
+    fprintf(stderr, "Ignoring invalid or incompatible manifest index: %s\n", filename);
+    manifest_index_close(index);
+    return NULL;
+}
+
+/**
+ * Unmap a `ManifestIndex`
+ * @param index
+ */
+void manifest_index_close(ManifestIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    munmap(index->data, index->data_size);
+    free(index);
+}
+
+/**
+ * Return a string stored in the index string table
+ * @param index
+ * @param offset
+ * @return pointer into the mapped string table
+ */
+const char *manifest_index_str(const ManifestIndex *index, uint32_t offset) {
+    return &index->strings[offset];
+}
+
+/**
+ * Scan a hash chain for the next record matching `name`
+ * @param index
+ * @param slot 1-based record slot to start from
+ * @param name package name
+ * @return 1-based record slot, 0=not found
+ */
+static size_t index_chain_scan(const ManifestIndex *index, size_t slot, const char *name) {
+    while (slot != 0) {
+        const ManifestIndexRecord *record = &index->records[slot - 1];
+        if (strcmp(manifest_index_str(index, record->name), name) == 0) {
+            break;
+        }
+        slot = record->next;
+    }
+    return slot;
+}
+
+/**
+ * Find the first record of a package by name
+ *
+ * ~~~{.c}
+ * for (size_t slot = manifest_index_first(index, "zlib"); slot != 0; slot = manifest_index_next(index, slot, "zlib")) {
+ *     ManifestPackage *package = manifest->packages[slot - 1];
+ * }
+ * ~~~
+ *
+ * @param index
+ * @param name package name
+ * @return 1-based record slot, 0=not found
+ */
+size_t manifest_index_first(const ManifestIndex *index, const char *name) {
+    if (index == NULL || name == NULL) {
+        return 0;
+    }
+    return index_chain_scan(index, index->buckets[strhash(name) & (index->header->buckets - 1)], name);
+}
+
+/**
+ * Find the next record of a package by name
+ * @param index
+ * @param slot value returned by `manifest_index_first` or `manifest_index_next`
+ * @param name package name
+ * @return 1-based record slot, 0=not found
+ */
+size_t manifest_index_next(const ManifestIndex *index, size_t slot, const char *name) {
+    if (index == NULL || name == NULL || slot == 0) {
+        return 0;
+    }
+    return index_chain_scan(index, index->records[slot - 1].next, name);
+}
+
+/**
+ * Populate a `Manifest` from a binary manifest index
+ *
+ * Package strings point directly into the mapped index, which the `Manifest` keeps open. Its `origin` members are
+ * left for the caller to assign.
+ *
+ * @param filename path to index file
+ * @return success=`Manifest`, failure=NULL
+ */
+Manifest *manifest_index_read(const char *filename) {
+    ManifestIndex *index = NULL;
+    Manifest *info = NULL;
+
+    if ((index = manifest_index_open(filename)) == NULL) {
+        return NULL;
+    }
+
+    info = manifest_init();
+    if (info == NULL) {
+        manifest_index_close(index);
+        return NULL;
+    }
+    free(info->packages);
+    info->index = index;
+    info->generation = index->header->generation;
+    info->records = index->header->records;
+    info->packages = calloc(info->records + 1, sizeof(ManifestPackage *));
+    if (info->packages == NULL) {
+        perror("Failed to allocate package array");
+        fprintf(SYSERROR);
+        manifest_free(info);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < info->records; i++) {
+        const ManifestIndexRecord *record = &index->records[i];
+        ManifestPackage *package = manifest_package_init(info);
+        if (package == NULL) {
+            perror("Failed to allocate package record");
+            fprintf(SYSERROR);
+            manifest_free(info);
+            return NULL;
+        }
+        info->packages[i] = package;
+
+        package->size = record->size;
+        package->mtime = (time_t) record->mtime;
+        package->archive = (char *) manifest_index_str(index, record->archive);
+        package->name = (char *) manifest_index_str(index, record->name);
+        package->version = (char *) manifest_index_str(index, record->version);
+        package->version_key = (char *) manifest_index_str(index, record->version_key);
+        package->revision = (char *) manifest_index_str(index, record->revision);
+        package->checksum_sha256 = (char *) manifest_index_str(index, record->checksum_sha256);
+
+        if (record->requirements_records == 0) {
+            continue;
+        }
+
+        package->requirements = arena_alloc(info->arena, (record->requirements_records + 1) * sizeof(char *));
+        if (package->requirements == NULL) {
+            perror("Failed to allocate requirements array");
+            fprintf(SYSERROR);
+            manifest_free(info);
+            return NULL;
+        }
+        for (size_t r = 0; r < record->requirements_records; r++) {
+            package->requirements[r] = (char *) manifest_index_str(index, index->requirements[record->requirements + r]);
+            package->requirements_records++;
+        }
+    }
+
+    return info;
+}
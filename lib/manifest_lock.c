@@ -0,0 +1,169 @@
+/**
+ * Lock files
+ *
+ * A lock file records a resolved dependency closure so it can be installed again without reading any manifest or
+ * resolving anything. Records are listed in installation order:
+ *
+ * ~~~
+ * # SPM LOCK FILE
+ * <manifest record>|<origin>
+ * ~~~
+ *
+ * Each record carries the archive checksum published by its manifest, which is verified before the archive is
+ * installed.
+ *
+ * @file manifest_lock.c
+ */
+#include "spm.h"
+
+/**
+ * Write a lock file
+ *
+ * The file is replaced atomically.
+ *
+ * @param filename path to the lock file
+ * @param packages NULL terminated array of `ManifestPackage` in installation order
+ * @return 0=success, -1=error
+ */
+int manifest_lock_write(const char *filename, ManifestPackage **packages) {
+    char tmpfile[PATH_MAX];
+    FILE *fp = NULL;
+    int fd = -1;
+    int problems = 0;
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", filename) >= (int) sizeof(tmpfile)) {
+        errno = ENAMETOOLONG;
+        perror(filename);
+        return -1;
+    }
+    if ((fd = mkstemp(tmpfile)) < 0 || fchmod(fd, 0644) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+        perror(tmpfile);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmpfile);
+        }
+        return -1;
+    }
+
+    fprintf(fp, "%s\n", SPM_MANIFEST_LOCK_HEADER);
+    for (size_t i = 0; packages[i] != NULL; i++) {
+        char *record = NULL;
+        if (isempty(packages[i]->checksum_sha256)) {
+            fprintf(stderr, "Package record has no checksum: %s\n", packages[i]->archive);
+            problems++;
+            continue;
+        }
+        if ((record = manifest_package_str(packages[i])) == NULL) {
+            problems++;
+            break;
+        }
+        fprintf(fp, "%s%c%s\n", record, SPM_MANIFEST_SEPARATOR, packages[i]->origin ? packages[i]->origin : "");
+        free(record);
+    }
+
+    if (fclose(fp) != 0 || problems) {
+        if (!problems) {
+            perror(filename);
+        }
+        unlink(tmpfile);
+        return -1;
+    }
+    if (rename(tmpfile, filename) < 0) {
+        perror(filename);
+        unlink(tmpfile);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read a lock file
+ * @param filename path to the lock file
+ * @return `Manifest` holding the records in installation order, or NULL on error (`spmerrno` is set when the file is
+ * malformed)
+ */
+Manifest *manifest_lock_read(const char *filename) {
+    char *line = NULL;
+    size_t line_alloc = 0;
+    size_t line_count = 0;
+    Manifest *info = NULL;
+    FILE *fp = fopen(filename, "r");
+
+    if (fp == NULL) {
+        perror(filename);
+        return NULL;
+    }
+    if ((info = manifest_init()) == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    info->origin = manifest_intern(info, filename);
+
+    while (getline(&line, &line_alloc, fp) >= 0) {
+        char *record = NULL;
+        char *origin = NULL;
+        ManifestPackage *package = NULL;
+
+        if (line_count++ == 0) {
+            if (strncmp(line, SPM_MANIFEST_LOCK_HEADER, strlen(SPM_MANIFEST_LOCK_HEADER)) != 0) {
+                fprintf(stderr, "Invalid lock file header: %s (expecting '%s')\n", strip(line), SPM_MANIFEST_LOCK_HEADER);
+                goto invalid;
+            }
+            continue;
+        }
+
+        record = strip(line);
+        if (isempty(record)) {
+            continue;
+        }
+
+        // The origin follows the last field of the manifest record and may contain anything
+        origin = record;
+        for (size_t f = 0; origin != NULL && f <= SPM_MANIFEST_SEPARATOR_MAX; f++) {
+            origin = strchr(origin, SPM_MANIFEST_SEPARATOR);
+            origin = origin ? origin + 1 : NULL;
+        }
+        if (origin == NULL) {
+            fprintf(stderr, "Invalid lock file record on line %zu: %s\n", line_count - 1, record);
+            goto invalid;
+        }
+        *(origin - 1) = '\0';
+
+        if ((package = manifest_package_parse(info, record)) == NULL || isempty(package->checksum_sha256)) {
+            fprintf(stderr, "Invalid lock file record on line %zu: %s\n", line_count - 1, record);
+            goto invalid;
+        }
+        package->origin = manifest_intern(info, origin);
+
+        ManifestPackage **tmp = realloc(info->packages, (info->records + 2) * sizeof(*tmp));
+        if (tmp == NULL) {
+            perror("Failed to allocate package array");
+            fprintf(SYSERROR);
+            free(line);
+            fclose(fp);
+            manifest_free(info);
+            return NULL;
+        }
+        info->packages = tmp;
+        info->packages[info->records++] = package;
+        info->packages[info->records] = NULL;
+    }
+    free(line);
+    fclose(fp);
+
+    if (line_count == 0) {
+        spmerrno = SPM_ERR_PARSE;
+        spmerrno_cause(filename);
+        manifest_free(info);
+        return NULL;
+    }
+    return info;
+
+invalid:
+    free(line);
+    fclose(fp);
+    manifest_free(info);
+    spmerrno = SPM_ERR_PARSE;
+    spmerrno_cause(filename);
+    return NULL;
+}
@@ -0,0 +1,212 @@
+/**
+ * Multi-pattern search
+ *
+ * The patterns are compiled into an Aho-Corasick automaton with a complete transition table, so scanning costs one
+ * table lookup per byte regardless of the number of patterns. Transitions hold the offset of the target state's row
+ * and flag the states that recognise a pattern, so the scanning loop does nothing else. The state is kept by the
+ * caller, which allows data to be fed in chunks (matches spanning two chunks are found).
+ *
+ * ~~~{.c}
+ * char *patterns[] = {"/usr/local", "/opt", NULL};
+ * unsigned char found[2] = {0};
+ * uint32_t state = 0;
+ * Matcher *matcher = matcher_init(patterns);
+ *
+ * while ((bytes = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+ *     matcher_feed(matcher, &state, buffer, bytes, found);
+ * }
+ * // found[i] is 1 if patterns[i] occurs in the file
+ * matcher_free(matcher);
+ * ~~~
+ *
+ * @file matcher.c
+ */
+#include "spm.h"
+
+#define MATCHER_ALPHABET 256
+#define MATCHER_OUTPUT 0x80000000u     // set in a transition leading to a state that recognises a pattern
+
+/**
+ * Compile `patterns` into a `Matcher`
+ *
+ * Pattern numbers are indexes into `patterns`. Empty patterns are never reported.
+ *
+ * @param patterns NULL terminated array of strings
+ * @return `Matcher`, or NULL on error
+ */
+Matcher *matcher_init(char **patterns) {
+    Matcher *matcher = NULL;
+    uint32_t *fail = NULL;
+    uint32_t *order = NULL;
+    uint32_t *terminal = NULL;      // first pattern ending in a state (0=none, otherwise pattern number + 1)
+    uint32_t *terminal_next = NULL; // next pattern ending in the same state
+    size_t max_states = 1;
+    size_t num_matches = 0;
+    size_t head = 0;
+    size_t tail = 0;
+
+    if (patterns == NULL) {
+        return NULL;
+    }
+
+    matcher = calloc(1, sizeof(Matcher));
+    if (matcher == NULL) {
+        return NULL;
+    }
+    for (size_t p = 0; patterns[p] != NULL; p++) {
+        max_states += strlen(patterns[p]);
+        matcher->num_patterns++;
+    }
+    if (max_states > (~MATCHER_OUTPUT) / MATCHER_ALPHABET) {
+        free(matcher);
+        return NULL;
+    }
+
+    matcher->next = calloc(max_states * MATCHER_ALPHABET, sizeof(*matcher->next));
+    matcher->match_start = calloc(max_states + 1, sizeof(*matcher->match_start));
+    fail = calloc(max_states, sizeof(*fail));
+    order = calloc(max_states, sizeof(*order));
+    terminal = calloc(max_states, sizeof(*terminal));
+    terminal_next = calloc(matcher->num_patterns + 1, sizeof(*terminal_next));
+    if (matcher->next == NULL || matcher->match_start == NULL || fail == NULL || order == NULL || terminal == NULL
+        || terminal_next == NULL) {
+        goto failed;
+    }
+
+    // Build the trie. State 0 is the root, so a transition to 0 means "no edge" until the table is completed below
+    matcher->num_states = 1;
+    for (size_t p = 0; p < matcher->num_patterns; p++) {
+        uint32_t state = 0;
+        if (*patterns[p] == '\0') {
+            continue;
+        }
+        for (const unsigned char *c = (const unsigned char *) patterns[p]; *c != '\0'; c++) {
+            uint32_t *edge = &matcher->next[state * MATCHER_ALPHABET + *c];
+            if (*edge == 0) {
+                *edge = (uint32_t) matcher->num_states++;
+            }
+            state = *edge;
+        }
+        terminal_next[p + 1] = terminal[state];
+        terminal[state] = (uint32_t) p + 1;
+    }
+
+    // Breadth first: link each state to the longest proper suffix that is also in the trie, and complete the table
+    for (size_t c = 0; c < MATCHER_ALPHABET; c++) {
+        uint32_t child = matcher->next[c];
+        if (child != 0) {
+            order[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        uint32_t state = order[head++];
+        for (size_t c = 0; c < MATCHER_ALPHABET; c++) {
+            uint32_t *edge = &matcher->next[state * MATCHER_ALPHABET + c];
+            uint32_t fallback = matcher->next[fail[state] * MATCHER_ALPHABET + c];
+            if (*edge != 0) {
+                fail[*edge] = fallback;
+                order[tail++] = *edge;
+            } else {
+                *edge = fallback;
+            }
+        }
+    }
+
+    // A state recognises its own patterns and those of its suffix link. Count them first...
+    for (size_t i = 0; i < tail; i++) {
+        uint32_t state = order[i];
+        size_t count = matcher->match_start[fail[state] + 1];
+        for (uint32_t p = terminal[state]; p != 0; p = terminal_next[p]) {
+            count++;
+        }
+        matcher->match_start[state + 1] = (uint32_t) count;
+        num_matches += count;
+    }
+    for (size_t state = 0; state < matcher->num_states; state++) {
+        matcher->match_start[state + 1] += matcher->match_start[state];
+    }
+
+    // ...then fill them in (a suffix link always points to a state visited earlier)
+    matcher->match_list = calloc(num_matches + 1, sizeof(*matcher->match_list));
+    if (matcher->match_list == NULL) {
+        goto failed;
+    }
+    for (size_t i = 0; i < tail; i++) {
+        uint32_t state = order[i];
+        uint32_t *dest = &matcher->match_list[matcher->match_start[state]];
+        for (uint32_t p = terminal[state]; p != 0; p = terminal_next[p]) {
+            *dest++ = p - 1;
+        }
+        for (uint32_t m = matcher->match_start[fail[state]]; m < matcher->match_start[fail[state] + 1]; m++) {
+            *dest++ = matcher->match_list[m];
+        }
+    }
+
+    // Store row offsets instead of state numbers, and flag the states with patterns
+    for (size_t i = 0; i < matcher->num_states * MATCHER_ALPHABET; i++) {
+        uint32_t state = matcher->next[i];
+        matcher->next[i] = state * MATCHER_ALPHABET;
+        if (matcher->match_start[state] != matcher->match_start[state + 1]) {
+            matcher->next[i] |= MATCHER_OUTPUT;
+        }
+    }
+
+    free(fail);
+    free(order);
+    free(terminal);
+    free(terminal_next);
+    return matcher;
+
+failed:
+    free(fail);
+    free(order);
+    free(terminal);
+    free(terminal_next);
+    matcher_free(matcher);
+    return NULL;
+}
+
+/**
+ * Scan `data` for the patterns of `matcher`
+ *
+ * @param matcher `Matcher`
+ * @param state automaton state. Set to 0 before the first call and keep it between the chunks of a stream
+ * @param data bytes to scan
+ * @param size number of bytes in `data`
+ * @param found array of `matcher->num_patterns` flags. The flag of each pattern seen is set to 1
+ * @return number of flags set by this call
+ */
+size_t matcher_feed(const Matcher *matcher, uint32_t *state, const char *data, size_t size, unsigned char *found) {
+    const unsigned char *c = (const unsigned char *) data;
+    const unsigned char *end = c + size;
+    uint32_t current = *state;
+    size_t result = 0;
+
+    for (; c < end; c++) {
+        current = matcher->next[(current & ~MATCHER_OUTPUT) + *c];
+        if (current & MATCHER_OUTPUT) {
+            uint32_t matched = (current & ~MATCHER_OUTPUT) / MATCHER_ALPHABET;
+            for (uint32_t m = matcher->match_start[matched]; m < matcher->match_start[matched + 1]; m++) {
+                if (!found[matcher->match_list[m]]) {
+                    found[matcher->match_list[m]] = 1;
+                    result++;
+                }
+            }
+        }
+    }
+    *state = current;
+    return result;
+}
+
+/**
+ * Free a `Matcher`
+ * @param matcher
+ */
+void matcher_free(Matcher *matcher) {
+    if (matcher != NULL) {
+        free(matcher->next);
+        free(matcher->match_start);
+        free(matcher->match_list);
+        free(matcher);
+    }
+}
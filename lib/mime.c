@@ -1,184 +1,269 @@
 /**
+ * File classification
+ *
+ * Files are classified by the magic bytes at the start of their first `SPM_MIME_MAGIC_SIZE` bytes, falling back to
+ * the text heuristic of `mime_data_is_text`. One `pread` per file replaces running file(1), and results are cached
+ * per file (device and inode) until the file is modified.
+ *
  * @file mime.c
  */
 #include "spm.h"
-#include <fnmatch.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 /**
- * Execute OS `file` command
- * @param _filename path to file
- * @return Process structure
+ * Class of a file, reused while the file is unchanged
  */
-Process *file_command(const char *_filename) {
-    char *filename = strdup(_filename);
-    Process *proc_info = NULL;
-    char sh_cmd[PATH_MAX];
-    sh_cmd[0] = '\0';
-#if OS_DARWIN
-    const char *fmt_cmd = "file -I \"%s\" 2>&1";
-#else  // GNU
-    const char *fmt_cmd = "file -i \"%s\" 2>&1";
-#endif
-    const char *fail_pattern = ": cannot open";
+typedef struct {
+    char key[64];       // "device:inode"
+    struct stat st;     // state of the file when it was classified
+    int type;           // SPM_MIME_*
+} MimeCacheEntry;
 
-    strchrdel(filename, SHELL_INVALID);
-    sprintf(sh_cmd, fmt_cmd, filename);
-    shell(&proc_info, SHELL_OUTPUT, sh_cmd);
+static HashMap *mime_cache = NULL;
+static pthread_mutex_t mime_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    // POSIXly ridiculous. Return non-zero when a file can't be found, or isn't accessible
-    if (strstr(proc_info->output, fail_pattern) != NULL) {
-        proc_info->returncode = 1;
+/**
+ * Read an unsigned integer stored in either byte order
+ * @param data
+ * @param size number of bytes (at most 8)
+ * @param big_endian 1=most significant byte first
+ * @return value
+ */
+static uint64_t mime_get(const unsigned char *data, size_t size, int big_endian) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < size; i++) {
+        result |= (uint64_t) data[i] << ((big_endian ? size - 1 - i : i) * 8);
     }
-    free(filename);
-    return proc_info;
+    return result;
 }
 
 /**
- * Execute the `file` command, parse its output, and return the data in a `Mime` structure
- * @param filename path to file
- * @return Mime structure
+ * Classify the leading bytes of a file
+ *
+ * Recognises ELF images (by object type), Mach-O images and universal binaries, ar(1) archives and scripts. Anything
+ * else is text or data according to `mime_data_is_text`. A script whose leading bytes are not all text (i.e. a
+ * self-extracting archive) is data.
+ *
+ * @param data leading bytes of the file (normally `SPM_MIME_MAGIC_SIZE`)
+ * @param size number of bytes in `data`
+ * @return SPM_MIME_* class
  */
-Mime *file_mimetype(const char *filename) {
-    char **output = NULL;
-    char **parts = NULL;
-    Mime *type = NULL;
-    Process *proc = file_command(filename);
-
-    if (proc->returncode != 0) {
-        fprintf(stderr, "%s\n", proc->output);
-        fprintf(stderr, "file command returned: %d\n", proc->returncode);
-        fprintf(SYSERROR);
-        shell_free(proc);
-        return NULL;
-    }
-
-#if OS_DARWIN
-    if (proc->output) {
-        // Universal binaries spit out multiple lines, but we only require the first
-        char *terminate_multi_part = strchr(proc->output, '\n');
-        if (terminate_multi_part != NULL) {
-            *(terminate_multi_part + 1) = '\0';
-        }
-    }
-#endif
+int mime_classify_data(const char *data, size_t size) {
+    const unsigned char *c = (const unsigned char *) data;
 
-    output = split(proc->output, ":");
-    if (!output || output[1] == NULL) {
-        shell_free(proc);
-        return NULL;
+    if (size == 0) {
+        return SPM_MIME_EMPTY;
     }
 
-    char *origin = NULL;
-    char *what = NULL;
-    char *charset = NULL;
+    // e_ident[EI_DATA] selects the byte order of e_type
+    if (size >= 18 && memcmp(c, "\x7f" "ELF", 4) == 0) {
+        uint64_t type = mime_get(&c[16], 2, c[5] == 2);
+        if (type == 2) {            // ET_EXEC
+            return SPM_MIME_ELF_EXEC;
+        } else if (type == 3) {     // ET_DYN
+            return SPM_MIME_ELF_SHARED;
+        }
+        return SPM_MIME_ELF_OBJECT;
+    }
 
-    if (strchr(output[1], ';')) {
-        parts = split(output[1], ";");
-        if (!parts || !parts[0] || !parts[1]) {
-            shell_free(proc);
-            return NULL;
+    // Mach-O magic numbers are written in the byte order of the target
+    if (size >= 16 && (memcmp(c, "\xfe\xed\xfa\xce", 4) == 0 || memcmp(c, "\xfe\xed\xfa\xcf", 4) == 0
+                       || memcmp(c, "\xce\xfa\xed\xfe", 4) == 0 || memcmp(c, "\xcf\xfa\xed\xfe", 4) == 0)) {
+        uint64_t type = mime_get(&c[12], 4, c[0] == 0xfe);
+        if (type == 2 || type == 6 || type == 7 || type == 8) {  // MH_EXECUTE, MH_DYLIB, MH_DYLINKER, MH_BUNDLE
+            return SPM_MIME_MACHO_EXEC;
         }
+        return SPM_MIME_MACHO_OBJECT;
+    }
 
-        what = strdup(parts[0]);
-        what = lstrip(what);
-
-        charset = strdup(strchr(parts[1], '=') + 1);
-        charset = lstrip(charset);
-        charset[strlen(charset) - 1] = '\0';
-    } else {
-        // this branch is for Darwin; the 'charset=' string is not guaranteed to exist using argument `-I`
-        what = strdup(output[1]);
-        what = lstrip(what);
-        what = strip(what);
-        if (strstr(output[1], "binary") != NULL) {
-            charset = strdup("binary");
+    // Universal binaries share their magic number with Java class files, which store a version >= 45 in its place
+    if (size >= 8 && (memcmp(c, "\xca\xfe\xba\xbe", 4) == 0 || memcmp(c, "\xca\xfe\xba\xbf", 4) == 0)) {
+        uint64_t num_arch = mime_get(&c[4], 4, 1);
+        if (num_arch > 0 && num_arch < 45) {
+            return SPM_MIME_MACHO_EXEC;
         }
+        return SPM_MIME_DATA;
+    }
+
+    if (size >= 8 && (memcmp(c, "!<arch>\n", 8) == 0 || memcmp(c, "!<thin>\n", 8) == 0)) {
+        return SPM_MIME_ARCHIVE;
+    }
+
+    if (!mime_data_is_text(data, size)) {
+        return SPM_MIME_DATA;
+    }
+    if (size >= 2 && c[0] == '#' && c[1] == '!') {
+        return SPM_MIME_SCRIPT;
+    }
+    return SPM_MIME_TEXT;
+}
+
+/**
+ * Determine whether two `stat` results describe the same version of a file
+ * @param a
+ * @param b
+ * @return 1=same, 0=modified
+ */
+static int mime_stat_same(const struct stat *a, const struct stat *b) {
+    if (a->st_size != b->st_size || a->st_mtime != b->st_mtime || a->st_ctime != b->st_ctime) {
+        return 0;
+    }
+#if OS_LINUX
+    if (a->st_mtim.tv_nsec != b->st_mtim.tv_nsec || a->st_ctim.tv_nsec != b->st_ctim.tv_nsec) {
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+/**
+ * Classify a file
+ *
+ * Only the first `SPM_MIME_MAGIC_SIZE` bytes are read (see `mime_classify_data`). Symbolic links are followed.
+ * Results are cached per file (device and inode) until the file is modified. The cache is shared by all threads.
+ *
+ * @param filename path to file
+ * @return success=SPM_MIME_* class, failure=-1 (+ errno will be set)
+ */
+int mime_classify(const char *filename) {
+    MimeCacheEntry *entry = NULL;
+    char data[SPM_MIME_MAGIC_SIZE];
+    ssize_t bytes = 0;
+    struct stat st;
+    char key[64];
+    int type = -1;
+    int fd = -1;
+
+    if (filename == NULL) {
+        errno = EINVAL;
+        return -1;
     }
+    if (stat(filename, &st) < 0) {
+        return -1;
+    }
+    // Never open a FIFO or a device just to look at it
+    if (!S_ISREG(st.st_mode)) {
+        return SPM_MIME_SPECIAL;
+    }
+    snprintf(key, sizeof(key), "%llx:%llx", (unsigned long long) st.st_dev, (unsigned long long) st.st_ino);
 
-    origin = realpath(filename, NULL);
+    pthread_mutex_lock(&mime_cache_lock);
+    entry = hashmap_get(mime_cache, key);
+    if (entry != NULL && mime_stat_same(&entry->st, &st)) {
+        type = entry->type;
+    }
+    pthread_mutex_unlock(&mime_cache_lock);
+    if (type >= 0) {
+        return type;
+    }
 
-    type = (Mime *)calloc(1, sizeof(Mime));
-    type->origin = origin;
-    type->type = what;
-    type->charset = charset;
+    if ((fd = open(filename, O_RDONLY)) < 0) {
+        return -1;
+    }
+    bytes = pread(fd, data, sizeof(data), 0);
+    close(fd);
+    if (bytes < 0) {
+        return -1;
+    }
+    type = mime_classify_data(data, (size_t) bytes);
 
-    split_free(output);
-    if (parts != NULL) {
-        split_free(parts);
+    pthread_mutex_lock(&mime_cache_lock);
+    if (mime_cache == NULL) {
+        mime_cache = hashmap_init(64);
     }
-    shell_free(proc);
+    entry = hashmap_get(mime_cache, key);
+    if (entry == NULL && mime_cache != NULL && (entry = calloc(1, sizeof(*entry))) != NULL) {
+        strcpy(entry->key, key);
+        if (hashmap_put(mime_cache, entry->key, entry) < 0) {
+            free(entry);
+            entry = NULL;
+        }
+    }
+    if (entry != NULL) {
+        entry->type = type;
+        entry->st = st;
+    }
+    pthread_mutex_unlock(&mime_cache_lock);
     return type;
 }
 
 /**
- * Free a `Mime` structure
- * @param m
+ * Determine whether a block of data looks like text
+ *
+ * Uses the rules of file(1): text consists of printable ASCII, the control characters BEL, BS, HT, LF, VT, FF, CR and
+ * ESC, and bytes above 0x7f (UTF-8 and 8-bit encodings). Any other byte (i.e. NUL) makes the data binary.
+ * `mime_classify` checks the first `SPM_MIME_MAGIC_SIZE` bytes of a file.
+ *
+ * @param data bytes to check
+ * @param size number of bytes in `data`
+ * @return yes=1, no=0
  */
-void mime_free(Mime *m) {
-    if (m != NULL) {
-        free(m->origin);
-        free(m->type);
-        free(m->charset);
-        free(m);
+int mime_data_is_text(const char *data, size_t size) {
+    static const unsigned char binary[32] = {
+            1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1,     // 0x00: BEL BS HT LF VT FF CR are text
+            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1,     // 0x10: ESC is text
+    };
+    const unsigned char *c = (const unsigned char *) data;
+
+    for (size_t i = 0; i < size; i++) {
+        if (c[i] < sizeof(binary) ? binary[c[i]] : c[i] == 0x7f) {
+            return 0;
+        }
     }
+    return 1;
 }
 
 /**
- * Determine if a file is a text file
+ * Classify a file, reporting failures
  * @param filename
- * @return yes=1, no=0
+ * @return success=SPM_MIME_* class, failure=-1
  */
-int file_is_text(const char *filename) {
-    int result = 0;
+static int file_type(const char *filename) {
     char *path = normpath(filename);
-    Mime *type = file_mimetype(path);
-    if (type == NULL) {
-        fprintf(stderr, "type detection failed: %s\n", filename);
-        return -1;
-    }
-    if (startswith(type->type, "text/")) {
-        result = 1;
+    int type = mime_classify(path != NULL ? path : filename);
+    if (type < 0) {
+        fprintf(stderr, "type detection failed: %s: %s\n", filename, strerror(errno));
     }
     free(path);
-    mime_free(type);
-    return result;
+    return type;
 }
 
 /**
- * Determine if a file is a binary data file
+ * Determine if a file is a text file (scripts included)
  * @param filename
- * @return yes=1, no=0
+ * @return yes=1, no=0, error=-1
  */
-int file_is_binary(const char *filename) {
-    int result = 0;
-    char *path = normpath(filename);
-    Mime *type = file_mimetype(path);
-    if (type == NULL) {
-        fprintf(stderr, "type detection failed: %s\n", filename);
+int file_is_text(const char *filename) {
+    int type = file_type(filename);
+    if (type < 0) {
         return -1;
     }
-    if (startswith(type->type, "application/") && strcmp(type->charset, "binary") == 0) {
-        result = 1;
+    return type == SPM_MIME_TEXT || type == SPM_MIME_SCRIPT;
+}
+
+/**
+ * Determine if a file is a binary data file (executables, libraries, archives, etc)
+ * @param filename
+ * @return yes=1, no=0, error=-1
+ */
+int file_is_binary(const char *filename) {
+    int type = file_type(filename);
+    if (type < 0) {
+        return -1;
     }
-    free(path);
-    mime_free(type);
-    return result;
+    return type != SPM_MIME_EMPTY && type != SPM_MIME_SPECIAL && type != SPM_MIME_TEXT && type != SPM_MIME_SCRIPT;
 }
 
+/**
+ * Determine if a file is a dynamically loadable image (executable or shared library), i.e. it may have an RPATH
+ * @param filename
+ * @return yes=1, no=0, error=-1
+ */
 int file_is_binexec(const char *filename) {
-    int result = 0;
-    char *path = normpath(filename);
-    Mime *type = file_mimetype(path);
-    if (type == NULL) {
-        fprintf(stderr, "type detection failed: %s\n", filename);
+    int type = file_type(filename);
+    if (type < 0) {
         return -1;
     }
-    // file-5.38: changed mime name associated with executables
-    // TODO: implement compatibility function to return the correct search pattern
-    if (fnmatch("application/x-[pic|pie|ex|sh]*", type->type, FNM_PATHNAME) != FNM_NOMATCH && strcmp(type->charset, "binary") == 0) {
-        result = 1;
-    }
-    free(path);
-    mime_free(type);
-    return result;
+    return type == SPM_MIME_ELF_EXEC || type == SPM_MIME_ELF_SHARED || type == SPM_MIME_MACHO_EXEC;
 }
@@ -82,8 +82,13 @@ int mirror_clone(Manifest *info, char *_dest) {
             }
         }
         printf("Fetch: %s\n", archive);
-        if ((response = fetch(archive, path)) >= 400) {
+        // The archive is verified while it is written. A mismatch is reported and nothing is stored.
+        const char *expected = isempty(info->packages[i]->checksum_sha256) ? NULL : info->packages[i]->checksum_sha256;
+        if ((response = fetch_sha256(archive, path, expected)) >= 400) {
             fprintf(stderr, "WARNING: HTTP(%ld, %s): %s\n", response, http_response_str(response), archive);
+        } else if (response != 0) {
+            fprintf(stderr, "WARNING: %s: %s\n", spmerrno ? spm_strerror(spmerrno) : "download failed", archive);
+            spmerrno = 0;
         }
         free(archive);
         free(path);
@@ -2,6 +2,8 @@
  * @file relocation.c
  */
 #include "spm.h"
+#include <fcntl.h>
+#include <sys/mman.h>
 
 const char *METADATA_FILES[] = {
         SPM_META_DEPENDS,
@@ -272,6 +274,79 @@ int file_is_metadata(const char *filename) {
     return 0;
 }
 
+/**
+ * State shared by the workers of `prefixes_write`
+ */
+struct PrefixScan {
+    const Matcher *matcher;
+    FSTree *fsdata;
+    int mode;
+    size_t num_prefixes;        // non-empty prefixes
+    unsigned char *found;       // num_records * matcher->num_patterns flags
+};
+
+/**
+ * Scan one file for every prefix, and classify its contents, while reading it once (threadpool worker)
+ *
+ * Reading stops as soon as the outcome is known: all prefixes were found and the file was classified, or the file
+ * turned out to be of the kind `mode` does not record. Flags are left clear for files that are not recorded.
+ *
+ * @param index record number
+ * @param worker unused
+ * @param arg `struct PrefixScan`
+ */
+static void prefixes_scan(size_t index, size_t worker, void *arg) {
+    struct PrefixScan *scan = arg;
+    FSRec *rec = scan->fsdata->record[index];
+    unsigned char *found = &scan->found[index * scan->matcher->num_patterns];
+    char buffer[BUFSIZ * 8];
+    size_t remaining = scan->num_prefixes;
+    size_t offset = 0;
+    uint32_t state = 0;
+    ssize_t bytes = 0;
+    int is_text = 1;
+    int relevant = 0;
+    int fd = -1;
+    (void) worker;
+
+    // Symbolic links, directories, devices, etc. are never recorded
+    if (rec->st == NULL || !S_ISREG(rec->st->st_mode) || file_is_metadata(rec->name)) {
+        return;
+    }
+    if ((fd = open(rec->name, O_RDONLY)) < 0) {
+        return;
+    }
+
+    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (offset < SPM_MIME_TEXT_SIZE && is_text) {
+            size_t window = SPM_MIME_TEXT_SIZE - offset;
+            is_text = mime_data_is_text(buffer, (size_t) bytes < window ? (size_t) bytes : window);
+        }
+        offset += (size_t) bytes;
+
+        if (scan->mode == PREFIX_WRITE_TEXT && !is_text) {
+            break;
+        }
+        if (scan->mode == PREFIX_WRITE_BIN && is_text && offset >= SPM_MIME_TEXT_SIZE) {
+            break;
+        }
+
+        remaining -= matcher_feed(scan->matcher, &state, buffer, (size_t) bytes, found);
+        if (remaining == 0 && (!is_text || offset >= SPM_MIME_TEXT_SIZE)) {
+            break;
+        }
+    }
+    close(fd);
+
+    // Empty files are neither text nor binary
+    if (bytes >= 0 && offset > 0) {
+        relevant = scan->mode == PREFIX_WRITE_BIN ? !is_text : is_text;
+    }
+    if (!relevant) {
+        memset(found, 0, scan->matcher->num_patterns);
+    }
+}
+
 /**
  * Scan `tree` for files containing `prefix`. Matches are recorded in `output_file` with the following format:
  *
@@ -284,6 +359,10 @@ int file_is_metadata(const char *filename) {
  * ...N
  * ~~~
  *
+ * Each file is read once, and all prefixes are searched for at the same time. Files are classified as text or
+ * binary data while they are scanned (see `mime_data_is_text`), so `PREFIX_WRITE_TEXT` stops reading a binary file
+ * at its first binary byte. Files are scanned by up to `SPM_GLOBAL.jobs` threads.
+ *
  * Example:
  * ~~~{.c}
  * char **prefixes = {"/usr", "/var", NULL};
@@ -298,6 +377,11 @@ int file_is_metadata(const char *filename) {
  * @return success=0, failure=1, error=-1
  */
 int prefixes_write(const char *output_file, int mode, char **prefix, const char *tree) {
+    struct PrefixScan scan;
+    FSTree *fsdata = NULL;
+    char *cwd = NULL;
+    int result = 0;
+
     FILE *fp = fopen(output_file, "w+");
     if (!fp) {
         perror(output_file);
@@ -305,98 +389,208 @@ int prefixes_write(const char *output_file, int mode, char **prefix, const char
         return -1;
     }
 
-    char *cwd = getcwd(NULL, PATH_MAX);
-    chdir(tree);
-    {
-        FSTree *fsdata = fstree(".", NULL, SPM_FSTREE_FLT_RELATIVE);
-        if (!fsdata) {
-            fclose(fp);
-            fprintf(SYSERROR);
-            return -1;
+    memset(&scan, 0, sizeof(scan));
+    scan.mode = mode;
+    scan.matcher = matcher_init(prefix);
+    if (scan.matcher == NULL) {
+        fclose(fp);
+        fprintf(SYSERROR);
+        return -1;
+    }
+    for (size_t p = 0; prefix[p] != NULL; p++) {
+        if (*prefix[p] != '\0') {
+            scan.num_prefixes++;
         }
-        for (size_t i = 0; i < fsdata->num_records; i++) {
-            if (S_ISDIR(fsdata->record[i]->st->st_mode)) {
-                continue;
-            }
-            if (file_is_metadata(fsdata->record[i]->name)) {
-                continue;
-            }
-            for (int p = 0; prefix[p] != NULL; p++) {
-                if (find_in_file(fsdata->record[i]->name, prefix[p]) == 0) {
-                    int proceed = 0;
-                    if (mode == PREFIX_WRITE_BIN) {
-                        proceed = file_is_binary(fsdata->record[i]->name);
-                    } else if (mode == PREFIX_WRITE_TEXT) {
-                        proceed = file_is_text(fsdata->record[i]->name);
-                    }
-
-                    // file_is_* functions return NULL when they encounter anything but a regular file
-                    if (!proceed) {
-                        continue;
-                    }
-                    // Record in file
-                    fprintf(fp, "#%s\n%s\n", prefix[p], fsdata->record[i]->name);
-                }
+    }
+
+    cwd = getcwd(NULL, PATH_MAX);
+    if (chdir(tree) < 0) {
+        perror(tree);
+        result = -1;
+        goto done;
+    }
+
+    fsdata = fstree(".", NULL, SPM_FSTREE_FLT_RELATIVE);
+    if (!fsdata) {
+        fprintf(SYSERROR);
+        result = -1;
+        goto done;
+    }
+    scan.fsdata = fsdata;
+    scan.found = calloc(fsdata->num_records * scan.matcher->num_patterns + 1, sizeof(*scan.found));
+    if (scan.found == NULL) {
+        fprintf(SYSERROR);
+        result = -1;
+        goto done;
+    }
+
+    if (fsdata->num_records && scan.num_prefixes) {
+        threadpool_run(threadpool_jobs(fsdata->num_records), fsdata->num_records, prefixes_scan, &scan);
+    }
+
+    // Record in file
+    for (size_t i = 0; i < fsdata->num_records; i++) {
+        for (size_t p = 0; prefix[p] != NULL; p++) {
+            if (scan.found[i * scan.matcher->num_patterns + p]) {
+                fprintf(fp, "#%s\n%s\n", prefix[p], fsdata->record[i]->name);
             }
         }
-    } chdir(cwd);
+    }
+
+done:
+    if (cwd != NULL) {
+        chdir(cwd);
+    }
     free(cwd);
+    free(scan.found);
+    fstree_free(fsdata);
+    matcher_free((Matcher *) scan.matcher);
     fclose(fp);
-    return 0;
+    return result;
 }
 
 /**
- * Wrapper for `reloc` program. Replace text in binary data.
- * @param _filename
- * @param _oldstr
- * @param _newstr
- * @return
+ * Replace prefixes embedded in the strings of a binary file
+ *
+ * Every occurrence of a prefix is treated as part of a NUL terminated string: the prefix is overwritten with `newstr`,
+ * the rest of the string is moved up behind it and the bytes left over at the end of the string are set to NUL. Files
+ * keep their size and strings keep their offsets, so `newstr` may not be longer than any of the prefixes (see
+ * `SPM_META_PREFIX_PLACEHOLDER`). When more than one prefix matches at the same offset the longest one is replaced.
+ *
+ * The file is mapped into memory once, scanned for all prefixes in a single pass and modified in place.
+ *
+ * ~~~{.c}
+ * char *prefixes[] = {"/build/prefix", "/other/prefix", NULL};
+ * relocate_prefixes("lib/libexample.so", prefixes, "/opt/spm");
+ * ~~~
+ *
+ * @param filename file to modify
+ * @param prefix NULL terminated array of prefixes to replace (empty strings are ignored)
+ * @param newstr replacement string
+ * @return number of replacements, or -1 on error
  */
-int relocate(const char *_filename, const char *_oldstr, const char *_newstr) {
-    int returncode;
-    Process *proc = NULL;
-    char *filename = NULL;
-    char *oldstr = NULL;
-    char *newstr = NULL;
-    char cmd[PATH_MAX];
-
-    if (_filename == NULL || _oldstr == NULL || _newstr == NULL) {
+ssize_t relocate_prefixes(const char *filename, char **prefix, const char *newstr) {
+    unsigned char first[256];
+    unsigned char first_char = 0;
+    size_t first_count = 0;
+    size_t newstr_len = 0;
+    size_t data_size = 0;
+    ssize_t count = 0;
+    struct stat st;
+    char *data = NULL;
+    int fd = -1;
+
+    if (filename == NULL || prefix == NULL || newstr == NULL) {
         return -1;
     }
 
-    oldstr = strdup(_oldstr);
-    newstr = strdup(_newstr);
-    filename = strdup(_filename);
-    // sanitize command
-    strchrdel(oldstr, SHELL_INVALID);
-    strchrdel(newstr, SHELL_INVALID);
-    strchrdel(filename, SHELL_INVALID);
-
-    memset(cmd, '\0', sizeof(cmd));
-    sprintf(cmd, "reloc \"%s\" \"%s\" \"%s\" \"%s\" 2>&1", oldstr, newstr, filename, filename);
+    // Only offsets starting with the first byte of a prefix are compared
+    memset(first, 0, sizeof(first));
+    newstr_len = strlen(newstr);
+    for (size_t p = 0; prefix[p] != NULL; p++) {
+        size_t prefix_len = strlen(prefix[p]);
+        if (prefix_len == 0) {
+            continue;
+        }
+        if (newstr_len > prefix_len) {
+            fprintf(stderr, "replacement string too long: %zu > %zu\n  '%s'\n  '%s'\n", newstr_len, prefix_len, newstr, prefix[p]);
+            return -1;
+        }
+        if (!first[(unsigned char) prefix[p][0]]) {
+            first[(unsigned char) prefix[p][0]] = 1;
+            first_char = (unsigned char) prefix[p][0];
+            first_count++;
+        }
+    }
+    if (first_count == 0) {
+        return 0;
+    }
 
-    if (SPM_GLOBAL.verbose > 1) {
-        printf("         EXEC : %s\n", cmd);
+    if ((fd = open(filename, O_RDWR)) < 0) {
+        perror(filename);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        perror(filename);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
     }
 
-    shell(&proc, SHELL_OUTPUT, cmd);
-    if (!proc) {
-        free(oldstr);
-        free(newstr);
-        free(filename);
+    data_size = (size_t) st.st_size;
+    data = mmap(NULL, data_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(filename);
         return -1;
     }
 
-    returncode = proc->returncode;
-    if (returncode != 0 && proc->output) {
-        fprintf(stderr, "%s\n", proc->output);
+    for (size_t i = 0; i < data_size;) {
+        size_t match = 0;
+
+        if (first_count == 1) {
+            char *next = memchr(&data[i], first_char, data_size - i);
+            if (next == NULL) {
+                break;
+            }
+            i = (size_t) (next - data);
+        } else if (!first[(unsigned char) data[i]]) {
+            i++;
+            continue;
+        }
+
+        for (size_t p = 0; prefix[p] != NULL; p++) {
+            size_t prefix_len = strlen(prefix[p]);
+            if (prefix_len > match && prefix_len <= data_size - i && memcmp(&data[i], prefix[p], prefix_len) == 0) {
+                match = prefix_len;
+            }
+        }
+        if (!match) {
+            i++;
+            continue;
+        }
+
+        // The string ends at the next NUL byte (or at the end of the file)
+        char *post = &data[i + match];
+        size_t post_len = strnlen(post, data_size - i - match);
+        memcpy(&data[i], newstr, newstr_len);
+        memmove(&data[i + newstr_len], post, post_len);
+        memset(&data[i + newstr_len + post_len], '\0', match - newstr_len);
+        count++;
+
+        // The moved remainder may hold another prefix
+        i += newstr_len;
+    }
+
+    if (munmap(data, data_size) < 0) {
+        perror(filename);
+        return -1;
+    }
+    if (count) {
+        // Strings of the dynamic section may have changed
+        shlib_info_forget(filename);
     }
+    return count;
+}
 
-    shell_free(proc);
-    free(oldstr);
-    free(newstr);
-    free(filename);
-    return returncode;
+/**
+ * Replace text in binary data
+ *
+ * A convenience wrapper around `relocate_prefixes()` for a single prefix.
+ *
+ * @param filename file to modify
+ * @param oldstr prefix to replace
+ * @param newstr replacement string
+ * @return success=0, error=-1
+ */
+int relocate(const char *filename, const char *oldstr, const char *newstr) {
+    if (filename == NULL || oldstr == NULL || newstr == NULL) {
+        return -1;
+    }
+    return relocate_prefixes(filename, (char *[]) {(char *) oldstr, NULL}, newstr) < 0 ? -1 : 0;
 }
 
 /**
@@ -407,48 +601,132 @@ int relocate(const char *_filename, const char *_oldstr, const char *_newstr) {
  * @param baseroot
  */
 void relocate_root(const char *destroot, const char *baseroot) {
+    relocate_root_ex(destroot, baseroot, NULL);
+}
+
+/**
+ * Parse package metadata and set `baseroot` binaries/text to point to `destroot`.
+ *
+ * The working directory is not changed, so different roots may be relocated concurrently.
+ *
+ * @param destroot installation root
+ * @param baseroot temporary directory holding the extracted package (modified)
+ * @param provided shared libraries of packages that will also be installed to `destroot`, relative to the directory
+ * they were found in (see `rpath_libraries_available`). These are searched after the libraries in `baseroot`.
+ * May be NULL.
+ */
+void relocate_root_ex(const char *destroot, const char *baseroot, FSTree *provided) {
     RelocationEntry **b_record = NULL;
     RelocationEntry **t_record = NULL;
-    char cwd[PATH_MAX];
-
-    getcwd(cwd, sizeof(cwd));
-    chdir(baseroot);
-    {
-        FSTree *libs = rpath_libraries_available(".");
-        // Rewrite binary prefixes
-        b_record = prefixes_read(SPM_META_PREFIX_BIN);
-        if (b_record) {
-            for (int i = 0; b_record[i] != NULL; i++) {
-                if (file_is_binexec(b_record[i]->path)) {
-                    if (SPM_GLOBAL.verbose) {
-                        printf("Relocate RPATH: %s\n", b_record[i]->path);
-                    }
-                    rpath_autoset(b_record[i]->path, libs, destroot);
-                }
-                if (SPM_GLOBAL.verbose) {
-                    printf("Relocate DATA : %s\n", b_record[i]->path);
-                }
-                relocate(b_record[i]->path, b_record[i]->prefix, destroot);
+    FSTree *libs = rpath_libraries_available(baseroot);
+    char *prefix_bin = join((char *[]) {(char *) baseroot, SPM_META_PREFIX_BIN, NULL}, DIRSEPS);
+    char *prefix_text = join((char *[]) {(char *) baseroot, SPM_META_PREFIX_TEXT, NULL}, DIRSEPS);
+    size_t own = libs ? libs->num_records : 0;
+
+    // Search the package's own libraries first
+    if (libs != NULL && provided != NULL && provided->num_records) {
+        FSRec **tmp = realloc(libs->record, (own + provided->num_records + 1) * sizeof(*tmp));
+        if (tmp != NULL) {
+            libs->record = tmp;
+            memcpy(&libs->record[own], provided->record, provided->num_records * sizeof(*tmp));
+            libs->num_records = own + provided->num_records;
+            libs->record[libs->num_records] = NULL;
+        }
+    }
+
+    // Rewrite binary prefixes
+    b_record = prefixes_read(prefix_bin);
+    if (b_record) {
+        size_t count = 0;
+        size_t num_rpath = 0;
+        char **prefixes = NULL;
+        char **rpath_file = NULL;
+        char **rpath_value = NULL;
+
+        while (b_record[count] != NULL) {
+            count++;
+        }
+        prefixes = calloc(count + 1, sizeof(char *));
+        rpath_file = calloc(count + 1, sizeof(char *));
+        rpath_value = calloc(count + 1, sizeof(char *));
+
+        // Set the RPATH of all executables and libraries in one batch
+        for (size_t i = 0; rpath_file != NULL && rpath_value != NULL && b_record[i] != NULL; i++) {
+            if (i > 0 && strcmp(b_record[i]->path, b_record[i - 1]->path) == 0) {
+                continue;
+            }
+            char *path = join((char *[]) {(char *) baseroot, b_record[i]->path, NULL}, DIRSEPS);
+            char *rpath = NULL;
+            if (file_is_binexec(path) != 1 || (rpath = rpath_generate(path, libs, destroot)) == NULL) {
+                free(path);
+                continue;
             }
+            if (SPM_GLOBAL.verbose) {
+                printf("Relocate RPATH: %s\n", b_record[i]->path);
+            }
+            rpath_file[num_rpath] = path;
+            rpath_value[num_rpath] = rpath;
+            num_rpath++;
+        }
+        if (num_rpath) {
+            rpath_set_batch(rpath_file, rpath_value);
         }
+        for (size_t i = 0; i < num_rpath; i++) {
+            free(rpath_file[i]);
+            free(rpath_value[i]);
+        }
+        free(rpath_file);
+        free(rpath_value);
+
+        for (size_t i = 0; prefixes != NULL && b_record[i] != NULL;) {
+            // A file holding more than one prefix has one record per prefix. Relocate them in one pass.
+            size_t n = 0;
+            size_t next = i;
+            while (b_record[next] != NULL && strcmp(b_record[next]->path, b_record[i]->path) == 0) {
+                prefixes[n++] = b_record[next++]->prefix;
+            }
+            prefixes[n] = NULL;
 
-        // Rewrite text prefixes
-        t_record = prefixes_read(SPM_META_PREFIX_TEXT);
-        if (t_record) {
-            for (int i = 0; t_record[i] != NULL; i++) {
-                if (SPM_GLOBAL.verbose) {
-                    printf("Relocate TEXT : %s\n", t_record[i]->path);
-                }
-                if (SPM_GLOBAL.verbose > 1) {
-                    printf("         EDIT : '%s' -> '%s'\n", t_record[i]->prefix, destroot);
+            char *path = join((char *[]) {(char *) baseroot, b_record[i]->path, NULL}, DIRSEPS);
+            if (SPM_GLOBAL.verbose) {
+                printf("Relocate DATA : %s\n", b_record[i]->path);
+            }
+            if (SPM_GLOBAL.verbose > 1) {
+                for (size_t p = 0; prefixes[p] != NULL; p++) {
+                    printf("         EDIT : '%s' -> '%s'\n", prefixes[p], destroot);
                 }
-                file_replace_text(t_record[i]->path, t_record[i]->prefix, destroot);
             }
+            relocate_prefixes(path, prefixes, destroot);
+            free(path);
+            i = next;
+        }
+        free(prefixes);
+    }
+
+    // Rewrite text prefixes
+    t_record = prefixes_read(prefix_text);
+    if (t_record) {
+        for (int i = 0; t_record[i] != NULL; i++) {
+            char *path = join((char *[]) {(char *) baseroot, t_record[i]->path, NULL}, DIRSEPS);
+            if (SPM_GLOBAL.verbose) {
+                printf("Relocate TEXT : %s\n", t_record[i]->path);
+            }
+            if (SPM_GLOBAL.verbose > 1) {
+                printf("         EDIT : '%s' -> '%s'\n", t_record[i]->prefix, destroot);
+            }
+            file_replace_text(path, t_record[i]->prefix, destroot);
+            free(path);
         }
+    }
 
-        prefixes_free(b_record);
-        prefixes_free(t_record);
+    // The records borrowed from `provided` are not ours to free
+    if (libs != NULL) {
+        libs->num_records = own;
     }
-    chdir(cwd);
+    fstree_free(libs);
+    prefixes_free(b_record);
+    prefixes_free(t_record);
+    free(prefix_bin);
+    free(prefix_text);
 }
 
@@ -1,66 +1,293 @@
 /**
  * Dependency resolution functions
+ *
+ * A `Resolver` builds the dependency graph of the requested packages. Each package appears once no matter how many
+ * packages require it, and each distinct requirement specification is looked up once. `resolve_order` returns the
+ * graph in installation order (a package's requirements come before the package itself).
+ *
  * @file resolve.c
  */
 #include "spm.h"
 
-static ManifestPackage *requirements[SPM_REQUIREMENT_MAX] = {0, };
+/**
+ * Initialize an empty `Resolver`
+ * @param manifests `ManifestList` to search for packages
+ * @return `Resolver` (free with `resolve_free`), or NULL on error
+ */
+Resolver *resolve_init(ManifestList *manifests) {
+    Resolver *resolver = calloc(1, sizeof(*resolver));
+    if (resolver == NULL) {
+        perror("Failed to allocate resolver");
+        fprintf(SYSERROR);
+        return NULL;
+    }
+
+    resolver->manifests = manifests;
+    resolver->arena = arena_init(0);
+    resolver->visited = hashmap_init(0);
+    resolver->lookups = hashmap_init(0);
+    if (resolver->arena == NULL || resolver->visited == NULL || resolver->lookups == NULL) {
+        resolve_free(resolver);
+        return NULL;
+    }
+    return resolver;
+}
 
-void resolve_free() {
-    for (size_t i = 0; i < SPM_REQUIREMENT_MAX; i++) {
-        if (requirements[i] != NULL)
-            manifest_package_free(requirements[i]);
+/**
+ * Free a `Resolver` and every package it resolved
+ * @param resolver `Resolver`
+ */
+void resolve_free(Resolver *resolver) {
+    if (resolver == NULL) {
+        return;
     }
+    for (size_t i = 0; i < resolver->num_nodes; i++) {
+        manifest_package_free(resolver->nodes[i].package);
+    }
+    free(resolver->nodes);
+    free(resolver->requested);
+    hashmap_free(resolver->visited);
+    hashmap_free(resolver->lookups);
+    hashmap_free(resolver->pinned);
+    arena_free(resolver->arena);
+    free(resolver);
 }
 
 /**
- * Scan global `requirements` array for `archive`
- * @param archive
- * @return 0 = not found, 1 = found
+ * Record why resolution stopped
+ * @param resolver `Resolver`
+ * @param code spmerrno value
+ * @param spec specification that could not be satisfied
+ * @param required_by archive that requires `spec` (NULL=requested directly)
  */
-int resolve_has_dependency(const char *archive) {
-    for (size_t i = 0; requirements[i] != NULL && i < SPM_REQUIREMENT_MAX; i++) {
-        if (strcmp(requirements[i]->archive, archive) == 0) {
-            return 1;
+static void resolve_error(Resolver *resolver, int code, const char *spec, const char *required_by) {
+    resolver->error.code = code;
+    resolver->error.spec = arena_strdup(resolver->arena, spec);
+    resolver->error.required_by = required_by ? arena_strdup(resolver->arena, required_by) : NULL;
+}
+
+/**
+ * Append a package to the graph
+ * @param resolver `Resolver`
+ * @param package `ManifestPackage` (owned by the resolver from now on)
+ * @return 1-based node slot, 0=error
+ */
+static size_t resolve_node_new(Resolver *resolver, ManifestPackage *package) {
+    if (resolver->num_nodes >= resolver->num_alloc) {
+        size_t num_alloc = resolver->num_alloc ? resolver->num_alloc * 2 : 64;
+        ResolveNode *tmp = realloc(resolver->nodes, num_alloc * sizeof(*tmp));
+        if (tmp == NULL) {
+            perror("Failed to allocate dependency graph");
+            fprintf(SYSERROR);
+            return 0;
         }
+        resolver->nodes = tmp;
+        resolver->num_alloc = num_alloc;
     }
-    return 0;
+
+    ResolveNode *node = &resolver->nodes[resolver->num_nodes];
+    memset(node, 0, sizeof(*node));
+    node->package = package;
+    node->edges = arena_alloc(resolver->arena, (package->requirements_records + 1) * sizeof(*node->edges));
+    if (node->edges == NULL || hashmap_put(resolver->visited, package->archive, (void *) (uintptr_t) (resolver->num_nodes + 1)) < 0) {
+        return 0;
+    }
+    return ++resolver->num_nodes;
 }
 
 /**
- * Recursively scan a package for its dependencies
- * @param manifests `ManifestList` struct
- * @param spec Package name (accepts version specifiers)
- * @return success = array of `ManifestPackage`, not found = NULL
+ * Find the package satisfying a specification
+ * @param resolver `Resolver`
+ * @param spec package specification
+ * @return copy of `ManifestPackage` (caller must free), or NULL when not found
  */
-ManifestPackage **resolve_dependencies(ManifestList *manifests, const char *spec) {
-    static size_t req_i = 0;
-    ManifestPackage *package = manifestlist_search(manifests, spec);
-    ManifestPackage *requirement = NULL;
+static ManifestPackage *resolve_search(Resolver *resolver, const char *spec) {
+    ManifestPackage *package = NULL;
+    VersionSpec *compiled = NULL;
 
-    if (package == NULL || package->requirements == NULL) {
-        return requirements;
+    if (resolver->pinned == NULL) {
+        return manifestlist_search(resolver->manifests, spec);
+    }
+
+    // Only the version selected by resolve_solve() is eligible
+    if ((compiled = version_spec_compile(spec)) == NULL) {
+        return NULL;
+    }
+    package = hashmap_get(resolver->pinned, compiled->name);
+    if (package != NULL && version_spec_test(compiled, package->version_key)) {
+        package = manifest_package_copy(package);
+    } else {
+        package = NULL;
+    }
+    version_spec_free(compiled);
+    return package;
+}
+
+/**
+ * Find the package satisfying a specification and add it, along with everything it requires, to the graph
+ * @param resolver `Resolver`
+ * @param spec package specification
+ * @param required_by archive that requires `spec` (NULL=requested directly)
+ * @return 1-based node slot, 0=error
+ */
+static size_t resolve_node(Resolver *resolver, const char *spec, const char *required_by) {
+    ManifestPackage *package = NULL;
+    char *key = NULL;
+    size_t slot = (uintptr_t) hashmap_get(resolver->lookups, spec);
+
+    if (slot != 0) {
+        return slot;
+    }
+
+    if ((package = resolve_search(resolver, spec)) == NULL) {
+        resolve_error(resolver, SPM_ERR_PKG_NOT_FOUND, spec, required_by);
+        return 0;
+    }
+
+    if ((key = arena_strdup(resolver->arena, spec)) == NULL) {
+        manifest_package_free(package);
+        return 0;
+    }
+
+    // Another specification already selected this package
+    if ((slot = (uintptr_t) hashmap_get(resolver->visited, package->archive)) != 0) {
+        manifest_package_free(package);
+        return hashmap_put(resolver->lookups, key, (void *) (uintptr_t) slot) < 0 ? 0 : slot;
+    }
+
+    if ((slot = resolve_node_new(resolver, package)) == 0) {
+        manifest_package_free(package);
+        return 0;
+    }
+    if (hashmap_put(resolver->lookups, key, (void *) (uintptr_t) slot) < 0) {
+        return 0;
     }
 
-    for (size_t i = 0; i < package->requirements_records && i < SPM_REQUIREMENT_MAX; i++) {
-        requirement = manifestlist_search(manifests, package->requirements[i]);
-        if (requirement == NULL) {
-            fprintf(stderr, "ERROR: unable to resolve package via manifestlist_search(): '%s'\n", package->requirements[i]);
-            exit(1);
+    for (size_t i = 0; i < package->requirements_records; i++) {
+        size_t edge = resolve_node(resolver, package->requirements[i], package->archive);
+        if (edge == 0) {
+            return 0;
         }
+        // `resolver->nodes` may have moved
+        ResolveNode *node = &resolver->nodes[slot - 1];
+        node->edges[node->num_edges++] = edge - 1;
+    }
+    return slot;
+}
 
-        if (resolve_has_dependency(requirement->archive)) {
-            free(requirement);
-        } else {
-            resolve_dependencies(manifests, requirement->archive);
-            requirements[req_i] = requirement;
+/**
+ * Add a package and its dependencies to the graph
+ *
+ * On failure `resolver->error` describes the specification that could not be satisfied.
+ *
+ * @param resolver `Resolver`
+ * @param spec package specification (`zlib`, `zlib>=1.2`, or an archive name)
+ * @return 0=success, -1=error
+ */
+int resolve_add(Resolver *resolver, const char *spec) {
+    size_t slot = resolve_node(resolver, spec, NULL);
+    if (slot == 0) {
+        if (resolver->error.code == 0) {
+            resolve_error(resolver, SPM_ERR_PKG_INVALID, spec, NULL);
+        }
+        return -1;
+    }
+
+    for (size_t i = 0; i < resolver->num_requested; i++) {
+        if (resolver->requested[i] == slot - 1) {
+            return 0;
+        }
+    }
+    if (resolver->num_requested >= resolver->num_requested_alloc) {
+        size_t num_alloc = resolver->num_requested_alloc ? resolver->num_requested_alloc * 2 : 16;
+        size_t *tmp = realloc(resolver->requested, num_alloc * sizeof(*tmp));
+        if (tmp == NULL) {
+            perror("Failed to allocate dependency graph");
+            fprintf(SYSERROR);
+            return -1;
         }
+        resolver->requested = tmp;
+        resolver->num_requested_alloc = num_alloc;
+    }
+    resolver->requested[resolver->num_requested++] = slot - 1;
+    return 0;
+}
+
+/**
+ * Depth-first visit of the graph, emitting each package after the packages it requires
+ * @param resolver `Resolver`
+ * @param n node
+ * @param order destination array
+ * @param count number of records in `order`
+ */
+static void resolve_visit(Resolver *resolver, size_t n, ManifestPackage **order, size_t *count) {
+    ResolveNode *node = &resolver->nodes[n];
+
+    // Visited already, or a circular dependency
+    if (node->state != 0) {
+        return;
+    }
+    node->state = 1;
+    for (size_t i = 0; i < node->num_edges; i++) {
+        resolve_visit(resolver, node->edges[i], order, count);
+    }
+    node->state = 2;
+    order[(*count)++] = node->package;
+}
+
+/**
+ * Get the installation order of the graph
+ *
+ * Requirements come before the packages that need them. Packages that depend on each other are emitted in the order
+ * they were reached.
+ *
+ * @param resolver `Resolver`
+ * @return NULL terminated array of `ManifestPackage` owned by the resolver (caller must free the array only)
+ */
+ManifestPackage **resolve_order(Resolver *resolver) {
+    ManifestPackage **order = calloc(resolver->num_nodes + 1, sizeof(*order));
+    size_t count = 0;
+
+    if (order == NULL) {
+        perror("Failed to allocate installation order");
+        fprintf(SYSERROR);
+        return NULL;
     }
+    for (size_t i = 0; i < resolver->num_nodes; i++) {
+        resolver->nodes[i].state = 0;
+    }
+    for (size_t i = 0; i < resolver->num_requested; i++) {
+        resolve_visit(resolver, resolver->requested[i], order, &count);
+    }
+    return order;
+}
+
+/**
+ * Resolve a package and its dependencies
+ * @param manifests `ManifestList` struct
+ * @param spec Package name (accepts version specifiers)
+ * @return success = NULL terminated array of `ManifestPackage` in installation order (caller must free each record
+ * and the array), failure = NULL (`spmerrno` is set)
+ */
+ManifestPackage **resolve_dependencies(ManifestList *manifests, const char *spec) {
+    ManifestPackage **result = NULL;
+    Resolver *resolver = resolve_init(manifests);
 
-    if (!resolve_has_dependency(package->archive)) {
-        requirements[req_i] = package;
-        req_i++;
+    if (resolver == NULL) {
+        return NULL;
+    }
+    if (resolve_add(resolver, spec) < 0) {
+        spmerrno = resolver->error.code;
+        spmerrno_cause(resolver->error.spec);
+        resolve_free(resolver);
+        return NULL;
     }
 
-    return requirements;
-}
\ No newline at end of file
+    if ((result = resolve_order(resolver)) != NULL) {
+        for (size_t i = 0; result[i] != NULL; i++) {
+            result[i] = manifest_package_copy(result[i]);
+        }
+    }
+    resolve_free(resolver);
+    return result;
+}
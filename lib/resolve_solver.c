@@ -0,0 +1,689 @@
+/**
+ * Dependency solver
+ *
+ * `resolve_solve` selects one version of every package in the closure of the requested packages such that all of
+ * their requirements hold at the same time. The greedy resolver picks the best match for each requirement on its
+ * own, which fails (or installs two versions of a package) when packages pin incompatible ranges of a shared
+ * dependency.
+ *
+ * The search decides one package name at a time, in the order the names are first required, and tries candidates
+ * in `manifestlist_search` order (last manifest first, then highest version). Selecting a candidate imposes its
+ * requirements right away, so a candidate that leaves another package without a usable version is rejected before
+ * the search goes any deeper. When every candidate of a package is rejected the search jumps back to the most recent
+ * decision responsible for the rejections (conflict-directed backjumping) and records the responsible decisions as a
+ * nogood, so that combination is never tried again.
+ *
+ * @file resolve_solver.c
+ */
+#include "spm.h"
+
+/**
+ * Package name taking part in the search
+ */
+struct SolverName {
+    const char *name;
+    ManifestPackage **candidates;   // group in `ManifestList.by_name` (least preferred first)
+    size_t first;                   // offset of `candidates` in `ManifestList.by_name`
+    size_t count;
+    ssize_t selected;               // offset in `candidates` (-1=undecided)
+    size_t level;                   // decision level of `selected`
+    ssize_t constraints;            // newest constraint on this name (offset in `trail`, -1=none)
+};
+
+/**
+ * Requirement imposed on a package name
+ */
+struct SolverConstraint {
+    size_t name;                    // offset in `names`
+    const VersionSpec *spec;
+    size_t level;                   // decision level that imposed it (0=requested by the user)
+    const ManifestPackage *by;      // package that imposed it (NULL=requested by the user)
+    ssize_t next;                   // next older constraint on the same name
+};
+
+/**
+ * Decision on a package name
+ */
+struct SolverLevel {
+    size_t name;                    // offset in `names`
+    size_t tried;                   // number of candidates tried so far
+    size_t trail;                   // length of `trail` before the decision
+    size_t *conflicts;              // earlier levels responsible for rejected candidates
+    size_t num_conflicts;
+    size_t num_conflicts_alloc;
+};
+
+/**
+ * Combination of selected candidates that cannot be part of a solution
+ */
+struct SolverNogood {
+    size_t first;                   // offset in `nogood_members`
+    size_t count;
+};
+
+/**
+ * Entry in the list of nogoods containing a candidate
+ */
+struct SolverWatch {
+    size_t nogood;
+    ssize_t next;
+};
+
+struct Solver {
+    ManifestList *manifests;
+    HashMap *name_index;            // package name -> 1-based offset in `names`
+    HashMap *specs;                 // specification -> compiled `VersionSpec`
+    struct SolverName *names;
+    size_t num_names;
+    size_t num_names_alloc;
+    struct SolverConstraint *trail;
+    size_t num_trail;
+    size_t num_trail_alloc;
+    struct SolverLevel *levels;
+    size_t num_levels;
+    size_t num_levels_alloc;
+    size_t *selected_level;         // `by_name` offset -> decision level that selected it (0=not selected)
+    ssize_t *watch_head;            // `by_name` offset -> newest entry in `watches` (-1=none)
+    struct SolverWatch *watches;
+    size_t num_watches;
+    size_t num_watches_alloc;
+    struct SolverNogood *nogoods;
+    size_t num_nogoods;
+    size_t num_nogoods_alloc;
+    size_t *nogood_members;         // `by_name` offsets
+    size_t num_nogood_members;
+    size_t num_nogood_members_alloc;
+    int conflict_code;              // spmerrno value describing the last conflict
+    struct SolverConstraint *conflict;  // constraints involved in the last conflict
+    size_t num_conflict;
+    size_t num_conflict_alloc;
+    unsigned char *match;           // scratch: result of each candidate of one package name
+};
+
+/**
+ * Make room for at least one more record in an array
+ * @param data address of the array
+ * @param count number of records in use
+ * @param alloc address of the number of records allocated
+ * @param size size of a record
+ * @return 0=success, -1=error
+ */
+static int solver_grow(void **data, size_t count, size_t *alloc, size_t size) {
+    if (count < *alloc) {
+        return 0;
+    }
+
+    size_t num_alloc = *alloc ? *alloc * 2 : 64;
+    void *tmp = realloc(*data, num_alloc * size);
+    if (tmp == NULL) {
+        perror("Failed to allocate solver state");
+        fprintf(SYSERROR);
+        return -1;
+    }
+    memset((char *) tmp + *alloc * size, 0, (num_alloc - *alloc) * size);
+    *data = tmp;
+    *alloc = num_alloc;
+    return 0;
+}
+
+/**
+ * Free solver state
+ * @param solver `Solver`
+ */
+static void solver_free(struct Solver *solver) {
+    if (solver == NULL) {
+        return;
+    }
+    for (size_t i = 0; solver->specs != NULL && i < solver->specs->num_alloc; i++) {
+        version_spec_free(solver->specs->entry[i].value);
+    }
+    for (size_t i = 0; i < solver->num_levels_alloc; i++) {
+        free(solver->levels[i].conflicts);
+    }
+    hashmap_free(solver->name_index);
+    hashmap_free(solver->specs);
+    free(solver->names);
+    free(solver->trail);
+    free(solver->levels);
+    free(solver->selected_level);
+    free(solver->watch_head);
+    free(solver->watches);
+    free(solver->nogoods);
+    free(solver->nogood_members);
+    free(solver->conflict);
+    free(solver->match);
+    free(solver);
+}
+
+/**
+ * Initialize solver state
+ * @param manifests `ManifestList` holding the candidates
+ * @return `Solver`, or NULL on error
+ */
+static struct Solver *solver_init(ManifestList *manifests) {
+    struct Solver *solver = calloc(1, sizeof(*solver));
+    size_t total = 0;
+
+    if (solver == NULL) {
+        perror("Failed to allocate solver");
+        fprintf(SYSERROR);
+        return NULL;
+    }
+    for (size_t i = 0; i < manifestlist_count(manifests); i++) {
+        total += manifests->data[i]->records;
+    }
+
+    solver->manifests = manifests;
+    solver->name_index = hashmap_init(0);
+    solver->specs = hashmap_init(0);
+    solver->selected_level = calloc(total + 1, sizeof(*solver->selected_level));
+    solver->watch_head = malloc((total + 1) * sizeof(*solver->watch_head));
+    solver->match = calloc(total + 1, sizeof(*solver->match));
+    if (solver->name_index == NULL || solver->specs == NULL || solver->selected_level == NULL || solver->watch_head == NULL
+        || solver->match == NULL) {
+        perror("Failed to allocate solver");
+        fprintf(SYSERROR);
+        solver_free(solver);
+        return NULL;
+    }
+    for (size_t i = 0; i < total + 1; i++) {
+        solver->watch_head[i] = -1;
+    }
+    return solver;
+}
+
+/**
+ * Compile a specification once
+ * @param solver `Solver`
+ * @param strspec package specification
+ * @return `VersionSpec` owned by the solver, or NULL on error
+ */
+static const VersionSpec *solver_spec(struct Solver *solver, const char *strspec) {
+    VersionSpec *spec = hashmap_get(solver->specs, strspec);
+    if (spec != NULL) {
+        return spec;
+    }
+    if ((spec = version_spec_compile(strspec)) == NULL) {
+        return NULL;
+    }
+    if (hashmap_put(solver->specs, spec->spec, spec) < 0) {
+        version_spec_free(spec);
+        return NULL;
+    }
+    return spec;
+}
+
+/**
+ * Get the offset of a package name in `names`, adding the name on first use
+ * @param solver `Solver`
+ * @param name package name
+ * @return offset, or -1 on error
+ */
+static ssize_t solver_name(struct Solver *solver, const char *name) {
+    size_t slot = (uintptr_t) hashmap_get(solver->name_index, name);
+    if (slot != 0) {
+        return (ssize_t) slot - 1;
+    }
+
+    if (solver_grow((void **) &solver->names, solver->num_names, &solver->num_names_alloc, sizeof(*solver->names)) < 0) {
+        return -1;
+    }
+
+    struct SolverName *record = &solver->names[solver->num_names];
+    const ManifestRange *range = manifestlist_name_range(solver->manifests, name);
+    memset(record, 0, sizeof(*record));
+    record->name = name;
+    record->selected = -1;
+    record->constraints = -1;
+    if (range != NULL) {
+        record->name = solver->manifests->by_name[range->first]->name;
+        record->candidates = &solver->manifests->by_name[range->first];
+        record->first = range->first;
+        record->count = range->count;
+    }
+    if (hashmap_put(solver->name_index, record->name, (void *) (uintptr_t) (solver->num_names + 1)) < 0) {
+        return -1;
+    }
+    return (ssize_t) solver->num_names++;
+}
+
+/**
+ * Impose a requirement on a package name
+ * @param solver `Solver`
+ * @param name offset in `names`
+ * @param spec requirement
+ * @param level decision level imposing it
+ * @param by package imposing it (NULL=requested by the user)
+ * @return 0=success, -1=error
+ */
+static int solver_constrain(struct Solver *solver, size_t name, const VersionSpec *spec, size_t level, const ManifestPackage *by) {
+    if (solver_grow((void **) &solver->trail, solver->num_trail, &solver->num_trail_alloc, sizeof(*solver->trail)) < 0) {
+        return -1;
+    }
+    struct SolverConstraint *record = &solver->trail[solver->num_trail];
+    record->name = name;
+    record->spec = spec;
+    record->level = level;
+    record->by = by;
+    record->next = solver->names[name].constraints;
+    solver->names[name].constraints = (ssize_t) solver->num_trail++;
+    return 0;
+}
+
+/**
+ * Remember the constraints behind a conflict, to explain a failed search
+ *
+ * A package left without a usable version by a new requirement is the most concrete explanation, so it replaces
+ * any earlier record.
+ * @param solver `Solver`
+ * @param name offset in `names` of the package left without a usable version
+ * @param spec requirement that could not be added (NULL=none)
+ * @param by package that requires `spec`
+ * @return 0=success, -1=error
+ */
+static int solver_conflict(struct Solver *solver, size_t name, const VersionSpec *spec, const ManifestPackage *by) {
+    solver->conflict_code = solver->names[name].count ? SPM_ERR_PKG_CONFLICT : SPM_ERR_PKG_NOT_FOUND;
+    solver->num_conflict = 0;
+    for (ssize_t c = solver->names[name].constraints; ; c = solver->trail[c].next) {
+        if (solver_grow((void **) &solver->conflict, solver->num_conflict, &solver->num_conflict_alloc, sizeof(*solver->conflict)) < 0) {
+            return -1;
+        }
+        if (c < 0) {
+            break;
+        }
+        solver->conflict[solver->num_conflict++] = solver->trail[c];
+    }
+    if (spec != NULL) {
+        solver->conflict[solver->num_conflict].spec = spec;
+        solver->conflict[solver->num_conflict].by = by;
+        solver->num_conflict++;
+    }
+    return 0;
+}
+
+/**
+ * Determine whether any candidate of a package name satisfies every constraint on it, plus one more
+ * @param solver `Solver`
+ * @param name offset in `names`
+ * @param spec additional requirement
+ * @return 1=yes, 0=no
+ */
+static int solver_satisfiable(struct Solver *solver, size_t name, const VersionSpec *spec) {
+    struct SolverName *record = &solver->names[name];
+    unsigned char *match = solver->match;
+    size_t matches = version_spec_eval(spec, record->candidates, record->count, match);
+
+    // Narrow the matches by each constraint, newest first
+    for (ssize_t c = record->constraints; c >= 0 && matches > 0; c = solver->trail[c].next) {
+        for (size_t i = 0; i < record->count; i++) {
+            if (match[i] && !version_spec_test(solver->trail[c].spec, record->candidates[i]->version_key)) {
+                match[i] = 0;
+                matches--;
+            }
+        }
+    }
+    return matches > 0;
+}
+
+/**
+ * Record an earlier decision level as responsible for a rejected candidate
+ * @param level `SolverLevel` that rejected the candidate
+ * @param reason decision level (0=requested by the user, ignored)
+ * @return 0=success, -1=error
+ */
+static int solver_blame(struct SolverLevel *level, size_t reason) {
+    if (reason == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < level->num_conflicts; i++) {
+        if (level->conflicts[i] == reason) {
+            return 0;
+        }
+    }
+    if (solver_grow((void **) &level->conflicts, level->num_conflicts, &level->num_conflicts_alloc, sizeof(*level->conflicts)) < 0) {
+        return -1;
+    }
+    level->conflicts[level->num_conflicts++] = reason;
+    return 0;
+}
+
+/**
+ * Try to select a candidate at the current decision level
+ * @param solver `Solver`
+ * @param offset offset of the candidate in the group of the level's package name
+ * @return 1=selected, 0=rejected (the responsible levels are added to the level's conflicts), -1=error
+ */
+static int solver_try(struct Solver *solver, size_t offset) {
+    size_t depth = solver->num_levels;
+    struct SolverLevel *level = &solver->levels[depth - 1];
+    size_t name = level->name;
+    ManifestPackage *package = solver->names[name].candidates[offset];
+    size_t id = solver->names[name].first + offset;
+    size_t reason = SIZE_MAX;
+
+    // Requirements already imposed on this package name
+    for (ssize_t c = solver->names[name].constraints; c >= 0; c = solver->trail[c].next) {
+        if (!version_spec_test(solver->trail[c].spec, package->version_key) && solver->trail[c].level < reason) {
+            reason = solver->trail[c].level;
+        }
+    }
+    if (reason != SIZE_MAX) {
+        return solver_blame(level, reason);
+    }
+
+    // Combinations known to fail
+    for (ssize_t w = solver->watch_head[id]; w >= 0; w = solver->watches[w].next) {
+        struct SolverNogood *nogood = &solver->nogoods[solver->watches[w].nogood];
+        size_t *members = &solver->nogood_members[nogood->first];
+        size_t i = 0;
+        while (i < nogood->count && (members[i] == id || solver->selected_level[members[i]] != 0)) {
+            i++;
+        }
+        if (i < nogood->count) {
+            continue;
+        }
+        for (i = 0; i < nogood->count; i++) {
+            if (members[i] != id && solver_blame(level, solver->selected_level[members[i]]) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // Requirements of the candidate
+    for (size_t i = 0; i < package->requirements_records; i++) {
+        const VersionSpec *spec = solver_spec(solver, package->requirements[i]);
+        ssize_t other = spec ? solver_name(solver, spec->name) : -1;
+        struct SolverName *record = NULL;
+
+        if (other < 0) {
+            return -1;
+        }
+        record = &solver->names[other];
+        if ((size_t) other == name) {
+            if (!version_spec_test(spec, package->version_key)) {
+                return 0;
+            }
+        } else if (record->selected >= 0) {
+            if (!version_spec_test(spec, record->candidates[record->selected]->version_key)) {
+                return solver_blame(level, record->level);
+            }
+        } else if (!solver_satisfiable(solver, other, spec)) {
+            for (ssize_t c = record->constraints; c >= 0; c = solver->trail[c].next) {
+                if (solver_blame(level, solver->trail[c].level) < 0) {
+                    return -1;
+                }
+            }
+            return solver_conflict(solver, other, spec, package);
+        }
+    }
+
+    solver->names[name].selected = (ssize_t) offset;
+    solver->names[name].level = depth;
+    solver->selected_level[id] = depth;
+    for (size_t i = 0; i < package->requirements_records; i++) {
+        const VersionSpec *spec = solver_spec(solver, package->requirements[i]);
+        if (solver_constrain(solver, (size_t) solver_name(solver, spec->name), spec, depth, package) < 0) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Record the candidates selected at the given levels as a combination that cannot be part of a solution
+ * @param solver `Solver`
+ * @param levels decision levels
+ * @param count number of levels
+ * @return 0=success, -1=error
+ */
+static int solver_learn(struct Solver *solver, const size_t *levels, size_t count) {
+    if (solver_grow((void **) &solver->nogoods, solver->num_nogoods, &solver->num_nogoods_alloc, sizeof(*solver->nogoods)) < 0) {
+        return -1;
+    }
+    struct SolverNogood *nogood = &solver->nogoods[solver->num_nogoods];
+    nogood->first = solver->num_nogood_members;
+    nogood->count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        struct SolverName *record = &solver->names[solver->levels[levels[i] - 1].name];
+        size_t id = record->first + (size_t) record->selected;
+
+        if (solver_grow((void **) &solver->nogood_members, solver->num_nogood_members, &solver->num_nogood_members_alloc, sizeof(*solver->nogood_members)) < 0
+            || solver_grow((void **) &solver->watches, solver->num_watches, &solver->num_watches_alloc, sizeof(*solver->watches)) < 0) {
+            return -1;
+        }
+        solver->nogood_members[solver->num_nogood_members++] = id;
+        solver->watches[solver->num_watches].nogood = solver->num_nogoods;
+        solver->watches[solver->num_watches].next = solver->watch_head[id];
+        solver->watch_head[id] = (ssize_t) solver->num_watches++;
+        nogood->count++;
+    }
+    solver->num_nogoods++;
+    return 0;
+}
+
+/**
+ * Undo decisions until `target` is the current level, including the selection made at `target`
+ * @param solver `Solver`
+ * @param target decision level
+ */
+static void solver_undo(struct Solver *solver, size_t target) {
+    for (;;) {
+        struct SolverLevel *level = &solver->levels[solver->num_levels - 1];
+        struct SolverName *record = &solver->names[level->name];
+
+        if (record->selected >= 0) {
+            solver->selected_level[record->first + (size_t) record->selected] = 0;
+            record->selected = -1;
+        }
+        while (solver->num_trail > level->trail) {
+            struct SolverConstraint *constraint = &solver->trail[--solver->num_trail];
+            solver->names[constraint->name].constraints = constraint->next;
+        }
+        if (solver->num_levels == target) {
+            break;
+        }
+        solver->num_levels--;
+    }
+}
+
+/**
+ * Open a decision level for the first required package name that is still undecided
+ * @param solver `Solver`
+ * @return 1=opened, 0=every required package is decided, -1=error
+ */
+static int solver_decide(struct Solver *solver) {
+    size_t name = 0;
+    while (name < solver->num_names && (solver->names[name].selected >= 0 || solver->names[name].constraints < 0)) {
+        name++;
+    }
+    if (name == solver->num_names) {
+        return 0;
+    }
+
+    if (solver_grow((void **) &solver->levels, solver->num_levels, &solver->num_levels_alloc, sizeof(*solver->levels)) < 0) {
+        return -1;
+    }
+    struct SolverLevel *level = &solver->levels[solver->num_levels++];
+    level->name = name;
+    level->tried = 0;
+    level->trail = solver->num_trail;
+    level->num_conflicts = 0;
+    return 1;
+}
+
+/**
+ * Search for a selection satisfying every constraint
+ * @param solver `Solver`
+ * @return 0=solved, 1=no solution, -1=error
+ */
+static int solver_search(struct Solver *solver) {
+    int status = solver_decide(solver);
+
+    while (status > 0) {
+        struct SolverLevel *level = &solver->levels[solver->num_levels - 1];
+        size_t count = solver->names[level->name].count;
+        int selected = 0;
+
+        while (selected == 0 && level->tried < count) {
+            // Most preferred candidates are at the end of the group
+            selected = solver_try(solver, count - 1 - level->tried++);
+        }
+        if (selected < 0) {
+            return -1;
+        }
+        if (selected > 0) {
+            status = solver_decide(solver);
+            continue;
+        }
+
+        // Every candidate was rejected. The package is needed because of its oldest requirement.
+        size_t required_by = SIZE_MAX;
+        for (ssize_t c = solver->names[level->name].constraints; c >= 0; c = solver->trail[c].next) {
+            if (solver->trail[c].level < required_by) {
+                required_by = solver->trail[c].level;
+            }
+        }
+        if (solver_blame(level, required_by) < 0) {
+            return -1;
+        }
+        if (solver->conflict_code == 0 && solver_conflict(solver, level->name, NULL, NULL) < 0) {
+            return -1;
+        }
+        if (level->num_conflicts == 0) {
+            return 1;
+        }
+
+        size_t target = 0;
+        for (size_t i = 0; i < level->num_conflicts; i++) {
+            if (level->conflicts[i] > target) {
+                target = level->conflicts[i];
+            }
+        }
+        if (solver_learn(solver, level->conflicts, level->num_conflicts) < 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < level->num_conflicts; i++) {
+            if (level->conflicts[i] != target && solver_blame(&solver->levels[target - 1], level->conflicts[i]) < 0) {
+                return -1;
+            }
+        }
+        solver_undo(solver, target);
+    }
+    return status;
+}
+
+/**
+ * Describe the last conflict in `resolver->error`
+ * @param resolver `Resolver`
+ * @param solver `Solver`
+ * @return 0=success, -1=error
+ */
+static int solver_explain(Resolver *resolver, struct Solver *solver) {
+    size_t spec_len = 1;
+    size_t by_len = 1;
+    char *spec = NULL;
+    char *by = NULL;
+
+    for (size_t i = 0; i < solver->num_conflict; i++) {
+        spec_len += strlen(solver->conflict[i].spec->spec) + 2;
+        by_len += solver->conflict[i].by ? strlen(solver->conflict[i].by->archive) + 2 : 0;
+    }
+    spec = arena_alloc(resolver->arena, spec_len);
+    by = arena_alloc(resolver->arena, by_len);
+    if (spec == NULL || by == NULL) {
+        return -1;
+    }
+    *spec = '\0';
+    *by = '\0';
+
+    // Oldest requirement first
+    for (size_t i = solver->num_conflict; i > 0; i--) {
+        const struct SolverConstraint *constraint = &solver->conflict[i - 1];
+        if (*spec != '\0') {
+            strcat(spec, ", ");
+        }
+        size_t seen = i;
+        while (seen < solver->num_conflict && solver->conflict[seen].by != constraint->by) {
+            seen++;
+        }
+        strcat(spec, constraint->spec->spec);
+        if (constraint->by != NULL && seen == solver->num_conflict) {
+            if (*by != '\0') {
+                strcat(by, ", ");
+            }
+            strcat(by, constraint->by->archive);
+        }
+    }
+
+    resolver->error.code = solver->conflict_code;
+    resolver->error.spec = spec;
+    resolver->error.required_by = *by != '\0' ? by : NULL;
+    return 0;
+}
+
+/**
+ * Select one version of every package required by a set of specifications
+ *
+ * Unlike `resolve_add`, which picks the best match for each requirement independently, the whole closure is solved
+ * at once: a package is selected only if its requirements can be met together with everything else that is
+ * selected, and at most one version of each package is selected. Subsequent `resolve_add` calls build the
+ * dependency graph from the selection.
+ *
+ * On failure `resolver->error` lists the conflicting specifications and the packages requiring them.
+ *
+ * @param resolver `Resolver`
+ * @param specs package specifications
+ * @return 0=success, -1=error or no solution
+ */
+int resolve_solve(Resolver *resolver, StrList *specs) {
+    struct Solver *solver = solver_init(resolver->manifests);
+    int status = -1;
+
+    if (solver == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < strlist_count(specs); i++) {
+        const char *strspec = strlist_item(specs, i);
+        const VersionSpec *spec = solver_spec(solver, strspec);
+        ssize_t name = spec ? solver_name(solver, spec->name) : -1;
+
+        if (name < 0) {
+            goto done;
+        }
+        if (!solver_satisfiable(solver, (size_t) name, spec)) {
+            solver_conflict(solver, (size_t) name, spec, NULL);
+            solver_explain(resolver, solver);
+            goto done;
+        }
+        if (solver_constrain(solver, (size_t) name, spec, 0, NULL) < 0) {
+            goto done;
+        }
+    }
+
+    if ((status = solver_search(solver)) != 0) {
+        if (status > 0) {
+            solver_explain(resolver, solver);
+        }
+        status = -1;
+        goto done;
+    }
+
+    if (resolver->pinned == NULL && (resolver->pinned = hashmap_init(solver->num_names)) == NULL) {
+        status = -1;
+        goto done;
+    }
+    for (size_t i = 0; i < solver->num_names; i++) {
+        struct SolverName *record = &solver->names[i];
+        if (record->selected >= 0 && hashmap_put(resolver->pinned, record->name, record->candidates[record->selected]) < 0) {
+            status = -1;
+            goto done;
+        }
+    }
+
+done:
+    solver_free(solver);
+    return status;
+}
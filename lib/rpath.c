@@ -3,34 +3,6 @@
  */
 #include "spm.h"
 
-/**
- * Wrapper function to execute `patchelf` with arguments
- * @param _filename Path to file
- * @param _args Arguments to pass to `patchelf`
- * @return success=Process struct, failure=NULL
- */
-Process *patchelf(const char *_filename, const char *_args) {
-    char *filename = strdup(_filename);
-    char *args = strdup(_args);
-    Process *proc_info = NULL;
-    char sh_cmd[PATH_MAX];
-    sh_cmd[0] = '\0';
-
-    strchrdel(args, SHELL_INVALID);
-    strchrdel(filename, SHELL_INVALID);
-    sprintf(sh_cmd, "patchelf %s %s 2>&1", args, filename);
-
-    if (SPM_GLOBAL.verbose > 1) {
-        printf("         EXEC : %s\n", sh_cmd);
-    }
-
-    shell(&proc_info, SHELL_OUTPUT, sh_cmd);
-
-    free(filename);
-    free(args);
-    return proc_info;
-}
-
 /**
  * Wrapper function to execute `install_name_tool` with arguments
  * @param _filename Path to file
@@ -62,8 +34,6 @@ Process *install_name_tool(const char *_filename, const char *_args) {
 /**
  * Determine whether a RPATH or RUNPATH is present in file
  *
- * TODO: Replace with OS-native solution(s)
- *
  * @param _filename path to executable or library
  * @return -1=OS error, 0=has rpath, 1=not found
  */
@@ -79,14 +49,13 @@ int has_rpath(const char *_filename) {
         return 1;
     };
 
+    free(rpath);
     return 0;
 }
 
 /**
  * Returns a RPATH or RUNPATH if one is defined in `_filename`
  *
- * TODO: Replace with OS-native solution(s)
- *
  * @param _filename path to executable or library
  * @return RPATH string, NULL=error (caller is responsible for freeing memory)
  */
@@ -125,31 +94,57 @@ char *rpath_generate(const char *_filename, FSTree *tree, const char *destroot)
  * Set the RPATH of an executable
  * @param filename
  * @param rpath
- * @return
+ * @return 0=success, non-zero=failure
  */
 int rpath_set(const char *filename, const char *rpath) {
     int returncode = 0;
+
+#if OS_LINUX
+    if (SPM_GLOBAL.verbose > 1) {
+        printf("         RPATH: '%s'\n", rpath);
+    }
+    returncode = elffile_set_rpath(filename, rpath);
+#elif OS_DARWIN
     char args[PATH_MAX];
     Process *pe = NULL;
 
     memset(args, '\0', PATH_MAX);
-#if OS_LINUX
-    sprintf(args, "--force-rpath --set-rpath '%s'", rpath);
-    pe = patchelf(filename, args);
-#elif OS_DARWIN
     sprintf(args, "-add-rpath '%s'", rpath);
     pe = install_name_tool(filename, args);
-#elif OS_WINDOWS
-    // TODO: assuming windows has a mechanism for changing runtime paths, do it here.
-#endif
-
     if (pe != NULL) {
         returncode = pe->returncode;
     }
     shell_free(pe);
+#elif OS_WINDOWS
+    // TODO: assuming windows has a mechanism for changing runtime paths, do it here.
+#endif
+
+    shlib_info_forget(filename);
     return returncode;
 }
 
+/**
+ * Set the RPATH of many executables
+ *
+ * Files are modified in process on Linux, so a batch costs no more than the sum of its files. Every file is attempted
+ * even when one of them fails.
+ *
+ * @param filename NULL terminated array of paths
+ * @param rpath RPATH of each file in `filename`
+ * @return number of files that could not be modified
+ */
+size_t rpath_set_batch(char **filename, char **rpath) {
+    size_t failed = 0;
+
+    for (size_t i = 0; filename[i] != NULL; i++) {
+        if (rpath_set(filename[i], rpath[i]) != 0) {
+            fprintf(stderr, "%s: unable to set RPATH\n", filename[i]);
+            failed++;
+        }
+    }
+    return failed;
+}
+
 /**
  * Automatically detect the nearest lib directory and set the RPATH of an executable
  * @param filename
@@ -173,16 +168,33 @@ int rpath_autoset(const char *filename, FSTree *tree, const char *destroot) {
 /**
  * Find shared libraries in a directory tree
  *
+ * Paths are reported relative to `root` (`./lib/libexample.so`) whether or not `root` is the current directory.
+ *
  * @param root directory
  * @return `FSTree`
  */
 FSTree *rpath_libraries_available(const char *root) {
     FSTree *tree = fstree(root, (char *[]) {SPM_SHLIB_EXTENSION, NULL}, SPM_FSTREE_FLT_CONTAINS | SPM_FSTREE_FLT_RELATIVE);
+    size_t root_len = strlen(root);
+
     if (tree == NULL) {
         perror(root);
         fprintf(SYSERROR);
         return NULL;
     }
+
+    while (root_len > 1 && root[root_len - 1] == DIRSEP) {
+        root_len--;
+    }
+    for (size_t i = 0; i < tree->num_records; i++) {
+        char *name = tree->record[i]->name;
+        if (strcmp(root, ".") == 0 || strncmp(name, root, root_len) != 0) {
+            continue;
+        }
+        // "root/lib/..." -> "./lib/..." (the replacement is never longer than the original)
+        name[0] = '.';
+        memmove(&name[1], &name[root_len], strlen(&name[root_len]) + 1);
+    }
     return tree;
 }
 
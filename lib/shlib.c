@@ -1,5 +1,18 @@
 #include "spm.h"
 #include "shlib.h"
+#include <pthread.h>
+
+/**
+ * `ShlibInfo` of a file, reused while the file is unchanged
+ */
+typedef struct {
+    char key[64];       // "device:inode"
+    struct stat st;     // state of the file when `info` was read
+    ShlibInfo *info;    // NULL=forgotten
+} ShlibCacheEntry;
+
+static HashMap *shlib_cache = NULL;
+static pthread_mutex_t shlib_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
 char *objdump(const char *_filename, char *_args) {
     // do not expose this function
@@ -36,9 +49,219 @@ char *objdump(const char *_filename, char *_args) {
     return result;
 }
 
+/**
+ * Determine whether two `stat` results describe the same version of a file
+ * @param a
+ * @param b
+ * @return 1=same, 0=modified
+ */
+static int shlib_stat_same(const struct stat *a, const struct stat *b) {
+    if (a->st_size != b->st_size || a->st_mtime != b->st_mtime || a->st_ctime != b->st_ctime) {
+        return 0;
+    }
+#if OS_LINUX
+    if (a->st_mtim.tv_nsec != b->st_mtim.tv_nsec || a->st_ctim.tv_nsec != b->st_ctim.tv_nsec) {
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+/**
+ * Generate the cache key of a file
+ * @param key destination
+ * @param size size of `key`
+ * @param st `stat` result of the file
+ */
+static void shlib_cache_key(char *key, size_t size, const struct stat *st) {
+    snprintf(key, size, "%llx:%llx", (unsigned long long) st->st_dev, (unsigned long long) st->st_ino);
+}
+
+/**
+ * Read the dynamic section of an ELF image
+ * @param filename path to executable or library
+ * @return success=`ShlibInfo`, failure=NULL
+ */
+static ShlibInfo *shlib_info_read(const char *filename) {
+    ElfFile *elf = NULL;
+    ShlibInfo *info = NULL;
+
+    if ((elf = elffile_open(filename)) == NULL) {
+        return NULL;
+    }
+    if ((info = calloc(1, sizeof(*info))) == NULL || (info->needed = strlist_init()) == NULL) {
+        fprintf(SYSERROR);
+        free(info);
+        elffile_close(elf);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < elf->num_dynamic; i++) {
+        char **dest = NULL;
+        const char *str = NULL;
+        uint64_t tag, value;
+
+        elffile_dynamic(elf, i, &tag, &value);
+        if (tag == ELF_DT_SONAME) {
+            dest = &info->soname;
+        } else if (tag == ELF_DT_RPATH) {
+            dest = &info->rpath;
+        } else if (tag == ELF_DT_RUNPATH) {
+            dest = &info->runpath;
+        } else if (tag != ELF_DT_NEEDED) {
+            continue;
+        }
+
+        if ((str = elffile_string(elf, value)) == NULL) {
+            spmerrno = SPM_ERR_PARSE;
+            spmerrno_cause("ELF dynamic entry refers to an invalid string");
+            shlib_info_free(info);
+            elffile_close(elf);
+            return NULL;
+        }
+
+        if (dest == NULL) {
+            strlist_append(info->needed, (char *) str);
+        } else if (*dest == NULL) {
+            *dest = strdup(str);
+        }
+    }
+
+    elffile_close(elf);
+    return info;
+}
+
+/**
+ * Duplicate a `ShlibInfo`
+ * @param info
+ * @return success=`ShlibInfo`, failure=NULL
+ */
+static ShlibInfo *shlib_info_copy(const ShlibInfo *info) {
+    ShlibInfo *result = calloc(1, sizeof(*result));
+    if (result == NULL) {
+        return NULL;
+    }
+
+    result->soname = info->soname ? strdup(info->soname) : NULL;
+    result->rpath = info->rpath ? strdup(info->rpath) : NULL;
+    result->runpath = info->runpath ? strdup(info->runpath) : NULL;
+    result->needed = strlist_copy(info->needed);
+    if (result->needed == NULL || (info->soname && !result->soname) || (info->rpath && !result->rpath)
+        || (info->runpath && !result->runpath)) {
+        shlib_info_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+/**
+ * Read the dynamic linking information of an ELF executable or library
+ *
+ * Results are cached per file (device and inode) until the file is modified, so `shlib_deps` and `shlib_rpath` share
+ * one parse. The cache is shared by all threads.
+ *
+ * @param filename path to executable or library
+ * @return success=`ShlibInfo` (caller frees with `shlib_info_free`), failure=NULL
+ */
+ShlibInfo *shlib_info(const char *filename) {
+    ShlibCacheEntry *entry = NULL;
+    ShlibInfo *info = NULL;
+    ShlibInfo *result = NULL;
+    struct stat st;
+    char key[64];
+
+    if (filename == NULL) {
+        spmerrno = EINVAL;
+        spmerrno_cause("filename was NULL");
+        return NULL;
+    }
+    if (stat(filename, &st) < 0) {
+        return NULL;
+    }
+    shlib_cache_key(key, sizeof(key), &st);
+
+    pthread_mutex_lock(&shlib_cache_lock);
+    entry = hashmap_get(shlib_cache, key);
+    if (entry != NULL && entry->info != NULL && shlib_stat_same(&entry->st, &st)) {
+        result = shlib_info_copy(entry->info);
+        pthread_mutex_unlock(&shlib_cache_lock);
+        return result;
+    }
+    pthread_mutex_unlock(&shlib_cache_lock);
+
+    // Parse without holding the lock. Threads reading the same file at once store the same result
+    if ((info = shlib_info_read(filename)) == NULL) {
+        return NULL;
+    }
+    result = shlib_info_copy(info);
+
+    pthread_mutex_lock(&shlib_cache_lock);
+    if (shlib_cache == NULL) {
+        shlib_cache = hashmap_init(64);
+    }
+    entry = hashmap_get(shlib_cache, key);
+    if (entry == NULL && shlib_cache != NULL && (entry = calloc(1, sizeof(*entry))) != NULL) {
+        strcpy(entry->key, key);
+        if (hashmap_put(shlib_cache, entry->key, entry) < 0) {
+            free(entry);
+            entry = NULL;
+        }
+    }
+    if (entry != NULL) {
+        shlib_info_free(entry->info);
+        entry->info = info;
+        entry->st = st;
+        info = NULL;
+    }
+    pthread_mutex_unlock(&shlib_cache_lock);
+
+    shlib_info_free(info);
+    return result;
+}
+
+/**
+ * Drop the cached `ShlibInfo` of a file. Call this after modifying a file in a way that may not change its size or
+ * timestamps (i.e. more than once within the timestamp resolution of the filesystem)
+ * @param filename path to executable or library
+ */
+void shlib_info_forget(const char *filename) {
+    ShlibCacheEntry *entry = NULL;
+    struct stat st;
+    char key[64];
+
+    if (filename == NULL || stat(filename, &st) < 0) {
+        return;
+    }
+    shlib_cache_key(key, sizeof(key), &st);
+
+    pthread_mutex_lock(&shlib_cache_lock);
+    if ((entry = hashmap_get(shlib_cache, key)) != NULL) {
+        shlib_info_free(entry->info);
+        entry->info = NULL;
+    }
+    pthread_mutex_unlock(&shlib_cache_lock);
+}
+
+/**
+ * Free a `ShlibInfo`
+ * @param info
+ */
+void shlib_info_free(ShlibInfo *info) {
+    if (info != NULL) {
+        free(info->soname);
+        free(info->rpath);
+        free(info->runpath);
+        strlist_free(info->needed);
+        free(info);
+    }
+}
+
+/**
+ * Get the runtime library search path of an executable or library
+ * @param filename path to executable or library
+ * @return success=search path, failure=NULL (also returned when there is none)
+ */
 char *shlib_rpath(const char *filename) {
-    char **data = NULL;
-    char *raw_data = NULL;
     char *result = NULL;
 
     if (filename == NULL) {
@@ -47,6 +270,24 @@ char *shlib_rpath(const char *filename) {
         return NULL;
     }
 
+#if OS_LINUX
+    ShlibInfo *info = shlib_info(filename);
+    if (info == NULL) {
+        return NULL;
+    }
+
+    // The dynamic linker ignores DT_RPATH when DT_RUNPATH is present
+    if (info->runpath != NULL) {
+        result = strdup(info->runpath);
+    } else if (info->rpath != NULL) {
+        result = strdup(info->rpath);
+    }
+    shlib_info_free(info);
+    return result;
+#else
+    char **data = NULL;
+    char *raw_data = NULL;
+
     if ((raw_data = objdump(filename, SPM_SHLIB_EXEC_ARGS)) == NULL) {
         return NULL;
     }
@@ -67,19 +308,7 @@ char *shlib_rpath(const char *filename) {
         char **field = NULL;
         char reason[255] = {0,};
 
-#if OS_LINUX
-        // Extract the RPATH record (second field)
-        if (startswith(data[i], "RPATH")) {
-            if ((field = split(data[i], " ")) == NULL) {
-                break;
-            }
-
-            // record library path
-            result = strdup(field[1]);
-            split_free(field);
-            break;
-        }
-#elif OS_DARWIN
+#if OS_DARWIN
         size_t offset_name = i + 2;  // how many lines to look ahead after reaching LC_RPATH
         size_t numLines;
         for (numLines = 0; data[numLines] != NULL; numLines++); // get line count
@@ -118,11 +347,15 @@ char *shlib_rpath(const char *filename) {
     free(raw_data);
     split_free(data);
     return result;
+#endif
 }
 
+/**
+ * Get the names of the shared libraries required by an executable or library
+ * @param filename path to executable or library
+ * @return success=`StrList` (may be empty), failure=NULL
+ */
 StrList *shlib_deps(const char *filename) {
-    char **data = NULL;
-    char *raw_data = NULL;
     StrList *result = NULL;
 
     if (filename == NULL) {
@@ -131,6 +364,19 @@ StrList *shlib_deps(const char *filename) {
         return NULL;
     }
 
+#if OS_LINUX
+    ShlibInfo *info = shlib_info(filename);
+    if (info == NULL) {
+        return NULL;
+    }
+    result = info->needed;
+    info->needed = NULL;
+    shlib_info_free(info);
+    return result;
+#else
+    char **data = NULL;
+    char *raw_data = NULL;
+
     // Get output from objdump
     if ((raw_data = objdump(filename, SPM_SHLIB_EXEC_ARGS)) == NULL) {
         return NULL;
@@ -159,21 +405,7 @@ StrList *shlib_deps(const char *filename) {
         char **field = NULL;
         char reason[255] = {0,};
 
-#if OS_LINUX
-        // Extract the NEEDED libraries (second field)
-        // AFAIK when "NEEDED" is present, a string containing the library name is guaranteed to be there
-        if (startswith(data[i], "NEEDED")) {
-            if ((field = split(data[i], " ")) == NULL) {
-                strlist_free(result);
-                result = NULL;
-                break;
-            }
-
-            // record library path
-            strlist_append(result, field[1]);
-            split_free(field);
-        }
-#elif OS_DARWIN
+#if OS_DARWIN
         size_t offset_name = i + 2;  // how many lines to look ahead after reaching LC_LOAD_DYLIB
         size_t numLines;
         for (numLines = 0; data[numLines] != NULL; numLines++); // get line count
@@ -214,4 +446,5 @@ StrList *shlib_deps(const char *filename) {
     free(raw_data);
     split_free(data);
     return result;
+#endif
 }
@@ -844,3 +844,25 @@ char *tolower_s(char *s) {
     return s;
 }
 
+
+/**
+ * Compute a 64-bit FNV-1a hash of a string
+ *
+ * ~~~{.c}
+ * uint64_t bucket = strhash("zlib") % 64;
+ * ~~~
+ *
+ * @param s string to hash
+ * @return hash value (`NULL` hashes to the FNV offset basis)
+ */
+uint64_t strhash(const char *s) {
+    uint64_t result = 0xcbf29ce484222325ULL;
+    if (s == NULL) {
+        return result;
+    }
+    for (size_t i = 0; s[i] != '\0'; i++) {
+        result ^= (unsigned char) s[i];
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
@@ -0,0 +1,150 @@
+/**
+ * Thread pool
+ *
+ * Work items are handed out one at a time from a shared counter, so workers that finish early keep pulling work
+ * until none is left. Callers store results by item number to keep their output in a predictable order.
+ *
+ * @file threadpool.c
+ */
+#include "spm.h"
+#include <pthread.h>
+
+struct ThreadPoolState {
+    size_t next;
+    size_t count;
+    ThreadPoolFunc func;
+    void *arg;
+    pthread_mutex_t lock;
+};
+
+struct ThreadPoolWorker {
+    struct ThreadPoolState *state;
+    size_t id;
+    pthread_t thread;
+};
+
+/**
+ * Process work items until none remain
+ * @param arg `struct ThreadPoolWorker`
+ * @return NULL
+ */
+static void *threadpool_worker(void *arg) {
+    struct ThreadPoolWorker *worker = arg;
+    struct ThreadPoolState *state = worker->state;
+
+    while (1) {
+        size_t index;
+        pthread_mutex_lock(&state->lock);
+        index = state->next++;
+        pthread_mutex_unlock(&state->lock);
+
+        if (index >= state->count) {
+            break;
+        }
+        state->func(index, worker->id, state->arg);
+    }
+    return NULL;
+}
+
+/**
+ * Determine the number of workers to use for `count` items
+ *
+ * Uses `SPM_GLOBAL.jobs`. A value of zero selects the number of online processors.
+ *
+ * @param count number of work items
+ * @return number of workers (at least 1, at most `count`)
+ */
+size_t threadpool_jobs(size_t count) {
+    long jobs = SPM_GLOBAL.jobs;
+
+    if (jobs <= 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if (count > 0 && (size_t) jobs > count) {
+        jobs = (long) count;
+    }
+    return (size_t) jobs;
+}
+
+/**
+ * Call `func` once for each item in `0 .. count - 1` using up to `jobs` threads
+ *
+ * ~~~{.c}
+ * void square(size_t index, size_t worker, void *arg) {
+ *     int *data = arg;
+ *     data[index] *= data[index];
+ * }
+ *
+ * int data[] = {1, 2, 3, 4};
+ * threadpool_run(threadpool_jobs(4), 4, square, data);
+ * ~~~
+ *
+ * When `jobs` is 1 the items are processed in order on the calling thread. If a thread cannot be started the
+ * remaining workers absorb its share.
+ *
+ * @param jobs number of workers
+ * @param count number of work items
+ * @param func callback
+ * @param arg user data passed to `func`
+ * @return 0=success, -1=error
+ */
+int threadpool_run(size_t jobs, size_t count, ThreadPoolFunc func, void *arg) {
+    struct ThreadPoolState state;
+    struct ThreadPoolWorker *workers = NULL;
+    size_t started = 0;
+
+    if (func == NULL) {
+        return -1;
+    }
+
+    if (jobs > count) {
+        jobs = count;
+    }
+
+    if (jobs <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            func(i, 0, arg);
+        }
+        return 0;
+    }
+
+    memset(&state, '\0', sizeof(state));
+    state.count = count;
+    state.func = func;
+    state.arg = arg;
+    if (pthread_mutex_init(&state.lock, NULL) != 0) {
+        return -1;
+    }
+
+    workers = calloc(jobs, sizeof(*workers));
+    if (workers == NULL) {
+        perror("Failed to allocate thread pool");
+        fprintf(SYSERROR);
+        pthread_mutex_destroy(&state.lock);
+        return -1;
+    }
+
+    // Worker zero runs on the calling thread
+    for (size_t i = 1; i < jobs; i++) {
+        workers[started].state = &state;
+        workers[started].id = i;
+        if (pthread_create(&workers[started].thread, NULL, threadpool_worker, &workers[started]) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    struct ThreadPoolWorker self = {.state = &state, .id = 0};
+    threadpool_worker(&self);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    free(workers);
+    pthread_mutex_destroy(&state.lock);
+    return 0;
+}
@@ -159,6 +159,102 @@ uint64_t version_from(const char *str) {
     return result;
 }
 
+/**
+ * Encode a version string as a key that sorts in version order
+ *
+ * Each dot separated segment is stored as its numeric value (a length byte followed by up to
+ * `VERSION_KEY_DIGITS_MAX` digits without leading zeros), then its alphanumeric suffix, if any. Trailing zero segments
+ * are dropped so `1.2` and `1.2.0` produce the same key. A local version (`1.2+local`) sorts after its public version
+ * and before any later release. Keys never contain a NUL byte, so `strcmp()` orders them the same way `memcmp()` does.
+ *
+ * @param str version string (NULL=version "zero")
+ * @param dest destination buffer (may be NULL when `size` is zero)
+ * @param size size of `dest`
+ * @return length of the key, excluding the terminator (the key was truncated when the result >= `size`)
+ */
+size_t version_key_encode(const char *str, char *dest, size_t size) {
+    size_t len = 0;
+    size_t keep = 0;
+#define VERSION_KEY_PUT(c) do { if (len < size) { dest[len] = (char) (c); } len++; } while (0)
+
+    for (const char *cursor = str; cursor != NULL && *cursor != '\0' && *cursor != *VERSION_DELIM_LOCAL;) {
+        if (cursor != str) {
+            VERSION_KEY_PUT(VERSION_KEY_SEGMENT);
+            cursor++;
+        }
+
+        // Numeric value
+        const char *digits = cursor;
+        size_t num_digits = 0;
+        while (*digits == '0') {
+            digits++;
+        }
+        while (isdigit((unsigned char) digits[num_digits])) {
+            num_digits++;
+        }
+        cursor = digits + num_digits;
+        if (num_digits > VERSION_KEY_DIGITS_MAX) {
+            num_digits = VERSION_KEY_DIGITS_MAX;
+        }
+        VERSION_KEY_PUT(VERSION_KEY_NUMBER + num_digits);
+        for (size_t i = 0; i < num_digits; i++) {
+            VERSION_KEY_PUT(digits[i]);
+        }
+
+        // Alphanumeric suffix. Everything else is ignored.
+        int has_suffix = 0;
+        for (; *cursor != '\0' && *cursor != *VERSION_DELIM && *cursor != *VERSION_DELIM_LOCAL; cursor++) {
+            if (isalnum((unsigned char) *cursor)) {
+                if (!has_suffix) {
+                    VERSION_KEY_PUT(VERSION_KEY_SUFFIX);
+                    has_suffix = 1;
+                }
+                VERSION_KEY_PUT(tolower((unsigned char) *cursor));
+            }
+        }
+
+        if (num_digits || has_suffix) {
+            keep = len;
+        }
+    }
+    len = keep;
+
+    const char *local = str != NULL ? strstr(str, VERSION_DELIM_LOCAL) : NULL;
+    if (local != NULL) {
+        VERSION_KEY_PUT(VERSION_KEY_LOCAL);
+        for (local++; *local != '\0'; local++) {
+            if ((unsigned char) *local >= ' ') {
+                VERSION_KEY_PUT(tolower((unsigned char) *local));
+            }
+        }
+    }
+    VERSION_KEY_PUT(VERSION_KEY_END);
+#undef VERSION_KEY_PUT
+
+    if (size) {
+        dest[len < size ? len : size - 1] = '\0';
+    }
+    return len;
+}
+
+/**
+ * Convert version string to a key that sorts in version order
+ *
+ * See `version_key_encode`.
+ *
+ * @param str version string (NULL=version "zero")
+ * @return key (caller must free), or NULL on error
+ */
+char *version_key(const char *str) {
+    size_t size = version_key_encode(str, NULL, 0) + 1;
+    char *result = malloc(size);
+    if (result == NULL) {
+        return NULL;
+    }
+    version_key_encode(str, result, size);
+    return result;
+}
+
 /**
  *
  * @param op
@@ -188,81 +284,332 @@ unsigned int version_spec_from(const char *op) {
 }
 
 /**
+ * Get the first release excluded by a compatible release specification
  *
- * @param a
- * @param b
- * @return
+ * `~=1.4.5` allows `1.4.5` up to, but not including, `1.5`. `~=1.4` allows `1.4` up to `2`.
+ *
+ * @param version version operand of `~=`
+ * @return version string (caller must free), or NULL on error
  */
-static int _find_by_spec_compare(const void *a, const void *b) {
-    const ManifestPackage *aa = *(const ManifestPackage**)a;
-    const ManifestPackage *bb = *(const ManifestPackage**)b;
-    uint64_t version_a = version_from(aa->version);
-    uint64_t version_b = version_from(bb->version);
-    return version_a > version_b;
+static char *version_spec_compat_upper(const char *version) {
+    char *str = strdup(version);
+    char *result = NULL;
+    char **part = NULL;
+    size_t num_parts = 0;
+
+    if (str == NULL) {
+        return NULL;
+    }
+    char *local = strstr(str, VERSION_DELIM_LOCAL);
+    if (local != NULL) {
+        *local = '\0';
+    }
+    if ((part = split(str, VERSION_DELIM)) == NULL) {
+        free(str);
+        return NULL;
+    }
+    for (num_parts = 0; part[num_parts] != NULL; num_parts++);
+
+    // Keep every segment but the last, and increment the one before it
+    size_t keep = num_parts > 1 ? num_parts - 1 : 1;
+    result = calloc(strlen(version) + 32, sizeof(char));
+    for (size_t i = 0; result != NULL && i < keep; i++) {
+        if (i + 1 < keep) {
+            strcat(result, part[i]);
+            strcat(result, VERSION_DELIM);
+        } else {
+            sprintf(result + strlen(result), "%llu", strtoull(part[i], NULL, VERSION_BASE) + 1);
+        }
+    }
+
+    split_free(part);
+    free(str);
+    return result;
+}
+
+/**
+ * Compile a package specification from its parts
+ * @param strspec text of the specification (NULL=build it from the parts)
+ * @param name package name
+ * @param op version operator(s)
+ * @param version_str version to compare against (NULL=version "zero")
+ * @return `VersionSpec`, or NULL on error
+ */
+static VersionSpec *version_spec_new(const char *strspec, const char *name, const char *op, const char *version_str) {
+    VersionSpec *result = NULL;
+    unsigned int flags = version_spec_from(op);
+    char *lower = version_key(version_str);
+    char *upper = NULL;
+    char *cursor = NULL;
+
+    if (lower == NULL) {
+        return NULL;
+    }
+    if (flags & VERSION_COMPAT && version_str != NULL) {
+        char *version_upper = version_spec_compat_upper(version_str);
+        upper = version_upper != NULL ? version_key(version_upper) : NULL;
+        free(version_upper);
+        if (upper == NULL) {
+            free(lower);
+            return NULL;
+        }
+    }
+
+    size_t spec_len = strspec ? strlen(strspec) : strlen(name) + strlen(op) + (version_str ? strlen(version_str) : 0);
+    result = calloc(1, sizeof(*result) + spec_len + 1 + strlen(name) + 1 + strlen(lower) + 1 + (upper ? strlen(upper) + 1 : 0));
+    if (result == NULL) {
+        perror("Failed to allocate version specification");
+        fprintf(SYSERROR);
+        free(lower);
+        free(upper);
+        return NULL;
+    }
+
+    cursor = result->data;
+    result->spec = cursor;
+    if (strspec != NULL) {
+        cursor = strcpy(cursor, strspec) + spec_len + 1;
+    } else {
+        cursor += sprintf(cursor, "%s%s%s", name, op, version_str ? version_str : "") + 1;
+    }
+    result->name = strcpy(cursor, name);
+    cursor += strlen(name) + 1;
+    result->lower = strcpy(cursor, lower);
+    cursor += strlen(lower) + 1;
+    if (upper != NULL) {
+        result->upper = strcpy(cursor, upper);
+    }
+    result->op = flags;
+
+    free(lower);
+    free(upper);
+    return result;
+}
+
+/**
+ * Compile a package specification from its parts
+ * @param name package name
+ * @param op version operator(s) (`>=`, `<`, `==`, `!=`, `~=`, ...)
+ * @param version_str version to compare against (NULL=version "zero")
+ * @return `VersionSpec` (free with `version_spec_free`), or NULL on error
+ */
+VersionSpec *version_spec_init(const char *name, const char *op, const char *version_str) {
+    return version_spec_new(NULL, name, op, version_str);
 }
 
 /**
+ * Compile a package specification
  *
- * @param manifest
- * @param name
- * @param op
- * @param version_str
- * @return
+ * A compiled specification is parsed once and can be tested against any number of candidates without touching
+ * the version strings again.
+ *
+ * @param strspec package specification (`zlib`, `zlib>=1.2`, `zlib~=1.2.3`, or an archive name)
+ * @return `VersionSpec` (free with `version_spec_free`), or NULL on error
+ */
+VersionSpec *version_spec_compile(const char *strspec) {
+    char name[NAME_MAX];
+    char op[NAME_MAX];
+    char version[NAME_MAX];
+
+    if (strspec == NULL) {
+        return NULL;
+    }
+    strspec_parse(strspec, name, op, version);
+    return version_spec_new(strspec, name, op, isempty(version) ? NULL : version);
+}
+
+/**
+ * Free a `VersionSpec`
+ * @param spec
+ */
+void version_spec_free(VersionSpec *spec) {
+    free(spec);
+}
+
+/**
+ * Test a version key against a compiled specification
+ * @param spec `VersionSpec`
+ * @param key version key (see `version_key`)
+ * @return 1=match, 0=no match
+ */
+int version_spec_test(const VersionSpec *spec, const char *key) {
+    int result = strcmp(key, spec->lower);
+
+    if (spec->op & VERSION_GT && spec->op & VERSION_EQ) {
+        return result >= 0;
+    }
+    else if (spec->op & VERSION_LT && spec->op & VERSION_EQ) {
+        return result <= 0;
+    }
+    else if (spec->op & VERSION_NE && spec->op & VERSION_EQ) {
+        return result != 0;
+    }
+    else if (spec->op & VERSION_GT) {
+        return result > 0;
+    }
+    else if (spec->op & VERSION_LT) {
+        return result < 0;
+    }
+    else if (spec->op & VERSION_COMPAT) {
+        return result >= 0 && (spec->upper == NULL || strcmp(key, spec->upper) < 0);
+    }
+    else if (spec->op & VERSION_EQ) {
+        return result == 0;
+    }
+    return 0;
+}
+
+/**
+ * Test every candidate against a compiled specification
+ * @param spec `VersionSpec`
+ * @param candidates packages in any order
+ * @param count number of candidates
+ * @param match destination for the result of each candidate (1=match, 0=no match)
+ * @return number of matches
+ */
+size_t version_spec_eval(const VersionSpec *spec, ManifestPackage **candidates, size_t count, unsigned char *match) {
+    size_t result = 0;
+    for (size_t i = 0; i < count; i++) {
+        match[i] = (unsigned char) version_spec_test(spec, candidates[i]->version_key);
+        result += match[i];
+    }
+    return result;
+}
+
+/**
+ * Find the first candidate whose version is not less than (or greater than) `key`
+ * @param candidates packages sorted by version
+ * @param count number of candidates
+ * @param key version key to search for
+ * @param upper 0=first version >= `key`, 1=first version > `key`
+ * @return offset (`count` when no candidate qualifies)
+ */
+static size_t _find_by_spec_bound(ManifestPackage **candidates, size_t count, const char *key, int upper) {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int result = strcmp(candidates[mid]->version_key, key);
+        if (result < 0 || (upper && result == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Locate the candidates that satisfy a compiled specification
+ *
+ * Up to two spans of `candidates` satisfy a specification (`!=` excludes the middle of the range).
+ *
+ * @param spec `VersionSpec`
+ * @param candidates packages sorted by version
+ * @param count number of candidates
+ * @param span destination for the `[start, end)` offsets of each span
+ */
+static void version_spec_spans(const VersionSpec *spec_info, ManifestPackage **candidates, size_t count, size_t span[2][2]) {
+    unsigned int spec = spec_info->op;
+    size_t lower = _find_by_spec_bound(candidates, count, spec_info->lower, 0);
+    size_t upper = _find_by_spec_bound(candidates, count, spec_info->lower, 1);
+
+    memset(span, 0, sizeof(size_t[2][2]));
+    if (spec & VERSION_GT && spec & VERSION_EQ) {
+        span[0][0] = lower; span[0][1] = count;
+    }
+    else if (spec & VERSION_LT && spec & VERSION_EQ) {
+        span[0][0] = 0; span[0][1] = upper;
+    }
+    else if (spec & VERSION_NE && spec & VERSION_EQ) {
+        span[0][0] = 0; span[0][1] = lower;
+        span[1][0] = upper; span[1][1] = count;
+    }
+    else if (spec & VERSION_GT) {
+        span[0][0] = upper; span[0][1] = count;
+    }
+    else if (spec & VERSION_LT) {
+        span[0][0] = 0; span[0][1] = lower;
+    }
+    else if (spec & VERSION_COMPAT) {
+        span[0][0] = lower;
+        span[0][1] = spec_info->upper ? _find_by_spec_bound(candidates, count, spec_info->upper, 0) : count;
+    }
+    else if (spec & VERSION_EQ) {
+        span[0][0] = lower; span[0][1] = upper;
+    }
+}
+
+/**
+ * Find all versions of a package that satisfy a version specification
+ *
+ * Candidates come from the `Manifest` name index, which holds each package's versions in ascending order, so the
+ * matching versions are located by binary search.
+ *
+ * @param manifest `Manifest`
+ * @param name package name
+ * @param op version operator(s) (`>=`, `<`, `==`, `!=`, ...)
+ * @param version_str version to compare against
+ * @return NULL terminated array of `ManifestPackage` copies in ascending version order
  */
 ManifestPackage **find_by_spec(const Manifest *manifest, const char *name, const char *op, const char *version_str) {
+    const ManifestRange *range = manifest_name_range(manifest, name);
+    size_t count = range ? range->count : 0;
     size_t record = 0;
-    ManifestPackage **list = (ManifestPackage **) calloc(manifest->records + 1, sizeof(ManifestPackage *));
+    ManifestPackage **list = (ManifestPackage **) calloc(count + 1, sizeof(ManifestPackage *));
     if (!list) {
         perror("ManifestPackage array");
         fprintf(SYSERROR);
         return NULL;
     }
 
-    for (size_t i = 0; i < manifest->records; i++) {
-        if (strcmp(manifest->packages[i]->name, name) == 0) {
-            uint64_t version_a = version_from(manifest->packages[i]->version);
-            uint64_t version_b = version_from(version_str);
-            unsigned int spec = version_spec_from(op);
-
-            int res = 0;
-            if (spec & VERSION_GT && spec & VERSION_EQ) {
-                res = version_a >= version_b;
-            }
-            else if (spec & VERSION_LT && spec & VERSION_EQ) {
-                res = version_a <= version_b;
-            }
-            else if (spec & VERSION_NE && spec & VERSION_EQ) {
-                res = version_a != version_b;
-            }
-            else if (spec & VERSION_GT) {
-                res = version_a > version_b;
-            }
-            else if (spec & VERSION_LT) {
-                res = version_a < version_b;
-            }
-            else if (spec & VERSION_COMPAT) {
-                // TODO
-            }
-            else if (spec & VERSION_EQ) {
-                res = version_a == version_b;
-            }
+    if (range == NULL) {
+        return list;
+    }
 
-            if (res != 0) {
-                list[record] = manifest_package_copy(manifest->packages[i]);
-                if (!list[record]) {
-                    perror("Unable to allocate memory for manifest record");
-                    fprintf(SYSERROR);
-                    return NULL;
-                }
-                record++;
+    ManifestPackage **candidates = &manifest->by_name[range->first];
+    VersionSpec *spec = version_spec_init(name, op, version_str);
+    size_t span[2][2];
+    if (spec == NULL) {
+        free(list);
+        return NULL;
+    }
+    version_spec_spans(spec, candidates, count, span);
+    version_spec_free(spec);
+
+    for (size_t s = 0; s < 2; s++) {
+        for (size_t i = span[s][0]; i < span[s][1]; i++) {
+            list[record] = manifest_package_copy(candidates[i]);
+            if (!list[record]) {
+                perror("Unable to allocate memory for manifest record");
+                fprintf(SYSERROR);
+                return NULL;
             }
+            record++;
         }
     }
-    qsort(list, record, sizeof(ManifestPackage *), _find_by_spec_compare);
 
     return list;
 }
 
+/**
+ * Find the highest version that satisfies a compiled specification
+ * @param spec `VersionSpec`
+ * @param candidates packages sorted by version
+ * @param count number of candidates
+ * @return offset of the match in `candidates`, or -1 when nothing matches
+ */
+ssize_t version_spec_best(const VersionSpec *spec, ManifestPackage **candidates, size_t count) {
+    size_t span[2][2];
+    version_spec_spans(spec, candidates, count, span);
+    for (ssize_t s = 1; s >= 0; s--) {
+        if (span[s][1] > span[s][0]) {
+            return (ssize_t) span[s][1] - 1;
+        }
+    }
+    return -1;
+}
+
 static void get_name(char **buf, const char *_str) {
     char *str = strdup(_str);
     int has_relational = 0;
@@ -317,51 +664,57 @@ static char *get_operators(char **op, const char *_strspec) {
     return pos;
 }
 
-ManifestPackage *find_by_strspec(const Manifest *manifest, const char *_strspec) {
+/**
+ * Split a package specification into its name, operator(s) and version
+ *
+ * A specification without an operator selects every version (`name>=0`).
+ *
+ * @param strspec package specification (`zlib`, `zlib>=1.2`, or an archive name)
+ * @param name destination for the package name (`NAME_MAX` bytes)
+ * @param op destination for the operator(s) (`NAME_MAX` bytes)
+ * @param version destination for the version, empty when there is none (`NAME_MAX` bytes)
+ */
+void strspec_parse(const char *strspec, char *name, char *op, char *version) {
+    char *spec = strdup(strspec);
     char *pos = NULL;
-    char s_op[NAME_MAX];
-    char s_name[NAME_MAX];
-    char s_version[NAME_MAX];
-    char *op = s_op;
-    char *name = s_name;
-    char *version = s_version;
-    char *strspec = strdup(_strspec);
-    ManifestPackage **m = NULL;
-    ManifestPackage *selected = NULL;
 
     memset(op, '\0', NAME_MAX);
     memset(name, '\0', NAME_MAX);
     memset(version, '\0', NAME_MAX);
 
     // Parse package name
-    get_name(&name, strspec);
+    get_name(&name, spec);
     // Get the starting address of any operator(s) (>, <, =, etc)
-    pos = get_operators(&op, strspec);
+    pos = get_operators(&op, spec);
 
-    // No operator(s) found
     if (pos == NULL) {
-        // Try `name >= 0`
-        m = find_by_spec(manifest, name, ">=", NULL);
-    }
-
-    // When `m` is still NULL after applying the default operator
-    if (m == NULL) {
+        strcpy(op, ">=");
+    } else {
         // Parse the version string if it's there
         for (size_t i = 0; *(pos + i) != '\0'; i++) {
             version[i] = *(pos + i);
         }
-        // Try `name op version`
-        m = find_by_spec(manifest, name, op, version);
+    }
+    free(spec);
+}
+
+ManifestPackage *find_by_strspec(const Manifest *manifest, const char *_strspec) {
+    VersionSpec *spec = version_spec_compile(_strspec);
+    const ManifestRange *range = NULL;
+    ManifestPackage *selected = NULL;
+
+    if (spec == NULL) {
+        return NULL;
     }
 
-    // Select the highest priority package
-    if (m != NULL) {
-        // (m[0] == default manifest, m[>0] == user-defined manifest)
-        for (size_t i = 0; m[i] != NULL; i++) {
-            selected = m[i];
+    // Select the highest matching version
+    if ((range = manifest_name_range(manifest, spec->name)) != NULL) {
+        ssize_t best = version_spec_best(spec, &manifest->by_name[range->first], range->count);
+        if (best >= 0) {
+            selected = manifest_package_copy(manifest->by_name[range->first + best]);
         }
     }
 
-    free(strspec);
+    version_spec_free(spec);
     return selected;  // or NULL
 }
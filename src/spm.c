@@ -10,22 +10,28 @@ int RUNTIME_INSTALL = 0;
 int RUNTIME_ROOTDIR = 0;
 int RUNTIME_LIST = 0;
 int RUNTIME_SEARCH = 0;
+int RUNTIME_REINDEX = 0;
 char *program_name = NULL;
 
 void usage(void) {
-    printf("usage: %s [-hVvBIRrmMLS]\n"
+    printf("usage: %s [-hVvjBIRrmMLS]\n"
            "  -h,  --help                show this help message\n"
            "  -V,  --version             show version\n"
            "  -v,  --verbose             show more information (additive)\n"
            "  -y   --yes                 do not prompt\n"
+           "  -j,  --jobs                number of worker threads (0 = all processors)\n"
            "  -B,  --build               build package(s)\n"
            "  -I,  --install             install package(s)\n"
+           "       --solve               resolve version conflicts across all requirements (requires --install)\n"
+           "       --lock                write the resolved package(s) to a lock file instead of installing (requires --install)\n"
+           "       --from-lock           install the package(s) recorded in a lock file\n"
            "  -R   --remove              remove package(s)\n"
            "  -r,  --root                installation prefix (requires --install)\n"
            "  -m   --manifest            specify a package manifest to use\n"
            "  -M   --override-manifests  disable default package manifest location\n"
            "  -L,  --list                list available packages\n"
            "  -S,  --search              search for a package\n"
+           "       --reindex             regenerate the local package manifest\n"
            "       --cmd                 execute an internal spm command\n"
            , program_name);
 }
@@ -58,6 +64,8 @@ int main(int argc, char *argv[], char *arge[]) {
     StrList *packages = strlist_init();
     ManifestList *mf = NULL;
     char package_search_str[PATH_MAX];
+    char *lock_file = NULL;
+    char *from_lock_file = NULL;
     int override_manifests = 0;
 
     memset(rootdir, '\0', PATH_MAX);
@@ -104,11 +112,34 @@ int main(int argc, char *argv[], char *arge[]) {
                 manifestlist_append(mf, target);
                 i++;
             }
+            else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) {
+                if (arg_next == NULL || isdigit_s(arg_next) == 0) {
+                    fprintf(stderr, "-j|--jobs requires a number\n");
+                    usage();
+                    exit(1);
+                }
+                SPM_GLOBAL.jobs = (int) strtol(arg_next, NULL, 10);
+                i++;
+            }
+            else if (strcmp(arg, "--solve") == 0) {
+                SPM_GLOBAL.solve = 1;
+            }
+            else if (strcmp(arg, "--lock") == 0 || strcmp(arg, "--from-lock") == 0) {
+                if (arg_next == NULL) {
+                    fprintf(stderr, "%s requires a file name\n", arg);
+                    usage();
+                    exit(1);
+                }
+                if (strcmp(arg, "--lock") == 0) {
+                    lock_file = arg_next;
+                } else {
+                    from_lock_file = arg_next;
+                    RUNTIME_INSTALL = 1;
+                }
+                i++;
+            }
             else if (strcmp(arg, "--reindex") == 0) {
-                Manifest *info = manifest_from(SPM_GLOBAL.package_dir);
-                manifest_write(info, SPM_GLOBAL.package_manifest);
-                manifest_free(info);
-                exit(0);
+                RUNTIME_REINDEX = 1;
             }
             else if (strcmp(arg, "--cmd") == 0) {
                 int c = argc - i;
@@ -215,8 +246,16 @@ int main(int argc, char *argv[], char *arge[]) {
         spm_die();
     }
 
+    if (RUNTIME_REINDEX) {
+        Manifest *info = manifest_from(SPM_GLOBAL.package_dir);
+        manifest_write(info, SPM_GLOBAL.package_manifest);
+        manifest_free(info);
+        exit(0);
+    }
+
     // Apply some default manifest locations; unless the user passes -M|--override-manifests
-    if (override_manifests == 0) {
+    // (a lock file does not need them)
+    if (override_manifests == 0 && from_lock_file == NULL) {
         char *target;
         // Remote package manifests have priority over the local package store
         target = join((char *[]) {"https://astroconda.org/spm", SPM_GLOBAL.repo_target, NULL}, DIRSEPS);
@@ -232,6 +271,22 @@ int main(int argc, char *argv[], char *arge[]) {
         show_global_config();
     }
 
+    if (lock_file != NULL && (!RUNTIME_INSTALL || from_lock_file != NULL)) {
+        fprintf(stderr, "--lock requires -I|--install\n");
+        usage();
+        exit(1);
+    }
+
+    if (lock_file != NULL) {
+        if (spm_do_lock(mf, packages, lock_file) < 0) {
+            if (spmerrno) {
+                spm_perror("Failed with reason");
+            }
+            exit(1);
+        }
+        exit(0);
+    }
+
     if (!RUNTIME_ROOTDIR && RUNTIME_INSTALL) {
         fprintf(stderr, "-r|--root requires -I|--install\n");
         usage();
@@ -281,7 +336,12 @@ int main(int argc, char *argv[], char *arge[]) {
 
     if (RUNTIME_INSTALL) {
         int status_install = 0;
-        if ((status_install = spm_do_install(rootfs, mf, packages)) == -1) {
+        if (from_lock_file != NULL) {
+            status_install = spm_do_install_lock(rootfs, from_lock_file);
+        } else {
+            status_install = spm_do_install(rootfs, mf, packages);
+        }
+        if (status_install == -1) {
             // general failure
             if (spmerrno) {
                 spm_perror("Failed with reason");
@@ -126,6 +126,73 @@ char *mock_size(size_t size, const char *fill_byte) {
     return strdup(filename);
 }
 
+/**
+ * Append a package record to a `Manifest`
+ *
+ * The archive is named `name-version-revision` + SPM_PACKAGE_EXTENSION. Other members (size, checksum, origin) can be
+ * set on the returned record.
+ *
+ * @param info `Manifest` receiving the record
+ * @param name package name
+ * @param version package version
+ * @param revision package revision
+ * @param requirements space separated requirement specifications (NULL or "" = none)
+ * @return record (owned by `info`)
+ */
+ManifestPackage *mock_package(Manifest *info, const char *name, const char *version, const char *revision, const char *requirements) {
+    char archive[PATH_MAX];
+    char *data = strdup(requirements ? requirements : "");
+    char **parts = split(data, " ");
+    size_t count = 0;
+    ManifestPackage *package = manifest_package_init(info);
+
+    sprintf(archive, "%s-%s-%s%s", name, version, revision, SPM_PACKAGE_EXTENSION);
+    package->archive = manifest_intern(info, archive);
+    package->name = manifest_intern(info, name);
+    manifest_package_set_version(info, package, version);
+    package->revision = manifest_intern(info, revision);
+    for (count = 0; parts[count] != NULL && *parts[count] != '\0'; count++);
+    manifest_package_set_requirements(info, package, parts, count);
+    split_free(parts);
+    free(data);
+
+    info->packages = realloc(info->packages, (info->records + 2) * sizeof(ManifestPackage *));
+    info->packages[info->records++] = package;
+    info->packages[info->records] = NULL;
+    return package;
+}
+
+/**
+ * Append a `Manifest` to a `ManifestList`
+ * @param list `ManifestList` receiving `info`
+ * @param info `Manifest` (owned by `list`)
+ * @return `list`
+ */
+ManifestList *mock_manifestlist_append(ManifestList *list, Manifest *info) {
+    list->data = realloc(list->data, (list->num_inuse + 1) * sizeof(Manifest *));
+    list->data[list->num_inuse++] = info;
+    list->num_alloc = list->num_inuse;
+    return list;
+}
+
+/**
+ * Describe an installation order as "name-version name-version ..."
+ * @param order NULL terminated array of records
+ * @return string (caller must free)
+ */
+char *mock_order_str(ManifestPackage **order) {
+    char *result = calloc(BUFSIZ, sizeof(char));
+    for (size_t i = 0; order[i] != NULL; i++) {
+        if (i) {
+            strcat(result, " ");
+        }
+        strcat(result, order[i]->name);
+        strcat(result, "-");
+        strcat(result, order[i]->version);
+    }
+    return result;
+}
+
 #define AS_MOCK_LIB 0
 #define AS_MOCK_BIN 1
 /**
@@ -0,0 +1,163 @@
+/**
+ * @file mock_http.c
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+#include "mock_http.h"
+
+/**
+ * Serve canned HTTP responses on a local port from a child process
+ *
+ * The first response matching the path (and header) of a request is sent. Other requests get "404 Not Found". Every
+ * request (request line and headers) is appended to `log`, so tests can count requests with `mock_http_count`.
+ *
+ * ~~~{.c}
+ * struct MockHttpResponse responses[] = {
+ *     {"/file", "If-None-Match: \"v1\"", "304 Not Modified", "ETag: \"v1\"\r\n", NULL},
+ *     {"/file", NULL, "200 OK", "ETag: \"v1\"\r\n", "data"},
+ *     {NULL},
+ * };
+ * int port = 0;
+ * pid_t server = mock_http_server(responses, "http.log", &port);
+ * // fetch http://127.0.0.1:<port>/file
+ * mock_http_stop(server);
+ * ~~~
+ *
+ * @param responses array terminated by an element with a NULL `path`
+ * @param log file receiving the requests (truncated)
+ * @param port where to store the port number
+ * @return process id of the server
+ */
+pid_t mock_http_server(const struct MockHttpResponse *responses, const char *log, int *port) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock = -1;
+    pid_t pid = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0
+        || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0
+        || listen(sock, 16) < 0
+        || getsockname(sock, (struct sockaddr *) &addr, &addr_len) < 0) {
+        perror("mock_http_server");
+        exit(errno);
+    }
+    *port = ntohs(addr.sin_port);
+    FILE *fp = fopen(log, "w");
+    if (fp == NULL) {
+        perror(log);
+        exit(errno);
+    }
+    fclose(fp);
+
+    fflush(stdout);
+    fflush(stderr);
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        exit(errno);
+    } else if (pid > 0) {
+        close(sock);
+        return pid;
+    }
+
+    // Do not outlive a test that gave up early
+#if defined(__linux__)
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    alarm(60);
+
+    while (1) {
+        char request[BUFSIZ];
+        size_t len = 0;
+        ssize_t bytes = 0;
+        const struct MockHttpResponse *response = NULL;
+        int client = accept(sock, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // Read the request line and headers
+        request[0] = '\0';
+        while (len < sizeof(request) - 1 && strstr(request, "\r\n\r\n") == NULL
+               && (bytes = read(client, &request[len], sizeof(request) - 1 - len)) > 0) {
+            len += (size_t) bytes;
+            request[len] = '\0';
+        }
+
+        int fd = open(log, O_WRONLY | O_APPEND);
+        if (fd >= 0) {
+            write(fd, request, len);
+            close(fd);
+        }
+
+        // "GET /path HTTP/1.1"
+        char *path = strchr(request, ' ');
+        char *path_end = path ? strchr(++path, ' ') : NULL;
+        for (size_t i = 0; path_end != NULL && responses[i].path != NULL; i++) {
+            if (strlen(responses[i].path) == (size_t) (path_end - path)
+                && strncmp(path, responses[i].path, path_end - path) == 0
+                && (responses[i].header == NULL || strstr(request, responses[i].header) != NULL)) {
+                response = &responses[i];
+                break;
+            }
+        }
+
+        const char *status = response ? response->status : "404 Not Found";
+        const char *headers = response && response->headers ? response->headers : "";
+        const char *body = response && response->body ? response->body : "";
+        size_t reply_size = strlen(status) + strlen(headers) + strlen(body) + 128;
+        char *reply = malloc(reply_size);
+        len = (size_t) snprintf(reply, reply_size,
+                                "HTTP/1.1 %s\r\n%sContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                                status, headers, strlen(body), body);
+        for (size_t sent = 0; sent < len && (bytes = write(client, &reply[sent], len - sent)) > 0; sent += (size_t) bytes);
+        free(reply);
+        shutdown(client, SHUT_WR);
+        while (read(client, request, sizeof(request)) > 0);
+        close(client);
+    }
+}
+
+/**
+ * Stop a server started by `mock_http_server`
+ * @param pid process id of the server
+ */
+void mock_http_stop(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+/**
+ * Count the requests received by `mock_http_server` that contain a string
+ * @param log file passed to `mock_http_server`
+ * @param pattern string to find (i.e. "GET " counts every request)
+ * @return number of requests containing `pattern`
+ */
+size_t mock_http_count(const char *log, const char *pattern) {
+    char line[BUFSIZ];
+    size_t count = 0;
+    FILE *fp = fopen(log, "r");
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (strstr(line, pattern) != NULL) {
+            count++;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    return count;
+}
@@ -0,0 +1,26 @@
+/**
+ * Local HTTP server for tests that exercise remote transfers
+ *
+ * @file mock_http.h
+ */
+#ifndef SPM_MOCK_HTTP_H
+#define SPM_MOCK_HTTP_H
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Canned response of `mock_http_server`
+ */
+struct MockHttpResponse {
+    const char *path;       // request path
+    const char *header;     // request header line that selects this response (NULL=any request for `path`)
+    const char *status;     // i.e. "304 Not Modified"
+    const char *headers;    // extra response headers, each terminated by "\r\n" (NULL=none)
+    const char *body;       // (NULL=none)
+};
+
+pid_t mock_http_server(const struct MockHttpResponse *responses, const char *log, int *port);
+void mock_http_stop(pid_t pid);
+size_t mock_http_count(const char *log, const char *pattern);
+
+#endif //SPM_MOCK_HTTP_H
@@ -0,0 +1,67 @@
+#include "spm.h"
+#include "framework.h"
+
+#define PLAIN_FILE "test_compress_file.txt"
+#define LINES 100000
+
+const char *testFmt = "case %zu: '%s' line %zu returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.arg[0].signed_int = SPM_COMPRESS_GZIP},
+        {.arg[0].signed_int = SPM_COMPRESS_ZSTD},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    FILE *fp = fopen(PLAIN_FILE, "w+");
+    myassert(fp != NULL, "%s: %s\n", PLAIN_FILE, strerror(errno));
+    for (size_t i = 0; i < LINES; i++) {
+        fprintf(fp, "package%zu-1.0.%zu-0.tar.gz|%zu\n", i % 100, i, i);
+    }
+    fclose(fp);
+
+    for (size_t i = 0; i < numCases; i++) {
+        int format = testCase[i].arg[0].signed_int;
+        char *compressed = join_ex("", PLAIN_FILE, compress_extension(format), NULL);
+        char expected[255];
+        char *line = NULL;
+        size_t line_alloc = 0;
+        size_t lineno = 0;
+
+        if (!compress_supported(format)) {
+            myassert(compress_file(PLAIN_FILE, compressed, format) != 0, "case %zu: unsupported format accepted\n", i);
+            free(compressed);
+            continue;
+        }
+
+        myassert(compress_file(PLAIN_FILE, compressed, format) == 0, "case %zu: compress_file failed\n", i);
+        myassert(compress_detect(compressed) == format, "case %zu: format of '%s' not detected\n", i, compressed);
+        myassert(get_file_size(compressed) < get_file_size(PLAIN_FILE) / 4, "case %zu: '%s' is too large\n", i, compressed);
+
+        fp = compress_fopen(compressed);
+        myassert(fp != NULL, "case %zu: compress_fopen failed\n", i);
+        while (getline(&line, &line_alloc, fp) >= 0) {
+            sprintf(expected, "package%zu-1.0.%zu-0.tar.gz|%zu\n", lineno % 100, lineno, lineno);
+            myassert(strcmp(line, expected) == 0, testFmt, i, compressed, lineno, line, expected);
+            lineno++;
+        }
+        myassert(!ferror(fp), "case %zu: read error\n", i);
+        myassert(lineno == LINES, "case %zu: read %zu lines, expected %d\n", i, lineno, LINES);
+        fclose(fp);
+
+        // A damaged stream is reported as an error
+        truncate(compressed, get_file_size(compressed) / 2);
+        fp = compress_fopen(compressed);
+        myassert(fp != NULL, "case %zu: compress_fopen failed\n", i);
+        while (getline(&line, &line_alloc, fp) >= 0);
+        myassert(ferror(fp), "case %zu: truncated stream was accepted\n", i);
+        fclose(fp);
+
+        free(line);
+        unlink(compressed);
+        free(compressed);
+    }
+
+    myassert(compress_detect(PLAIN_FILE) == SPM_COMPRESS_NONE, "plain file was not detected\n");
+    unlink(PLAIN_FILE);
+    return 0;
+}
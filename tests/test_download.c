@@ -0,0 +1,122 @@
+#include "spm.h"
+#include "framework.h"
+
+#define FILES_MAX 24
+#define SOURCE_DIR "test_download_src"
+#define DEST_DIR "test_download_dest"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+
+static char *read_all(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    char *data = calloc(BUFSIZ, sizeof(char));
+    if (fp != NULL) {
+        fread(data, 1, BUFSIZ - 1, fp);
+        fclose(fp);
+    }
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    char cwd[PATH_MAX];
+    char url[PATH_MAX * 2];
+    char dest[PATH_MAX];
+    char expected[PATH_MAX];
+    DownloadManager *dm = NULL;
+
+    getcwd(cwd, sizeof(cwd));
+    mkdirs(SOURCE_DIR, 0755);
+    mkdirs(DEST_DIR, 0755);
+    for (size_t i = 0; i < FILES_MAX; i++) {
+        sprintf(dest, "%s/file%zu", SOURCE_DIR, i);
+        FILE *fp = fopen(dest, "w");
+        fprintf(fp, "data of file %zu\n", i);
+        fclose(fp);
+    }
+
+    // Every file is transferred, regardless of the concurrency limits
+    dm = download_init(5, 2);
+    myassert(dm != NULL, "download_init failed\n");
+    for (size_t i = 0; i < FILES_MAX; i++) {
+        snprintf(url, sizeof(url), "file://%s/%s/file%zu", cwd, SOURCE_DIR, i);
+        sprintf(dest, "%s/file%zu", DEST_DIR, i);
+        myassert(download_add(dm, url, dest, NULL) != NULL, "download_add failed\n");
+    }
+    // Queueing a destination twice does not transfer it twice
+    myassert(download_add(dm, url, dest, NULL) == download_item(dm, FILES_MAX - 1), "duplicate destination was queued\n");
+    myassert(download_count(dm) == FILES_MAX, "expected %d downloads, got %zu\n", FILES_MAX, download_count(dm));
+    myassert(download_find(dm, dest) == download_item(dm, FILES_MAX - 1), "download_find failed\n");
+    myassert(download_find(dm, "nothere") == NULL, "download_find found a file that was not queued\n");
+
+    myassert(download_run(dm) == 0, "download_run failed\n");
+    for (size_t i = 0; i < FILES_MAX; i++) {
+        Download *item = download_item(dm, i);
+        myassert(item->status == 0, "case %zu: %s failed: %s\n", i, item->url, item->error);
+        myassert(strcmp(item->host, "file://") == 0, testFmt, i, "host", item->host, "file://");
+
+        char *checksum = sha256sum(item->dest);
+        myassert(strcmp(item->checksum, checksum) == 0, testFmt, i, "checksum", item->checksum, checksum);
+        free(checksum);
+
+        char *result = read_all(item->dest);
+        sprintf(expected, "data of file %zu\n", i);
+        myassert(strcmp(result, expected) == 0, testFmt, i, item->dest, result, expected);
+        free(result);
+
+        sprintf(dest, "%s%s", item->dest, SPM_DOWNLOAD_PART_EXT);
+        myassert(exists(dest) != 0, "case %zu: partial file was left behind\n", i);
+    }
+    download_free(dm);
+
+    // A failed transfer is reported and leaves nothing behind
+    dm = download_init(0, 0);
+    snprintf(url, sizeof(url), "file://%s/%s/file0", cwd, SOURCE_DIR);
+    download_add(dm, url, DEST_DIR "/good", NULL);
+    snprintf(url, sizeof(url), "file://%s/%s/missing", cwd, SOURCE_DIR);
+    Download *missing = download_add(dm, url, DEST_DIR "/missing", NULL);
+    myassert(download_run(dm) == 1, "expected one failed transfer\n");
+    myassert(download_item(dm, 0)->status == 0, "good transfer failed: %s\n", download_item(dm, 0)->error);
+    myassert(missing->status < 0, "missing file was downloaded\n");
+    myassert(!isempty(missing->error), "no error was reported\n");
+    myassert(exists(DEST_DIR "/missing") != 0, "missing file exists\n");
+    myassert(exists(DEST_DIR "/missing" SPM_DOWNLOAD_PART_EXT) != 0, "partial file was left behind\n");
+    download_free(dm);
+
+    // Files are verified as they are written, and only a file matching its checksum is kept
+    char *checksum = sha256sum(SOURCE_DIR "/file1");
+    dm = download_init(0, 0);
+    snprintf(url, sizeof(url), "file://%s/%s/file1", cwd, SOURCE_DIR);
+    Download *verified = download_add(dm, url, DEST_DIR "/verified", checksum);
+    snprintf(url, sizeof(url), "file://%s/%s/file2", cwd, SOURCE_DIR);
+    Download *tampered = download_add(dm, url, DEST_DIR "/tampered", checksum);
+    myassert(download_run(dm) == 1, "expected one checksum mismatch\n");
+    myassert(verified->status == 0, "verified transfer failed: %s\n", verified->error);
+    myassert(exists(DEST_DIR "/verified") == 0, "verified file is missing\n");
+    myassert(tampered->status < 0, "tampered file was accepted\n");
+    myassert(strstr(tampered->error, "checksum mismatch") != NULL, "unexpected error: %s\n", tampered->error);
+    myassert(exists(DEST_DIR "/tampered") != 0, "tampered file was kept\n");
+    myassert(exists(DEST_DIR "/tampered" SPM_DOWNLOAD_PART_EXT) != 0, "partial file was left behind\n");
+    download_free(dm);
+
+    // fetch() verifies the same way
+    snprintf(url, sizeof(url), "file://%s/%s/file1", cwd, SOURCE_DIR);
+    myassert(fetch_sha256(url, DEST_DIR "/fetched", checksum) == 0, "fetch_sha256 failed\n");
+    myassert(exists(DEST_DIR "/fetched") == 0, "fetched file is missing\n");
+    snprintf(url, sizeof(url), "file://%s/%s/file2", cwd, SOURCE_DIR);
+    myassert(fetch_sha256(url, DEST_DIR "/fetched_tampered", checksum) < 0, "fetch_sha256 accepted a tampered file\n");
+    myassert(spmerrno == SPM_ERR_PKG_CHECKSUM, "spmerrno was not set\n");
+    myassert(exists(DEST_DIR "/fetched_tampered") != 0, "tampered file was kept\n");
+    myassert(exists(DEST_DIR "/fetched_tampered" SPM_DOWNLOAD_PART_EXT) != 0, "partial file was left behind\n");
+    spmerrno = 0;
+    free(checksum);
+
+    // The host is the scheme and authority of the URL
+    dm = download_init(1, 1);
+    Download *item = download_add(dm, "https://user@example.com:8443/spm/Linux?x=1", DEST_DIR "/unused", NULL);
+    myassert(strcmp(item->host, "https://user@example.com:8443") == 0, testFmt, (size_t) 0, "host", item->host, "https://user@example.com:8443");
+    download_free(dm);
+
+    rmdirs(SOURCE_DIR);
+    rmdirs(DEST_DIR);
+    return 0;
+}
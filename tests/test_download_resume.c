@@ -0,0 +1,168 @@
+#include <curl/curl.h>
+#include "spm.h"
+#include "framework.h"
+#include "mock_http.h"
+
+#define SOURCE_DIR "test_download_resume_src"
+#define DEST_DIR "test_download_resume_dest"
+#define SOURCE_SIZE (BUFSIZ * 8)
+#define HTTP_LOG "test_download_resume.log"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "valid prefix", .arg[0].unsigned_long = 1, .arg[1].unsigned_long = SOURCE_SIZE / 3},
+        {.caseValue.sptr = "stale prefix", .arg[0].unsigned_long = 0, .arg[1].unsigned_long = SOURCE_SIZE / 3},
+        {.caseValue.sptr = "complete prefix", .arg[0].unsigned_long = 1, .arg[1].unsigned_long = SOURCE_SIZE},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static void write_part(const char *partfile, const char *data, size_t size, int valid) {
+    FILE *fp = fopen(partfile, "wb");
+    for (size_t i = 0; i < size; i++) {
+        fputc(valid ? data[i] : '?', fp);
+    }
+    fclose(fp);
+}
+
+static int same_file(const char *a, const char *b) {
+    char *sum_a = sha256sum(a);
+    char *sum_b = sha256sum(b);
+    int result = sum_a != NULL && sum_b != NULL && strcmp(sum_a, sum_b) == 0;
+    free(sum_a);
+    free(sum_b);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    char cwd[PATH_MAX];
+    char url[PATH_MAX * 2];
+    char dest[PATH_MAX];
+    char partfile[PATH_MAX + sizeof(SPM_DOWNLOAD_PART_EXT)];
+    char *data = calloc(SOURCE_SIZE + 1, sizeof(char));
+    char *checksum = NULL;
+
+    getcwd(cwd, sizeof(cwd));
+    mkdirs(SOURCE_DIR, 0755);
+    mkdirs(DEST_DIR, 0755);
+    for (size_t i = 0; i < SOURCE_SIZE; i++) {
+        data[i] = (char) ('a' + (i * 7) % 26);
+    }
+    FILE *fp = fopen(SOURCE_DIR "/archive", "wb");
+    fwrite(data, 1, SOURCE_SIZE, fp);
+    fclose(fp);
+    checksum = sha256sum(SOURCE_DIR "/archive");
+    snprintf(url, sizeof(url), "file://%s/%s/archive", cwd, SOURCE_DIR);
+
+    // A verified download continues from the partial file, or starts over when its contents turn out to be stale
+    for (size_t i = 0; i < numCases; i++) {
+        int valid = (int) testCase[i].arg[0].unsigned_long;
+        size_t prefix = testCase[i].arg[1].unsigned_long;
+
+        snprintf(dest, sizeof(dest), "%s/archive%zu", DEST_DIR, i);
+        snprintf(partfile, sizeof(partfile), "%s%s", dest, SPM_DOWNLOAD_PART_EXT);
+        write_part(partfile, data, prefix, valid);
+
+        DownloadManager *dm = download_init(0, 0);
+        Download *item = download_add(dm, url, dest, checksum);
+        myassert(download_run(dm) == 0, "case %zu: %s: download failed: %s\n", i, testCase[i].caseValue.sptr, item->error);
+        myassert(same_file(dest, SOURCE_DIR "/archive"), "case %zu: %s: file differs\n", i, testCase[i].caseValue.sptr);
+        myassert(strcmp(item->checksum, checksum) == 0, testFmt, i, testCase[i].caseValue.sptr, item->checksum, checksum);
+        myassert(exists(partfile) != 0, "case %zu: partial file was left behind\n", i);
+        if (valid) {
+            myassert(item->attempts == 1, "case %zu: %s: expected 1 attempt, got %zu\n", i, testCase[i].caseValue.sptr, item->attempts);
+            myassert(item->resumed == prefix, "case %zu: %s: resumed from %zu, expected %zu\n", i, testCase[i].caseValue.sptr, (size_t) item->resumed, prefix);
+        } else {
+            myassert(item->attempts == 2, "case %zu: %s: expected 2 attempts, got %zu\n", i, testCase[i].caseValue.sptr, item->attempts);
+            myassert(item->resumed == 0, "case %zu: %s: the last attempt resumed stale data\n", i, testCase[i].caseValue.sptr);
+        }
+        download_free(dm);
+
+        // fetch() behaves the same way
+        unlink(dest);
+        write_part(partfile, data, prefix, valid);
+        myassert(fetch_sha256(url, dest, checksum) == 0, "case %zu: %s: fetch_sha256 failed\n", i, testCase[i].caseValue.sptr);
+        myassert(same_file(dest, SOURCE_DIR "/archive"), "case %zu: %s: fetched file differs\n", i, testCase[i].caseValue.sptr);
+        myassert(exists(partfile) != 0, "case %zu: partial file was left behind\n", i);
+        spmerrno = 0;
+    }
+
+    // Over HTTP, a file that changed since the partial download is sent in full by the same request
+    char content_range[BUFSIZ];
+    int port = 0;
+    snprintf(content_range, sizeof(content_range), "Content-Range: bytes %d-%d/%d\r\nETag: \"v1\"\r\n",
+             SOURCE_SIZE / 2, SOURCE_SIZE - 1, SOURCE_SIZE);
+    struct MockHttpResponse responses[] = {
+            {"/archive", "If-Range: \"v1\"", "206 Partial Content", content_range, &data[SOURCE_SIZE / 2]},
+            {"/archive", NULL, "200 OK", "ETag: \"v1\"\r\n", data},
+            {NULL},
+    };
+    pid_t server = mock_http_server(responses, HTTP_LOG, &port);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/archive", port);
+    const char *validators[] = {"\"v1\"", "\"v0\""};
+    for (size_t i = 0; i < sizeof(validators) / sizeof(*validators); i++) {
+        size_t resumed = i == 0 ? SOURCE_SIZE / 2 : 0;
+        size_t requests = mock_http_count(HTTP_LOG, "GET ");
+
+        snprintf(dest, sizeof(dest), "%s/http%zu", DEST_DIR, i);
+        snprintf(partfile, sizeof(partfile), "%s%s", dest, SPM_DOWNLOAD_PART_EXT);
+        write_part(partfile, data, SOURCE_SIZE / 2, 1);
+        download_part_save(partfile, validators[i]);
+
+        DownloadManager *dm = download_init(0, 0);
+        Download *item = download_add(dm, url, dest, checksum);
+        myassert(download_run(dm) == 0, "http case %zu: download failed: %s\n", i, item->error);
+        myassert(same_file(dest, SOURCE_DIR "/archive"), "http case %zu: file differs\n", i);
+        myassert(item->resumed == resumed, "http case %zu: resumed from %zu, expected %zu\n", i, (size_t) item->resumed, resumed);
+        myassert(mock_http_count(HTTP_LOG, "GET ") == requests + 1, "http case %zu: expected one request\n", i);
+        download_free(dm);
+
+        unlink(dest);
+        write_part(partfile, data, SOURCE_SIZE / 2, 1);
+        download_part_save(partfile, validators[i]);
+        myassert(fetch_sha256(url, dest, checksum) == 0, "http case %zu: fetch_sha256 failed\n", i);
+        myassert(same_file(dest, SOURCE_DIR "/archive"), "http case %zu: fetched file differs\n", i);
+        myassert(mock_http_count(HTTP_LOG, "GET ") == requests + 2, "http case %zu: fetch_sha256 expected one request\n", i);
+    }
+    mock_http_stop(server);
+    unlink(HTTP_LOG);
+    snprintf(url, sizeof(url), "file://%s/%s/archive", cwd, SOURCE_DIR);
+
+    // Without a validator or a checksum nothing proves the partial file belongs to the same file, so it is discarded
+    snprintf(dest, sizeof(dest), "%s/unverified", DEST_DIR);
+    snprintf(partfile, sizeof(partfile), "%s%s", dest, SPM_DOWNLOAD_PART_EXT);
+    write_part(partfile, data, SOURCE_SIZE / 2, 0);
+    DownloadManager *dm = download_init(0, 0);
+    Download *item = download_add(dm, url, dest, NULL);
+    myassert(download_run(dm) == 0, "unverified download failed: %s\n", item->error);
+    myassert(item->resumed == 0, "resumed a partial file that cannot be validated\n");
+    myassert(same_file(dest, SOURCE_DIR "/archive"), "unverified file differs\n");
+    download_free(dm);
+
+    // A saved validator allows resuming an unverified download
+    unlink(dest);
+    write_part(partfile, data, SOURCE_SIZE / 2, 1);
+    myassert(download_part_save(partfile, "\"etag\"") == 0, "download_part_save failed\n");
+    EVP_MD_CTX *context = EVP_MD_CTX_new();
+    char *validator = NULL;
+    EVP_DigestInit_ex(context, EVP_sha256(), NULL);
+    myassert(download_part_resume(partfile, 0, &validator, context) == SOURCE_SIZE / 2, "partial file was not resumed\n");
+    EVP_MD_CTX_free(context);
+    myassert(validator != NULL && strcmp(validator, "\"etag\"") == 0, "validator was not read back\n");
+    free(validator);
+    download_part_remove(partfile);
+    myassert(exists(partfile) != 0, "download_part_remove left the partial file\n");
+
+    // Only transient errors are retried, with exponential backoff
+    myassert(download_retryable(CURLE_RECV_ERROR, 0), "receive errors are transient\n");
+    myassert(download_retryable(CURLE_HTTP_RETURNED_ERROR, 503), "HTTP 503 is transient\n");
+    myassert(!download_retryable(CURLE_HTTP_RETURNED_ERROR, 404), "HTTP 404 is not transient\n");
+    myassert(!download_retryable(CURLE_FILE_COULDNT_READ_FILE, 0), "a missing file is not transient\n");
+    myassert(download_backoff(1) == 1 && download_backoff(2) == 2 && download_backoff(3) == 4, "unexpected backoff\n");
+    myassert(download_backoff(100) == SPM_DOWNLOAD_BACKOFF_MAX, "backoff is not capped\n");
+
+    free(checksum);
+    free(data);
+    rmdirs(SOURCE_DIR);
+    rmdirs(DEST_DIR);
+    return 0;
+}
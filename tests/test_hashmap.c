@@ -0,0 +1,42 @@
+#include "spm.h"
+#include "framework.h"
+
+#define KEYS 5000
+
+const char *testFmt = "key '%s': returned '%s', expected '%s'\n";
+
+int main(int argc, char *argv[]) {
+    Arena *arena = arena_init(0);
+    HashMap *map = hashmap_init(0);
+    char key[255];
+
+    // Enough keys to force the table to grow several times
+    for (size_t i = 0; i < KEYS; i++) {
+        sprintf(key, "key%zu", i);
+        char *stored = arena_strdup(arena, key);
+        myassert(stored != NULL, "arena_strdup failed on '%s'\n", key);
+        myassert(hashmap_put(map, stored, stored) == 0, "hashmap_put failed on '%s'\n", key);
+    }
+    myassert(hashmap_count(map) == KEYS, "returned %zu keys, expected %d\n", hashmap_count(map), KEYS);
+
+    for (size_t i = 0; i < KEYS; i++) {
+        sprintf(key, "key%zu", i);
+        char *value = hashmap_get(map, key);
+        myassert(value != NULL && strcmp(value, key) == 0, testFmt, key, value, key);
+    }
+    myassert(hashmap_get(map, "missing") == NULL, "found a key that was never stored\n");
+
+    // Replacing a value does not add a key
+    hashmap_put(map, "key0", "replaced");
+    myassert(hashmap_count(map) == KEYS, "returned %zu keys after replace, expected %d\n", hashmap_count(map), KEYS);
+    myassert(strcmp(hashmap_get(map, "key0"), "replaced") == 0, testFmt, "key0", (char *) hashmap_get(map, "key0"), "replaced");
+
+    // Oversized allocations are still usable
+    char *big = arena_alloc(arena, SPM_ARENA_BLOCK_SIZE * 2);
+    myassert(big != NULL, "arena_alloc failed on an oversized allocation\n");
+    memset(big, 'x', SPM_ARENA_BLOCK_SIZE * 2);
+
+    hashmap_free(map);
+    arena_free(arena);
+    return 0;
+}
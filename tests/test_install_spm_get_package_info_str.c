@@ -0,0 +1,44 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "%n", .arg[0].sptr = "zlib"},
+        {.caseValue.sptr = "%V", .arg[0].sptr = "1.2.12-0"},
+        {.caseValue.sptr = "%-6n|", .arg[0].sptr = "zlib  |"},
+        {.caseValue.sptr = "%6n|", .arg[0].sptr = "  zlib|"},
+        {.caseValue.sptr = "%4n|", .arg[0].sptr = "zlib|"},
+        {.caseValue.sptr = "%s %S", .arg[0].sptr = "2048 2.00K"},
+        {.caseValue.sptr = "[%x]", .arg[0].sptr = "[]"},
+        {.caseValue.sptr = "%a", .arg[0].sptr = "zlib-1.2.12-0" SPM_PACKAGE_EXTENSION},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    Manifest *info = manifest_init();
+    ManifestPackage *package = mock_package(info, "zlib", "1.2.12", "0", NULL);
+    char *result = NULL;
+
+    package->size = 2048;
+
+    for (size_t i = 0; i < numCases; i++) {
+        result = spm_get_package_info_str(package, testCase[i].caseValue.sptr);
+        myassert(result != NULL && strcmp(result, testCase[i].arg[0].sptr) == 0, testFmt, i,
+                 testCase[i].caseValue.sptr, result, testCase[i].arg[0].sptr);
+        free(result);
+    }
+
+    // Package strings are not length bounded
+    char *origin = calloc(PATH_MAX * 4, sizeof(char));
+    memset(origin, 'o', PATH_MAX * 4 - 1);
+    package->origin = manifest_intern(info, origin);
+    result = spm_get_package_info_str(package, "%-20n %-10V %8S %4o");
+    myassert(result != NULL && strlen(result) == 20 + 1 + 10 + 1 + 8 + 1 + strlen(origin) + 4,
+             "long origin was not formatted correctly\n");
+    myassert(strstr(result, origin) != NULL, "origin is missing from '%s'\n", result);
+    free(result);
+    free(origin);
+
+    manifest_free(info);
+    return 0;
+}
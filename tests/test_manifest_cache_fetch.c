@@ -0,0 +1,106 @@
+#include "spm.h"
+#include "framework.h"
+#include "mock_http.h"
+
+#define CACHE_DIR "test_manifest_cache_fetch.d"
+#define SOURCE_FILE CACHE_DIR DIRSEPS "manifest.dat"
+#define HTTP_LOG CACHE_DIR DIRSEPS "http.log"
+
+const char *data = SPM_MANIFEST_HEADER "\n";
+
+struct MockHttpResponse responses[] = {
+        {"/manifest.dat", "If-None-Match: \"v1\"", "304 Not Modified", "ETag: \"v1\"\r\n", NULL},
+        {"/manifest.dat", NULL, "200 OK", "ETag: \"v1\"\r\n", SPM_MANIFEST_HEADER "\n"},
+        {NULL},
+};
+
+int main(int argc, char *argv[]) {
+    char *source = NULL;
+    char *url = NULL;
+    char *missing = NULL;
+    char *path = NULL;
+    char *path_again = NULL;
+    char *meta = NULL;
+    int status = 0;
+
+    mkdirs(CACHE_DIR, 0755);
+    SPM_GLOBAL.user_config_basedir = realpath(CACHE_DIR, NULL);
+    mock(SOURCE_FILE, (void *) data, sizeof(char), strlen(data));
+    source = realpath(SOURCE_FILE, NULL);
+    url = join_ex("", "file://", source, NULL);
+    missing = join_ex("", "file://", source, ".missing", NULL);
+
+    // Entries are named after the URL
+    path = manifest_cache_path(url);
+    path_again = manifest_cache_path(url);
+    myassert(path != NULL && startswith(path, SPM_GLOBAL.user_config_basedir), "unexpected cache path: %s\n", path);
+    myassert(strcmp(path, path_again) == 0, "'%s' and '%s' should be the same entry\n", path, path_again);
+    free(path_again);
+    path_again = manifest_cache_path(missing);
+    myassert(strcmp(path, path_again) != 0, "different URLs share the entry '%s'\n", path);
+    free(path_again);
+    free(path);
+
+    // A download is stored with its validators
+    status = manifest_cache_fetch(url, &path);
+    myassert(status == 0 && path != NULL, "manifest_cache_fetch returned %d\n", status);
+    myassert(get_file_size(path) == (long) strlen(data), "cached copy of '%s' is damaged\n", url);
+    meta = join_ex("", path, ".meta", NULL);
+    myassert(exists(meta) == 0, "%s was not written\n", meta);
+
+    // A cached copy is used when the source disappears
+    unlink(source);
+    free(path);
+    status = manifest_cache_fetch(url, &path);
+    myassert(status == 0 && path != NULL, "cached copy was not used (%d)\n", status);
+    free(path);
+
+    // Failures are reported
+    status = manifest_cache_fetch(missing, &path);
+    myassert(status != 0 && path == NULL, "missing file was fetched\n");
+
+    // Revalidation over HTTP
+    int port = 0;
+    char http_url[PATH_MAX];
+    char http_missing[PATH_MAX];
+    pid_t server = mock_http_server(responses, HTTP_LOG, &port);
+    sprintf(http_url, "http://127.0.0.1:%d/manifest.dat", port);
+    sprintf(http_missing, "http://127.0.0.1:%d/manifest.missing", port);
+
+    status = manifest_cache_fetch(http_url, &path);
+    myassert(status == 0 && path != NULL, "manifest_cache_fetch returned %d\n", status);
+    myassert(mock_http_count(HTTP_LOG, "GET ") == 1, "expected 1 request\n");
+    free(path);
+
+    // "304 Not Modified" reuses the cached copy
+    status = manifest_cache_fetch(http_url, &path);
+    myassert(status == 0 && path != NULL, "cached copy was not reused after 304 (%d)\n", status);
+    myassert(get_file_size(path) == (long) strlen(data), "cached copy of '%s' is damaged\n", http_url);
+    myassert(mock_http_count(HTTP_LOG, "GET ") == 2, "expected 2 requests\n");
+    myassert(mock_http_count(HTTP_LOG, "If-None-Match: \"v1\"") == 1, "the request was not conditional\n");
+    free(path);
+
+    // Errors are cached
+    status = manifest_cache_fetch(http_missing, &path);
+    myassert(status == 404 && path == NULL, "expected 404, got %d\n", status);
+    myassert(mock_http_count(HTTP_LOG, "GET ") == 3, "expected 3 requests\n");
+
+    // Fresh entries do not contact the server
+    SPM_GLOBAL.manifest_ttl = 3600;
+    status = manifest_cache_fetch(http_url, &path);
+    myassert(status == 0 && path != NULL, "cached copy was not used within its TTL (%d)\n", status);
+    free(path);
+    status = manifest_cache_fetch(http_missing, &path);
+    myassert(status == 404 && path == NULL, "cached 404 was not used within its TTL (%d)\n", status);
+    myassert(mock_http_count(HTTP_LOG, "GET ") == 3, "the server was contacted within the TTL\n");
+    SPM_GLOBAL.manifest_ttl = 0;
+    mock_http_stop(server);
+
+    rmdirs(CACHE_DIR);
+    free(SPM_GLOBAL.user_config_basedir);
+    free(source);
+    free(url);
+    free(missing);
+    free(meta);
+    return 0;
+}
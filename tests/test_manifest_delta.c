@@ -0,0 +1,129 @@
+#include "spm.h"
+#include "framework.h"
+
+#define REPO_DIR "test_manifest_delta.d"
+
+struct TestCase previousCase[] = {
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "1.2.11", .arg[2].sptr = "0"},
+        {.arg[0].sptr = "openssl", .arg[1].sptr = "1.1.1", .arg[2].sptr = "0", .arg[3].sptr = "zlib>=1.2"},
+        {.arg[0].sptr = "python", .arg[1].sptr = "3.8.0", .arg[2].sptr = "0", .arg[3].sptr = "openssl zlib"},
+        {.arg[0].sptr = "sqlite", .arg[1].sptr = "3.31.1", .arg[2].sptr = "0"},
+};
+size_t numPreviousCases = sizeof(previousCase) / sizeof(struct TestCase);
+
+// zlib is rebuilt with new requirements, python is removed, and two packages are added
+struct TestCase currentCase[] = {
+        {.arg[0].sptr = "bzip2", .arg[1].sptr = "1.0.8", .arg[2].sptr = "0"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "1.2.11", .arg[2].sptr = "0", .arg[3].sptr = "bzip2"},
+        {.arg[0].sptr = "openssl", .arg[1].sptr = "1.1.1", .arg[2].sptr = "0", .arg[3].sptr = "zlib>=1.2"},
+        {.arg[0].sptr = "sqlite", .arg[1].sptr = "3.31.1", .arg[2].sptr = "0"},
+        {.arg[0].sptr = "python", .arg[1].sptr = "3.8.1", .arg[2].sptr = "0", .arg[3].sptr = "openssl zlib"},
+};
+size_t numCurrentCases = sizeof(currentCase) / sizeof(struct TestCase);
+
+static Manifest *manifest_mock(struct TestCase *cases, size_t count) {
+    Manifest *info = manifest_init();
+    for (size_t i = 0; i < count; i++) {
+        ManifestPackage *package = mock_package(info, cases[i].arg[0].sptr, cases[i].arg[1].sptr, cases[i].arg[2].sptr, cases[i].arg[3].sptr);
+        package->size = strlen(package->archive) * 1024;
+    }
+    return info;
+}
+
+static int manifest_compare(Manifest *a, Manifest *b) {
+    myassert(a->records == b->records, "returned %zu records, expected %zu\n", a->records, b->records);
+    for (size_t i = 0; i < a->records; i++) {
+        char *record_a = manifest_package_str(a->packages[i]);
+        char *record_b = manifest_package_str(b->packages[i]);
+        myassert(strcmp(record_a, record_b) == 0, "case %zu: returned '%s', expected '%s'\n", i, record_a, record_b);
+        free(record_a);
+        free(record_b);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    Manifest *previous = manifest_mock(previousCase, numPreviousCases);
+    Manifest *current = manifest_mock(currentCase, numCurrentCases);
+    Manifest *result = manifest_mock(previousCase, numPreviousCases);
+    FILE *fp = tmpfile();
+
+    myassert(manifest_delta_write(previous, current, 2, fp) == 0, "manifest_delta_write failed\n");
+
+    // The delta reproduces the new generation
+    rewind(fp);
+    myassert(manifest_delta_apply(result, fp, 2) == 0, "manifest_delta_apply failed\n");
+    myassert(manifest_compare(result, current) == 0, "delta did not reproduce the new generation\n");
+    ManifestPackage *found = manifest_search(result, "zlib");
+    myassert(found != NULL, "name index was not rebuilt\n");
+    free(found);
+
+    // Applying it again changes nothing
+    rewind(fp);
+    myassert(manifest_delta_apply(result, fp, 2) == 0, "manifest_delta_apply failed on second pass\n");
+    myassert(manifest_compare(result, current) == 0, "delta changed the manifest on second pass\n");
+
+    // The generation must match
+    rewind(fp);
+    myassert(manifest_delta_apply(result, fp, 3) < 0, "delta applied to the wrong generation\n");
+    fclose(fp);
+
+    // Identical manifests have no delta
+    fp = tmpfile();
+    myassert(manifest_delta_write(current, current, 3, fp) == 1, "identical manifests produced a delta\n");
+
+    // Reordered records cannot be expressed
+    ManifestPackage *swap = current->packages[2];
+    current->packages[2] = current->packages[3];
+    current->packages[3] = swap;
+    myassert(manifest_delta_write(previous, current, 3, fp) == 2, "reordered manifest produced a delta\n");
+    fclose(fp);
+    current->packages[3] = current->packages[2];
+    current->packages[2] = swap;
+
+    // A remote repository is read through its index, then kept up to date with deltas
+    char path_index[PATH_MAX];
+    char path_delta[PATH_MAX];
+    char *repo = NULL;
+    char *url = NULL;
+    mkdirs(REPO_DIR, 0755);
+    repo = realpath(REPO_DIR, NULL);
+    url = join_ex("", "file://", repo, NULL);
+    SPM_GLOBAL.user_config_basedir = repo;
+    sprintf(path_index, "%s%c%s", repo, DIRSEP, SPM_MANIFEST_INDEX_FILENAME);
+    sprintf(path_delta, "%s%c%s%d", repo, DIRSEP, SPM_MANIFEST_DELTA_PREFIX, 2);
+
+    myassert(manifest_delta_publish(repo, NULL, previous) == 0, "manifest_delta_publish failed\n");
+    myassert(previous->generation == 1, "published generation %zu, expected 1\n", previous->generation);
+    manifest_free(result);
+    result = manifest_read(url);
+    myassert(result != NULL && result->index != NULL, "the repository's index was not used\n");
+    myassert(result->generation == 1, "read generation %zu, expected 1\n", result->generation);
+    myassert(manifest_compare(result, previous) == 0, "index did not reproduce the manifest\n");
+
+    myassert(manifest_delta_publish(repo, previous, current) == 0, "manifest_delta_publish failed\n");
+    myassert(current->generation == 2, "published generation %zu, expected 2\n", current->generation);
+    myassert(exists(path_delta) == 0, "%s was not written\n", path_delta);
+    unlink(path_index);
+    manifest_free(result);
+    result = manifest_read(url);
+    myassert(result != NULL && result->generation == 2, "delta was not applied to the cached index\n");
+    myassert(manifest_compare(result, current) == 0, "delta did not reproduce the new generation\n");
+
+    // The updated copy is mapped without downloading anything but the generation
+    unlink(path_delta);
+    manifest_free(result);
+    result = manifest_read(url);
+    myassert(result != NULL && result->index != NULL, "the cached index was not used\n");
+    myassert(result->generation == 2, "read generation %zu, expected 2\n", result->generation);
+    myassert(manifest_compare(result, current) == 0, "cached index did not reproduce the new generation\n");
+
+    rmdirs(REPO_DIR);
+    free(repo);
+    free(url);
+
+    manifest_free(result);
+    manifest_free(current);
+    manifest_free(previous);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "spm.h"
+#include "framework.h"
+
+#define INDEX_FILE "test_manifest_index_read.idx"
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "1.2.11", .arg[2].sptr = "0", .arg[3].sptr = NULL},
+        {.arg[0].sptr = "openssl", .arg[1].sptr = "1.1.1", .arg[2].sptr = "0", .arg[3].sptr = "zlib>=1.2"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "1.2.12", .arg[2].sptr = "1", .arg[3].sptr = NULL},
+        {.arg[0].sptr = "python", .arg[1].sptr = "3.8.0", .arg[2].sptr = "1", .arg[3].sptr = "openssl zlib"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    Manifest *info = NULL;
+    Manifest *result = NULL;
+    size_t count = 0;
+
+    info = manifest_init();
+    for (size_t i = 0; i < numCases; i++) {
+        ManifestPackage *package = mock_package(info, testCase[i].arg[0].sptr, testCase[i].arg[1].sptr, testCase[i].arg[2].sptr, testCase[i].arg[3].sptr);
+        package->size = (i + 1) * 1024;
+    }
+
+    myassert(manifest_index_write(info, INDEX_FILE) == 0, "manifest_index_write failed\n");
+    result = manifest_index_read(INDEX_FILE);
+    myassert(result != NULL, "manifest_index_read failed\n");
+    myassert(result->records == info->records, "returned %zu records, expected %zu\n", result->records, info->records);
+
+    for (size_t i = 0; i < numCases; i++) {
+        ManifestPackage *a = result->packages[i];
+        ManifestPackage *b = info->packages[i];
+        myassert(strcmp(a->archive, b->archive) == 0, testFmt, i, "archive", a->archive, b->archive);
+        myassert(strcmp(a->name, b->name) == 0, testFmt, i, "name", a->name, b->name);
+        myassert(strcmp(a->version, b->version) == 0, testFmt, i, "version", a->version, b->version);
+        myassert(strcmp(a->revision, b->revision) == 0, testFmt, i, "revision", a->revision, b->revision);
+        myassert(a->size == b->size, "case %zu: size returned '%zu', expected '%zu'\n", i, a->size, b->size);
+        myassert(a->requirements_records == b->requirements_records, "case %zu: requirements_records returned '%zu', expected '%zu'\n", i, a->requirements_records, b->requirements_records);
+        for (size_t r = 0; r < b->requirements_records; r++) {
+            myassert(strcmp(a->requirements[r], b->requirements[r]) == 0, testFmt, i, "requirement", a->requirements[r], b->requirements[r]);
+        }
+    }
+
+    // Records sharing a name are chained in manifest order
+    for (size_t slot = manifest_index_first(result->index, "zlib"); slot != 0; slot = manifest_index_next(result->index, slot, "zlib")) {
+        myassert(strcmp(result->packages[slot - 1]->name, "zlib") == 0, "slot %zu is '%s', expected 'zlib'\n", slot, result->packages[slot - 1]->name);
+        myassert(slot == (count == 0 ? 1 : 3), "zlib record %zu in slot %zu\n", count, slot);
+        count++;
+    }
+    myassert(count == 2, "found %zu zlib records, expected 2\n", count);
+    myassert(manifest_index_first(result->index, "missing") == 0, "found a package that does not exist\n");
+
+    // A damaged index is rejected, i.e. sections shifted off their alignment
+    size_t size = result->index->data_size;
+    char *data = calloc(size + 4, sizeof(char));
+    ManifestIndexHeader *header = (ManifestIndexHeader *) data;
+    memcpy(data, result->index->data, sizeof(*header));
+    memcpy(data + sizeof(*header) + 4, (const char *) result->index->data + sizeof(*header), size - sizeof(*header));
+    header->offset_records += 4;
+    header->offset_requirements += 4;
+    header->offset_buckets += 4;
+    header->offset_strings += 4;
+    mock(INDEX_FILE, data, sizeof(char), size + 4);
+    myassert(manifest_index_open(INDEX_FILE) == NULL, "misaligned index was accepted\n");
+    free(data);
+
+    // or a truncated file
+    mock(INDEX_FILE, "SPMINDEX", sizeof(char), 8);
+    myassert(manifest_index_open(INDEX_FILE) == NULL, "truncated index was accepted\n");
+
+    unlink(INDEX_FILE);
+    manifest_free(result);
+    manifest_free(info);
+    return 0;
+}
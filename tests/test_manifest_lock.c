@@ -0,0 +1,74 @@
+#include "spm.h"
+#include "framework.h"
+
+#define LOCK_FILE "test_manifest_lock.lock"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "1.2.11", .arg[2].sptr = "/srv/repo", .arg[3].sptr = NULL},
+        {.arg[0].sptr = "openssl", .arg[1].sptr = "1.1.1", .arg[2].sptr = "https://example.com/spm", .arg[3].sptr = "zlib>=1.2"},
+        {.arg[0].sptr = "python", .arg[1].sptr = "3.8.0", .arg[2].sptr = "/odd|path", .arg[3].sptr = "openssl"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static Manifest *manifest_mock(void) {
+    Manifest *info = manifest_init();
+    for (size_t i = 0; i < numCases; i++) {
+        ManifestPackage *package = mock_package(info, testCase[i].arg[0].sptr, testCase[i].arg[1].sptr, "0", testCase[i].arg[3].sptr);
+        char checksum[SHA256_DIGEST_STRING_LENGTH];
+
+        memset(checksum, 'a' + (int) i, SHA256_DIGEST_LENGTH * 2);
+        checksum[SHA256_DIGEST_LENGTH * 2] = '\0';
+        package->checksum_sha256 = manifest_intern(info, checksum);
+        package->origin = manifest_intern(info, testCase[i].arg[2].sptr);
+        package->size = strlen(package->archive) * 1024;
+    }
+    return info;
+}
+
+int main(int argc, char *argv[]) {
+    Manifest *info = manifest_mock();
+    Manifest *locked = NULL;
+
+    // Records are read back unchanged and in order
+    myassert(manifest_lock_write(LOCK_FILE, info->packages) == 0, "manifest_lock_write failed\n");
+    locked = manifest_lock_read(LOCK_FILE);
+    myassert(locked != NULL, "manifest_lock_read failed\n");
+    myassert(locked->records == numCases, "expected %zu records, got %zu\n", numCases, locked->records);
+    for (size_t i = 0; i < numCases; i++) {
+        char *expected = manifest_package_str(info->packages[i]);
+        char *result = manifest_package_str(locked->packages[i]);
+        myassert(strcmp(result, expected) == 0, testFmt, i, "record", result, expected);
+        myassert(strcmp(locked->packages[i]->origin, info->packages[i]->origin) == 0, testFmt, i, "origin", locked->packages[i]->origin, info->packages[i]->origin);
+        myassert(locked->packages[i]->version_key != NULL, "case %zu: version key was not set\n", i);
+        free(expected);
+        free(result);
+    }
+    myassert(locked->packages[numCases] == NULL, "package array is not terminated\n");
+    manifest_free(locked);
+
+    // Records without a checksum cannot be verified, so they are not locked
+    info->packages[1]->checksum_sha256 = manifest_intern(info, "");
+    myassert(manifest_lock_write(LOCK_FILE, info->packages) < 0, "locked a record without a checksum\n");
+    locked = manifest_lock_read(LOCK_FILE);
+    myassert(locked != NULL && locked->records == numCases, "a failed write replaced the lock file\n");
+    manifest_free(locked);
+
+    // Anything else is rejected
+    FILE *fp = fopen(LOCK_FILE, "w");
+    fprintf(fp, "%s\n", SPM_MANIFEST_HEADER);
+    fclose(fp);
+    myassert(manifest_lock_read(LOCK_FILE) == NULL, "accepted a manifest as a lock file\n");
+    myassert(spmerrno == SPM_ERR_PARSE, "spmerrno was not set\n");
+    spmerrno = 0;
+
+    fp = fopen(LOCK_FILE, "w");
+    fprintf(fp, "%s\nzlib-1.2.11-0%s|1|zlib\n", SPM_MANIFEST_LOCK_HEADER, SPM_PACKAGE_EXTENSION);
+    fclose(fp);
+    myassert(manifest_lock_read(LOCK_FILE) == NULL, "accepted a truncated record\n");
+    spmerrno = 0;
+
+    unlink(LOCK_FILE);
+    manifest_free(info);
+    return 0;
+}
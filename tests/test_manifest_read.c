@@ -0,0 +1,62 @@
+#include "spm.h"
+#include "framework.h"
+
+#define MANIFEST_DIR "test_manifest_read.d"
+#define LONG_REQUIREMENTS 2000
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.arg[0].sptr = "zlib-1.2.11-0.tar.gz", .arg[1].sptr = "zlib", .arg[2].sptr = "1.2.11", .arg[3].sptr = "0", .arg[4].unsigned_long = 0},
+        {.arg[0].sptr = "openssl-1.1.1-0.tar.gz", .arg[1].sptr = "openssl", .arg[2].sptr = "1.1.1", .arg[3].sptr = "0", .arg[4].unsigned_long = 1},
+        {.arg[0].sptr = "long-1.0-2.tar.gz", .arg[1].sptr = "long", .arg[2].sptr = "1.0", .arg[3].sptr = "2", .arg[4].unsigned_long = LONG_REQUIREMENTS},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    char *manifest_file = join((char *[]) {MANIFEST_DIR, SPM_MANIFEST_FILENAME, NULL}, DIRSEPS);
+    FILE *fp = NULL;
+    Manifest *info = NULL;
+
+    mkdirs(MANIFEST_DIR, 0755);
+    fp = fopen(manifest_file, "w+");
+    myassert(fp != NULL, "%s: %s\n", manifest_file, strerror(errno));
+    fprintf(fp, "%s\n", SPM_MANIFEST_HEADER);
+    for (size_t i = 0; i < numCases; i++) {
+        size_t requirements = testCase[i].arg[4].unsigned_long;
+        fprintf(fp, "%s|%zu|%s|%s|%s|%zu|", testCase[i].arg[0].sptr, i, testCase[i].arg[1].sptr,
+                testCase[i].arg[2].sptr, testCase[i].arg[3].sptr, requirements);
+        // the last record is far longer than BUFSIZ
+        for (size_t r = 0; r < requirements; r++) {
+            fprintf(fp, "%srequirement%05zu>=1.0", r ? "," : "", r);
+        }
+        fprintf(fp, "%s|%s\n", requirements ? "" : SPM_MANIFEST_NODATA, SPM_MANIFEST_NODATA);
+    }
+    fclose(fp);
+
+    info = manifest_read(MANIFEST_DIR);
+    myassert(info != NULL, "manifest_read failed\n");
+    myassert(info->records == numCases, "returned %zu records, expected %zu\n", info->records, numCases);
+
+    for (size_t i = 0; i < numCases; i++) {
+        ManifestPackage *package = info->packages[i];
+        myassert(strcmp(package->archive, testCase[i].arg[0].sptr) == 0, testFmt, i, "archive", package->archive, testCase[i].arg[0].sptr);
+        myassert(strcmp(package->name, testCase[i].arg[1].sptr) == 0, testFmt, i, "name", package->name, testCase[i].arg[1].sptr);
+        myassert(strcmp(package->version, testCase[i].arg[2].sptr) == 0, testFmt, i, "version", package->version, testCase[i].arg[2].sptr);
+        myassert(strcmp(package->revision, testCase[i].arg[3].sptr) == 0, testFmt, i, "revision", package->revision, testCase[i].arg[3].sptr);
+        myassert(strcmp(package->origin, MANIFEST_DIR) == 0, testFmt, i, "origin", package->origin, MANIFEST_DIR);
+        myassert(package->size == i, "case %zu: size returned '%zu', expected '%zu'\n", i, package->size, i);
+        myassert(package->requirements_records == testCase[i].arg[4].unsigned_long,
+                 "case %zu: requirements_records returned '%zu', expected '%zu'\n", i, package->requirements_records, testCase[i].arg[4].unsigned_long);
+    }
+    myassert(strcmp(info->packages[numCases - 1]->requirements[LONG_REQUIREMENTS - 1], "requirement01999>=1.0") == 0,
+             "last requirement is '%s'\n", info->packages[numCases - 1]->requirements[LONG_REQUIREMENTS - 1]);
+    manifest_free(info);
+
+    // A malformed record invalidates the manifest
+    mock(manifest_file, SPM_MANIFEST_HEADER "\nbad|record\n", sizeof(char), strlen(SPM_MANIFEST_HEADER "\nbad|record\n"));
+    myassert(manifest_read(MANIFEST_DIR) == NULL, "malformed manifest was accepted\n");
+
+    rmdirs(MANIFEST_DIR);
+    free(manifest_file);
+    return 0;
+}
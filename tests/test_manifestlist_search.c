@@ -0,0 +1,71 @@
+#include "spm.h"
+#include "framework.h"
+
+#define MANY_MANIFESTS 300
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "zlib", .arg[0].sptr = "zlib-1.2.5-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "zlib>1.2.5", .arg[0].sptr = "zlib-1.2.12-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "zlib<=1.2.11", .arg[0].sptr = "zlib-1.2.5-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "zlib==1.2.11", .arg[0].sptr = "zlib-1.2.11-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "openssl", .arg[0].sptr = "openssl-1.1.1-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "python>=3.8", .arg[0].sptr = "python-3.8.0-1" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "python<3", .arg[0].sptr = NULL},
+        {.caseValue.sptr = "missing", .arg[0].sptr = NULL},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static Manifest *manifest_mock(const char **packages) {
+    Manifest *info = manifest_init();
+    for (size_t i = 0; packages[i] != NULL; i += 3) {
+        mock_package(info, packages[i], packages[i + 1], packages[i + 2], NULL);
+    }
+    return info;
+}
+
+int main(int argc, char *argv[]) {
+    ManifestList *list = manifestlist_init();
+    ManifestPackage *result = NULL;
+
+    mock_manifestlist_append(list, manifest_mock((const char *[]) {
+        "zlib", "1.2.12", "0",
+        "openssl", "1.1.1", "0",
+        "zlib", "1.2.11", "0",
+        NULL,
+    }));
+    mock_manifestlist_append(list, manifest_mock((const char *[]) {
+        "python", "3.8.0", "1",
+        "zlib", "1.2.5", "0",
+        NULL,
+    }));
+
+    // The last manifest with a match wins, then the highest version within it
+    for (size_t i = 0; i < numCases; i++) {
+        const char *expected = testCase[i].arg[0].sptr;
+        result = manifestlist_search(list, testCase[i].caseValue.sptr);
+        if (expected == NULL) {
+            myassert(result == NULL, testFmt, i, testCase[i].caseValue.sptr, result ? result->archive : "NULL", "NULL");
+        } else {
+            myassert(result != NULL, testFmt, i, testCase[i].caseValue.sptr, "NULL", expected);
+            myassert(strcmp(result->archive, expected) == 0, testFmt, i, testCase[i].caseValue.sptr, result->archive, expected);
+        }
+        manifest_package_free(result);
+    }
+
+    // The number of manifests is not limited
+    ManifestList *many = manifestlist_init();
+    for (size_t i = 0; i < MANY_MANIFESTS; i++) {
+        char version[32];
+        sprintf(version, "1.%zu", i % 7);
+        mock_manifestlist_append(many, manifest_mock((const char *[]) {"many", version, "0", NULL}));
+    }
+    result = manifestlist_search(many, "many");
+    myassert(result != NULL, "no match across %d manifests\n", MANY_MANIFESTS);
+    myassert(result->version == many->data[MANY_MANIFESTS - 1]->packages[0]->version, "returned '%s' from the wrong manifest\n", result->version);
+    manifest_package_free(result);
+    manifestlist_free(many);
+
+    manifestlist_free(list);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s' found=%d, expected %d\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "nothing to look at", .truthValue.sptr = "0000"},
+        {.caseValue.sptr = "prefix=/opt/spm/lib", .truthValue.sptr = "1000"},
+        {.caseValue.sptr = "/opt/spm/lib:/usr/local", .truthValue.sptr = "1100"},
+        {.caseValue.sptr = "xx/usr/localxx", .truthValue.sptr = "0100"},
+        {.caseValue.sptr = "ushers", .truthValue.sptr = "0011"},
+        {.caseValue.sptr = "she", .truthValue.sptr = "0010"},
+        {.caseValue.sptr = "/opt/sp", .truthValue.sptr = "0000"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    char *patterns[] = {"/opt/spm", "/usr/local", "he", "hers", "", NULL};
+    size_t num_patterns = sizeof(patterns) / sizeof(*patterns) - 1;
+    Matcher *matcher = matcher_init(patterns);
+    myassert(matcher != NULL, "matcher_init failed\n");
+    myassert(matcher->num_patterns == num_patterns, "expected %zu patterns, got %zu\n", num_patterns, matcher->num_patterns);
+
+    // Patterns are found whole, overlapping each other, and across chunk boundaries
+    for (size_t i = 0; i < numCases; i++) {
+        const char *data = testCase[i].caseValue.sptr;
+        size_t size = strlen(data);
+
+        for (size_t chunk = 1; chunk <= size; chunk++) {
+            unsigned char found[sizeof(patterns) / sizeof(*patterns)] = {0};
+            size_t count = 0;
+            size_t expected_count = 0;
+            uint32_t state = 0;
+
+            for (size_t offset = 0; offset < size; offset += chunk) {
+                size_t bytes = size - offset < chunk ? size - offset : chunk;
+                count += matcher_feed(matcher, &state, &data[offset], bytes, found);
+            }
+            for (size_t p = 0; p < 4; p++) {
+                int expected = testCase[i].truthValue.sptr[p] == '1';
+                expected_count += (size_t) expected;
+                myassert(found[p] == expected, testFmt, i, data, found[p], expected);
+            }
+            myassert(found[4] == 0, "case %zu: the empty pattern was reported\n", i);
+            myassert(count == expected_count, "case %zu: counted %zu new matches, expected %zu\n", i, count, expected_count);
+        }
+    }
+
+    // Matches already flagged are not counted again
+    unsigned char found[sizeof(patterns) / sizeof(*patterns)] = {0};
+    uint32_t state = 0;
+    myassert(matcher_feed(matcher, &state, "/opt/spm", 8, found) == 1, "first match was not counted\n");
+    myassert(matcher_feed(matcher, &state, "/opt/spm", 8, found) == 0, "second match was counted\n");
+    matcher_free(matcher);
+
+    // Binary data
+    char *binary_patterns[] = {"\xff\x01", NULL};
+    matcher = matcher_init(binary_patterns);
+    memset(found, 0, sizeof(found));
+    state = 0;
+    matcher_feed(matcher, &state, "\x00\xff\xff\x01\x00", 5, found);
+    myassert(found[0] == 1, "binary pattern was not found\n");
+    matcher_free(matcher);
+    return 0;
+}
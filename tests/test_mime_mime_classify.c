@@ -0,0 +1,84 @@
+#include "spm.h"
+#include "framework.h"
+
+#define MOCK_FILE "test_mime_mime_classify.dat"
+
+const char *testFmt = "case %zu: %s: returned %d, expected %d\n";
+struct MimeCase {
+    const char *name;
+    const char *data;
+    size_t size;
+    int type;
+    int is_text;
+    int is_binary;
+    int is_binexec;
+};
+#define DATA(X) X, sizeof(X) - 1
+struct MimeCase testCase[] = {
+        {"empty", DATA(""), SPM_MIME_EMPTY, 0, 0, 0},
+        {"text", DATA("hello world\n\tindented\r\n\x1b[0m\n"), SPM_MIME_TEXT, 1, 0, 0},
+        {"utf-8 text", DATA("caf\xc3\xa9\n"), SPM_MIME_TEXT, 1, 0, 0},
+        {"script", DATA("#!/bin/sh\necho hello\n"), SPM_MIME_SCRIPT, 1, 0, 0},
+        {"self-extracting script", DATA("#!/bin/sh\nexit 0\n\x1f\x8b\x08\0\0\0"), SPM_MIME_DATA, 0, 1, 0},
+        {"data", DATA("\0\1\2\3"), SPM_MIME_DATA, 0, 1, 0},
+        {"archive", DATA("!<arch>\n/               0           0     0     0       4         `\n"), SPM_MIME_ARCHIVE, 0, 1, 0},
+        {"ELF64 LSB relocatable", DATA("\x7f" "ELF\2\1\1\0\0\0\0\0\0\0\0\0\1\0"), SPM_MIME_ELF_OBJECT, 0, 1, 0},
+        {"ELF64 LSB executable", DATA("\x7f" "ELF\2\1\1\0\0\0\0\0\0\0\0\0\2\0"), SPM_MIME_ELF_EXEC, 0, 1, 1},
+        {"ELF64 LSB shared object", DATA("\x7f" "ELF\2\1\1\0\0\0\0\0\0\0\0\0\3\0"), SPM_MIME_ELF_SHARED, 0, 1, 1},
+        {"ELF32 MSB executable", DATA("\x7f" "ELF\1\2\1\0\0\0\0\0\0\0\0\0\0\2"), SPM_MIME_ELF_EXEC, 0, 1, 1},
+        {"ELF32 MSB core", DATA("\x7f" "ELF\1\2\1\0\0\0\0\0\0\0\0\0\0\4"), SPM_MIME_ELF_OBJECT, 0, 1, 0},
+        {"truncated ELF", DATA("\x7f" "ELF\2\1"), SPM_MIME_DATA, 0, 1, 0},
+        {"Mach-O 64 LSB executable", DATA("\xcf\xfa\xed\xfe\7\0\0\1\3\0\0\0\2\0\0\0"), SPM_MIME_MACHO_EXEC, 0, 1, 1},
+        {"Mach-O 64 LSB dylib", DATA("\xcf\xfa\xed\xfe\7\0\0\1\3\0\0\0\6\0\0\0"), SPM_MIME_MACHO_EXEC, 0, 1, 1},
+        {"Mach-O 32 MSB object", DATA("\xfe\xed\xfa\xce\0\0\0\x12\0\0\0\0\0\0\0\1"), SPM_MIME_MACHO_OBJECT, 0, 1, 0},
+        {"universal binary", DATA("\xca\xfe\xba\xbe\0\0\0\2"), SPM_MIME_MACHO_EXEC, 0, 1, 1},
+        {"Java class", DATA("\xca\xfe\xba\xbe\0\0\0\x34"), SPM_MIME_DATA, 0, 1, 0},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct MimeCase);
+
+int main(int argc, char *argv[]) {
+    char cwd[PATH_MAX];
+    int result = 0;
+
+    for (size_t i = 0; i < numCases; i++) {
+        result = mime_classify_data(testCase[i].data, testCase[i].size);
+        myassert(result == testCase[i].type, testFmt, i, testCase[i].name, result, testCase[i].type);
+
+        mock(MOCK_FILE, (void *) testCase[i].data, sizeof(char), testCase[i].size);
+        result = mime_classify(MOCK_FILE);
+        myassert(result == testCase[i].type, testFmt, i, testCase[i].name, result, testCase[i].type);
+        result = file_is_text(MOCK_FILE);
+        myassert(result == testCase[i].is_text, testFmt, i, "file_is_text", result, testCase[i].is_text);
+        result = file_is_binary(MOCK_FILE);
+        myassert(result == testCase[i].is_binary, testFmt, i, "file_is_binary", result, testCase[i].is_binary);
+        result = file_is_binexec(MOCK_FILE);
+        myassert(result == testCase[i].is_binexec, testFmt, i, "file_is_binexec", result, testCase[i].is_binexec);
+        unlink(MOCK_FILE);
+    }
+
+    // Only the leading bytes are examined
+    char *text = calloc(SPM_MIME_MAGIC_SIZE + 2, sizeof(char));
+    memset(text, 'x', SPM_MIME_MAGIC_SIZE);
+    mock(MOCK_FILE, text, sizeof(char), SPM_MIME_MAGIC_SIZE + 1);
+    result = mime_classify(MOCK_FILE);
+    myassert(result == SPM_MIME_TEXT, testFmt, (size_t) 0, "trailing NUL", result, SPM_MIME_TEXT);
+
+    // A modified file is classified again
+    text[0] = '\0';
+    mock(MOCK_FILE, text, sizeof(char), SPM_MIME_MAGIC_SIZE + 2);
+    result = mime_classify(MOCK_FILE);
+    myassert(result == SPM_MIME_DATA, testFmt, (size_t) 1, "modified", result, SPM_MIME_DATA);
+    unlink(MOCK_FILE);
+    free(text);
+
+    // Real programs, directories and missing files
+    result = file_is_binexec("/bin/sh");
+    myassert(result == 1, testFmt, (size_t) 2, "/bin/sh", result, 1);
+    myassert(getcwd(cwd, sizeof(cwd)) != NULL, "getcwd failed\n");
+    result = mime_classify(cwd);
+    myassert(result == SPM_MIME_SPECIAL, testFmt, (size_t) 3, cwd, result, SPM_MIME_SPECIAL);
+    myassert(file_is_binary(cwd) == 0 && file_is_text(cwd) == 0, "a directory was classified as a file\n");
+    myassert(mime_classify("/nonexistent/file") < 0, "a missing file was classified\n");
+    myassert(file_is_binexec("/nonexistent/file") < 0, "file_is_binexec did not fail on a missing file\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "spm.h"
+#include "framework.h"
+
+#define TREE "test_relocation_prefixes_write.d"
+#define OUTPUT "test_relocation_prefixes_write.manifest"
+#define PREFIX_A "/build/prefix/a"
+#define PREFIX_B "/build/other"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "bin", .inputValue.signed_int = PREFIX_WRITE_BIN,
+         .truthValue.sptr = "#" PREFIX_A "\n./bin/both\n#" PREFIX_B "\n./bin/both\n#" PREFIX_A "\n./lib/late\n"},
+        {.caseValue.sptr = "text", .inputValue.signed_int = PREFIX_WRITE_TEXT,
+         .truthValue.sptr = "#" PREFIX_B "\n./etc/config\n#" PREFIX_A "\n./share/split\n"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static void write_file(const char *filename, const char *data, size_t size) {
+    char path[PATH_MAX];
+    sprintf(path, "%s/%s", TREE, filename);
+    mock(path, (void *) data, sizeof(char), size);
+}
+
+int main(int argc, char *argv[]) {
+    char *prefixes[] = {PREFIX_A, PREFIX_B, NULL};
+    char *data = NULL;
+    size_t size = 0;
+
+    mkdirs(TREE "/bin", 0755);
+    mkdirs(TREE "/etc", 0755);
+    mkdirs(TREE "/lib", 0755);
+    mkdirs(TREE "/share", 0755);
+
+    // binary files
+    write_file("bin/both", "\x7f" "ELF\0" PREFIX_A "\0" PREFIX_B "\0", sizeof("\x7f" "ELF\0" PREFIX_A "\0" PREFIX_B "\0") - 1);
+    write_file("bin/none", "\x7f" "ELF\0/usr/lib\0", sizeof("\x7f" "ELF\0/usr/lib\0") - 1);
+    // text files
+    write_file("etc/config", "root=" PREFIX_B "\n", strlen("root=" PREFIX_B "\n"));
+    write_file("etc/plain", "nothing\n", strlen("nothing\n"));
+    // metadata is never recorded
+    write_file(SPM_META_DEPENDS, PREFIX_A "\n", strlen(PREFIX_A "\n"));
+    // a prefix straddling the chunks read from the file
+    size = BUFSIZ * 8 + 64;
+    data = calloc(size, sizeof(char));
+    memset(data, 'x', size);
+    memcpy(&data[BUFSIZ * 8 - 5], PREFIX_A, strlen(PREFIX_A));
+    write_file("share/split", data, size);
+    // binary data that only shows up past the first chunk, after a prefix
+    memset(data, 'y', size);
+    memcpy(&data[10], PREFIX_A, strlen(PREFIX_A));
+    data[size - 1] = '\0';
+    write_file("lib/late", data, size);
+    free(data);
+    // links and empty files
+    symlink("both", TREE "/bin/link");
+    touch(TREE "/etc/empty");
+
+    for (size_t i = 0; i < numCases; i++) {
+        myassert(prefixes_write(OUTPUT, testCase[i].inputValue.signed_int, prefixes, TREE) == 0, "case %zu: prefixes_write failed\n", i);
+        FILE *fp = fopen(OUTPUT, "r");
+        char result[BUFSIZ] = {0};
+        fread(result, sizeof(char), sizeof(result) - 1, fp);
+        fclose(fp);
+        myassert(strcmp(result, testCase[i].truthValue.sptr) == 0, testFmt, i, testCase[i].caseValue.sptr, result, testCase[i].truthValue.sptr);
+    }
+
+    // The records can be read back
+    prefixes_write(OUTPUT, PREFIX_WRITE_BIN, prefixes, TREE);
+    RelocationEntry **entry = prefixes_read(OUTPUT);
+    myassert(entry != NULL && entry[0] != NULL && entry[3] == NULL, "prefixes_read did not return 3 records\n");
+    myassert(strcmp(entry[1]->prefix, PREFIX_B) == 0, testFmt, (size_t) 1, "prefix", entry[1]->prefix, PREFIX_B);
+    prefixes_free(entry);
+
+    unlink(OUTPUT);
+    rmdirs(TREE);
+    return 0;
+}
@@ -37,7 +37,7 @@ int main(int argc, char *argv[]) {
             exit(1);
         }
 
-        myassert(return_value == 0, "reloc exited with error condition: %d\n", return_value);
+        myassert(return_value == 0, "relocate returned an error condition: %d\n", return_value);
         myassert(strstr(caseValue, testCase[i].truthValue.sptr) != NULL, testFmt, testCase[i].caseValue.sptr, caseValue, testCase[i].truthValue.sptr);
 
         // clean up
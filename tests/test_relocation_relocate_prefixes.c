@@ -0,0 +1,77 @@
+#include "spm.h"
+#include "framework.h"
+
+#define DATA_MIXED "\x7f" "ELF" "/aaa/bbb/lib\0" "xx" "/cc/dd:/aaa/bbb/x\0" "/aaa/bbb"
+#define TRUTH_MIXED "\x7f" "ELF" "/n/lib\0\0\0\0\0\0\0" "xx" "/n:/n/x\0\0\0\0\0\0\0\0\0\0\0" "/n\0\0\0\0\0\0"
+#define DATA_NESTED "/opt/long/bin\0/opt/x\0"
+#define TRUTH_NESTED "/p/bin\0\0\0\0\0\0\0\0/p/x\0\0\0\0"
+#define DATA_PLACEHOLDER "\xFE\xFEprefix=" SPM_META_PREFIX_PLACEHOLDER "/lib\0\xFF\xFF"
+
+const char *testFmt = "case %zu: %s: returned %zd, expected %zd\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = DATA_MIXED, .truthValue.sptr = TRUTH_MIXED, .arg[0].unsigned_long = sizeof(DATA_MIXED) - 1,
+         .arg[1].slptr = (char *[]) {"/aaa/bbb", "/cc/dd", NULL}, .arg[2].sptr = "/n", .arg[3].signed_long = 4},
+        {.caseValue.sptr = DATA_NESTED, .truthValue.sptr = TRUTH_NESTED, .arg[0].unsigned_long = sizeof(DATA_NESTED) - 1,
+         .arg[1].slptr = (char *[]) {"/opt", "/opt/long", NULL}, .arg[2].sptr = "/p", .arg[3].signed_long = 2},
+        {.caseValue.sptr = DATA_NESTED, .truthValue.sptr = DATA_NESTED, .arg[0].unsigned_long = sizeof(DATA_NESTED) - 1,
+         .arg[1].slptr = (char *[]) {"", NULL}, .arg[2].sptr = "/p", .arg[3].signed_long = 0},
+        {.caseValue.sptr = DATA_NESTED, .truthValue.sptr = DATA_NESTED, .arg[0].unsigned_long = sizeof(DATA_NESTED) - 1,
+         .arg[1].slptr = (char *[]) {"/opt", NULL}, .arg[2].sptr = "/too/long", .arg[3].signed_long = -1},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static char *read_mock(const char *filename, size_t size) {
+    char *data = calloc(size + 1, sizeof(char));
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    fread(data, sizeof(char), size, fp);
+    fclose(fp);
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    char filename[PATH_MAX];
+
+    // Prefixes are replaced within their strings, and the file keeps its size
+    for (size_t i = 0; i < numCases; i++) {
+        size_t size = testCase[i].arg[0].unsigned_long;
+        sprintf(filename, "%s.%s_%zu.mock", basename(__FILE__), __FUNCTION__, i);
+        mock(filename, (void *) testCase[i].caseValue.sptr, sizeof(char), size);
+
+        ssize_t result = relocate_prefixes(filename, testCase[i].arg[1].slptr, testCase[i].arg[2].sptr);
+        char *data = read_mock(filename, size);
+        myassert(result == testCase[i].arg[3].signed_long, testFmt, i, "relocate_prefixes", result, testCase[i].arg[3].signed_long);
+        myassert(get_file_size(filename) == (long int) size, "case %zu: file size changed\n", i);
+        myassert(memcmp(data, testCase[i].truthValue.sptr, size) == 0, "case %zu: unexpected data\n", i);
+        free(data);
+        unlink(filename);
+    }
+
+    // The placeholder used to build packages is replaced by the installation root
+    size_t size = sizeof(DATA_PLACEHOLDER) - 1;
+    const char *destroot = "/home/user/.spm/root";
+    sprintf(filename, "%s.%s_placeholder.mock", basename(__FILE__), __FUNCTION__);
+    mock(filename, (void *) DATA_PLACEHOLDER, sizeof(char), size);
+    myassert(relocate(filename, SPM_META_PREFIX_PLACEHOLDER, destroot) == 0, "relocate failed\n");
+    char *data = read_mock(filename, size);
+    char expected[PATH_MAX];
+    sprintf(expected, "prefix=%s/lib", destroot);
+    myassert(strcmp(&data[2], expected) == 0, "case placeholder: returned '%s', expected '%s'\n", &data[2], expected);
+    for (size_t i = 2 + strlen(expected); i < size - 2; i++) {
+        myassert(data[i] == '\0', "case placeholder: byte %zu was not cleared\n", i);
+    }
+    myassert(memcmp(&data[size - 2], "\xFF\xFF", 2) == 0, "case placeholder: data after the string was modified\n");
+    free(data);
+    unlink(filename);
+
+    // Empty and missing files
+    sprintf(filename, "%s.%s_empty.mock", basename(__FILE__), __FUNCTION__);
+    touch(filename);
+    myassert(relocate(filename, "/opt", "/p") == 0, "relocating an empty file failed\n");
+    unlink(filename);
+    myassert(relocate(filename, "/opt", "/p") < 0, "relocated a missing file\n");
+    return 0;
+}
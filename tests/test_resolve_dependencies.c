@@ -0,0 +1,75 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "zlib", .arg[0].sptr = "zlib-1.2.12"},
+        {.caseValue.sptr = "openssl", .arg[0].sptr = "zlib-1.2.12 openssl-1.1.1"},
+        {.caseValue.sptr = "python", .arg[0].sptr = "zlib-1.2.12 openssl-1.1.1 python-3.8.0"},
+        {.caseValue.sptr = "python-dateutil", .arg[0].sptr = "zlib-1.2.12 openssl-1.1.1 python-3.8.0 python-dateutil-2.8"},
+        {.caseValue.sptr = "legacy", .arg[0].sptr = "zlib-1.2.11 legacy-1.0"},
+        {.caseValue.sptr = "chicken", .arg[0].sptr = "egg-1.0 chicken-1.0"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+const char *packages[] = {
+        "zlib", "1.2.11", "",
+        "zlib", "1.2.12", "",
+        "openssl", "1.1.1", "zlib>=1.2",
+        "python", "3.8.0", "openssl zlib",
+        "python-dateutil", "2.8", "python>=3",
+        "legacy", "1.0", "zlib<1.2.12",
+        "chicken", "1.0", "egg",
+        "egg", "1.0", "chicken",
+        "broken", "1.0", "zlib missing>=1",
+        NULL,
+};
+
+int main(int argc, char *argv[]) {
+    Manifest *info = manifest_init();
+    for (size_t i = 0; packages[i] != NULL; i += 3) {
+        mock_package(info, packages[i], packages[i + 1], "0", packages[i + 2]);
+    }
+    ManifestList *list = mock_manifestlist_append(manifestlist_init(), info);
+
+    // Each package is resolved twice to make sure no state leaks between calls
+    for (size_t pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < numCases; i++) {
+            ManifestPackage **order = resolve_dependencies(list, testCase[i].caseValue.sptr);
+            myassert(order != NULL, "case %zu: resolve_dependencies failed\n", i);
+            char *result = mock_order_str(order);
+            myassert(strcmp(result, testCase[i].arg[0].sptr) == 0, testFmt, i, testCase[i].caseValue.sptr, result, testCase[i].arg[0].sptr);
+            for (size_t p = 0; order[p] != NULL; p++) {
+                manifest_package_free(order[p]);
+            }
+            free(order);
+            free(result);
+        }
+    }
+
+    // Several requests share one graph, and packages required more than once appear once
+    Resolver *resolver = resolve_init(list);
+    myassert(resolve_add(resolver, "legacy") == 0, "resolve_add(legacy) failed\n");
+    myassert(resolve_add(resolver, "python-dateutil") == 0, "resolve_add(python-dateutil) failed\n");
+    myassert(resolve_add(resolver, "python") == 0, "resolve_add(python) failed\n");
+    ManifestPackage **order = resolve_order(resolver);
+    char *result = mock_order_str(order);
+    const char *expected = "zlib-1.2.11 legacy-1.0 zlib-1.2.12 openssl-1.1.1 python-3.8.0 python-dateutil-2.8";
+    myassert(strcmp(result, expected) == 0, testFmt, (size_t) 0, "combined", result, expected);
+    free(result);
+    free(order);
+
+    // Missing requirements are reported instead of terminating the process
+    myassert(resolve_add(resolver, "broken") < 0, "resolve_add(broken) succeeded\n");
+    myassert(resolver->error.code == SPM_ERR_PKG_NOT_FOUND, "unexpected error code %d\n", resolver->error.code);
+    myassert(strcmp(resolver->error.spec, "missing>=1") == 0, "error spec '%s'\n", resolver->error.spec);
+    myassert(strcmp(resolver->error.required_by, "broken-1.0-0" SPM_PACKAGE_EXTENSION) == 0, "error required_by '%s'\n", resolver->error.required_by);
+    resolve_free(resolver);
+
+    myassert(resolve_dependencies(list, "nothere") == NULL, "resolved a package that does not exist\n");
+    myassert(spmerrno == SPM_ERR_PKG_NOT_FOUND, "spmerrno was not set\n");
+    spmerrno = 0;
+
+    manifestlist_free(list);
+    return 0;
+}
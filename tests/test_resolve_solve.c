@@ -0,0 +1,134 @@
+#include "spm.h"
+#include "framework.h"
+
+#define CHAIN_PACKAGES 500
+#define CHAIN_VERSIONS 4
+#define CHAIN_SECONDS_MAX 1.0
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        // The greedy resolver would install both zlib-1.2.12 and zlib-1.2.11
+        {.caseValue.sptr = "legacy python", .arg[0].sptr = "zlib-1.2.11 legacy-1.0 openssl-1.1.1 python-3.8.0"},
+        // tool-2.0 needs a newer zlib than legacy allows, so tool-1.0 is selected instead
+        {.caseValue.sptr = "tool legacy", .arg[0].sptr = "zlib-1.2.11 tool-1.0 legacy-1.0"},
+        // openssl-1.1.1 needs zlib>=1.2.11, ancient needs an older zlib, so openssl-1.0.2 is selected
+        {.caseValue.sptr = "ancient openssl", .arg[0].sptr = "zlib-1.2.5 ancient-1.0 openssl-1.0.2"},
+        {.caseValue.sptr = "python", .arg[0].sptr = "zlib-1.2.12 openssl-1.1.1 python-3.8.0"},
+        {.caseValue.sptr = "zlib<1.2.12 python", .arg[0].sptr = "zlib-1.2.11 openssl-1.1.1 python-3.8.0"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+struct TestCase failCase[] = {
+        {.caseValue.sptr = "legacy zlib>=1.2.12", .arg[0].sptr = "zlib<1.2.12, zlib>=1.2.12", .arg[1].sptr = "legacy-1.0-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "zlib>=2", .arg[0].sptr = "zlib>=2", .arg[1].sptr = NULL},
+        {.caseValue.sptr = "broken", .arg[0].sptr = "missing", .arg[1].sptr = "broken-1.0-0" SPM_PACKAGE_EXTENSION},
+        {.caseValue.sptr = "ancient python", .arg[0].sptr = "openssl>=1.1", .arg[1].sptr = "python-3.8.0-0" SPM_PACKAGE_EXTENSION},
+};
+size_t numFailCases = sizeof(failCase) / sizeof(struct TestCase);
+
+const char *packages[] = {
+        "zlib", "1.2.5", "",
+        "zlib", "1.2.11", "",
+        "zlib", "1.2.12", "",
+        "openssl", "1.0.2", "zlib",
+        "openssl", "1.1.1", "zlib>=1.2.11",
+        "python", "3.8.0", "openssl>=1.1 zlib",
+        "legacy", "1.0", "zlib<1.2.12",
+        "ancient", "1.0", "zlib<1.2.11",
+        "tool", "1.0", "zlib",
+        "tool", "2.0", "zlib>=1.2.12",
+        "broken", "1.0", "missing",
+        NULL,
+};
+
+static Resolver *solve(ManifestList *list, const char *specs, int *status) {
+    char *data = strdup(specs);
+    char **parts = split(data, " ");
+    StrList *request = strlist_init();
+    Resolver *resolver = resolve_init(list);
+
+    for (size_t i = 0; parts[i] != NULL; i++) {
+        strlist_append(request, parts[i]);
+    }
+    *status = resolve_solve(resolver, request);
+    for (size_t i = 0; *status == 0 && parts[i] != NULL; i++) {
+        *status = resolve_add(resolver, parts[i]);
+    }
+    strlist_free(request);
+    split_free(parts);
+    free(data);
+    return resolver;
+}
+
+int main(int argc, char *argv[]) {
+    ManifestList *list = NULL;
+    Manifest *info = manifest_init();
+    int status = 0;
+
+    for (size_t i = 0; packages[i] != NULL; i += 3) {
+        mock_package(info, packages[i], packages[i + 1], "0", packages[i + 2]);
+    }
+    list = mock_manifestlist_append(manifestlist_init(), info);
+
+    for (size_t i = 0; i < numCases; i++) {
+        Resolver *resolver = solve(list, testCase[i].caseValue.sptr, &status);
+        myassert(status == 0, "case %zu: '%s' has no solution: %s (%s)\n", i, testCase[i].caseValue.sptr, resolver->error.spec, resolver->error.required_by);
+        ManifestPackage **order = resolve_order(resolver);
+        char *result = mock_order_str(order);
+        myassert(strcmp(result, testCase[i].arg[0].sptr) == 0, testFmt, i, testCase[i].caseValue.sptr, result, testCase[i].arg[0].sptr);
+        free(result);
+        free(order);
+        resolve_free(resolver);
+    }
+
+    for (size_t i = 0; i < numFailCases; i++) {
+        const char *spec = failCase[i].arg[0].sptr;
+        const char *required_by = failCase[i].arg[1].sptr;
+        Resolver *resolver = solve(list, failCase[i].caseValue.sptr, &status);
+        myassert(status < 0, "case %zu: '%s' should have no solution\n", i, failCase[i].caseValue.sptr);
+        myassert(resolver->error.code != 0, "case %zu: error code not set\n", i);
+        if (spec != NULL) {
+            myassert(strcmp(resolver->error.spec, spec) == 0, testFmt, i, failCase[i].caseValue.sptr, resolver->error.spec, spec);
+        }
+        if (required_by != NULL) {
+            myassert(resolver->error.required_by != NULL && strcmp(resolver->error.required_by, required_by) == 0,
+                     testFmt, i, failCase[i].caseValue.sptr, resolver->error.required_by, required_by);
+        }
+        resolve_free(resolver);
+    }
+    manifestlist_free(list);
+
+    // Every version of p[i] requires p[i + 1] at the same version or newer, but the last package is pinned to the
+    // oldest version. Every other package has to be walked back to its oldest version as well.
+    info = manifest_init();
+    for (size_t i = 0; i < CHAIN_PACKAGES; i++) {
+        for (size_t v = 1; v <= CHAIN_VERSIONS; v++) {
+            char name[NAME_MAX];
+            char version[NAME_MAX];
+            char requirement[NAME_MAX];
+            sprintf(name, "p%03zu", i);
+            sprintf(version, "%zu.0", v);
+            sprintf(requirement, "p%03zu>=%zu.0", i + 1, v);
+            mock_package(info, name, version, "0", i + 1 < CHAIN_PACKAGES ? requirement : "");
+        }
+    }
+    list = mock_manifestlist_append(manifestlist_init(), info);
+
+    char last[NAME_MAX];
+    sprintf(last, "p000 p%03d==1.0", CHAIN_PACKAGES - 1);
+    clock_t begin = clock();
+    Resolver *resolver = solve(list, last, &status);
+    double elapsed = (double) (clock() - begin) / CLOCKS_PER_SEC;
+    myassert(status == 0, "chain has no solution: %s\n", resolver->error.spec);
+    myassert(elapsed < CHAIN_SECONDS_MAX, "solving %d packages took %.3fs\n", CHAIN_PACKAGES, elapsed);
+    ManifestPackage **order = resolve_order(resolver);
+    size_t count = 0;
+    for (; order[count] != NULL; count++) {
+        myassert(strcmp(order[count]->version, "1.0") == 0, "%s selected version %s\n", order[count]->name, order[count]->version);
+    }
+    myassert(count == CHAIN_PACKAGES, "expected %d packages, got %zu\n", CHAIN_PACKAGES, count);
+    free(order);
+    resolve_free(resolver);
+    manifestlist_free(list);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "spm.h"
+#include "framework.h"
+
+#define IMAGE_SIZE 0x300
+#define IMAGE_VADDR 0x10000
+#define IMAGE_STRTAB 0x100
+#define IMAGE_DYNAMIC 0x200
+#define IMAGE_STRINGS "\0libfoo.so.1\0libme.so.2\0/old/rpath\0"
+#define LONG_RPATH "/a/path/that/is/much/longer/than/the/original/one:$ORIGIN/../lib"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "ELF64 LSB", .arg[0].signed_int = 1, .arg[1].signed_int = 0},
+        {.caseValue.sptr = "ELF64 MSB", .arg[0].signed_int = 1, .arg[1].signed_int = 1},
+        {.caseValue.sptr = "ELF32 LSB", .arg[0].signed_int = 0, .arg[1].signed_int = 0},
+        {.caseValue.sptr = "ELF32 MSB", .arg[0].signed_int = 0, .arg[1].signed_int = 1},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static void put(unsigned char *data, size_t offset, size_t size, uint64_t value, int big_endian) {
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = big_endian ? size - 1 - i : i;
+        data[offset + i] = (unsigned char) (value >> (shift * 8));
+    }
+}
+
+/**
+ * Generate a minimal shared library whose dynamic array has no free slot
+ */
+static void make_image(unsigned char *data, int is64, int big_endian, uint64_t path_tag) {
+    size_t word = is64 ? 8 : 4;
+    size_t phoff = is64 ? 64 : 52;
+    size_t phentsize = is64 ? 56 : 32;
+    uint64_t dynamic[][2] = {
+            {ELF_DT_NEEDED, 1},
+            {ELF_DT_SONAME, 13},
+            {ELF_DT_STRTAB, IMAGE_VADDR + IMAGE_STRTAB},
+            {ELF_DT_STRSZ, sizeof(IMAGE_STRINGS)},
+            {path_tag, 24},
+            {ELF_DT_NULL, 0},
+    };
+    size_t num_dynamic = sizeof(dynamic) / sizeof(*dynamic) - (path_tag == ELF_DT_NULL);
+
+    memset(data, 0, IMAGE_SIZE);
+    memcpy(data, "\x7f" "ELF", 4);
+    data[4] = is64 ? 2 : 1;
+    data[5] = big_endian ? 2 : 1;
+    data[6] = 1;
+    put(data, is64 ? 32 : 28, word, phoff, big_endian);
+    put(data, is64 ? 54 : 42, 2, phentsize, big_endian);
+    put(data, is64 ? 56 : 44, 2, 2, big_endian);
+
+    for (size_t i = 0; i < 2; i++) {
+        size_t base = phoff + i * phentsize;
+        uint64_t offset = i ? IMAGE_DYNAMIC : 0;
+        uint64_t size = i ? num_dynamic * word * 2 : IMAGE_SIZE;
+        put(data, base, 4, i ? ELF_PT_DYNAMIC : ELF_PT_LOAD, big_endian);
+        put(data, base + (is64 ? 8 : 4), word, offset, big_endian);
+        put(data, base + (is64 ? 16 : 8), word, IMAGE_VADDR + offset, big_endian);
+        put(data, base + (is64 ? 32 : 16), word, size, big_endian);
+        put(data, base + (is64 ? 40 : 20), word, size, big_endian);
+        put(data, base + (is64 ? 48 : 28), word, 0x1000, big_endian);
+    }
+
+    memcpy(&data[IMAGE_STRTAB], IMAGE_STRINGS, sizeof(IMAGE_STRINGS));
+    for (size_t i = 0; i < num_dynamic; i++) {
+        put(data, IMAGE_DYNAMIC + i * word * 2, word, dynamic[i][0], big_endian);
+        put(data, IMAGE_DYNAMIC + i * word * 2 + word, word, dynamic[i][1], big_endian);
+    }
+}
+
+static int check_image(size_t i, const char *filename, const char *rpath) {
+    ShlibInfo *info = shlib_info(filename);
+    myassert(info != NULL, "case %zu: shlib_info failed after rpath_set\n", i);
+    myassert(info->rpath && strcmp(info->rpath, rpath) == 0, testFmt, i, "rpath", info->rpath, rpath);
+    myassert(info->runpath == NULL, testFmt, i, "runpath", info->runpath, "(null)");
+    myassert(info->soname && strcmp(info->soname, "libme.so.2") == 0, testFmt, i, "soname", info->soname, "libme.so.2");
+    myassert(strlist_count(info->needed) == 1 && strcmp(strlist_item(info->needed, 0), "libfoo.so.1") == 0,
+             "case %zu: DT_NEEDED was lost\n", i);
+    shlib_info_free(info);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned char data[IMAGE_SIZE];
+    char filename[PATH_MAX];
+    char cwd[PATH_MAX];
+    char rpath[PATH_MAX * 2];
+    uint64_t path_tags[] = {ELF_DT_RPATH, ELF_DT_RUNPATH, ELF_DT_NULL};
+
+    sprintf(filename, "%s.mock.so", basename(__FILE__));
+
+    // Every class and byte order, with a DT_RPATH, a DT_RUNPATH, or neither (the dynamic array must move)
+    for (size_t i = 0; i < numCases; i++) {
+        for (size_t t = 0; t < sizeof(path_tags) / sizeof(*path_tags); t++) {
+            make_image(data, testCase[i].arg[0].signed_int, testCase[i].arg[1].signed_int, path_tags[t]);
+            mock(filename, data, sizeof(char), sizeof(data));
+
+            // Rewritten in place
+            if (path_tags[t] != ELF_DT_NULL) {
+                myassert(rpath_set(filename, "/new") == 0, "case %zu: %s: rpath_set (in place) failed\n", i, testCase[i].caseValue.sptr);
+                myassert(get_file_size(filename) == IMAGE_SIZE, "case %zu: file size changed\n", i);
+                myassert(check_image(i, filename, "/new") == 0, "case %zu: in place\n", i);
+            }
+
+            // Relocated to a new segment
+            myassert(rpath_set(filename, LONG_RPATH) == 0, "case %zu: %s: rpath_set failed\n", i, testCase[i].caseValue.sptr);
+            myassert(get_file_size(filename) > IMAGE_SIZE, "case %zu: file did not grow\n", i);
+            myassert(check_image(i, filename, LONG_RPATH) == 0, "case %zu: relocated\n", i);
+
+            ElfFile *elf = elffile_open(filename);
+            myassert(elf != NULL && elf->phnum == 3, "case %zu: expected 3 program headers\n", i);
+            myassert(elf->strtab >= IMAGE_SIZE, "case %zu: string table was not relocated\n", i);
+            elffile_close(elf);
+            unlink(filename);
+        }
+    }
+
+    // Real programs still run, and use the new RPATH
+    int retval_lib = 0;
+    int retval_bin = 0;
+    char *filename_lib = mock_image(AS_MOCK_LIB, "librpathset", (char *[]) {"-L.", NULL}, &retval_lib);
+    char *filename_bin = mock_image(AS_MOCK_BIN, "rpathset", (char *[]) {"-L.", "-Wl,--no-as-needed", "-lrpathset", NULL}, &retval_bin);
+    Process *proc = NULL;
+    myassert(retval_lib == 0 && retval_bin == 0, "mock image build failed\n");
+    myassert(getcwd(cwd, sizeof(cwd)) != NULL, "getcwd failed\n");
+
+    sprintf(rpath, "/nonexistent/%s:%s", LONG_RPATH, cwd);
+    myassert(rpath_set(filename_bin, rpath) == 0, "rpath_set failed on %s\n", filename_bin);
+    char *result = rpath_get(filename_bin);
+    myassert(strcmp(result, rpath) == 0, testFmt, (size_t) 0, "rpath_get", result, rpath);
+    free(result);
+    shell(&proc, SHELL_OUTPUT, filename_bin);
+    myassert(proc != NULL && proc->returncode == 0, "%s did not run after its RPATH was set\n", filename_bin);
+    shell_free(proc);
+
+    myassert(rpath_set(filename_bin, "/nonexistent") == 0, "rpath_set failed on %s\n", filename_bin);
+    shell(&proc, SHELL_OUTPUT, filename_bin);
+    myassert(proc != NULL && proc->returncode != 0, "%s ignored its RPATH\n", filename_bin);
+    shell_free(proc);
+
+    // Batches carry on after a failure
+    char *batch_file[] = {filename_bin, "/nonexistent/file", filename_lib, NULL};
+    char *batch_rpath[] = {cwd, "/x", "/lib", NULL};
+    myassert(rpath_set_batch(batch_file, batch_rpath) == 1, "rpath_set_batch did not report one failure\n");
+    result = rpath_get(filename_lib);
+    myassert(strcmp(result, "/lib") == 0, testFmt, (size_t) 1, "rpath_get", result, "/lib");
+    free(result);
+    shell(&proc, SHELL_OUTPUT, filename_bin);
+    myassert(proc != NULL && proc->returncode == 0, "%s did not run after a batch\n", filename_bin);
+    shell_free(proc);
+    free(filename_lib);
+    free(filename_bin);
+
+    // Files without a dynamic section
+    mock(filename, (void *) "#!/bin/sh\n", sizeof(char), strlen("#!/bin/sh\n"));
+    myassert(rpath_set(filename, "/x") != 0, "rpath_set modified a script\n");
+    unlink(filename);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "spm.h"
+#include "framework.h"
+
+#define IMAGE_SIZE 0x300
+#define IMAGE_VADDR 0x10000
+#define IMAGE_STRTAB 0x100
+#define IMAGE_DYNAMIC 0x200
+#define IMAGE_STRINGS "\0libfoo.so.1\0libbar.so\0libme.so.2\0/opt/rpath\0$ORIGIN/../lib\0"
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "ELF64 LSB", .arg[0].signed_int = 1, .arg[1].signed_int = 0},
+        {.caseValue.sptr = "ELF64 MSB", .arg[0].signed_int = 1, .arg[1].signed_int = 1},
+        {.caseValue.sptr = "ELF32 LSB", .arg[0].signed_int = 0, .arg[1].signed_int = 0},
+        {.caseValue.sptr = "ELF32 MSB", .arg[0].signed_int = 0, .arg[1].signed_int = 1},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static void put(unsigned char *data, size_t offset, size_t size, uint64_t value, int big_endian) {
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = big_endian ? size - 1 - i : i;
+        data[offset + i] = (unsigned char) (value >> (shift * 8));
+    }
+}
+
+/**
+ * Generate a minimal shared library: one loadable segment covering the file, and a dynamic segment
+ */
+static void make_image(unsigned char *data, int is64, int big_endian, uint64_t rpath_offset) {
+    size_t word = is64 ? 8 : 4;
+    size_t phoff = is64 ? 64 : 52;
+    size_t phentsize = is64 ? 56 : 32;
+    uint64_t dynamic[][2] = {
+            {ELF_DT_NEEDED, 1},
+            {ELF_DT_NEEDED, 13},
+            {ELF_DT_SONAME, 23},
+            {ELF_DT_RPATH, rpath_offset},
+            {ELF_DT_RUNPATH, 45},
+            {ELF_DT_STRTAB, IMAGE_VADDR + IMAGE_STRTAB},
+            {ELF_DT_STRSZ, sizeof(IMAGE_STRINGS)},
+            {ELF_DT_NULL, 0},
+    };
+    size_t num_dynamic = sizeof(dynamic) / sizeof(*dynamic);
+
+    memset(data, 0, IMAGE_SIZE);
+    memcpy(data, "\x7f" "ELF", 4);
+    data[4] = is64 ? 2 : 1;
+    data[5] = big_endian ? 2 : 1;
+    data[6] = 1;
+    put(data, is64 ? 32 : 28, word, phoff, big_endian);
+    put(data, is64 ? 54 : 42, 2, phentsize, big_endian);
+    put(data, is64 ? 56 : 44, 2, 2, big_endian);
+
+    for (size_t i = 0; i < 2; i++) {
+        size_t base = phoff + i * phentsize;
+        uint64_t offset = i ? IMAGE_DYNAMIC : 0;
+        uint64_t size = i ? num_dynamic * word * 2 : IMAGE_SIZE;
+        put(data, base, 4, i ? ELF_PT_DYNAMIC : ELF_PT_LOAD, big_endian);
+        put(data, base + (is64 ? 8 : 4), word, offset, big_endian);
+        put(data, base + (is64 ? 16 : 8), word, IMAGE_VADDR + offset, big_endian);
+        put(data, base + (is64 ? 32 : 16), word, size, big_endian);
+        put(data, base + (is64 ? 40 : 20), word, size, big_endian);
+    }
+
+    memcpy(&data[IMAGE_STRTAB], IMAGE_STRINGS, sizeof(IMAGE_STRINGS));
+    for (size_t i = 0; i < num_dynamic; i++) {
+        put(data, IMAGE_DYNAMIC + i * word * 2, word, dynamic[i][0], big_endian);
+        put(data, IMAGE_DYNAMIC + i * word * 2 + word, word, dynamic[i][1], big_endian);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned char data[IMAGE_SIZE];
+    char filename[PATH_MAX];
+    ShlibInfo *info = NULL;
+
+    sprintf(filename, "%s.mock.so", basename(__FILE__));
+
+    // Every class and byte order
+    for (size_t i = 0; i < numCases; i++) {
+        make_image(data, testCase[i].arg[0].signed_int, testCase[i].arg[1].signed_int, 34);
+        mock(filename, data, sizeof(char), sizeof(data));
+
+        info = shlib_info(filename);
+        myassert(info != NULL, "case %zu: %s: shlib_info failed\n", i, testCase[i].caseValue.sptr);
+        myassert(strlist_count(info->needed) == 2, "case %zu: expected 2 libraries, got %zu\n", i, strlist_count(info->needed));
+        myassert(strcmp(strlist_item(info->needed, 0), "libfoo.so.1") == 0, testFmt, i, "needed[0]", strlist_item(info->needed, 0), "libfoo.so.1");
+        myassert(strcmp(strlist_item(info->needed, 1), "libbar.so") == 0, testFmt, i, "needed[1]", strlist_item(info->needed, 1), "libbar.so");
+        myassert(info->soname && strcmp(info->soname, "libme.so.2") == 0, testFmt, i, "soname", info->soname, "libme.so.2");
+        myassert(info->rpath && strcmp(info->rpath, "/opt/rpath") == 0, testFmt, i, "rpath", info->rpath, "/opt/rpath");
+        myassert(info->runpath && strcmp(info->runpath, "$ORIGIN/../lib") == 0, testFmt, i, "runpath", info->runpath, "$ORIGIN/../lib");
+        shlib_info_free(info);
+
+        // RUNPATH takes precedence
+        char *rpath = shlib_rpath(filename);
+        myassert(rpath && strcmp(rpath, "$ORIGIN/../lib") == 0, testFmt, i, "shlib_rpath", rpath, "$ORIGIN/../lib");
+        free(rpath);
+        unlink(filename);
+    }
+
+    // Results are cached until the file changes
+    make_image(data, 1, 0, 34);
+    mock(filename, data, sizeof(char), sizeof(data));
+    info = shlib_info(filename);
+    shlib_info_free(info);
+
+    FILE *fp = fopen(filename, "r+b");
+    fseek(fp, IMAGE_STRTAB + 34, SEEK_SET);
+    fwrite("/new/rpath", sizeof(char), 10, fp);
+    fclose(fp);
+    shlib_info_forget(filename);
+    info = shlib_info(filename);
+    myassert(info && strcmp(info->rpath, "/new/rpath") == 0, testFmt, (size_t) 0, "shlib_info (modified)", info ? info->rpath : NULL, "/new/rpath");
+    shlib_info_free(info);
+
+    fp = fopen(filename, "ab");
+    fwrite("\0", sizeof(char), 1, fp);
+    fclose(fp);
+    make_image(data, 1, 0, 0);
+    fp = fopen(filename, "r+b");
+    fwrite(data, sizeof(char), sizeof(data), fp);
+    fclose(fp);
+    info = shlib_info(filename);
+    myassert(info && strcmp(info->rpath, "") == 0, testFmt, (size_t) 1, "shlib_info (resized)", info ? info->rpath : NULL, "");
+    shlib_info_free(info);
+
+    // A string outside of the string table
+    make_image(data, 1, 0, sizeof(IMAGE_STRINGS));
+    mock(filename, data, sizeof(char), sizeof(data));
+    spmerrno = 0;
+    myassert(shlib_info(filename) == NULL, "string outside of the table was accepted\n");
+    myassert(spmerrno == SPM_ERR_PARSE, "expected SPM_ERR_PARSE, got %d\n", spmerrno);
+
+    // Program headers beyond the end of the file
+    make_image(data, 1, 0, 34);
+    put(data, 56, 2, 100, 0);
+    mock(filename, data, sizeof(char), sizeof(data));
+    myassert(shlib_info(filename) == NULL, "truncated program header table was accepted\n");
+
+    // Not an ELF image
+    mock(filename, (void *) "#!/bin/sh\nexit 0\n", sizeof(char), strlen("#!/bin/sh\nexit 0\n"));
+    myassert(shlib_info(filename) == NULL, "script was accepted\n");
+    myassert(shlib_info("/dev/null") == NULL, "/dev/null was accepted\n");
+    myassert(shlib_deps(filename) == NULL, "shlib_deps accepted a script\n");
+    unlink(filename);
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "spm.h"
+#include "framework.h"
+
+#define ITEMS 1000
+
+const char *testFmt = "jobs=%zu: item %zu returned '%zu', expected '%zu'\n";
+struct TestCase testCase[] = {
+        {.caseValue.unsigned_long = 1},
+        {.caseValue.unsigned_long = 2},
+        {.caseValue.unsigned_long = 8},
+        {.caseValue.unsigned_long = ITEMS * 2},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+static void square(size_t index, size_t worker, void *arg) {
+    size_t *data = arg;
+    data[index] = index * index;
+}
+
+int main(int argc, char *argv[]) {
+    size_t data[ITEMS];
+    for (size_t i = 0; i < numCases; i++) {
+        size_t jobs = testCase[i].caseValue.unsigned_long;
+        memset(data, '\0', sizeof(data));
+        int result = threadpool_run(jobs, ITEMS, square, data);
+        myassert(result == 0, "threadpool_run failed with %zu jobs\n", jobs);
+        for (size_t item = 0; item < ITEMS; item++) {
+            myassert(data[item] == item * item, testFmt, jobs, item, data[item], item * item);
+        }
+    }
+    myassert(threadpool_run(4, 0, square, data) == 0, "threadpool_run failed with no items\n");
+    return 0;
+}
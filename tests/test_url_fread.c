@@ -0,0 +1,88 @@
+#include "spm.h"
+#include "url.h"
+#include "framework.h"
+
+#define SOURCE_FILE "test_url_fread.txt"
+#define LINES_MAX 20000
+
+const char *testFmt = "case %zu: %s returned '%s', expected '%s'\n";
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "small reads", .arg[0].unsigned_long = 7},
+        {.caseValue.sptr = "line reads", .arg[0].unsigned_long = 0},
+        {.caseValue.sptr = "large reads", .arg[0].unsigned_long = URL_BUFFER_SIZE * 3 + 11},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    char cwd[PATH_MAX];
+    char url[PATH_MAX * 2];
+    char *data = NULL;
+    char *result = NULL;
+    size_t data_size = 0;
+
+    // Lines of varying length, so reads straddle the edges of curl's chunks
+    FILE *fp = fopen(SOURCE_FILE, "w");
+    for (size_t i = 0; i < LINES_MAX; i++) {
+        fprintf(fp, "line %zu %.*s\n", i, (int) (i % 97), "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+    }
+    fclose(fp);
+    data_size = get_file_size(SOURCE_FILE);
+    data = calloc(data_size + 1, sizeof(char));
+    fp = fopen(SOURCE_FILE, "r");
+    fread(data, 1, data_size, fp);
+    fclose(fp);
+
+    getcwd(cwd, sizeof(cwd));
+    snprintf(url, sizeof(url), "file://%s/%s", cwd, SOURCE_FILE);
+
+    // Every byte is returned once and in order, whatever the size of the reads
+    for (size_t i = 0; i < numCases; i++) {
+        size_t chunk = testCase[i].arg[0].unsigned_long;
+        size_t total = 0;
+        URL_FILE *handle = url_fopen(url, "r");
+        myassert(handle != NULL, "case %zu: url_fopen failed\n", i);
+
+        result = calloc(data_size + BUFSIZ, sizeof(char));
+        while (!url_feof(handle)) {
+            if (chunk) {
+                size_t bytes = url_fread(&result[total], 1, chunk, handle);
+                total += bytes;
+                if (!bytes) {
+                    break;
+                }
+            } else {
+                char line[BUFSIZ];
+                if (url_fgets(line, sizeof(line), handle) == NULL) {
+                    break;
+                }
+                strcpy(&result[total], line);
+                total += strlen(line);
+            }
+        }
+        url_fclose(handle);
+
+        myassert(total == data_size, "case %zu: %s: read %zu bytes, expected %zu\n", i, testCase[i].caseValue.sptr, total, data_size);
+        myassert(memcmp(result, data, data_size) == 0, "case %zu: %s: data differs\n", i, testCase[i].caseValue.sptr);
+        free(result);
+    }
+
+    // Reads of both kinds can be mixed on one handle
+    URL_FILE *handle = url_fopen(url, "r");
+    char line[BUFSIZ];
+    char expected[BUFSIZ];
+    char block[URL_BUFFER_SIZE * 2];
+    myassert(url_fgets(line, sizeof(line), handle) != NULL, "url_fgets failed\n");
+    myassert(strcmp(line, "line 0 \n") == 0, testFmt, (size_t) 0, "url_fgets", line, "line 0 \n");
+    myassert(url_fread(block, 1, sizeof(block), handle) == sizeof(block), "url_fread returned a short read\n");
+    myassert(memcmp(block, &data[strlen("line 0 \n")], sizeof(block)) == 0, "url_fread data differs\n");
+    url_fgets(line, sizeof(line), handle);
+    size_t offset = strlen("line 0 \n") + sizeof(block);
+    size_t length = (size_t) (strchr(&data[offset], '\n') - &data[offset]) + 1;
+    snprintf(expected, sizeof(expected), "%.*s", (int) length, &data[offset]);
+    myassert(strcmp(line, expected) == 0, testFmt, (size_t) 1, "url_fgets", line, expected);
+    url_fclose(handle);
+
+    free(data);
+    unlink(SOURCE_FILE);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s' should sort before '%s'\n";
+
+// Ascending order
+char *versions[] = {
+        "0", "0.0.1", "0.0.2", "0.0.10", "0.1", "0.1.1", "0.2", "0.9.10", "0.10.0", "0.10.10",
+        "1", "1+local", "1+local.2", "1a", "1.0.1",
+        "1.1.1.1.1.1.1.1.1.1", "1.1.1.1.1.1.1.1.1.2", "1.1.1.1.1.1.1.1.2",
+        "1.5", "1.255", "1.256", "1.65536", "1.4294967296", "2", "10",
+        "100.1a", "100.1a2", "100.3a10", "101", "101.1",
+        "2019.1", "2019.2a", "2019.3", "2019.12", "2020.1", "20201230.9", "20201231.1",
+};
+
+// Equal keys
+char *equal[][2] = {
+        {"1.2", "1.2.0"},
+        {"1.2", "1.2.0.0.0.0.0.0.0.0"},
+        {"1.02", "1.2"},
+        {"1.2RC1", "1.2rc1"},
+        {"", "0"},
+};
+
+int main(int argc, char *argv[]) {
+    size_t num_versions = sizeof(versions) / sizeof(*versions);
+    size_t num_equal = sizeof(equal) / sizeof(*equal);
+
+    for (size_t i = 1; i < num_versions; i++) {
+        char *a = version_key(versions[i - 1]);
+        char *b = version_key(versions[i]);
+        myassert(strcmp(a, b) < 0, testFmt, i, versions[i - 1], versions[i]);
+        myassert(memcmp(a, b, strlen(a) < strlen(b) ? strlen(a) + 1 : strlen(b) + 1) < 0, testFmt, i, versions[i - 1], versions[i]);
+        free(a);
+        free(b);
+    }
+
+    for (size_t i = 0; i < num_equal; i++) {
+        char *a = version_key(equal[i][0]);
+        char *b = version_key(equal[i][1]);
+        myassert(strcmp(a, b) == 0, "case %zu: '%s' and '%s' should be equal\n", i, equal[i][0], equal[i][1]);
+        free(a);
+        free(b);
+    }
+
+    // NULL is version "zero"
+    char *zero = version_key(NULL);
+    char *a = version_key("0");
+    myassert(strcmp(zero, a) == 0, "NULL and '0' should be equal\n");
+    free(zero);
+    free(a);
+
+    // A truncated key is still terminated
+    char buf[4];
+    size_t len = version_key_encode("1.2.3", buf, sizeof(buf));
+    myassert(len >= sizeof(buf), "expected truncation, returned %zu\n", len);
+    myassert(buf[sizeof(buf) - 1] == '\0', "truncated key is not terminated\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s' returned '%s', expected '%s'\n";
+const char *versions[] = {"1.0", "1.2.11", "1.2.11", "1.2.12", "1.3", "2.0", "2.0+local", NULL};
+struct TestCase testCase[] = {
+        {.caseValue.sptr = "zlib", .arg[0].sptr = "zlib", .arg[1].sptr = "1111111", .arg[2].sptr = "2.0+local"},
+        {.caseValue.sptr = "zlib>=1.2.12", .arg[0].sptr = "zlib", .arg[1].sptr = "0001111", .arg[2].sptr = "2.0+local"},
+        {.caseValue.sptr = "zlib<1.2.12", .arg[0].sptr = "zlib", .arg[1].sptr = "1110000", .arg[2].sptr = "1.2.11"},
+        {.caseValue.sptr = "zlib==1.2.11", .arg[0].sptr = "zlib", .arg[1].sptr = "0110000", .arg[2].sptr = "1.2.11"},
+        {.caseValue.sptr = "zlib!=1.2.11", .arg[0].sptr = "zlib", .arg[1].sptr = "1001111", .arg[2].sptr = "2.0+local"},
+        {.caseValue.sptr = "zlib~=1.2.11", .arg[0].sptr = "zlib", .arg[1].sptr = "0111000", .arg[2].sptr = "1.2.12"},
+        {.caseValue.sptr = "zlib~=1.2", .arg[0].sptr = "zlib", .arg[1].sptr = "0111100", .arg[2].sptr = "1.3"},
+        {.caseValue.sptr = "zlib>3", .arg[0].sptr = "zlib", .arg[1].sptr = "0000000", .arg[2].sptr = NULL},
+        {.caseValue.sptr = "zlib-1.2.11-0" SPM_PACKAGE_EXTENSION, .arg[0].sptr = "zlib", .arg[1].sptr = "1111111", .arg[2].sptr = "2.0+local"},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    Manifest *info = manifest_init();
+    size_t count = 0;
+
+    for (count = 0; versions[count] != NULL; count++);
+    for (size_t i = 0; i < count; i++) {
+        mock_package(info, "zlib", versions[i], "0", NULL);
+    }
+
+    for (size_t i = 0; i < numCases; i++) {
+        VersionSpec *spec = version_spec_compile(testCase[i].caseValue.sptr);
+        unsigned char match[sizeof(versions) / sizeof(*versions)] = {0};
+        char result[sizeof(versions) / sizeof(*versions)] = {0};
+        size_t expected_matches = 0;
+
+        myassert(spec != NULL, "case %zu: version_spec_compile failed\n", i);
+        myassert(strcmp(spec->spec, testCase[i].caseValue.sptr) == 0, testFmt, i, "spec", spec->spec, testCase[i].caseValue.sptr);
+        myassert(strcmp(spec->name, testCase[i].arg[0].sptr) == 0, testFmt, i, "name", spec->name, testCase[i].arg[0].sptr);
+
+        // Batch evaluation
+        size_t matches = version_spec_eval(spec, info->packages, info->records, match);
+        for (size_t p = 0; p < info->records; p++) {
+            result[p] = match[p] ? '1' : '0';
+            expected_matches += testCase[i].arg[1].sptr[p] == '1';
+            myassert(version_spec_test(spec, info->packages[p]->version_key) == match[p], "case %zu: version_spec_test disagrees on '%s'\n", i, versions[p]);
+        }
+        myassert(strcmp(result, testCase[i].arg[1].sptr) == 0, testFmt, i, testCase[i].caseValue.sptr, result, testCase[i].arg[1].sptr);
+        myassert(matches == expected_matches, "case %zu: returned %zu matches, expected %zu\n", i, matches, expected_matches);
+
+        // Highest match in a sorted array
+        ssize_t best = version_spec_best(spec, info->packages, info->records);
+        const char *best_version = best < 0 ? NULL : info->packages[best]->version;
+        if (testCase[i].arg[2].sptr == NULL) {
+            myassert(best < 0, testFmt, i, testCase[i].caseValue.sptr, best_version, "none");
+        } else {
+            myassert(best >= 0 && strcmp(best_version, testCase[i].arg[2].sptr) == 0, testFmt, i, testCase[i].caseValue.sptr, best_version ? best_version : "none", testCase[i].arg[2].sptr);
+        }
+        version_spec_free(spec);
+    }
+
+    manifest_free(info);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "spm.h"
+#include "framework.h"
+
+const char *testFmt = "case %zu: '%s%s%s' returned '%s', expected '%s'\n";
+const char *versions[] = {"1.2.12", "1.0", "1.2.11", "2.0", "1.2.11", NULL};
+struct TestCase testCase[] = {
+        {.arg[0].sptr = "zlib", .arg[1].sptr = ">=", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.2.11 1.2.11 1.2.12 2.0"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = ">", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.2.12 2.0"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "<=", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.0 1.2.11 1.2.11"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "<", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.0"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "==", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.2.11 1.2.11"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "!=", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.0 1.2.12 2.0"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "~=", .arg[2].sptr = "1.2.11", .arg[3].sptr = "1.2.11 1.2.11 1.2.12"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "~=", .arg[2].sptr = "1.0", .arg[3].sptr = "1.0 1.2.11 1.2.11 1.2.12"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = "~=", .arg[2].sptr = "1.2", .arg[3].sptr = "1.2.11 1.2.11 1.2.12"},
+        {.arg[0].sptr = "zlib", .arg[1].sptr = ">", .arg[2].sptr = "2.0", .arg[3].sptr = ""},
+        {.arg[0].sptr = "missing", .arg[1].sptr = ">=", .arg[2].sptr = "0", .arg[3].sptr = ""},
+};
+size_t numCases = sizeof(testCase) / sizeof(struct TestCase);
+
+int main(int argc, char *argv[]) {
+    Manifest *info = manifest_init();
+
+    for (size_t i = 0; versions[i] != NULL; i++) {
+        mock_package(info, "zlib", versions[i], "0", NULL);
+    }
+
+    for (size_t i = 0; i < numCases; i++) {
+        char result[255] = {0};
+        ManifestPackage **found = find_by_spec(info, testCase[i].arg[0].sptr, testCase[i].arg[1].sptr, testCase[i].arg[2].sptr);
+        myassert(found != NULL, "case %zu: find_by_spec failed\n", i);
+        for (size_t p = 0; found[p] != NULL; p++) {
+            if (p) {
+                strcat(result, " ");
+            }
+            strcat(result, found[p]->version);
+            manifest_package_free(found[p]);
+        }
+        free(found);
+        myassert(strcmp(result, testCase[i].arg[3].sptr) == 0, testFmt, i, testCase[i].arg[0].sptr,
+                 testCase[i].arg[1].sptr, testCase[i].arg[2].sptr, result, testCase[i].arg[3].sptr);
+    }
+
+    manifest_free(info);
+    return 0;
+}